@@ -1,7 +1,10 @@
 #include "basics.h"
 
+#include <chrono>
+#include <string.h>
+
 // keys for use with the settings API
-const char *const k_pch_Sample_Section = "driver_null";
+const char *const k_pch_Sample_Section = "driver_sample";
 const char *const k_pch_Sample_SerialNumber_String = "serialNumber";
 const char *const k_pch_Sample_ModelNumber_String = "modelNumber";
 const char *const k_pch_Sample_WindowX_Int32 = "windowX";
@@ -12,9 +15,87 @@ const char *const k_pch_Sample_RenderWidth_Int32 = "renderWidth";
 const char *const k_pch_Sample_RenderHeight_Int32 = "renderHeight";
 const char *const k_pch_Sample_SecondsFromVsyncToPhotons_Float = "secondsFromVsyncToPhotons";
 const char *const k_pch_Sample_DisplayFrequency_Float = "displayFrequency";
+const char *const k_pch_Sample_HmdCount_Int32 = "hmdCount";
+const char *const k_pch_Sample_ControllerCount_Int32 = "controllerCount";
+const char *const k_pch_Sample_TrackerCount_Int32 = "trackerCount";
+const char *const k_pch_Sample_KeyboardInput_Bool = "keyboardInput";
+const char *const k_pch_Sample_TransportPort_Int32 = "transportPort";
+const char *const k_pch_Sample_DeviceTimeout_Float = "deviceTimeout";
+const char *const k_pch_Sample_PoseRate_Float = "poseRate";
+const char *const k_pch_Sample_WorkerThreads_Int32 = "workerThreads";
+const char *const k_pch_Sample_WorkerFirstCpu_Int32 = "workerFirstCpu";
+const char *const k_pch_Sample_StandbyPoseRate_Float = "standbyPoseRate";
+const char *const k_pch_Sample_LensModel_String = "lensModel";
+const char *const k_pch_Sample_LensCoefficientsRed_String = "lensCoefficientsRed";
+const char *const k_pch_Sample_LensCoefficientsGreen_String = "lensCoefficientsGreen";
+const char *const k_pch_Sample_LensCoefficientsBlue_String = "lensCoefficientsBlue";
+const char *const k_pch_Sample_LensCenterLeftU_Float = "lensCenterLeftU";
+const char *const k_pch_Sample_LensCenterLeftV_Float = "lensCenterLeftV";
+const char *const k_pch_Sample_LensCenterRightU_Float = "lensCenterRightU";
+const char *const k_pch_Sample_LensCenterRightV_Float = "lensCenterRightV";
+const char *const k_pch_Sample_LensLutResolution_Int32 = "lensLutResolution";
+const char *const k_pch_Sample_PanelWidth_Float = "panelWidth";
+const char *const k_pch_Sample_PanelHeight_Float = "panelHeight";
+const char *const k_pch_Sample_LensFocalLength_Float = "lensFocalLength";
+const char *const k_pch_Sample_LensSeparation_Float = "lensSeparation";
+const char *const k_pch_Sample_LensFov_Float = "lensFov";
+const char *const k_pch_Sample_RenderQuality_Float = "renderQuality";
+const char *const k_pch_Sample_VirtualDisplay_Bool = "virtualDisplay";
+const char *const k_pch_Sample_FrameExportName_String = "frameExportName";
+const char *const k_pch_Sample_SoftwareVsync_Bool = "softwareVsync";
+const char *const k_pch_Sample_VsyncJitterStats_Bool = "vsyncJitterStats";
+const char *const k_pch_Sample_AdaptiveRender_Bool = "adaptiveRender";
+const char *const k_pch_Sample_AdaptiveMinScale_Float = "adaptiveMinScale";
+const char *const k_pch_Sample_AdaptiveMinFrequency_Float = "adaptiveMinFrequency";
+const char *const k_pch_Sample_AdaptiveFrequencyStep_Float = "adaptiveFrequencyStep";
+const char *const k_pch_Sample_AdaptiveTargetLoad_Float = "adaptiveTargetLoad";
+const char *const k_pch_Sample_AdaptiveHysteresis_Float = "adaptiveHysteresis";
+const char *const k_pch_Sample_TraceEnabled_Bool = "traceEnabled";
+const char *const k_pch_Sample_TraceDirectory_String = "traceDirectory";
+const char *const k_pch_Sample_TraceRecords_Int32 = "traceRecords";
+const char *const k_pch_Sample_LogLevels_String = "logLevels";
+const char *const k_pch_Sample_RunFrameStallMs_Float = "runFrameStallMs";
+const char *const k_pch_Sample_StallWarnInterval_Float = "stallWarnInterval";
+const char *const k_pch_Sample_MetricsSocket_String = "metricsSocket";
 
 bool g_bExiting = false;
 
+uint64_t GetTimestampNs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int32_t GetSampleSettingInt32(const char *pchSettingsKey, int32_t nDefault)
+{
+    vr::EVRSettingsError eError = vr::VRSettingsError_None;
+    int32_t nValue = vr::VRSettings()->GetInt32(k_pch_Sample_Section, pchSettingsKey, &eError);
+    return eError == vr::VRSettingsError_None ? nValue : nDefault;
+}
+
+float GetSampleSettingFloat(const char *pchSettingsKey, float flDefault)
+{
+    vr::EVRSettingsError eError = vr::VRSettingsError_None;
+    float flValue = vr::VRSettings()->GetFloat(k_pch_Sample_Section, pchSettingsKey, &eError);
+    return eError == vr::VRSettingsError_None ? flValue : flDefault;
+}
+
+bool GetSampleSettingBool(const char *pchSettingsKey, bool bDefault)
+{
+    vr::EVRSettingsError eError = vr::VRSettingsError_None;
+    bool bValue = vr::VRSettings()->GetBool(k_pch_Sample_Section, pchSettingsKey, &eError);
+    return eError == vr::VRSettingsError_None ? bValue : bDefault;
+}
+
+void GetSampleSettingString(const char *pchSettingsKey, char *pchValue, uint32_t unValueLen, const char *pchDefault)
+{
+    vr::EVRSettingsError eError = vr::VRSettingsError_None;
+    vr::VRSettings()->GetString(k_pch_Sample_Section, pchSettingsKey, pchValue, unValueLen, &eError);
+    if (eError != vr::VRSettingsError_None && unValueLen > 0) {
+        strncpy(pchValue, pchDefault, unValueLen - 1);
+        pchValue[unValueLen - 1] = 0;
+    }
+}
+
 #if !defined(_WINDOWS)
 
 int GetAsyncKeyState(int key)
@@ -3,6 +3,8 @@
 
 #include <openvr_driver.h>
 
+#include <math.h>
+
 #if defined(_WINDOWS)
 #include <windows.h>
 #else
@@ -38,9 +40,60 @@ extern const char *const k_pch_Sample_RenderWidth_Int32;
 extern const char *const k_pch_Sample_RenderHeight_Int32;
 extern const char *const k_pch_Sample_SecondsFromVsyncToPhotons_Float;
 extern const char *const k_pch_Sample_DisplayFrequency_Float;
+extern const char *const k_pch_Sample_HmdCount_Int32;
+extern const char *const k_pch_Sample_ControllerCount_Int32;
+extern const char *const k_pch_Sample_TrackerCount_Int32;
+extern const char *const k_pch_Sample_KeyboardInput_Bool;
+extern const char *const k_pch_Sample_TransportPort_Int32;
+extern const char *const k_pch_Sample_DeviceTimeout_Float;
+extern const char *const k_pch_Sample_PoseRate_Float;
+extern const char *const k_pch_Sample_WorkerThreads_Int32;
+extern const char *const k_pch_Sample_WorkerFirstCpu_Int32;
+extern const char *const k_pch_Sample_StandbyPoseRate_Float;
+extern const char *const k_pch_Sample_LensModel_String;
+extern const char *const k_pch_Sample_LensCoefficientsRed_String;
+extern const char *const k_pch_Sample_LensCoefficientsGreen_String;
+extern const char *const k_pch_Sample_LensCoefficientsBlue_String;
+extern const char *const k_pch_Sample_LensCenterLeftU_Float;
+extern const char *const k_pch_Sample_LensCenterLeftV_Float;
+extern const char *const k_pch_Sample_LensCenterRightU_Float;
+extern const char *const k_pch_Sample_LensCenterRightV_Float;
+extern const char *const k_pch_Sample_LensLutResolution_Int32;
+extern const char *const k_pch_Sample_PanelWidth_Float;
+extern const char *const k_pch_Sample_PanelHeight_Float;
+extern const char *const k_pch_Sample_LensFocalLength_Float;
+extern const char *const k_pch_Sample_LensSeparation_Float;
+extern const char *const k_pch_Sample_LensFov_Float;
+extern const char *const k_pch_Sample_RenderQuality_Float;
+extern const char *const k_pch_Sample_VirtualDisplay_Bool;
+extern const char *const k_pch_Sample_FrameExportName_String;
+extern const char *const k_pch_Sample_SoftwareVsync_Bool;
+extern const char *const k_pch_Sample_VsyncJitterStats_Bool;
+extern const char *const k_pch_Sample_AdaptiveRender_Bool;
+extern const char *const k_pch_Sample_AdaptiveMinScale_Float;
+extern const char *const k_pch_Sample_AdaptiveMinFrequency_Float;
+extern const char *const k_pch_Sample_AdaptiveFrequencyStep_Float;
+extern const char *const k_pch_Sample_AdaptiveTargetLoad_Float;
+extern const char *const k_pch_Sample_AdaptiveHysteresis_Float;
+extern const char *const k_pch_Sample_TraceEnabled_Bool;
+extern const char *const k_pch_Sample_TraceDirectory_String;
+extern const char *const k_pch_Sample_TraceRecords_Int32;
+extern const char *const k_pch_Sample_LogLevels_String;
+extern const char *const k_pch_Sample_RunFrameStallMs_Float;
+extern const char *const k_pch_Sample_StallWarnInterval_Float;
+extern const char *const k_pch_Sample_MetricsSocket_String;
+
+// settings lookups in the sample section that fall back to a default when the key is missing
+int32_t GetSampleSettingInt32(const char *pchSettingsKey, int32_t nDefault);
+float GetSampleSettingFloat(const char *pchSettingsKey, float flDefault);
+bool GetSampleSettingBool(const char *pchSettingsKey, bool bDefault);
+void GetSampleSettingString(const char *pchSettingsKey, char *pchValue, uint32_t unValueLen, const char *pchDefault);
 
 extern bool g_bExiting;
 
+// monotonic clock shared by all timing code of the driver
+uint64_t GetTimestampNs();
+
 inline vr::HmdQuaternion_t HmdQuaternion_Init( double w, double x, double y, double z )
 {
     vr::HmdQuaternion_t quat;
@@ -51,6 +104,36 @@ inline vr::HmdQuaternion_t HmdQuaternion_Init( double w, double x, double y, dou
     return quat;
 }
 
+inline vr::HmdQuaternion_t HmdQuaternion_Conjugate(const vr::HmdQuaternion_t &q)
+{
+    return HmdQuaternion_Init(q.w, -q.x, -q.y, -q.z);
+}
+
+inline vr::HmdQuaternion_t HmdQuaternion_Multiply(const vr::HmdQuaternion_t &a, const vr::HmdQuaternion_t &b)
+{
+    return HmdQuaternion_Init(
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w);
+}
+
+// yaw about y, pitch about x and roll about z, applied in that order, as the keyboard emulation turns
+inline vr::HmdQuaternion_t HmdQuaternion_FromEuler(double yaw, double pitch, double roll)
+{
+    double t0 = cos(yaw * 0.5);
+    double t1 = sin(yaw * 0.5);
+    double t2 = cos(roll * 0.5);
+    double t3 = sin(roll * 0.5);
+    double t4 = cos(pitch * 0.5);
+    double t5 = sin(pitch * 0.5);
+    return HmdQuaternion_Init(
+        t0 * t2 * t4 + t1 * t3 * t5,
+        t0 * t3 * t4 - t1 * t2 * t5,
+        t0 * t2 * t5 + t1 * t3 * t4,
+        t1 * t2 * t4 - t0 * t3 * t5);
+}
+
 inline void HmdMatrix_SetIdentity(vr::HmdMatrix34_t *pMatrix)
 {
     pMatrix->m[0][0] = 1.f;
@@ -0,0 +1,647 @@
+// Microbenchmarks of the driver's hot paths, for comparing builds.
+//
+// usage: driver_benchmarks [--filter=<substring>] [--min-time=<seconds>] [--repetitions=<n>]
+//                          [--format=console|json|csv] [--out=<file>] [--list]
+//
+// Covers GetPose of the HMD, controllers and trackers (keyboard emulation and
+// transport poses), the Euler angle to quaternion conversion, ComputeDistortion
+// over a whole compositor mesh, controller input snapshots and the pose packet
+// codec. The devices are the real driver classes running against the mock host,
+// so they see the same settings, properties and input interfaces as under
+// SteamVR.
+//
+// Every case runs enough iterations to take at least --min-time (0.2 s) and is
+// repeated --repetitions times (5). json is the format of Google Benchmark, so
+// its compare.py diffs two runs; csv has one line per repetition and per
+// aggregate. Times are per iteration in nanoseconds.
+
+#include "basics.h"
+#include "csamplecontrollerdriver.h"
+#include "csampledevicedriver.h"
+#include "csamplelensmodel.h"
+#include "csampletrackerdriver.h"
+#include "csampleudptransport.h"
+#include "../tools/csamplemockhost.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#if defined(_WINDOWS)
+#include <windows.h>
+#endif
+
+using namespace vr;
+
+#if defined(_MSC_VER)
+static const void *volatile s_pvSink;
+
+// forces the compiler to produce the value without the cost of storing it
+template <typename T>
+inline void KeepValue(const T &value)
+{
+    s_pvSink = &value;
+}
+#else
+template <typename T>
+inline void KeepValue(const T &value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+#endif
+
+static uint64_t GetThreadCpuNs()
+{
+#if defined(_WINDOWS)
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    uint64_t ulKernel = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t ulUser = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (ulKernel + ulUser) * 100;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Fixture: the mock host as driver context and one device of every kind
+//-----------------------------------------------------------------------------
+static const uint32_t k_unMeshSide = 256; // the compositor asks for about this many points per eye
+static const uint32_t k_unDatagramPackets = 16;
+
+static CSampleMockHost *s_pHost;
+static CSampleDeviceDriver *s_pHmdKeyboard;
+static CSampleDeviceDriver *s_pHmdTransport;
+static CSampleControllerDriver *s_pControllerKeyboard;
+static CSampleControllerDriver *s_pControllerTransport;
+static CSampleTrackerDriver *s_pTracker;
+static CSampleLensModel s_lensModel;
+static std::vector<float> s_vecMeshU;
+static std::vector<float> s_vecMeshV;
+static std::vector<DistortionCoordinates_t> s_vecMeshOut;
+static uint8_t s_rgubDatagram[k_unDatagramPackets * sizeof(SamplePosePacket_t)];
+
+static bool SetupFixture()
+{
+    s_pHost = new CSampleMockHost();
+    s_pHost->SetLogFile(nullptr);
+
+    // a lens with chromatic aberration, so distortion does the full work of all three channels
+    s_pHost->SetSetting(k_pch_Sample_Section, k_pch_Sample_LensModel_String, "brown");
+    s_pHost->SetSetting(k_pch_Sample_Section, k_pch_Sample_LensCoefficientsRed_String, "0.20 0.22 0.01 0.001 -0.001");
+    s_pHost->SetSetting(k_pch_Sample_Section, k_pch_Sample_LensCoefficientsGreen_String, "0.22 0.24 0.01 0.001 -0.001");
+    s_pHost->SetSetting(k_pch_Sample_Section, k_pch_Sample_LensCoefficientsBlue_String, "0.24 0.26 0.01 0.001 -0.001");
+    s_pHost->SetSetting(k_pch_Sample_Section, k_pch_Sample_SerialNumber_String, "bench");
+    s_pHost->SetSetting(k_pch_SteamVR_Section, k_pch_SteamVR_IPD_Float, "0.063");
+    if (InitServerDriverContext(s_pHost) != VRInitError_None) {
+        return false;
+    }
+
+    s_pHmdKeyboard = new CSampleDeviceDriver();
+    s_pHmdTransport = new CSampleDeviceDriver();
+    s_pHmdTransport->SetHmdIndex(2);
+    s_pControllerKeyboard = new CSampleControllerDriver();
+    s_pControllerKeyboard->SetControllerIndex(1);
+    s_pControllerTransport = new CSampleControllerDriver();
+    s_pControllerTransport->SetControllerIndex(3);
+    s_pTracker = new CSampleTrackerDriver();
+    s_pTracker->SetTrackerIndex(1);
+
+    CSampleTrackedDevice *rgpDevices[] = { s_pHmdKeyboard, s_pHmdTransport, s_pControllerKeyboard, s_pControllerTransport, s_pTracker };
+    const double rdPosition[3] = { 0.1, 1.6, -0.2 };
+    HmdQuaternion_t qRotation = HmdQuaternion_FromEuler(0.3, 0.1, 0.05);
+    for (uint32_t i = 0; i < sizeof(rgpDevices) / sizeof(rgpDevices[0]); i++) {
+        if (rgpDevices[i]->Activate(i) != VRInitError_None) {
+            return false;
+        }
+        rgpDevices[i]->SetConnectionTimeout(1e6);
+        rgpDevices[i]->OnTransportData();
+        if (!rgpDevices[i]->IsKeyboardDriven()) {
+            rgpDevices[i]->OnTransportPose(rdPosition, qRotation);
+        }
+    }
+
+    s_lensModel.SetModel(SampleLensModel_BrownConrady);
+    const float rgflRed[k_unSampleLensCoefficients] = { 0.20f, 0.22f, 0.01f, 0.001f, -0.001f };
+    const float rgflGreen[k_unSampleLensCoefficients] = { 0.22f, 0.24f, 0.01f, 0.001f, -0.001f };
+    const float rgflBlue[k_unSampleLensCoefficients] = { 0.24f, 0.26f, 0.01f, 0.001f, -0.001f };
+    s_lensModel.SetCoefficients(SampleLensChannel_Red, rgflRed);
+    s_lensModel.SetCoefficients(SampleLensChannel_Green, rgflGreen);
+    s_lensModel.SetCoefficients(SampleLensChannel_Blue, rgflBlue);
+
+    uint32_t unPoints = k_unMeshSide * k_unMeshSide;
+    s_vecMeshU.resize(unPoints);
+    s_vecMeshV.resize(unPoints);
+    s_vecMeshOut.resize(unPoints);
+    for (uint32_t y = 0; y < k_unMeshSide; y++) {
+        for (uint32_t x = 0; x < k_unMeshSide; x++) {
+            s_vecMeshU[y * k_unMeshSide + x] = (float)x / (k_unMeshSide - 1);
+            s_vecMeshV[y * k_unMeshSide + x] = (float)y / (k_unMeshSide - 1);
+        }
+    }
+
+    for (uint32_t i = 0; i < k_unDatagramPackets; i++) {
+        SamplePosePacket_t packet = { k_unSamplePosePacketMagic, (uint16_t)(i % 4), 0, i, { 0.1f, 1.6f, -0.2f }, { 1.0f, 0.0f, 0.0f, 0.0f } };
+        EncodeSamplePosePacket(packet, s_rgubDatagram + i * sizeof(SamplePosePacket_t), sizeof(SamplePosePacket_t));
+    }
+    return true;
+}
+
+static void TeardownFixture()
+{
+    CSampleTrackedDevice *rgpDevices[] = { s_pHmdKeyboard, s_pHmdTransport, s_pControllerKeyboard, s_pControllerTransport, s_pTracker };
+    for (CSampleTrackedDevice *pDevice : rgpDevices) {
+        pDevice->Deactivate();
+        delete pDevice;
+    }
+    CleanupDriverContext();
+    delete s_pHost;
+}
+
+//-----------------------------------------------------------------------------
+// Cases: run the given number of iterations, return the items processed
+//-----------------------------------------------------------------------------
+static uint64_t BenchHmdKeyboardPose(uint64_t ulIterations)
+{
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        DriverPose_t pose = s_pHmdKeyboard->GetPose();
+        KeepValue(pose);
+    }
+    return ulIterations;
+}
+
+static uint64_t BenchHmdTransportPose(uint64_t ulIterations)
+{
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        DriverPose_t pose = s_pHmdTransport->GetPose();
+        KeepValue(pose);
+    }
+    return ulIterations;
+}
+
+static uint64_t BenchControllerKeyboardPose(uint64_t ulIterations)
+{
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        DriverPose_t pose = s_pControllerKeyboard->GetPose();
+        KeepValue(pose);
+    }
+    return ulIterations;
+}
+
+static uint64_t BenchControllerTransportPose(uint64_t ulIterations)
+{
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        DriverPose_t pose = s_pControllerTransport->GetPose();
+        KeepValue(pose);
+    }
+    return ulIterations;
+}
+
+static uint64_t BenchTrackerTransportPose(uint64_t ulIterations)
+{
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        DriverPose_t pose = s_pTracker->GetPose();
+        KeepValue(pose);
+    }
+    return ulIterations;
+}
+
+// what the pose thread does per device and tick before submitting: GetPose plus the latency histogram
+static uint64_t BenchUpdatePose(uint64_t ulIterations)
+{
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        s_pControllerTransport->UpdatePose();
+    }
+    return ulIterations;
+}
+
+static uint64_t BenchEulerToQuaternion(uint64_t ulIterations)
+{
+    // the angles change every iteration so the conversion can't be hoisted out of the loop
+    double flAngle = 0.0;
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        HmdQuaternion_t q = HmdQuaternion_FromEuler(flAngle, flAngle * 0.5, flAngle * 0.25);
+        KeepValue(q);
+        flAngle += 0.001;
+    }
+    return ulIterations;
+}
+
+static uint64_t BenchComputeDistortionMesh(uint64_t ulIterations)
+{
+    uint32_t unPoints = k_unMeshSide * k_unMeshSide;
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        for (uint32_t unEye = 0; unEye < 2; unEye++) {
+            for (uint32_t j = 0; j < unPoints; j++) {
+                s_vecMeshOut[j] = s_pHmdKeyboard->ComputeDistortion((EVREye)unEye, s_vecMeshU[j], s_vecMeshV[j]);
+            }
+            KeepValue(s_vecMeshOut[0]);
+        }
+    }
+    return ulIterations * unPoints * 2;
+}
+
+// the lens evaluated for every point instead of the baked grid ComputeDistortion reads
+static uint64_t BenchLensEvaluateMesh(uint64_t ulIterations)
+{
+    uint32_t unPoints = k_unMeshSide * k_unMeshSide;
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        for (uint32_t unEye = 0; unEye < 2; unEye++) {
+            s_lensModel.EvaluateBatch((EVREye)unEye, s_vecMeshU.data(), s_vecMeshV.data(), unPoints, s_vecMeshOut.data());
+            KeepValue(s_vecMeshOut[0]);
+        }
+    }
+    return ulIterations * unPoints * 2;
+}
+
+static uint64_t BenchReadInput(uint64_t ulIterations)
+{
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        SampleControllerInput_t input;
+        s_pControllerKeyboard->ReadKeyboardInput(&input);
+        KeepValue(input);
+    }
+    return ulIterations;
+}
+
+// the common case: nothing changed since the last frame and nothing goes to SteamVR
+static uint64_t BenchApplyInputUnchanged(uint64_t ulIterations)
+{
+    SampleControllerInput_t input = {};
+    s_pControllerKeyboard->ApplyInput(input, GetTimestampNs());
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        s_pControllerKeyboard->ApplyInput(input, 0);
+    }
+    return ulIterations;
+}
+
+// every button and axis flips, so all seven components are sent to the host each time
+static uint64_t BenchApplyInputChanged(uint64_t ulIterations)
+{
+    SampleControllerInput_t rgInputs[2] = {};
+    for (uint32_t i = 0; i < 4; i++) {
+        rgInputs[1].rgbButtons[i] = true;
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        rgInputs[1].rgflAxes[i] = 1.0f;
+    }
+    uint64_t ulNow = GetTimestampNs();
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        s_pControllerKeyboard->ApplyInput(rgInputs[(i + 1) & 1], ulNow);
+    }
+    return ulIterations * 7;
+}
+
+static uint64_t BenchPollKeyboard(uint64_t ulIterations)
+{
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        CSampleDeviceDriver::PollKeyboard();
+        CSampleControllerDriver::PollKeyboard();
+    }
+    return ulIterations;
+}
+
+static uint64_t BenchEncodePosePacket(uint64_t ulIterations)
+{
+    SamplePosePacket_t packet = { k_unSamplePosePacketMagic, 1, 0, 0, { 0.1f, 1.6f, -0.2f }, { 1.0f, 0.0f, 0.0f, 0.0f } };
+    uint8_t rgubPacket[sizeof(SamplePosePacket_t)];
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        packet.unSequence = (uint32_t)i;
+        size_t cbWritten = EncodeSamplePosePacket(packet, rgubPacket, sizeof(rgubPacket));
+        KeepValue(cbWritten);
+        KeepValue(rgubPacket);
+    }
+    return ulIterations;
+}
+
+static uint64_t BenchDecodePosePacket(uint64_t ulIterations)
+{
+    SamplePosePacket_t packet;
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        bool bDecoded = DecodeSamplePosePacket(s_rgubDatagram + (i % k_unDatagramPackets) * sizeof(SamplePosePacket_t), sizeof(SamplePosePacket_t), &packet);
+        KeepValue(bDecoded);
+        KeepValue(packet);
+    }
+    return ulIterations;
+}
+
+// a datagram of several packets back to back, walked the way the transport does
+static uint64_t BenchDecodeDatagram(uint64_t ulIterations)
+{
+    for (uint64_t i = 0; i < ulIterations; i++) {
+        const uint8_t *pData = s_rgubDatagram;
+        size_t cbData = sizeof(s_rgubDatagram);
+        SamplePosePacket_t packet;
+        while (DecodeSamplePosePacket(pData, cbData, &packet)) {
+            KeepValue(packet);
+            pData += sizeof(SamplePosePacket_t);
+            cbData -= sizeof(SamplePosePacket_t);
+        }
+    }
+    return ulIterations * k_unDatagramPackets;
+}
+
+struct BenchmarkCase_t
+{
+    const char *pchName;
+    uint64_t (*pfnRun)(uint64_t ulIterations);
+};
+
+static const BenchmarkCase_t k_rgCases[] = {
+    { "pose/hmd_keyboard", BenchHmdKeyboardPose },
+    { "pose/hmd_transport", BenchHmdTransportPose },
+    { "pose/controller_keyboard", BenchControllerKeyboardPose },
+    { "pose/controller_transport", BenchControllerTransportPose },
+    { "pose/tracker_transport", BenchTrackerTransportPose },
+    { "pose/update", BenchUpdatePose },
+    { "math/euler_to_quaternion", BenchEulerToQuaternion },
+    { "distortion/compute_mesh", BenchComputeDistortionMesh },
+    { "distortion/lens_evaluate_mesh", BenchLensEvaluateMesh },
+    { "input/read_snapshot", BenchReadInput },
+    { "input/apply_unchanged", BenchApplyInputUnchanged },
+    { "input/apply_changed", BenchApplyInputChanged },
+    { "input/poll_keyboard", BenchPollKeyboard },
+    { "codec/encode_pose_packet", BenchEncodePosePacket },
+    { "codec/decode_pose_packet", BenchDecodePosePacket },
+    { "codec/decode_datagram", BenchDecodeDatagram },
+};
+
+//-----------------------------------------------------------------------------
+// Harness
+//-----------------------------------------------------------------------------
+struct BenchmarkRun_t
+{
+    uint64_t ulIterations;
+    double flRealNs;       // per iteration
+    double flCpuNs;        // per iteration
+    double flItemsPerSecond;
+};
+
+static BenchmarkRun_t RunOnce(const BenchmarkCase_t &benchmark, uint64_t ulIterations)
+{
+    uint64_t ulCpuStart = GetThreadCpuNs();
+    uint64_t ulStart = GetTimestampNs();
+    uint64_t ulItems = benchmark.pfnRun(ulIterations);
+    uint64_t ulRealNs = GetTimestampNs() - ulStart;
+    uint64_t ulCpuNs = GetThreadCpuNs() - ulCpuStart;
+
+    BenchmarkRun_t run;
+    run.ulIterations = ulIterations;
+    run.flRealNs = (double)ulRealNs / ulIterations;
+    run.flCpuNs = (double)ulCpuNs / ulIterations;
+    run.flItemsPerSecond = ulRealNs ? ulItems * 1e9 / ulRealNs : 0.0;
+    return run;
+}
+
+// grows the iteration count until one run takes the minimum time, like Google Benchmark does
+static uint64_t CalibrateIterations(const BenchmarkCase_t &benchmark, double flMinSeconds)
+{
+    uint64_t ulIterations = 1;
+    for (;;) {
+        BenchmarkRun_t run = RunOnce(benchmark, ulIterations);
+        double flSeconds = run.flRealNs * ulIterations * 1e-9;
+        if (flSeconds >= flMinSeconds || ulIterations >= 1000000000ull) {
+            return ulIterations;
+        }
+        double flScale = flSeconds > 0.0 ? flMinSeconds * 1.4 / flSeconds : 10.0;
+        flScale = std::min(std::max(flScale, 2.0), 10.0);
+        ulIterations = (uint64_t)(ulIterations * flScale);
+    }
+}
+
+enum EOutputFormat
+{
+    OutputFormat_Console,
+    OutputFormat_Json,
+    OutputFormat_Csv,
+};
+
+struct BenchmarkResult_t
+{
+    const char *pchName;
+    std::vector<BenchmarkRun_t> vecRuns;
+    BenchmarkRun_t mean;
+    BenchmarkRun_t median;
+    BenchmarkRun_t stddev;
+};
+
+static void Aggregate(BenchmarkResult_t *pResult)
+{
+    const std::vector<BenchmarkRun_t> &vecRuns = pResult->vecRuns;
+    size_t unRuns = vecRuns.size();
+    BenchmarkRun_t mean = { vecRuns[0].ulIterations, 0.0, 0.0, 0.0 };
+    for (const BenchmarkRun_t &run : vecRuns) {
+        mean.flRealNs += run.flRealNs / unRuns;
+        mean.flCpuNs += run.flCpuNs / unRuns;
+        mean.flItemsPerSecond += run.flItemsPerSecond / unRuns;
+    }
+
+    BenchmarkRun_t stddev = { vecRuns[0].ulIterations, 0.0, 0.0, 0.0 };
+    for (const BenchmarkRun_t &run : vecRuns) {
+        stddev.flRealNs += (run.flRealNs - mean.flRealNs) * (run.flRealNs - mean.flRealNs);
+        stddev.flCpuNs += (run.flCpuNs - mean.flCpuNs) * (run.flCpuNs - mean.flCpuNs);
+        stddev.flItemsPerSecond += (run.flItemsPerSecond - mean.flItemsPerSecond) * (run.flItemsPerSecond - mean.flItemsPerSecond);
+    }
+    double flDivisor = unRuns > 1 ? (double)(unRuns - 1) : 1.0;
+    stddev.flRealNs = sqrt(stddev.flRealNs / flDivisor);
+    stddev.flCpuNs = sqrt(stddev.flCpuNs / flDivisor);
+    stddev.flItemsPerSecond = sqrt(stddev.flItemsPerSecond / flDivisor);
+
+    // median of each column on its own
+    std::vector<double> vecValues(unRuns);
+    BenchmarkRun_t median = { vecRuns[0].ulIterations, 0.0, 0.0, 0.0 };
+    double BenchmarkRun_t::*rgpMembers[3] = { &BenchmarkRun_t::flRealNs, &BenchmarkRun_t::flCpuNs, &BenchmarkRun_t::flItemsPerSecond };
+    for (double BenchmarkRun_t::*pMember : rgpMembers) {
+        for (size_t i = 0; i < unRuns; i++) {
+            vecValues[i] = vecRuns[i].*pMember;
+        }
+        std::sort(vecValues.begin(), vecValues.end());
+        median.*pMember = unRuns % 2 ? vecValues[unRuns / 2] : (vecValues[unRuns / 2 - 1] + vecValues[unRuns / 2]) * 0.5;
+    }
+
+    pResult->mean = mean;
+    pResult->median = median;
+    pResult->stddev = stddev;
+}
+
+static void WriteJsonRun(FILE *pFile, bool *pbFirst, const char *pchName, const char *pchAggregate, uint32_t unRepetitions, uint32_t unIndex,
+    const BenchmarkRun_t &run)
+{
+    fprintf(pFile, "%s\n    {\n", *pbFirst ? "" : ",");
+    *pbFirst = false;
+    if (pchAggregate) {
+        fprintf(pFile, "      \"name\": \"%s_%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"aggregate\",\n      \"aggregate_name\": \"%s\",\n",
+            pchName, pchAggregate, pchName, pchAggregate);
+    } else {
+        fprintf(pFile, "      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"iteration\",\n      \"repetition_index\": %u,\n",
+            pchName, pchName, unIndex);
+    }
+    fprintf(pFile, "      \"repetitions\": %u,\n      \"threads\": 1,\n      \"iterations\": %llu,\n      \"real_time\": %.4f,\n      \"cpu_time\": %.4f,\n"
+        "      \"time_unit\": \"ns\",\n      \"items_per_second\": %.1f\n    }",
+        unRepetitions, (unsigned long long)run.ulIterations, run.flRealNs, run.flCpuNs, run.flItemsPerSecond);
+}
+
+static void WriteJsonString(FILE *pFile, const char *pchValue)
+{
+    fputc('"', pFile);
+    for (const char *pch = pchValue; *pch; pch++) {
+        if (*pch == '"' || *pch == '\\') {
+            fputc('\\', pFile);
+        }
+        fputc(*pch, pFile);
+    }
+    fputc('"', pFile);
+}
+
+static void WriteJson(FILE *pFile, const char *pchExecutable, const std::vector<BenchmarkResult_t> &vecResults, uint32_t unRepetitions)
+{
+    char rgchDate[64];
+    time_t now = time(nullptr);
+    strftime(rgchDate, sizeof(rgchDate), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+#if defined(NDEBUG)
+    const char *pchBuildType = "release";
+#else
+    const char *pchBuildType = "debug";
+#endif
+    fprintf(pFile, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"executable\": ", rgchDate);
+    WriteJsonString(pFile, pchExecutable);
+    fprintf(pFile, ",\n    \"num_cpus\": %u,\n    \"library_build_type\": \"%s\"\n  },\n  \"benchmarks\": [", std::thread::hardware_concurrency(), pchBuildType);
+    bool bFirst = true;
+    for (const BenchmarkResult_t &result : vecResults) {
+        for (uint32_t i = 0; i < (uint32_t)result.vecRuns.size(); i++) {
+            WriteJsonRun(pFile, &bFirst, result.pchName, nullptr, unRepetitions, i, result.vecRuns[i]);
+        }
+        WriteJsonRun(pFile, &bFirst, result.pchName, "mean", unRepetitions, 0, result.mean);
+        WriteJsonRun(pFile, &bFirst, result.pchName, "median", unRepetitions, 0, result.median);
+        WriteJsonRun(pFile, &bFirst, result.pchName, "stddev", unRepetitions, 0, result.stddev);
+    }
+    fprintf(pFile, "\n  ]\n}\n");
+}
+
+static void WriteCsv(FILE *pFile, const std::vector<BenchmarkResult_t> &vecResults)
+{
+    fprintf(pFile, "name,run,iterations,real_time_ns,cpu_time_ns,items_per_second\n");
+    for (const BenchmarkResult_t &result : vecResults) {
+        for (uint32_t i = 0; i < (uint32_t)result.vecRuns.size(); i++) {
+            const BenchmarkRun_t &run = result.vecRuns[i];
+            fprintf(pFile, "%s,%u,%llu,%.4f,%.4f,%.1f\n", result.pchName, i, (unsigned long long)run.ulIterations, run.flRealNs, run.flCpuNs, run.flItemsPerSecond);
+        }
+        const char *rgpchAggregates[3] = { "mean", "median", "stddev" };
+        const BenchmarkRun_t *rgpAggregates[3] = { &result.mean, &result.median, &result.stddev };
+        for (uint32_t i = 0; i < 3; i++) {
+            fprintf(pFile, "%s,%s,%llu,%.4f,%.4f,%.1f\n", result.pchName, rgpchAggregates[i], (unsigned long long)rgpAggregates[i]->ulIterations,
+                rgpAggregates[i]->flRealNs, rgpAggregates[i]->flCpuNs, rgpAggregates[i]->flItemsPerSecond);
+        }
+    }
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr, "usage: driver_benchmarks [--filter=<substring>] [--min-time=<seconds>] [--repetitions=<n>] [--format=console|json|csv] [--out=<file>] [--list]\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *pchFilter = "";
+    double flMinSeconds = 0.2;
+    uint32_t unRepetitions = 5;
+    EOutputFormat eFormat = OutputFormat_Console;
+    const char *pchOutPath = nullptr;
+    bool bList = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--filter=", 9) == 0) {
+            pchFilter = argv[i] + 9;
+        } else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+            flMinSeconds = atof(argv[i] + 11);
+        } else if (strncmp(argv[i], "--repetitions=", 14) == 0) {
+            int nRepetitions = atoi(argv[i] + 14);
+            unRepetitions = nRepetitions > 0 ? (uint32_t)nRepetitions : 1;
+        } else if (strcmp(argv[i], "--format=console") == 0) {
+            eFormat = OutputFormat_Console;
+        } else if (strcmp(argv[i], "--format=json") == 0) {
+            eFormat = OutputFormat_Json;
+        } else if (strcmp(argv[i], "--format=csv") == 0) {
+            eFormat = OutputFormat_Csv;
+        } else if (strncmp(argv[i], "--out=", 6) == 0) {
+            pchOutPath = argv[i] + 6;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            bList = true;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    std::vector<const BenchmarkCase_t *> vecSelected;
+    for (const BenchmarkCase_t &benchmark : k_rgCases) {
+        if (strstr(benchmark.pchName, pchFilter)) {
+            vecSelected.push_back(&benchmark);
+        }
+    }
+    if (bList) {
+        for (const BenchmarkCase_t *pBenchmark : vecSelected) {
+            printf("%s\n", pBenchmark->pchName);
+        }
+        return 0;
+    }
+
+    FILE *pOut = stdout;
+    if (pchOutPath) {
+        pOut = fopen(pchOutPath, "w");
+        if (!pOut) {
+            fprintf(stderr, "driver_benchmarks: unable to write %s\n", pchOutPath);
+            return 1;
+        }
+    }
+
+    if (!SetupFixture()) {
+        fprintf(stderr, "driver_benchmarks: unable to set up the devices\n");
+        return 1;
+    }
+
+    if (eFormat == OutputFormat_Console) {
+        fprintf(pOut, "%-32s %12s %12s %12s %12s %14s\n", "benchmark", "iterations", "median ns", "min ns", "cpu ns", "items/s");
+    }
+    std::vector<BenchmarkResult_t> vecResults;
+    for (const BenchmarkCase_t *pBenchmark : vecSelected) {
+        BenchmarkResult_t result;
+        result.pchName = pBenchmark->pchName;
+        uint64_t ulIterations = CalibrateIterations(*pBenchmark, flMinSeconds);
+        for (uint32_t i = 0; i < unRepetitions; i++) {
+            result.vecRuns.push_back(RunOnce(*pBenchmark, ulIterations));
+        }
+        Aggregate(&result);
+        vecResults.push_back(result);
+
+        if (eFormat == OutputFormat_Console) {
+            double flMinNs = result.vecRuns[0].flRealNs;
+            for (const BenchmarkRun_t &run : result.vecRuns) {
+                flMinNs = std::min(flMinNs, run.flRealNs);
+            }
+            fprintf(pOut, "%-32s %12llu %12.2f %12.2f %12.2f %14.4g\n", result.pchName, (unsigned long long)ulIterations, result.median.flRealNs, flMinNs,
+                result.median.flCpuNs, result.median.flItemsPerSecond);
+            fflush(pOut);
+        }
+    }
+
+    TeardownFixture();
+
+    if (eFormat == OutputFormat_Json) {
+        WriteJson(pOut, argv[0], vecResults, unRepetitions);
+    } else if (eFormat == OutputFormat_Csv) {
+        WriteCsv(pOut, vecResults);
+    }
+    if (pOut != stdout) {
+        fclose(pOut);
+    }
+    return 0;
+}
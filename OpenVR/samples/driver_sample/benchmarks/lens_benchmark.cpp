@@ -0,0 +1,132 @@
+// Cost of answering ComputeDistortion for a whole compositor mesh.
+//
+// usage: lens_benchmark [mesh points per side] [lut resolution]
+//
+// Compares direct per-point evaluation of a Brown-Conrady lens with chromatic
+// aberration, the SSE2 batch evaluation and the baked grid with bilinear lookup,
+// and reports how far the lookup is off from the direct evaluation. Fails if
+// an identity lens doesn't recommend exactly the panel size as render target.
+
+#include "csamplelensmodel.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace vr;
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// set up like the HMD does it, the identity lens must render one pixel per panel pixel, not one more
+static bool CheckIdentityRenderTarget()
+{
+    const uint32_t rgunPanels[][2] = { { 1600, 800 }, { 2160, 1200 }, { 2880, 1600 }, { 3840, 2160 }, { 1001, 777 } };
+    bool bPassed = true;
+    for (uint32_t i = 0; i < sizeof(rgunPanels) / sizeof(rgunPanels[0]); i++) {
+        uint32_t unEyeWidth = rgunPanels[i][0] / 2;
+        uint32_t unEyeHeight = rgunPanels[i][1];
+        CSampleLensModel lensModel;
+        lensModel.SetModel(SampleLensModel_None);
+        lensModel.SetAspect(0.5f * rgunPanels[i][0] / rgunPanels[i][1]);
+        lensModel.SetCenterOffset(Eye_Left, 0.02f, 0.0f);
+        lensModel.SetCenterOffset(Eye_Right, -0.02f, 0.0f);
+        for (uint32_t unEye = 0; unEye < 2; unEye++) {
+            lensModel.SetOutputBounds((EVREye)unEye, lensModel.ComputeVisibleBounds((EVREye)unEye, 0.0f));
+        }
+
+        int32_t nWidth, nHeight;
+        lensModel.GetRenderTargetSize((float)unEyeWidth, (float)unEyeHeight, 1.0f, &nWidth, &nHeight);
+        if (nWidth != (int32_t)unEyeWidth || nHeight != (int32_t)unEyeHeight) {
+            printf("identity lens on %u x %u per eye recommends %d x %d\n", unEyeWidth, unEyeHeight, nWidth, nHeight);
+            bPassed = false;
+        }
+    }
+    return bPassed;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t unMeshSide = argc > 1 ? (uint32_t)atoi(argv[1]) : 256;
+    uint32_t unLutResolution = argc > 2 ? (uint32_t)atoi(argv[2]) : 64;
+    const uint32_t unRepeats = 20;
+
+    CSampleLensModel lensModel;
+    lensModel.SetModel(SampleLensModel_BrownConrady);
+    const float rgflRed[k_unSampleLensCoefficients] = { 0.20f, 0.22f, 0.01f, 0.001f, -0.001f };
+    const float rgflGreen[k_unSampleLensCoefficients] = { 0.22f, 0.24f, 0.01f, 0.001f, -0.001f };
+    const float rgflBlue[k_unSampleLensCoefficients] = { 0.24f, 0.26f, 0.01f, 0.001f, -0.001f };
+    lensModel.SetCoefficients(SampleLensChannel_Red, rgflRed);
+    lensModel.SetCoefficients(SampleLensChannel_Green, rgflGreen);
+    lensModel.SetCoefficients(SampleLensChannel_Blue, rgflBlue);
+    lensModel.SetCenterOffset(Eye_Left, 0.03f, 0.0f);
+    lensModel.SetCenterOffset(Eye_Right, -0.03f, 0.0f);
+
+    std::chrono::steady_clock::time_point bakeStart = std::chrono::steady_clock::now();
+    lensModel.BakeLut(unLutResolution);
+    double flBakeMs = MillisecondsSince(bakeStart);
+
+    uint32_t unPoints = unMeshSide * unMeshSide;
+    std::vector<float> vecU(unPoints), vecV(unPoints);
+    for (uint32_t y = 0; y < unMeshSide; y++) {
+        for (uint32_t x = 0; x < unMeshSide; x++) {
+            vecU[y * unMeshSide + x] = (float)x / (unMeshSide - 1);
+            vecV[y * unMeshSide + x] = (float)y / (unMeshSide - 1);
+        }
+    }
+    std::vector<DistortionCoordinates_t> vecDirect(unPoints), vecBatch(unPoints), vecLookup(unPoints);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < unRepeats; r++) {
+        for (uint32_t unEye = 0; unEye < 2; unEye++) {
+            for (uint32_t i = 0; i < unPoints; i++) {
+                vecDirect[i] = lensModel.Evaluate((EVREye)unEye, vecU[i], vecV[i]);
+            }
+        }
+    }
+    double flDirectMs = MillisecondsSince(start) / unRepeats;
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < unRepeats; r++) {
+        for (uint32_t unEye = 0; unEye < 2; unEye++) {
+            lensModel.EvaluateBatch((EVREye)unEye, vecU.data(), vecV.data(), unPoints, vecBatch.data());
+        }
+    }
+    double flBatchMs = MillisecondsSince(start) / unRepeats;
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < unRepeats; r++) {
+        for (uint32_t unEye = 0; unEye < 2; unEye++) {
+            for (uint32_t i = 0; i < unPoints; i++) {
+                vecLookup[i] = lensModel.Lookup((EVREye)unEye, vecU[i], vecV[i]);
+            }
+        }
+    }
+    double flLookupMs = MillisecondsSince(start) / unRepeats;
+
+    // the last pass was the right eye for all three
+    float flMaxBatchError = 0, flMaxLookupError = 0;
+    for (uint32_t i = 0; i < unPoints; i++) {
+        const float *pDirect = (const float *)&vecDirect[i];
+        const float *pBatch = (const float *)&vecBatch[i];
+        const float *pLookup = (const float *)&vecLookup[i];
+        for (uint32_t j = 0; j < 6; j++) {
+            flMaxBatchError = fmaxf(flMaxBatchError, fabsf(pBatch[j] - pDirect[j]));
+            flMaxLookupError = fmaxf(flMaxLookupError, fabsf(pLookup[j] - pDirect[j]));
+        }
+    }
+
+    printf("mesh: %ux%u points per eye, lut: %u cells per side (baked in %.3f ms)\n", unMeshSide, unMeshSide, unLutResolution, flBakeMs);
+    printf("%-10s %10s %12s\n", "path", "ms/mesh", "max error");
+    printf("%-10s %10.3f %12s\n", "direct", flDirectMs, "-");
+    printf("%-10s %10.3f %12.2e\n", "batch", flBatchMs, flMaxBatchError);
+    printf("%-10s %10.3f %12.2e\n", "lookup", flLookupMs, flMaxLookupError);
+
+    bool bIdentityPassed = CheckIdentityRenderTarget();
+    printf("identity lens render target: %s\n", bIdentityPassed ? "panel size" : "FAILED");
+    return bIdentityPassed ? 0 : 1;
+}
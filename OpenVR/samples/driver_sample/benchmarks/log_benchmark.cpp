@@ -0,0 +1,137 @@
+// Cost of DriverLog on the calling thread, and what reaches IVRDriverLog.
+//
+// usage: log_benchmark [producer threads] [lines per thread]
+//
+// Times a typical pose thread line (a string, ints, doubles) through the queue
+// against formatting the same line with snprintf on the spot, which is what
+// the synchronous logger did before handing it to SteamVR. Then floods the
+// queue from every producer at once and checks that every line was either
+// written or counted as dropped. Last, the cost of a DRIVERLOG_VERBOSE line
+// whose category is turned down, which is what verbose logs on hot paths cost
+// in production.
+
+#include "driverlog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+static const char *const k_pchDropReport = "driver_null: log queue full";
+
+// stands in for SteamVR's log, counts lines apart from the drop reports and keeps the first one
+class CCountingLog : public vr::IVRDriverLog
+{
+public:
+    CCountingLog() : m_ulLines(0), m_ulCalls(0) { m_rgchFirst[0] = 0; }
+
+    virtual void Log(const char *pchLogMessage)
+    {
+        if (!m_rgchFirst[0]) {
+            const char *pchEnd = strchr(pchLogMessage, '\n');
+            size_t cbFirst = pchEnd ? (size_t)(pchEnd - pchLogMessage) : strlen(pchLogMessage);
+            snprintf(m_rgchFirst, sizeof(m_rgchFirst), "%.*s", (int)cbFirst, pchLogMessage);
+        }
+        for (const char *pch = pchLogMessage; *pch;) {
+            const char *pchEnd = strchr(pch, '\n');
+            if (!pchEnd) {
+                break;
+            }
+            if (strncmp(pch, k_pchDropReport, strlen(k_pchDropReport))) {
+                m_ulLines++;
+            }
+            pch = pchEnd + 1;
+        }
+        m_ulCalls++;
+    }
+
+    uint64_t m_ulLines;
+    uint64_t m_ulCalls;
+    char m_rgchFirst[256];
+};
+
+static double NowNs()
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t unThreads = argc > 1 ? (uint32_t)atoi(argv[1]) : 4;
+    uint32_t unLines = argc > 2 ? (uint32_t)atoi(argv[2]) : 100000;
+
+    // the old way, formatted on the caller
+    char buf[1024];
+    double flStart = NowNs();
+    for (uint32_t i = 0; i < unLines; i++) {
+        snprintf(buf, sizeof(buf), "driver_null: device %s pose %u at %.3f %.3f %.3f late %llu ns\n", "LHR-0001", i, 0.1 * i, 1.7, -0.25, 1234ull);
+    }
+    double flSyncNs = (NowNs() - flStart) / unLines;
+
+    // one producer, paced so the queue never fills
+    CCountingLog log;
+    InitDriverLog(&log);
+    double flTotalNs = 0.0;
+    for (uint32_t i = 0; i < unLines; i++) {
+        double flCall = NowNs();
+        DriverLog("driver_null: device %s pose %u at %.3f %.3f %.3f late %llu ns\n", "LHR-0001", i, 0.1 * i, 1.7, -0.25, 1234ull);
+        flTotalNs += NowNs() - flCall;
+        if ((i & 63) == 63) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    CleanupDriverLog();
+    printf("snprintf on the caller %.0f ns/line, queued %.0f ns/line, %llu lines in %llu Log calls, %llu dropped\n", flSyncNs,
+        flTotalNs / unLines, (unsigned long long)log.m_ulLines, (unsigned long long)log.m_ulCalls, (unsigned long long)GetDriverLogDropped());
+    printf("first line: %s\n", log.m_rgchFirst);
+    bool bPaced = log.m_ulLines + GetDriverLogDropped() == unLines;
+
+    // every producer as fast as it can, the queue overflows
+    CCountingLog floodLog;
+    InitDriverLog(&floodLog);
+    std::vector<float> vecCallNs((size_t)unThreads * unLines);
+    flStart = NowNs();
+    std::vector<std::thread> vecThreads;
+    for (uint32_t t = 0; t < unThreads; t++) {
+        vecThreads.emplace_back([&, t]() {
+            float *pCallNs = vecCallNs.data() + (size_t)t * unLines;
+            for (uint32_t i = 0; i < unLines; i++) {
+                double flCall = NowNs();
+                DriverLog("driver_null: thread %u line %u %s\n", t, i, "flood");
+                pCallNs[i] = (float)(NowNs() - flCall);
+            }
+        });
+    }
+    for (std::thread &thread : vecThreads) {
+        thread.join();
+    }
+    double flFloodNs = (NowNs() - flStart) / unLines;
+    CleanupDriverLog();
+    uint64_t ulDropped = GetDriverLogDropped();
+
+    // the worst calls are the ones the scheduler preempted, percentiles say more about the queue
+    std::sort(vecCallNs.begin(), vecCallNs.end());
+    printf("%u producers flooding: %.0f ns per line per thread, calls p50 %.0f ns p99 %.0f ns p99.9 %.0f ns, %llu written, %llu dropped\n",
+        unThreads, flFloodNs, vecCallNs[vecCallNs.size() / 2], vecCallNs[vecCallNs.size() * 99 / 100], vecCallNs[vecCallNs.size() * 999 / 1000],
+        (unsigned long long)floodLog.m_ulLines, (unsigned long long)ulDropped);
+
+    bool bFlood = floodLog.m_ulLines + ulDropped == (uint64_t)unThreads * unLines;
+
+    // filtered by the category level, the arguments are never evaluated
+    CCountingLog filteredLog;
+    InitDriverLog(&filteredLog);
+    SetDriverLogLevels("all=info");
+    flStart = NowNs();
+    for (uint32_t i = 0; i < unLines; i++) {
+        DRIVERLOG_VERBOSE(DriverLogCategory_Tracking, "driver_null: device %s pose %u at %.3f %.3f %.3f late %llu ns\n", "LHR-0001", i, 0.1 * i, 1.7, -0.25, 1234ull);
+    }
+    double flFilteredNs = (NowNs() - flStart) / unLines;
+    CleanupDriverLog();
+    printf("verbose line with its category at info: %.2f ns/line, %llu written\n", flFilteredNs, (unsigned long long)filteredLog.m_ulLines);
+
+    bool bFiltered = filteredLog.m_ulLines == 0;
+    return bPaced && bFlood && bFiltered ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+// CPU lens distortion remap of exported frames, 2x1440x1440 by default.
+//
+// usage: remap_benchmark [eye width] [eye height] [max worker threads]
+//
+// Remaps a synthetic side by side RGBA frame through a Brown-Conrady lens with
+// chromatic aberration, on the calling thread with the scalar and SSE2 paths
+// and then over the worker pool with more and more workers. The budget at
+// 90 Hz is 11.1 ms per frame. The scalar and SSE2 results must be identical.
+// Last it times rebuilding the nodes for a late head rotation, which the
+// reprojection adds to every frame.
+
+#include "csampledistortionremap.h"
+#include "csamplelensmodel.h"
+#include "csampleworkerpool.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace vr;
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t unEyeWidth = argc > 1 ? (uint32_t)atoi(argv[1]) : 1440;
+    uint32_t unEyeHeight = argc > 2 ? (uint32_t)atoi(argv[2]) : 1440;
+    uint32_t unMaxWorkers = argc > 3 ? (uint32_t)atoi(argv[3]) : std::thread::hardware_concurrency() - 1;
+    if (unMaxWorkers > CSampleWorkerPool::k_unMaxWorkers) {
+        unMaxWorkers = CSampleWorkerPool::k_unMaxWorkers;
+    }
+    const uint32_t unRepeats = 20;
+
+    CSampleLensModel lensModel;
+    lensModel.SetModel(SampleLensModel_BrownConrady);
+    const float rgflRed[k_unSampleLensCoefficients] = { 0.20f, 0.22f, 0.01f, 0.001f, -0.001f };
+    const float rgflGreen[k_unSampleLensCoefficients] = { 0.22f, 0.24f, 0.01f, 0.001f, -0.001f };
+    const float rgflBlue[k_unSampleLensCoefficients] = { 0.24f, 0.26f, 0.01f, 0.001f, -0.001f };
+    lensModel.SetCoefficients(SampleLensChannel_Red, rgflRed);
+    lensModel.SetCoefficients(SampleLensChannel_Green, rgflGreen);
+    lensModel.SetCoefficients(SampleLensChannel_Blue, rgflBlue);
+    lensModel.SetAspect((float)unEyeWidth / unEyeHeight);
+
+    uint32_t unWidth = unEyeWidth * 2;
+    uint32_t unStride = unWidth * 4;
+    std::vector<uint8_t> vecSource((size_t)unStride * unEyeHeight);
+    for (uint32_t y = 0; y < unEyeHeight; y++) {
+        for (uint32_t x = 0; x < unWidth; x++) {
+            uint8_t *p = &vecSource[(size_t)y * unStride + x * 4];
+            p[0] = (uint8_t)(x ^ y);
+            p[1] = (uint8_t)(x + y);
+            p[2] = (uint8_t)(x * 3);
+            p[3] = 255;
+        }
+    }
+    std::vector<uint8_t> vecTarget(vecSource.size());
+    std::vector<uint8_t> vecReference(vecSource.size());
+
+    CSampleDistortionRemap remap;
+    const float rgflProjection[2][4] = { { -1.2f, 1.0f, -1.1f, 1.1f }, { -1.0f, 1.2f, -1.1f, 1.1f } };
+    remap.SetProjection(rgflProjection);
+    auto start = std::chrono::steady_clock::now();
+    remap.Build(lensModel, unWidth, unEyeHeight, unWidth, unEyeHeight);
+    printf("frame: 2x%ux%u, tables built in %.2f ms\n", unEyeWidth, unEyeHeight, MillisecondsSince(start));
+
+    // the scalar result is the reference
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < unRepeats; r++) {
+        for (uint32_t i = 0; i < remap.GetBandCount(); i++) {
+            remap.RemapBand(vecSource.data(), unStride, vecReference.data(), unStride, i, false);
+        }
+    }
+    printf("%-22s %8.2f ms/frame\n", "scalar, 1 thread", MillisecondsSince(start) / unRepeats);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < unRepeats; r++) {
+        remap.Remap(vecSource.data(), unStride, vecTarget.data(), unStride, nullptr);
+    }
+    printf("%-22s %8.2f ms/frame\n", "simd, 1 thread", MillisecondsSince(start) / unRepeats);
+    if (memcmp(vecTarget.data(), vecReference.data(), vecTarget.size()) != 0) {
+        printf("simd and scalar results differ\n");
+        return 1;
+    }
+
+    for (uint32_t unWorkers = 1; unWorkers <= unMaxWorkers; unWorkers++) {
+        CSampleWorkerPool pool;
+        pool.Start(unWorkers, -1);
+        remap.Remap(vecSource.data(), unStride, vecTarget.data(), unStride, &pool);
+
+        start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < unRepeats; r++) {
+            remap.Remap(vecSource.data(), unStride, vecTarget.data(), unStride, &pool);
+        }
+        double flMs = MillisecondsSince(start) / unRepeats;
+        char label[64];
+        snprintf(label, sizeof(label), "simd, %u threads", unWorkers + 1);
+        printf("%-22s %8.2f ms/frame%s\n", label, flMs, flMs <= 1000.0 / 90.0 ? "  (fits 90 Hz)" : "");
+        pool.Stop();
+    }
+
+    // two degrees of yaw, about what a quick head turn does in 20 ms
+    HmdQuaternion_t qDelta;
+    qDelta.w = cos(0.5 * 2.0 * M_PI / 180.0);
+    qDelta.x = 0;
+    qDelta.y = sin(0.5 * 2.0 * M_PI / 180.0);
+    qDelta.z = 0;
+    for (uint32_t unWorkers = 0; unWorkers <= unMaxWorkers; unWorkers++) {
+        CSampleWorkerPool pool;
+        pool.Start(unWorkers, -1);
+        start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < unRepeats; r++) {
+            remap.Reproject(qDelta, &pool);
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "reproject, %u threads", unWorkers + 1);
+        printf("%-22s %8.2f ms/frame\n", label, MillisecondsSince(start) / unRepeats);
+        pool.Stop();
+    }
+    return 0;
+}
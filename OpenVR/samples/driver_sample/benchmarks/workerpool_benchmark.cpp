@@ -0,0 +1,113 @@
+// Scaling of the per-tick device update over the worker pool, from 1 to 64 devices.
+//
+// usage: workerpool_benchmark [worker threads] [first cpu to pin to, -1 = none]
+//
+// Every device runs a synthetic workload that stands in for filtering, fusion and
+// prediction (a few microseconds of quaternion integration). Devices are grouped
+// into chunks of 4 like CSampleDeviceRegistry does.
+
+#include "csampleworkerpool.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const uint32_t k_unDevicesPerChunk = 4;
+static const uint32_t k_unTicks = 2000;
+
+struct BenchDevice_t
+{
+    double rdQuat[4];
+    double rdVelocity[3];
+};
+
+struct BenchContext_t
+{
+    BenchDevice_t *pDevices;
+    uint32_t unDeviceCount;
+};
+
+static void UpdateDevice(BenchDevice_t &device)
+{
+    for (int i = 0; i < 400; i++) {
+        double dt = 0.0001;
+        double wx = device.rdVelocity[0] * dt * 0.5;
+        double wy = device.rdVelocity[1] * dt * 0.5;
+        double wz = device.rdVelocity[2] * dt * 0.5;
+        double *q = device.rdQuat;
+        double w = q[0] - wx * q[1] - wy * q[2] - wz * q[3];
+        double x = q[1] + wx * q[0] + wy * q[3] - wz * q[2];
+        double y = q[2] - wx * q[3] + wy * q[0] + wz * q[1];
+        double z = q[3] + wx * q[2] - wy * q[1] + wz * q[0];
+        double flInvLength = 1.0 / sqrt(w * w + x * x + y * y + z * z);
+        q[0] = w * flInvLength;
+        q[1] = x * flInvLength;
+        q[2] = y * flInvLength;
+        q[3] = z * flInvLength;
+    }
+}
+
+static void UpdateChunk(void *pContext, uint32_t unChunk)
+{
+    BenchContext_t *pBench = (BenchContext_t *)pContext;
+    uint32_t unBegin = unChunk * k_unDevicesPerChunk;
+    uint32_t unEnd = unBegin + k_unDevicesPerChunk;
+    if (unEnd > pBench->unDeviceCount) {
+        unEnd = pBench->unDeviceCount;
+    }
+    for (uint32_t i = unBegin; i < unEnd; i++) {
+        UpdateDevice(pBench->pDevices[i]);
+    }
+}
+
+static double RunTicks(CSampleWorkerPool *pPool, BenchContext_t *pBench)
+{
+    uint32_t unChunkCount = (pBench->unDeviceCount + k_unDevicesPerChunk - 1) / k_unDevicesPerChunk;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < k_unTicks; i++) {
+        if (pPool) {
+            pPool->ParallelFor(unChunkCount, UpdateChunk, pBench);
+        } else {
+            for (uint32_t unChunk = 0; unChunk < unChunkCount; unChunk++) {
+                UpdateChunk(pBench, unChunk);
+            }
+        }
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / k_unTicks;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t unWorkers = argc > 1 ? (uint32_t)atoi(argv[1]) : 3;
+    int32_t nFirstCpu = argc > 2 ? atoi(argv[2]) : -1;
+
+    CSampleWorkerPool pool;
+    pool.Start(unWorkers, nFirstCpu);
+
+    printf("workers: %u (+ calling thread), pinning: %d\n", pool.GetWorkerCount(), nFirstCpu);
+    printf("%8s %14s %14s %8s\n", "devices", "serial us/tick", "pool us/tick", "speedup");
+
+    for (uint32_t unDevices = 1; unDevices <= 64; unDevices *= 2) {
+        std::vector<BenchDevice_t> vecDevices(unDevices);
+        for (uint32_t i = 0; i < unDevices; i++) {
+            BenchDevice_t &device = vecDevices[i];
+            device.rdQuat[0] = 1;
+            device.rdQuat[1] = device.rdQuat[2] = device.rdQuat[3] = 0;
+            device.rdVelocity[0] = 0.1 * i;
+            device.rdVelocity[1] = 0.2;
+            device.rdVelocity[2] = -0.3;
+        }
+
+        BenchContext_t bench = { vecDevices.data(), unDevices };
+        double flSerial = RunTicks(nullptr, &bench);
+        double flPool = RunTicks(&pool, &bench);
+        printf("%8u %14.2f %14.2f %7.2fx\n", unDevices, flSerial, flPool, flSerial / flPool);
+    }
+
+    pool.Stop();
+    return 0;
+}
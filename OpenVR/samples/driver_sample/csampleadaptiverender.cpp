@@ -0,0 +1,140 @@
+#include "csampleadaptiverender.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// more than one miss in this many frames is too many even if the average load looks fine, fewer is scheduling noise
+static const uint64_t k_ulMissedFrameRatio = 10;
+
+static const uint64_t k_ulWindowNs = 1000000000ull;
+
+CSampleAdaptiveRender::CSampleAdaptiveRender()
+{
+    SampleAdaptiveRenderConfig_t config;
+    config.flMinScale = 1.0f;
+    config.flMaxScale = 1.0f;
+    config.flScaleStep = 0.1f;
+    config.flMinFrequency = 90.0f;
+    config.flMaxFrequency = 90.0f;
+    config.flFrequencyStep = 10.0f;
+    config.flTargetLoad = 0.85f;
+    config.flHysteresis = 0.1f;
+    config.flHoldSeconds = 2.0f;
+    Configure(config);
+}
+
+void CSampleAdaptiveRender::Configure(const SampleAdaptiveRenderConfig_t &config)
+{
+    m_config = config;
+    if (m_config.flMaxScale <= 0.0f) {
+        m_config.flMaxScale = 1.0f;
+    }
+    if (m_config.flMinScale <= 0.0f || m_config.flMinScale > m_config.flMaxScale) {
+        m_config.flMinScale = m_config.flMaxScale;
+    }
+    if (m_config.flMinFrequency <= 0.0f || m_config.flMinFrequency > m_config.flMaxFrequency) {
+        m_config.flMinFrequency = m_config.flMaxFrequency;
+    }
+    if (m_config.flScaleStep <= 0.0f) {
+        m_config.flScaleStep = 0.1f;
+    }
+    if (m_config.flFrequencyStep <= 0.0f) {
+        m_config.flFrequencyStep = 10.0f;
+    }
+
+    m_flScale = m_config.flMaxScale;
+    m_flFrequency = m_config.flMaxFrequency;
+    m_ulHoldUntilNs = 0;
+    m_ulWindowStartNs = 0;
+    m_ulWindowFrames = 0;
+    m_ulWindowBusyNs = 0;
+    m_ulWindowMissed = 0;
+    m_rgchReason[0] = 0;
+}
+
+bool CSampleAdaptiveRender::AddFrames(uint64_t ulNowNs, uint64_t ulFrames, uint64_t ulBusyNs, uint64_t ulMissedVsyncs)
+{
+    // what was rendered before the last change says nothing about the current settings
+    if (ulNowNs < m_ulHoldUntilNs) {
+        return false;
+    }
+
+    if (!m_ulWindowStartNs) {
+        m_ulWindowStartNs = ulNowNs;
+    }
+    m_ulWindowFrames += ulFrames;
+    m_ulWindowBusyNs += ulBusyNs;
+    m_ulWindowMissed += ulMissedVsyncs;
+    if (ulNowNs - m_ulWindowStartNs < k_ulWindowNs || !m_ulWindowFrames) {
+        return false;
+    }
+
+    bool bChanged = Evaluate(ulNowNs);
+    m_ulWindowStartNs = 0;
+    m_ulWindowFrames = 0;
+    m_ulWindowBusyNs = 0;
+    m_ulWindowMissed = 0;
+    return bChanged;
+}
+
+bool CSampleAdaptiveRender::Evaluate(uint64_t ulNowNs)
+{
+    float flIntervalMs = 1000.0f / m_flFrequency;
+    float flFrameMs = (float)(m_ulWindowBusyNs * 1e-6 / m_ulWindowFrames);
+    float flLoad = flFrameMs / flIntervalMs;
+    bool bMissing = m_ulWindowMissed * k_ulMissedFrameRatio > m_ulWindowFrames;
+
+    char rgchWhy[128];
+    snprintf(rgchWhy, sizeof(rgchWhy), "frames took %.2f ms of %.2f ms (load %.2f, target %.2f) with %llu missed vsyncs in %llu frames",
+        flFrameMs, flIntervalMs, flLoad, m_config.flTargetLoad, (unsigned long long)m_ulWindowMissed, (unsigned long long)m_ulWindowFrames);
+
+    float flScale = m_flScale;
+    float flFrequency = m_flFrequency;
+    if (flLoad > m_config.flTargetLoad || bMissing) {
+        if (m_flScale > m_config.flMinScale) {
+            flScale = m_flScale - m_config.flScaleStep;
+            if (flScale < m_config.flMinScale) {
+                flScale = m_config.flMinScale;
+            }
+        } else if (m_flFrequency > m_config.flMinFrequency) {
+            flFrequency = m_flFrequency - m_config.flFrequencyStep;
+            if (flFrequency < m_config.flMinFrequency) {
+                flFrequency = m_config.flMinFrequency;
+            }
+        }
+    } else {
+        // the frame time stays, the interval shrinks; pixels and with them the frame time grow with the scale squared
+        float flHeadroom = m_config.flTargetLoad - m_config.flHysteresis;
+        if (m_flFrequency < m_config.flMaxFrequency) {
+            float flNext = m_flFrequency + m_config.flFrequencyStep;
+            if (flNext > m_config.flMaxFrequency) {
+                flNext = m_config.flMaxFrequency;
+            }
+            if (flLoad * flNext / m_flFrequency < flHeadroom) {
+                flFrequency = flNext;
+            }
+        } else if (m_flScale < m_config.flMaxScale) {
+            float flNext = m_flScale + m_config.flScaleStep;
+            if (flNext > m_config.flMaxScale) {
+                flNext = m_config.flMaxScale;
+            }
+            if (flLoad * (flNext * flNext) / (m_flScale * m_flScale) < flHeadroom) {
+                flScale = flNext;
+            }
+        }
+    }
+
+    if (flScale == m_flScale && flFrequency == m_flFrequency) {
+        return false;
+    }
+
+    if (flScale != m_flScale) {
+        snprintf(m_rgchReason, sizeof(m_rgchReason), "render scale %.2f -> %.2f: %s", m_flScale, flScale, rgchWhy);
+    } else {
+        snprintf(m_rgchReason, sizeof(m_rgchReason), "display frequency %.1f -> %.1f Hz: %s", m_flFrequency, flFrequency, rgchWhy);
+    }
+    m_flScale = flScale;
+    m_flFrequency = flFrequency;
+    m_ulHoldUntilNs = ulNowNs + (uint64_t)(m_config.flHoldSeconds * 1e9);
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef CSAMPLEADAPTIVERENDER_H
+#define CSAMPLEADAPTIVERENDER_H
+
+#include <stdint.h>
+
+// bounds and thresholds of CSampleAdaptiveRender
+struct SampleAdaptiveRenderConfig_t
+{
+    float flMinScale;           // of the render target derived from the lens, per axis
+    float flMaxScale;
+    float flScaleStep;
+    float flMinFrequency;       // Hz
+    float flMaxFrequency;
+    float flFrequencyStep;
+    float flTargetLoad;         // share of the frame interval a frame may take before quality goes down
+    float flHysteresis;         // quality only goes up again when the load after the change stays this far below the target
+    float flHoldSeconds;        // no decisions this long after a change, the old timings don't describe the new settings
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Trades render resolution and display frequency against measured
+// frame times. Timings are collected over windows of about one second. A
+// window whose frames take more than the target load of the frame interval
+// or miss vsyncs lowers the render scale one step, then the frequency once
+// the scale is at its minimum. A window with room to spare undoes that, the
+// frequency first, but only if the load predicted for the next step (scale
+// squared for pixels, frequency for the shorter interval) stays below the
+// target by the hysteresis, so it doesn't flap between two steps. After a
+// change it holds still until the new settings had time to show.
+//-----------------------------------------------------------------------------
+class CSampleAdaptiveRender
+{
+public:
+    CSampleAdaptiveRender();
+
+    /** starts at full scale and the highest frequency */
+    void Configure(const SampleAdaptiveRenderConfig_t &config);
+
+    /**
+     * adds the frames presented since the last call, ulBusyNs summed over them. Returns true when
+     * the scale or frequency changed, GetReason() then says why.
+     */
+    bool AddFrames(uint64_t ulNowNs, uint64_t ulFrames, uint64_t ulBusyNs, uint64_t ulMissedVsyncs);
+
+    float GetScale() const { return m_flScale; }
+
+    float GetFrequency() const { return m_flFrequency; }
+
+    const char *GetReason() const { return m_rgchReason; }
+
+private:
+    bool Evaluate(uint64_t ulNowNs);
+
+    SampleAdaptiveRenderConfig_t m_config;
+    float m_flScale;
+    float m_flFrequency;
+    uint64_t m_ulHoldUntilNs;
+
+    // the window being collected
+    uint64_t m_ulWindowStartNs;
+    uint64_t m_ulWindowFrames;
+    uint64_t m_ulWindowBusyNs;
+    uint64_t m_ulWindowMissed;
+
+    char m_rgchReason[256];
+};
+
+#endif // CSAMPLEADAPTIVERENDER_H
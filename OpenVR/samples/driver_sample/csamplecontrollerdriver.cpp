@@ -1,25 +1,37 @@
 #include "csamplecontrollerdriver.h"
 #include "basics.h"
+#include "csamplelatencystats.h"
+#include "csampletrace.h"
+#include "csampletuning.h"
+#include "driverlog.h"
 
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 using namespace vr;
 
 static double cyaw = 0, cpitch = 0, croll = 0;
 static double cpX = 0, cpY = 0, cpZ = 0;
-static double ct0, ct1, ct2, ct3, ct4, ct5;
 
 static double c2pX = 0, c2pY = 0, c2pZ = 0;
 
 CSampleControllerDriver::CSampleControllerDriver()
 {
-    m_unObjectId = vr::k_unTrackedDeviceIndexInvalid;
     m_ulPropertyContainer = vr::k_ulInvalidPropertyContainer;
+    ControllerIndex = 0;
+    memset(m_rgbButtonValue, 0, sizeof(m_rgbButtonValue));
+    memset(m_rgflAxisValue, 0, sizeof(m_rgflAxisValue));
+    m_ulInputReadNs = 0;
 }
 
 void CSampleControllerDriver::SetControllerIndex(int32_t CtrlIndex)
 {
     ControllerIndex = CtrlIndex;
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "CTRL%dSerial", CtrlIndex);
+    m_sSerialNumber = buf;
 }
 
 CSampleControllerDriver::~CSampleControllerDriver()
@@ -41,14 +53,7 @@ vr::EVRInitError CSampleControllerDriver::Activate(vr::TrackedDeviceIndex_t unOb
     vr::VRProperties()->SetStringProperty(m_ulPropertyContainer, Prop_TrackingSystemName_String, "VR Controller");
     vr::VRProperties()->SetInt32Property(m_ulPropertyContainer, Prop_DeviceClass_Int32, TrackedDeviceClass_Controller);
 
-    switch (ControllerIndex) {
-    case 1:
-        vr::VRProperties()->SetStringProperty(m_ulPropertyContainer, Prop_SerialNumber_String, "CTRL1Serial");
-        break;
-    case 2:
-        vr::VRProperties()->SetStringProperty(m_ulPropertyContainer, Prop_SerialNumber_String, "CTRL2Serial");
-        break;
-    }
+    vr::VRProperties()->SetStringProperty(m_ulPropertyContainer, Prop_SerialNumber_String, m_sSerialNumber.c_str());
 
     uint64_t supportedButtons = 0xFFFFFFFFFFFFFFFFULL;
     vr::VRProperties()->SetUint64Property(m_ulPropertyContainer, vr::Prop_SupportedButtons_Uint64, supportedButtons);
@@ -71,6 +76,10 @@ vr::EVRInitError CSampleControllerDriver::Activate(vr::TrackedDeviceIndex_t unOb
     case 2:
         vr::VRProperties()->SetInt32Property(m_ulPropertyContainer, Prop_ControllerRoleHint_Int32, TrackedControllerRole_RightHand);
         break;
+    default:
+        // any extra controllers leave the hands to the first two
+        vr::VRProperties()->SetInt32Property(m_ulPropertyContainer, Prop_ControllerRoleHint_Int32, TrackedControllerRole_OptOut);
+        break;
     }
 
     // this file tells the UI what to show the user for binding this controller as well as what default bindings should
@@ -112,6 +121,8 @@ void CSampleControllerDriver::Deactivate()
 
 void CSampleControllerDriver::EnterStandby()
 {
+    // no more poses from this device until the server leaves standby
+    SetStandby(true);
 }
 
 void *CSampleControllerDriver::GetComponent(const char *pchComponentNameAndVersion)
@@ -124,173 +135,190 @@ void CSampleControllerDriver::PowerOff()
 {
 }
 
-void CSampleControllerDriver::DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize)
+void CSampleControllerDriver::PollKeyboard()
 {
-    if (unResponseBufferSize >= 1) {
-        pchResponseBuffer[0] = 0;
+    double flTurn = GetSampleTuning(SampleTuning_ControllerTurnStep);
+    double flMove = GetSampleTuning(SampleTuning_ControllerMoveStep);
+
+    //Controller1
+    if ((GetAsyncKeyState(70) & 0x8000) != 0) {
+        cyaw += flTurn;                                       //F
+    }
+    if ((GetAsyncKeyState(72) & 0x8000) != 0) {
+        cyaw += -flTurn;                                       //H
+    }
+    if ((GetAsyncKeyState(84) & 0x8000) != 0) {
+        croll += flTurn;                                       //T
+    }
+    if ((GetAsyncKeyState(71) & 0x8000) != 0) {
+        croll += -flTurn;                                       //G
+    }
+    if ((GetAsyncKeyState(66) & 0x8000) != 0) { //B
+        cpitch = 0;
+        croll = 0;
+    }
+
+    //Change position controller1
+    if ((GetAsyncKeyState(87) & 0x8000) != 0) {
+        cpZ += -flMove;                                       //W
+    }
+    if ((GetAsyncKeyState(83) & 0x8000) != 0) {
+        cpZ += flMove;                                       //S
+    }
+    if ((GetAsyncKeyState(65) & 0x8000) != 0) {
+        cpX += -flMove;                                       //A
+    }
+    if ((GetAsyncKeyState(68) & 0x8000) != 0) {
+        cpX += flMove;                                       //D
+    }
+    if ((GetAsyncKeyState(81) & 0x8000) != 0) {
+        cpY += flMove;                                       //Q
+    }
+    if ((GetAsyncKeyState(69) & 0x8000) != 0) {
+        cpY += -flMove;                                       //E
+    }
+    if ((GetAsyncKeyState(82) & 0x8000) != 0) {
+        cpX = 0;
+        cpY = 0;
+        cpZ = 0;
+    }                                                                        //R
+
+    //Controller2
+
+    if ((GetAsyncKeyState(73) & 0x8000) != 0) {
+        c2pZ += -flMove;                                       //I
+    }
+    if ((GetAsyncKeyState(75) & 0x8000) != 0) {
+        c2pZ += flMove;                                       //K
+    }
+    if ((GetAsyncKeyState(74) & 0x8000) != 0) {
+        c2pX += -flMove;                                       //J
+    }
+    if ((GetAsyncKeyState(76) & 0x8000) != 0) {
+        c2pX += flMove;                                       //L
+    }
+    if ((GetAsyncKeyState(85) & 0x8000) != 0) {
+        c2pY += flMove;                                       //U
+    }
+    if ((GetAsyncKeyState(79) & 0x8000) != 0) {
+        c2pY += -flMove;                                       //O
     }
+    if ((GetAsyncKeyState(80) & 0x8000) != 0) {
+        c2pX = 0;
+        c2pY = 0;
+        c2pZ = 0;
+    }                                                                           //P
 }
 
 DriverPose_t CSampleControllerDriver::GetPose()
 {
     DriverPose_t pose = { 0 };
-    //pose.poseIsValid = false;
-    pose.poseIsValid = true;
-    //pose.result = TrackingResult_Calibrating_OutOfRange;
-    pose.result = TrackingResult_Running_OK;
-    pose.deviceIsConnected = true;
+    FillConnectionState(pose);
 
     pose.qWorldFromDriverRotation = HmdQuaternion_Init(1, 0, 0, 0);
     pose.qDriverFromHeadRotation = HmdQuaternion_Init(1, 0, 0, 0);
 
-    if (ControllerIndex == 1) {
-        if ((GetAsyncKeyState(70) & 0x8000) != 0) {
-            cyaw += 0.1;                                       //F
-        }
-        if ((GetAsyncKeyState(72) & 0x8000) != 0) {
-            cyaw += -0.1;                                       //H
-        }
-        if ((GetAsyncKeyState(84) & 0x8000) != 0) {
-            croll += 0.1;                                       //T
-        }
-        if ((GetAsyncKeyState(71) & 0x8000) != 0) {
-            croll += -0.1;                                       //G
-        }
-        if ((GetAsyncKeyState(66) & 0x8000) != 0) { //B
-            cpitch = 0;
-            croll = 0;
-        }
-
-        //Change position controller1
-        if ((GetAsyncKeyState(87) & 0x8000) != 0) {
-            cpZ += -0.01;                                       //W
-        }
-        if ((GetAsyncKeyState(83) & 0x8000) != 0) {
-            cpZ += 0.01;                                       //S
-        }
-        if ((GetAsyncKeyState(65) & 0x8000) != 0) {
-            cpX += -0.01;                                       //A
-        }
-        if ((GetAsyncKeyState(68) & 0x8000) != 0) {
-            cpX += 0.01;                                       //D
-        }
-        if ((GetAsyncKeyState(81) & 0x8000) != 0) {
-            cpY += 0.01;                                       //Q
-        }
-        if ((GetAsyncKeyState(69) & 0x8000) != 0) {
-            cpY += -0.01;                                       //E
-        }
-        if ((GetAsyncKeyState(82) & 0x8000) != 0) {
-            cpX = 0;
-            cpY = 0;
-            cpZ = 0;
-        }                                                                        //R
+    //A pose from the transport wins over the keyboard emulation
+    if (GetTransportPose(pose)) {
+        return pose;
+    }
+    if (!IsKeyboardDriven()) {
+        pose.qRotation = HmdQuaternion_Init(1, 0, 0, 0);
+        return pose;
+    }
 
+    if (ControllerIndex == 1) {
         pose.vecPosition[0] = cpX;
         pose.vecPosition[1] = cpY;
         pose.vecPosition[2] = cpZ;
     } else {
-        //Controller2
-
-        if ((GetAsyncKeyState(73) & 0x8000) != 0) {
-            c2pZ += -0.01;                                       //I
-        }
-        if ((GetAsyncKeyState(75) & 0x8000) != 0) {
-            c2pZ += 0.01;                                       //K
-        }
-        if ((GetAsyncKeyState(74) & 0x8000) != 0) {
-            c2pX += -0.01;                                       //J
-        }
-        if ((GetAsyncKeyState(76) & 0x8000) != 0) {
-            c2pX += 0.01;                                       //L
-        }
-        if ((GetAsyncKeyState(85) & 0x8000) != 0) {
-            c2pY += 0.01;                                       //U
-        }
-        if ((GetAsyncKeyState(79) & 0x8000) != 0) {
-            c2pY += -0.01;                                       //O
-        }
-        if ((GetAsyncKeyState(80) & 0x8000) != 0) {
-            c2pX = 0;
-            c2pY = 0;
-            c2pZ = 0;
-        }                                                                           //P
-
         pose.vecPosition[0] = c2pX;
         pose.vecPosition[1] = c2pY;
         pose.vecPosition[2] = c2pZ;
     }
 
-    //Convert yaw, pitch, roll to quaternion
-    ct0 = cos(cyaw * 0.5);
-    ct1 = sin(cyaw * 0.5);
-    ct2 = cos(croll * 0.5);
-    ct3 = sin(croll * 0.5);
-    ct4 = cos(cpitch * 0.5);
-    ct5 = sin(cpitch * 0.5);
-
     //Set controller rotation
-    pose.qRotation.w = ct0 * ct2 * ct4 + ct1 * ct3 * ct5;
-    pose.qRotation.x = ct0 * ct3 * ct4 - ct1 * ct2 * ct5;
-    pose.qRotation.y = ct0 * ct2 * ct5 + ct1 * ct3 * ct4;
-    pose.qRotation.z = ct1 * ct2 * ct4 - ct0 * ct3 * ct5;
+    pose.qRotation = HmdQuaternion_FromEuler(cyaw, cpitch, croll);
 
     return pose;
 }
 
+void CSampleControllerDriver::UpdateButton(uint32_t unButton, bool bValue)
+{
+    if (m_rgbButtonValue[unButton] == bValue) {
+        return;
+    }
+    m_rgbButtonValue[unButton] = bValue;
+    vr::VRDriverInput()->UpdateBooleanComponent(HButtons[unButton], bValue, 0);
+    RecordSampleLatency(SampleLatencyStage_InputToState, GetTimestampNs() - m_ulInputReadNs);
+    DRIVERLOG_VERBOSE(DriverLogCategory_Input, "driver_null: %s button %u %s\n", m_sSerialNumber.c_str(), unButton, bValue ? "down" : "up");
+
+    SampleTraceInputChange_t change = { m_unObjectId.load(std::memory_order_relaxed), unButton, bValue ? 1.0f : 0.0f };
+    SampleTrace(change);
+}
+
+void CSampleControllerDriver::UpdateAxis(uint32_t unAxis, float flValue)
+{
+    if (m_rgflAxisValue[unAxis] == flValue) {
+        return;
+    }
+    m_rgflAxisValue[unAxis] = flValue;
+    vr::VRDriverInput()->UpdateScalarComponent(HAnalog[unAxis], flValue, 0);
+    RecordSampleLatency(SampleLatencyStage_InputToState, GetTimestampNs() - m_ulInputReadNs);
+    DRIVERLOG_VERBOSE(DriverLogCategory_Input, "driver_null: %s axis %u %.3f\n", m_sSerialNumber.c_str(), unAxis, flValue);
+
+    // axes follow the buttons in the component numbering of the trace
+    SampleTraceInputChange_t change = { m_unObjectId.load(std::memory_order_relaxed), 4 + unAxis, flValue };
+    SampleTrace(change);
+}
+
 void CSampleControllerDriver::RunFrame()
 {
-#if defined(_WINDOWS)
     // Your driver would read whatever hardware state is associated with its input components and pass that
     // in to UpdateBooleanComponent. This could happen in RunFrame or on a thread of your own that's reading USB
-    // state. There's no need to update input state unless it changes, but it doesn't do any harm to do so.
+    // state. There's no need to update input state unless it changes, so ApplyInput skips the components that
+    // kept their value.
+    SampleControllerInput_t input;
+    ReadKeyboardInput(&input);
+    ApplyInput(input, GetTimestampNs());
+}
 
+void CSampleControllerDriver::ReadKeyboardInput(SampleControllerInput_t *pInput) const
+{
+    memset(pInput, 0, sizeof(*pInput));
+#if defined(_WINDOWS)
     if (ControllerIndex == 1) {
-        vr::VRDriverInput()->UpdateBooleanComponent(HButtons[0], (0x8000 & GetAsyncKeyState('Z')) != 0, 0); //Application Menu
-        vr::VRDriverInput()->UpdateBooleanComponent(HButtons[1], (0x8000 & GetAsyncKeyState('C')) != 0, 0); //Grip
-        vr::VRDriverInput()->UpdateBooleanComponent(HButtons[2], (0x8000 & GetAsyncKeyState('V')) != 0, 0); //System
-        vr::VRDriverInput()->UpdateBooleanComponent(HButtons[3], (0x8000 & GetAsyncKeyState('1')) != 0, 0); //Trackpad
-
-        vr::VRDriverInput()->UpdateScalarComponent(HAnalog[0], 0.0, 0); //Trackpad x
-        vr::VRDriverInput()->UpdateScalarComponent(HAnalog[1], 0.0, 0); //Trackpad y
-
-        if ((GetAsyncKeyState('2') & 0x8000) != 0) {
-            vr::VRDriverInput()->UpdateScalarComponent(HAnalog[0], 1.0, 0);
-        }
-
-        if ((GetAsyncKeyState('3') & 0x8000) != 0) {
-            vr::VRDriverInput()->UpdateScalarComponent(HAnalog[1], 1.0, 0);
-        }
-
-        if ((GetAsyncKeyState('X') & 0x8000) != 0) { //Trigger
-            vr::VRDriverInput()->UpdateScalarComponent(HAnalog[2], 1.0, 0);
-        } else {
-            vr::VRDriverInput()->UpdateScalarComponent(HAnalog[2], 0.0, 0);
-        }
-    } else {
+        pInput->rgbButtons[0] = (0x8000 & GetAsyncKeyState('Z')) != 0; //Application Menu
+        pInput->rgbButtons[1] = (0x8000 & GetAsyncKeyState('C')) != 0; //Grip
+        pInput->rgbButtons[2] = (0x8000 & GetAsyncKeyState('V')) != 0; //System
+        pInput->rgbButtons[3] = (0x8000 & GetAsyncKeyState('1')) != 0; //Trackpad
+
+        pInput->rgflAxes[0] = (GetAsyncKeyState('2') & 0x8000) != 0 ? 1.0f : 0.0f; //Trackpad x
+        pInput->rgflAxes[1] = (GetAsyncKeyState('3') & 0x8000) != 0 ? 1.0f : 0.0f; //Trackpad y
+        pInput->rgflAxes[2] = (GetAsyncKeyState('X') & 0x8000) != 0 ? 1.0f : 0.0f; //Trigger
+    } else if (ControllerIndex == 2) {
         //Controller2
-        vr::VRDriverInput()->UpdateBooleanComponent(HButtons[0], (0x8000 & GetAsyncKeyState(190)) != 0, 0); //Application Menu
-        vr::VRDriverInput()->UpdateBooleanComponent(HButtons[1], (0x8000 & GetAsyncKeyState(191)) != 0, 0); //Grip
-        vr::VRDriverInput()->UpdateBooleanComponent(HButtons[2], (0x8000 & GetAsyncKeyState('N')) != 0, 0); //System
-        vr::VRDriverInput()->UpdateBooleanComponent(HButtons[3], (0x8000 & GetAsyncKeyState('2')) != 0, 0); //Trackpad
-
-        vr::VRDriverInput()->UpdateScalarComponent(HAnalog[0], 0.0, 0); //Trackpad x
-        vr::VRDriverInput()->UpdateScalarComponent(HAnalog[1], 0.0, 0); //Trackpad y
-
-        if ((GetAsyncKeyState('4') & 0x8000) != 0) { //Trigger
-            vr::VRDriverInput()->UpdateScalarComponent(HAnalog[2], 1.0, 0);
-        } else {
-            vr::VRDriverInput()->UpdateScalarComponent(HAnalog[2], 0.0, 0);
-        }
-    }
+        pInput->rgbButtons[0] = (0x8000 & GetAsyncKeyState(190)) != 0; //Application Menu
+        pInput->rgbButtons[1] = (0x8000 & GetAsyncKeyState(191)) != 0; //Grip
+        pInput->rgbButtons[2] = (0x8000 & GetAsyncKeyState('N')) != 0; //System
+        pInput->rgbButtons[3] = (0x8000 & GetAsyncKeyState('2')) != 0; //Trackpad
 
-    if (m_unObjectId != vr::k_unTrackedDeviceIndexInvalid) {
-        vr::VRServerDriverHost()->TrackedDevicePoseUpdated(m_unObjectId, GetPose(), sizeof(DriverPose_t));
+        pInput->rgflAxes[2] = (GetAsyncKeyState('4') & 0x8000) != 0 ? 1.0f : 0.0f; //Trigger
     }
-
 #endif
 }
 
+void CSampleControllerDriver::ApplyInput(const SampleControllerInput_t &input, uint64_t ulReadNs)
+{
+    m_ulInputReadNs = ulReadNs;
+    for (uint32_t i = 0; i < 4; i++) {
+        UpdateButton(i, input.rgbButtons[i]);
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        UpdateAxis(i, input.rgflAxes[i]);
+    }
+}
+
 void CSampleControllerDriver::ProcessEvent(const vr::VREvent_t &vrEvent)
 {
     switch (vrEvent.eventType) {
@@ -303,16 +331,9 @@ void CSampleControllerDriver::ProcessEvent(const vr::VREvent_t &vrEvent)
     }
 }
 
-std::string CSampleControllerDriver::GetSerialNumber() const
+uint32_t CSampleControllerDriver::GetEventSubscriptions(const uint32_t **ppunEventTypes) const
 {
-    switch (ControllerIndex) {
-    case 1:
-        return "CTRL1Serial";
-        break;
-    case 2:
-        return "CTRL2Serial";
-        break;
-    }
+    static const uint32_t s_rgunEventTypes[] = { vr::VREvent_Input_HapticVibration };
+    *ppunEventTypes = s_rgunEventTypes;
+    return sizeof(s_rgunEventTypes) / sizeof(s_rgunEventTypes[0]);
 }
-
-
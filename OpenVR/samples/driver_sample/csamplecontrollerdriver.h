@@ -2,12 +2,20 @@
 #define CSAMPLECONTROLLERDRIVER_H
 
 #include <openvr_driver.h>
+#include "csampletrackeddevice.h"
+
+// the input state of a controller at one point in time
+struct SampleControllerInput_t
+{
+    bool rgbButtons[4];  // application menu, grip, system, trackpad click
+    float rgflAxes[3];   // trackpad x, trackpad y, trigger
+};
 
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
 
-class CSampleControllerDriver : public vr::ITrackedDeviceServerDriver
+class CSampleControllerDriver : public CSampleTrackedDevice
 {
     int32_t ControllerIndex;
 public:
@@ -27,19 +35,34 @@ public:
 
     virtual void PowerOff();
 
-    /** debug request from a client */
-    virtual void DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize);
-
     virtual vr::DriverPose_t GetPose();
 
-    void RunFrame();
+    virtual vr::ETrackedDeviceClass GetDeviceClass() const { return vr::TrackedDeviceClass_Controller; }
+
+    virtual const std::string &GetSerialNumber() const { return m_sSerialNumber; }
+
+    virtual bool IsKeyboardDriven() const { return ControllerIndex == 1 || ControllerIndex == 2; }
 
-    void ProcessEvent(const vr::VREvent_t &vrEvent);
+    virtual void RunFrame();
 
-    std::string GetSerialNumber() const;
+    /** the keyboard emulation of this controller, everything released where there is no keyboard to read */
+    void ReadKeyboardInput(SampleControllerInput_t *pInput) const;
+
+    /** sends the components that differ from the last snapshot to SteamVR, ulReadNs is when the snapshot was taken */
+    void ApplyInput(const SampleControllerInput_t &input, uint64_t ulReadNs);
+
+    static void PollKeyboard();
+
+    virtual void ProcessEvent(const vr::VREvent_t &vrEvent);
+
+    virtual uint32_t GetEventSubscriptions(const uint32_t **ppunEventTypes) const;
 
 private:
-    vr::TrackedDeviceIndex_t m_unObjectId;
+    /** sends a button or axis to SteamVR and traces it, only when it differs from what was sent last */
+    void UpdateButton(uint32_t unButton, bool bValue);
+
+    void UpdateAxis(uint32_t unAxis, float flValue);
+
     vr::PropertyContainerHandle_t m_ulPropertyContainer;
 
     //vr::VRInputComponentHandle_t m_compA;
@@ -48,7 +71,10 @@ private:
     vr::VRInputComponentHandle_t m_compHaptic;
 
     vr::VRInputComponentHandle_t HButtons[4], HAnalog[3];
-    //std::string m_sSerialNumber;
+    bool m_rgbButtonValue[4];
+    float m_rgflAxisValue[3];
+    uint64_t m_ulInputReadNs;   // when the input state being sent was read
+    std::string m_sSerialNumber;
     //std::string m_sModelNumber;
 };
 
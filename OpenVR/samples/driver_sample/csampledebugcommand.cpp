@@ -0,0 +1,137 @@
+#include "csampledebugcommand.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool IsSpace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+CSampleDebugCommand::CSampleDebugCommand(const char *pchRequest)
+{
+    m_pchRequest = pchRequest ? pchRequest : "";
+    m_unTokens = 0;
+    m_bValid = true;
+
+    const char *pch = m_pchRequest;
+    while (*pch) {
+        while (IsSpace(*pch)) {
+            pch++;
+        }
+        if (!*pch) {
+            break;
+        }
+        if (m_unTokens == k_unMaxTokens) {
+            m_bValid = false;
+            break;
+        }
+        const char *pchStart = pch;
+        while (*pch && !IsSpace(*pch)) {
+            pch++;
+        }
+        m_rgpchTokens[m_unTokens] = pchStart;
+        m_rgcchTokens[m_unTokens] = (uint32_t)(pch - pchStart);
+        m_unTokens++;
+    }
+}
+
+bool CSampleDebugCommand::IsToken(uint32_t unToken, const char *pchWord) const
+{
+    if (unToken >= m_unTokens) {
+        return false;
+    }
+    size_t cchWord = strlen(pchWord);
+    return cchWord == m_rgcchTokens[unToken] && !strncmp(m_rgpchTokens[unToken], pchWord, cchWord);
+}
+
+const char *CSampleDebugCommand::GetRest(uint32_t unToken) const
+{
+    return unToken < m_unTokens ? m_rgpchTokens[unToken] : "";
+}
+
+bool CSampleDebugCommand::GetFloat(uint32_t unToken, float *pflValue) const
+{
+    // strtof wants a terminated string, numbers longer than this aren't numbers we take
+    char rgchNumber[32];
+    if (unToken >= m_unTokens || m_rgcchTokens[unToken] >= sizeof(rgchNumber)) {
+        return false;
+    }
+    memcpy(rgchNumber, m_rgpchTokens[unToken], m_rgcchTokens[unToken]);
+    rgchNumber[m_rgcchTokens[unToken]] = 0;
+
+    char *pchEnd = nullptr;
+    float flValue = strtof(rgchNumber, &pchEnd);
+    if (pchEnd == rgchNumber || *pchEnd != 0 || !isfinite(flValue)) {
+        return false;
+    }
+    *pflValue = flValue;
+    return true;
+}
+
+CSampleDebugResponse::CSampleDebugResponse(char *pchBuffer, uint32_t unBufferSize)
+{
+    m_pchBuffer = pchBuffer;
+    m_unBufferSize = unBufferSize;
+    m_cbUsed = 0;
+    m_bOverflow = false;
+    if (m_unBufferSize > 0) {
+        m_pchBuffer[0] = 0;
+    }
+}
+
+bool CSampleDebugResponse::Append(const char *pchFormat, ...)
+{
+    if (m_bOverflow || m_unBufferSize == 0) {
+        m_bOverflow = true;
+        return false;
+    }
+
+    va_list args;
+    va_start(args, pchFormat);
+    int nWritten = vsnprintf(m_pchBuffer + m_cbUsed, m_unBufferSize - m_cbUsed, pchFormat, args);
+    va_end(args);
+
+    if (nWritten < 0 || m_cbUsed + (uint32_t)nWritten >= m_unBufferSize) {
+        m_pchBuffer[m_cbUsed] = 0;
+        m_bOverflow = true;
+        return false;
+    }
+    m_cbUsed += (uint32_t)nWritten;
+    return true;
+}
+
+void CSampleDebugResponse::Error(const char *pchFormat, ...)
+{
+    if (m_unBufferSize == 0) {
+        return;
+    }
+
+    int nPrefix = snprintf(m_pchBuffer, m_unBufferSize, "error: ");
+    if (nPrefix > 0 && (uint32_t)nPrefix < m_unBufferSize) {
+        va_list args;
+        va_start(args, pchFormat);
+        vsnprintf(m_pchBuffer + nPrefix, m_unBufferSize - nPrefix, pchFormat, args);
+        va_end(args);
+    }
+    m_cbUsed = (uint32_t)strlen(m_pchBuffer);
+    m_bOverflow = false;
+}
+
+void CSampleDebugResponse::SetWritten(bool bFit)
+{
+    if (m_unBufferSize == 0) {
+        return;
+    }
+    m_cbUsed = bFit ? (uint32_t)strlen(m_pchBuffer) : 0;
+    m_bOverflow = !bFit;
+}
+
+void CSampleDebugResponse::Finish()
+{
+    if (m_bOverflow) {
+        Error("response buffer too small");
+    }
+}
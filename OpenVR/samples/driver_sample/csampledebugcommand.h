@@ -0,0 +1,75 @@
+#ifndef CSAMPLEDEBUGCOMMAND_H
+#define CSAMPLEDEBUGCOMMAND_H
+
+#include <stdarg.h>
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Purpose: Splits a debug request into whitespace separated words without
+// copying or allocating; tokens point into the request string. Words past
+// k_unMaxTokens make the request invalid rather than being dropped.
+//-----------------------------------------------------------------------------
+class CSampleDebugCommand
+{
+public:
+    static const uint32_t k_unMaxTokens = 8;
+
+    explicit CSampleDebugCommand(const char *pchRequest);
+
+    bool IsValid() const { return m_bValid; }
+
+    uint32_t GetTokenCount() const { return m_unTokens; }
+
+    /** true if token unToken exists and is exactly pchWord */
+    bool IsToken(uint32_t unToken, const char *pchWord) const;
+
+    const char *GetToken(uint32_t unToken) const { return m_rgpchTokens[unToken]; }
+
+    uint32_t GetTokenLength(uint32_t unToken) const { return m_rgcchTokens[unToken]; }
+
+    /** everything from token unToken to the end of the request, for arguments that contain spaces */
+    const char *GetRest(uint32_t unToken) const;
+
+    /** parses the whole token as a finite number */
+    bool GetFloat(uint32_t unToken, float *pflValue) const;
+
+private:
+    const char *m_pchRequest;
+    const char *m_rgpchTokens[k_unMaxTokens];
+    uint32_t m_rgcchTokens[k_unMaxTokens];
+    uint32_t m_unTokens;
+    bool m_bValid;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Formats a debug response into the buffer SteamVR passed in. Once a
+// write doesn't fit the response is marked overflowed and Finish() replaces
+// it by an error, so a client never sees half a line.
+//-----------------------------------------------------------------------------
+class CSampleDebugResponse
+{
+public:
+    CSampleDebugResponse(char *pchBuffer, uint32_t unBufferSize);
+
+    bool Append(const char *pchFormat, ...);
+
+    /** replaces whatever was written by "error: <message>" */
+    void Error(const char *pchFormat, ...);
+
+    char *GetBuffer() const { return m_pchBuffer; }
+
+    uint32_t GetBufferSize() const { return m_unBufferSize; }
+
+    /** call once a callee wrote the buffer directly, false means it reported that the buffer was too small */
+    void SetWritten(bool bFit);
+
+    void Finish();
+
+private:
+    char *m_pchBuffer;
+    uint32_t m_unBufferSize;
+    uint32_t m_cbUsed;
+    bool m_bOverflow;
+};
+
+#endif // CSAMPLEDEBUGCOMMAND_H
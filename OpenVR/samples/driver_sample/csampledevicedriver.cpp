@@ -1,20 +1,33 @@
 #include "csampledevicedriver.h"
 
 #include "basics.h"
+#include "csampletuning.h"
+#include "driverlog.h"
 
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 using namespace vr;
 
+static void LoadLensCoefficients(CSampleLensModel &lensModel, ESampleLensChannel eChannel, const char *pchSettingsKey, const char *pchDefault)
+{
+    char buf[256];
+    GetSampleSettingString(pchSettingsKey, buf, sizeof(buf), pchDefault);
+
+    float rgflCoefficients[k_unSampleLensCoefficients] = { 0 };
+    sscanf(buf, "%f %f %f %f %f", &rgflCoefficients[0], &rgflCoefficients[1], &rgflCoefficients[2], &rgflCoefficients[3], &rgflCoefficients[4]);
+    lensModel.SetCoefficients(eChannel, rgflCoefficients);
+}
+
 //Head tracking vars
 static double yaw = 0, pitch = 0, roll = 0;
 static double pX = 0, pY = 0, pZ = 0;
-static double t0, t1, t2, t3, t4, t5;
 
 CSampleDeviceDriver::CSampleDeviceDriver()
 {
-    m_unObjectId = vr::k_unTrackedDeviceIndexInvalid;
     m_ulPropertyContainer = vr::k_ulInvalidPropertyContainer;
+    m_nHmdIndex = 1;
 
     //DriverLog( "Using settings values\n" );
     m_flIPD = vr::VRSettings()->GetFloat(k_pch_SteamVR_Section, k_pch_SteamVR_IPD_Float);
@@ -30,24 +43,93 @@ CSampleDeviceDriver::CSampleDeviceDriver()
     m_nWindowY = vr::VRSettings()->GetInt32(k_pch_Sample_Section, k_pch_Sample_WindowY_Int32);
     m_nWindowWidth = vr::VRSettings()->GetInt32(k_pch_Sample_Section, k_pch_Sample_WindowWidth_Int32);
     m_nWindowHeight = vr::VRSettings()->GetInt32(k_pch_Sample_Section, k_pch_Sample_WindowHeight_Int32);
-    m_nRenderWidth = vr::VRSettings()->GetInt32(k_pch_Sample_Section, k_pch_Sample_RenderWidth_Int32);
-    m_nRenderHeight = vr::VRSettings()->GetInt32(k_pch_Sample_Section, k_pch_Sample_RenderHeight_Int32);
     m_flSecondsFromVsyncToPhotons = vr::VRSettings()->GetFloat(k_pch_Sample_Section, k_pch_Sample_SecondsFromVsyncToPhotons_Float);
     m_flDisplayFrequency = vr::VRSettings()->GetFloat(k_pch_Sample_Section, k_pch_Sample_DisplayFrequency_Float);
 
-    /*DriverLog( "driver_null: Serial Number: %s\n", m_sSerialNumber.c_str() );
-        DriverLog( "driver_null: Model Number: %s\n", m_sModelNumber.c_str() );
-        DriverLog( "driver_null: Window: %d %d %d %d\n", m_nWindowX, m_nWindowY, m_nWindowWidth, m_nWindowHeight );
-        DriverLog( "driver_null: Render Target: %d %d\n", m_nRenderWidth, m_nRenderHeight );
-        DriverLog( "driver_null: Seconds from Vsync to Photons: %f\n", m_flSecondsFromVsyncToPhotons );
-        DriverLog( "driver_null: Display Frequency: %f\n", m_flDisplayFrequency );
-        DriverLog( "driver_null: IPD: %f\n", m_flIPD );*/
+    // hand composited frames to another process instead of showing them in a window
+    m_bVirtualDisplay = GetSampleSettingBool(k_pch_Sample_VirtualDisplay_Bool, false);
+    GetSampleSettingString(k_pch_Sample_FrameExportName_String, buf, sizeof(buf), "openvr_diy_frames");
+    m_sFrameExportName = buf;
+
+    // a virtual display has no panel to take vsync from, so it always gets the software clock
+    m_bSoftwareVsync = m_bVirtualDisplay || GetSampleSettingBool(k_pch_Sample_SoftwareVsync_Bool, false);
+    m_bVsyncJitterStats = GetSampleSettingBool(k_pch_Sample_VsyncJitterStats_Bool, false);
+
+    // lens model, red and blue default to the green coefficients which means no chromatic aberration
+    GetSampleSettingString(k_pch_Sample_LensModel_String, buf, sizeof(buf), "none");
+    if (!_stricmp(buf, "brown")) {
+        m_lensModel.SetModel(SampleLensModel_BrownConrady);
+    } else if (!_stricmp(buf, "polynomial")) {
+        m_lensModel.SetModel(SampleLensModel_Polynomial);
+    } else {
+        m_lensModel.SetModel(SampleLensModel_None);
+    }
+    char greenBuf[256];
+    GetSampleSettingString(k_pch_Sample_LensCoefficientsGreen_String, greenBuf, sizeof(greenBuf), m_lensModel.GetModel() == SampleLensModel_Polynomial ? "1 0 0 0 0" : "0 0 0 0 0");
+    LoadLensCoefficients(m_lensModel, SampleLensChannel_Green, k_pch_Sample_LensCoefficientsGreen_String, greenBuf);
+    LoadLensCoefficients(m_lensModel, SampleLensChannel_Red, k_pch_Sample_LensCoefficientsRed_String, greenBuf);
+    LoadLensCoefficients(m_lensModel, SampleLensChannel_Blue, k_pch_Sample_LensCoefficientsBlue_String, greenBuf);
+    int32_t nLutResolution = GetSampleSettingInt32(k_pch_Sample_LensLutResolution_Int32, 64);
+    m_unLensLutResolution = nLutResolution > 1 ? (uint32_t)nLutResolution : 2;
+
+    // physical layout of panel and lenses, a lens separation of 0 means the lenses follow the IPD
+    m_flPanelWidth = GetSampleSettingFloat(k_pch_Sample_PanelWidth_Float, 0.12f);
+    m_flPanelHeight = GetSampleSettingFloat(k_pch_Sample_PanelHeight_Float, 0.06f);
+    m_flLensFocalLength = GetSampleSettingFloat(k_pch_Sample_LensFocalLength_Float, 0.04f);
+    m_flLensSeparation = GetSampleSettingFloat(k_pch_Sample_LensSeparation_Float, 0.0f);
+    if (m_flLensSeparation <= 0.0f) {
+        m_flLensSeparation = m_flIPD;
+    }
+    SetupLensGeometry();
+
+    // renderWidth and renderHeight still override the size derived from the lens when set
+    m_nFullRenderWidth = GetSampleSettingInt32(k_pch_Sample_RenderWidth_Int32, 0);
+    m_nFullRenderHeight = GetSampleSettingInt32(k_pch_Sample_RenderHeight_Int32, 0);
+    if (m_nFullRenderWidth <= 0 || m_nFullRenderHeight <= 0) {
+        ComputeRenderTargetSize();
+    }
+    SetRenderSize(m_nFullRenderWidth, m_nFullRenderHeight);
+
+    // scale the render target down and then the frequency when frames take too long, displayFrequency is the top
+    m_bAdaptiveRender = GetSampleSettingBool(k_pch_Sample_AdaptiveRender_Bool, false);
+    SampleAdaptiveRenderConfig_t adaptiveConfig;
+    adaptiveConfig.flMinScale = GetSampleSettingFloat(k_pch_Sample_AdaptiveMinScale_Float, 0.6f);
+    adaptiveConfig.flMaxScale = 1.0f;
+    adaptiveConfig.flScaleStep = 0.1f;
+    adaptiveConfig.flMinFrequency = GetSampleSettingFloat(k_pch_Sample_AdaptiveMinFrequency_Float, 0.0f);
+    adaptiveConfig.flMaxFrequency = m_flDisplayFrequency;
+    adaptiveConfig.flFrequencyStep = GetSampleSettingFloat(k_pch_Sample_AdaptiveFrequencyStep_Float, 10.0f);
+    adaptiveConfig.flTargetLoad = GetSampleSettingFloat(k_pch_Sample_AdaptiveTargetLoad_Float, 0.85f);
+    adaptiveConfig.flHysteresis = GetSampleSettingFloat(k_pch_Sample_AdaptiveHysteresis_Float, 0.1f);
+    adaptiveConfig.flHoldSeconds = 2.0f;
+    m_adaptiveRender.Configure(adaptiveConfig);
+    memset(&m_lastFrameTiming, 0, sizeof(m_lastFrameTiming));
+
+    DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: Serial Number: %s\n", m_sSerialNumber.c_str());
+    DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: Model Number: %s\n", m_sModelNumber.c_str());
+    DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: Window: %d %d %d %d\n", m_nWindowX, m_nWindowY, m_nWindowWidth, m_nWindowHeight);
+    DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: Render Target: %d %d\n", m_nFullRenderWidth, m_nFullRenderHeight);
+    DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: Seconds from Vsync to Photons: %f\n", m_flSecondsFromVsyncToPhotons);
+    DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: Display Frequency: %f\n", m_flDisplayFrequency);
+    DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: IPD: %f\n", m_flIPD);
 }
 
 CSampleDeviceDriver::~CSampleDeviceDriver()
 {
 }
 
+void CSampleDeviceDriver::SetHmdIndex(int32_t nHmdIndex)
+{
+    m_nHmdIndex = nHmdIndex;
+
+    // the first HMD keeps the configured serial, extra ones get a suffix so every serial stays unique
+    if (nHmdIndex > 1) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "-%d", nHmdIndex);
+        m_sSerialNumber += buf;
+    }
+}
+
 EVRInitError CSampleDeviceDriver::Activate(TrackedDeviceIndex_t unObjectId)
 {
     m_unObjectId = unObjectId;
@@ -60,6 +142,10 @@ EVRInitError CSampleDeviceDriver::Activate(TrackedDeviceIndex_t unObjectId)
     vr::VRProperties()->SetFloatProperty(m_ulPropertyContainer, Prop_DisplayFrequency_Float, m_flDisplayFrequency);
     vr::VRProperties()->SetFloatProperty(m_ulPropertyContainer, Prop_SecondsFromVsyncToPhotons_Float, m_flSecondsFromVsyncToPhotons);
 
+    // ComputeDistortion is called for the whole compositor mesh, bake the lens into a grid once up front
+    m_lensModel.BakeLut(m_unLensLutResolution);
+    PublishHiddenArea();
+
     // return a constant that's not 0 (invalid) or 1 (reserved for Oculus)
     vr::VRProperties()->SetUint64Property(m_ulPropertyContainer, Prop_CurrentUniverseId_Uint64, 2);
 
@@ -67,7 +153,26 @@ EVRInitError CSampleDeviceDriver::Activate(TrackedDeviceIndex_t unObjectId)
     vr::VRProperties()->SetBoolProperty(m_ulPropertyContainer, Prop_IsOnDesktop_Bool, false);
 
     //Debug mode activate Windowed Mode (borderless fullscreen), locked to 30 FPS, for testing
-    vr::VRProperties()->SetBoolProperty(m_ulPropertyContainer, Prop_DisplayDebugMode_Bool, true);
+    vr::VRProperties()->SetBoolProperty(m_ulPropertyContainer, Prop_DisplayDebugMode_Bool, !m_bVirtualDisplay);
+
+    // a virtual display that can't export leaves the compositor without a display, better to fail loudly.
+    // Present() never has pixels, the backbuffer stays on the GPU, so the export is metadata only
+    if (m_bVirtualDisplay && !m_virtualDisplay.Open(m_sFrameExportName.c_str(), m_nWindowWidth, m_nWindowHeight, &m_vsyncClock, false)) {
+        DRIVERLOG_ERROR(DriverLogCategory_Display, "driver_null: cannot create frame export %s\n", m_sFrameExportName.c_str());
+        m_unObjectId = vr::k_unTrackedDeviceIndexInvalid;
+        return VRInitError_Driver_Failed;
+    }
+
+    // after everything that can fail, a device that didn't activate must not get VsyncEvents
+    if (m_bSoftwareVsync) {
+        vr::VRProperties()->SetBoolProperty(m_ulPropertyContainer, Prop_DriverDirectModeSendsVsyncEvents_Bool, true);
+        m_vsyncClock.Start(m_flDisplayFrequency, true, m_bVsyncJitterStats);
+    }
+
+    if (m_bAdaptiveRender && !m_bVirtualDisplay) {
+        DRIVERLOG_WARNING(DriverLogCategory_Display, "driver_null: adaptiveRender needs virtualDisplay for frame timings, staying at %d x %d\n", m_nFullRenderWidth, m_nFullRenderHeight);
+    }
+    memset(&m_lastFrameTiming, 0, sizeof(m_lastFrameTiming));
 
     // Icons can be configured in code or automatically configured by an external file "drivername\resources\driver.vrresources".
     // Icon properties NOT configured in code (post Activate) are then auto-configured by the optional presence of a driver's "drivername\resources\driver.vrresources".
@@ -111,11 +216,24 @@ EVRInitError CSampleDeviceDriver::Activate(TrackedDeviceIndex_t unObjectId)
 
 void CSampleDeviceDriver::Deactivate()
 {
+    m_virtualDisplay.Close();
+    m_vsyncClock.Stop();
     m_unObjectId = vr::k_unTrackedDeviceIndexInvalid;
 }
 
 void CSampleDeviceDriver::EnterStandby()
 {
+    // no more poses or vsyncs from this device until the server leaves standby
+    SetStandby(true);
+    m_vsyncClock.Stop();
+}
+
+void CSampleDeviceDriver::LeaveStandby()
+{
+    SetStandby(false);
+    if (m_bSoftwareVsync && GetObjectId() != vr::k_unTrackedDeviceIndexInvalid) {
+        m_vsyncClock.Resume();
+    }
 }
 
 void *CSampleDeviceDriver::GetComponent(const char *pchComponentNameAndVersion)
@@ -123,6 +241,9 @@ void *CSampleDeviceDriver::GetComponent(const char *pchComponentNameAndVersion)
     if (!_stricmp(pchComponentNameAndVersion, vr::IVRDisplayComponent_Version)) {
         return (vr::IVRDisplayComponent *)this;
     }
+    if (m_bVirtualDisplay && !_stricmp(pchComponentNameAndVersion, vr::IVRVirtualDisplay_Version)) {
+        return (vr::IVRVirtualDisplay *)&m_virtualDisplay;
+    }
 
     // override this to add a component to a driver
     return NULL;
@@ -132,13 +253,44 @@ void CSampleDeviceDriver::PowerOff()
 {
 }
 
-void CSampleDeviceDriver::DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize)
+void CSampleDeviceDriver::RunFrame()
 {
-    if (unResponseBufferSize >= 1) {
-        pchResponseBuffer[0] = 0;
+    if (!m_bAdaptiveRender || !m_virtualDisplay.IsOpen()) {
+        return;
+    }
+
+    SampleFrameTiming_t timing;
+    m_virtualDisplay.GetFrameTiming(&timing);
+    bool bChanged = m_adaptiveRender.AddFrames(GetTimestampNs(), timing.ulFrames - m_lastFrameTiming.ulFrames,
+        timing.ulBusyNs - m_lastFrameTiming.ulBusyNs, timing.ulMissedVsyncs - m_lastFrameTiming.ulMissedVsyncs);
+    m_lastFrameTiming = timing;
+    if (bChanged) {
+        ApplyAdaptiveRender();
     }
 }
 
+void CSampleDeviceDriver::ApplyAdaptiveRender()
+{
+    float flScale = m_adaptiveRender.GetScale();
+    int32_t nRenderWidth = (int32_t)ceilf(m_nFullRenderWidth * flScale);
+    int32_t nRenderHeight = (int32_t)ceilf(m_nFullRenderHeight * flScale);
+    SetRenderSize(nRenderWidth, nRenderHeight);
+
+    // the vsync grid moves at the next vsync, the counter WaitForPresent waits on keeps counting
+    float flFrequency = m_adaptiveRender.GetFrequency();
+    if (flFrequency != m_flDisplayFrequency) {
+        m_flDisplayFrequency = flFrequency;
+        vr::VRProperties()->SetFloatProperty(m_ulPropertyContainer, Prop_DisplayFrequency_Float, m_flDisplayFrequency);
+        m_vsyncClock.SetFrequency(m_flDisplayFrequency);
+    }
+    DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: %s, render target %d x %d at %.1f Hz\n", m_adaptiveRender.GetReason(), nRenderWidth, nRenderHeight, m_flDisplayFrequency);
+}
+
+void CSampleDeviceDriver::SetRenderSize(int32_t nWidth, int32_t nHeight)
+{
+    m_ulRenderSize.store(((uint64_t)(uint32_t)nWidth << 32) | (uint32_t)nHeight, std::memory_order_relaxed);
+}
+
 void CSampleDeviceDriver::GetWindowBounds(int32_t *pnX, int32_t *pnY, uint32_t *pnWidth, uint32_t *pnHeight)
 {
     *pnX = m_nWindowX;
@@ -149,7 +301,7 @@ void CSampleDeviceDriver::GetWindowBounds(int32_t *pnX, int32_t *pnY, uint32_t *
 
 bool CSampleDeviceDriver::IsDisplayOnDesktop()
 {
-    return true;
+    return !m_bVirtualDisplay;
 }
 
 bool CSampleDeviceDriver::IsDisplayRealDisplay()
@@ -159,8 +311,10 @@ bool CSampleDeviceDriver::IsDisplayRealDisplay()
 
 void CSampleDeviceDriver::GetRecommendedRenderTargetSize(uint32_t *pnWidth, uint32_t *pnHeight)
 {
-    *pnWidth = m_nRenderWidth;
-    *pnHeight = m_nRenderHeight;
+    // width and height from the same adaptive step, never one of each
+    uint64_t ulRenderSize = m_ulRenderSize.load(std::memory_order_relaxed);
+    *pnWidth = (uint32_t)(ulRenderSize >> 32);
+    *pnHeight = (uint32_t)ulRenderSize;
 }
 
 void CSampleDeviceDriver::GetEyeOutputViewport(EVREye eEye, uint32_t *pnX, uint32_t *pnY, uint32_t *pnWidth, uint32_t *pnHeight)
@@ -178,54 +332,109 @@ void CSampleDeviceDriver::GetEyeOutputViewport(EVREye eEye, uint32_t *pnX, uint3
 
 void CSampleDeviceDriver::GetProjectionRaw(EVREye eEye, float *pfLeft, float *pfRight, float *pfTop, float *pfBottom)
 {
-    *pfLeft = -1.0;
-    *pfRight = 1.0;
-    *pfTop = -1.0;
-    *pfBottom = 1.0;
+    *pfLeft = m_rgflProjection[eEye][0];
+    *pfRight = m_rgflProjection[eEye][1];
+    *pfTop = m_rgflProjection[eEye][2];
+    *pfBottom = m_rgflProjection[eEye][3];
 }
 
-DistortionCoordinates_t CSampleDeviceDriver::ComputeDistortion(EVREye eEye, float fU, float fV)
+void CSampleDeviceDriver::SetupLensGeometry()
+{
+    // nonsense in the settings would divide by zero below, fall back to the defaults
+    if (m_flPanelWidth <= 0.0f || m_flPanelHeight <= 0.0f || m_flLensFocalLength <= 0.0f) {
+        DRIVERLOG_WARNING(DriverLogCategory_Display, "driver_null: invalid panel or lens size, using the defaults\n");
+        m_flPanelWidth = 0.12f;
+        m_flPanelHeight = 0.06f;
+        m_flLensFocalLength = 0.04f;
+    }
+
+    // one unit of lens space is half the panel height, the panel sits in the focal plane
+    // so that distance on it turns into a view angle tangent by dividing by the focal length
+    float flTangentPerUnit = 0.5f * m_flPanelHeight / m_flLensFocalLength;
+    m_lensModel.SetAspect(0.5f * m_flPanelWidth / m_flPanelHeight);
+
+    // the lens edge cuts the view off at lensFov, 0 means the panel edge is always what limits it
+    float flLensFov = GetSampleSettingFloat(k_pch_Sample_LensFov_Float, 0.0f);
+    m_flLensMaxRadius = 0.0f;
+    if (flLensFov > 0.0f && flLensFov < 180.0f) {
+        m_flLensMaxRadius = tanf(flLensFov * 0.5f * 3.14159265f / 180.0f) / flTangentPerUnit;
+    }
+
+    // lens centres sit lensSeparation apart around the middle of the panel, plus the configured offsets
+    float flSeparationOffset = m_flLensSeparation / m_flPanelWidth - 0.5f;
+    m_lensModel.SetCenterOffset(Eye_Left, GetSampleSettingFloat(k_pch_Sample_LensCenterLeftU_Float, 0.0f) - flSeparationOffset, GetSampleSettingFloat(k_pch_Sample_LensCenterLeftV_Float, 0.0f));
+    m_lensModel.SetCenterOffset(Eye_Right, GetSampleSettingFloat(k_pch_Sample_LensCenterRightU_Float, 0.0f) + flSeparationOffset, GetSampleSettingFloat(k_pch_Sample_LensCenterRightV_Float, 0.0f));
+
+    // render exactly what can be seen, the frustum is the visible region turned into tangents
+    for (uint32_t unEye = 0; unEye < 2; unEye++) {
+        SampleLensBounds_t bounds = m_lensModel.ComputeVisibleBounds((EVREye)unEye, m_flLensMaxRadius);
+        m_lensModel.SetOutputBounds((EVREye)unEye, bounds);
+        m_rgflProjection[unEye][0] = bounds.flLeft * flTangentPerUnit;
+        m_rgflProjection[unEye][1] = bounds.flRight * flTangentPerUnit;
+        m_rgflProjection[unEye][2] = bounds.flTop * flTangentPerUnit;
+        m_rgflProjection[unEye][3] = bounds.flBottom * flTangentPerUnit;
+        DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: %s eye projection %.3f %.3f %.3f %.3f\n", unEye == Eye_Left ? "left" : "right",
+            m_rgflProjection[unEye][0], m_rgflProjection[unEye][1], m_rgflProjection[unEye][2], m_rgflProjection[unEye][3]);
+    }
+}
+
+void CSampleDeviceDriver::PublishHiddenArea()
 {
-    DistortionCoordinates_t coordinates;
-    coordinates.rfBlue[0] = fU;
-    coordinates.rfBlue[1] = fV;
-    coordinates.rfGreen[0] = fU;
-    coordinates.rfGreen[1] = fV;
-    coordinates.rfRed[0] = fU;
-    coordinates.rfRed[1] = fV;
-    return coordinates;
+    // the helper always writes to the property container of the first HMD
+    if (m_unObjectId != vr::k_unTrackedDeviceIndex_Hmd) {
+        return;
+    }
+
+    std::vector<HmdVector2_t> vecVertices;
+    for (uint32_t unEye = 0; unEye < 2; unEye++) {
+        m_lensModel.BuildHiddenAreaMesh((EVREye)unEye, m_flLensMaxRadius, vecVertices);
+        if (!vecVertices.empty()) {
+            vr::VRHiddenArea()->SetHiddenArea((EVREye)unEye, k_eHiddenAreaMesh_Standard, vecVertices.data(), (uint32_t)vecVertices.size());
+        }
+    }
 }
 
-vr::DriverPose_t CSampleDeviceDriver::GetPose()
+void CSampleDeviceDriver::ComputeRenderTargetSize()
 {
-    vr::DriverPose_t pose = { 0 };
-    pose.poseIsValid = true;
-    pose.result = vr::TrackingResult_Running_OK;
-    pose.deviceIsConnected = true;
+    float flQuality = GetSampleSettingFloat(k_pch_Sample_RenderQuality_Float, 1.0f);
+    if (flQuality <= 0.0f) {
+        flQuality = 1.0f;
+    }
 
-    pose.qWorldFromDriverRotation = HmdQuaternion_Init(1, 0, 0, 0);
-    pose.qDriverFromHeadRotation = HmdQuaternion_Init(1, 0, 0, 0);
+    m_lensModel.GetRenderTargetSize((float)(m_nWindowWidth / 2), (float)m_nWindowHeight, flQuality, &m_nFullRenderWidth, &m_nFullRenderHeight);
+    DRIVERLOG_INFO(DriverLogCategory_Display, "driver_null: recommended render target %d x %d\n", m_nFullRenderWidth, m_nFullRenderHeight);
+}
+
+DistortionCoordinates_t CSampleDeviceDriver::ComputeDistortion(EVREye eEye, float fU, float fV)
+{
+    return m_lensModel.Lookup(eEye, fU, fV);
+}
+
+void CSampleDeviceDriver::PollKeyboard()
+{
+    double flTurn = GetSampleTuning(SampleTuning_HmdTurnStep);
+    double flMove = GetSampleTuning(SampleTuning_HmdMoveStep);
 
     //Simple change yaw, pitch, roll with numpad keys
     if ((GetAsyncKeyState(VK_NUMPAD3) & 0x8000) != 0) {
-        yaw += 0.01;
+        yaw += flTurn;
     }
     if ((GetAsyncKeyState(VK_NUMPAD1) & 0x8000) != 0) {
-        yaw += -0.01;
+        yaw += -flTurn;
     }
 
     if ((GetAsyncKeyState(VK_NUMPAD4) & 0x8000) != 0) {
-        pitch += 0.01;
+        pitch += flTurn;
     }
     if ((GetAsyncKeyState(VK_NUMPAD6) & 0x8000) != 0) {
-        pitch += -0.01;
+        pitch += -flTurn;
     }
 
     if ((GetAsyncKeyState(VK_NUMPAD8) & 0x8000) != 0) {
-        roll += 0.01;
+        roll += flTurn;
     }
     if ((GetAsyncKeyState(VK_NUMPAD2) & 0x8000) != 0) {
-        roll += -0.01;
+        roll += -flTurn;
     }
 
     if ((GetAsyncKeyState(VK_NUMPAD9) & 0x8000) != 0) {
@@ -235,24 +444,24 @@ vr::DriverPose_t CSampleDeviceDriver::GetPose()
     }
 
     if ((GetAsyncKeyState(VK_UP) & 0x8000) != 0) {
-        pZ += -0.01;
+        pZ += -flMove;
     }
     if ((GetAsyncKeyState(VK_DOWN) & 0x8000) != 0) {
-        pZ += 0.01;
+        pZ += flMove;
     }
 
     if ((GetAsyncKeyState(VK_LEFT) & 0x8000) != 0) {
-        pX += -0.01;
+        pX += -flMove;
     }
     if ((GetAsyncKeyState(VK_RIGHT) & 0x8000) != 0) {
-        pX += 0.01;
+        pX += flMove;
     }
 
     if ((GetAsyncKeyState(VK_PRIOR) & 0x8000) != 0) {
-        pY += 0.01;
+        pY += flMove;
     }
     if ((GetAsyncKeyState(VK_NEXT) & 0x8000) != 0) {
-        pY += -0.01;
+        pY += -flMove;
     }
 
     if ((GetAsyncKeyState(VK_END) & 0x8000) != 0) {
@@ -260,34 +469,31 @@ vr::DriverPose_t CSampleDeviceDriver::GetPose()
         pY = 0;
         pZ = 0;
     }
+}
+
+vr::DriverPose_t CSampleDeviceDriver::GetPose()
+{
+    vr::DriverPose_t pose = { 0 };
+    FillConnectionState(pose);
+
+    pose.qWorldFromDriverRotation = HmdQuaternion_Init(1, 0, 0, 0);
+    pose.qDriverFromHeadRotation = HmdQuaternion_Init(1, 0, 0, 0);
+
+    //A pose from the transport wins over the keyboard emulation
+    if (GetTransportPose(pose)) {
+        return pose;
+    }
+    if (!IsKeyboardDriven()) {
+        pose.qRotation = HmdQuaternion_Init(1, 0, 0, 0);
+        return pose;
+    }
 
     pose.vecPosition[0] = pX;
     pose.vecPosition[1] = pY;
     pose.vecPosition[2] = pZ;
 
-    //Convert yaw, pitch, roll to quaternion
-    t0 = cos(yaw * 0.5);
-    t1 = sin(yaw * 0.5);
-    t2 = cos(roll * 0.5);
-    t3 = sin(roll * 0.5);
-    t4 = cos(pitch * 0.5);
-    t5 = sin(pitch * 0.5);
-
     //Set head tracking rotation
-    pose.qRotation.w = t0 * t2 * t4 + t1 * t3 * t5;
-    pose.qRotation.x = t0 * t3 * t4 - t1 * t2 * t5;
-    pose.qRotation.y = t0 * t2 * t5 + t1 * t3 * t4;
-    pose.qRotation.z = t1 * t2 * t4 - t0 * t3 * t5;
+    pose.qRotation = HmdQuaternion_FromEuler(yaw, pitch, roll);
 
     return pose;
 }
-
-void CSampleDeviceDriver::RunFrame()
-{
-    // In a real driver, this should happen from some pose tracking thread.
-    // The RunFrame interval is unspecified and can be very irregular if some other
-    // driver blocks it for some periodic task.
-    if (m_unObjectId != vr::k_unTrackedDeviceIndexInvalid) {
-        vr::VRServerDriverHost()->TrackedDevicePoseUpdated(m_unObjectId, GetPose(), sizeof(DriverPose_t));
-    }
-}
@@ -2,29 +2,39 @@
 #define CSAMPLEDEVICEDRIVER_H
 
 #include <openvr_driver.h>
+#include "csampletrackeddevice.h"
+#include "csampleadaptiverender.h"
+#include "csamplelensmodel.h"
+#include "csamplevirtualdisplay.h"
+
+#include <atomic>
 
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
-class CSampleDeviceDriver : public vr::ITrackedDeviceServerDriver, public vr::IVRDisplayComponent
+class CSampleDeviceDriver : public CSampleTrackedDevice, public vr::IVRDisplayComponent
 {
 public:
     CSampleDeviceDriver();
 
     virtual ~CSampleDeviceDriver();
 
+    void SetHmdIndex(int32_t nHmdIndex);
+
     virtual vr::EVRInitError Activate(vr::TrackedDeviceIndex_t unObjectId);
 
     virtual void Deactivate();
 
     virtual void EnterStandby();
 
+    virtual void LeaveStandby();
+
     void *GetComponent(const char *pchComponentNameAndVersion);
 
     virtual void PowerOff();
 
-    /** debug request from a client */
-    virtual void DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize);
+    /** follows the frame timing of the virtual display with render size and frequency when adaptiveRender is on */
+    virtual void RunFrame();
 
     virtual void GetWindowBounds(int32_t *pnX, int32_t *pnY, uint32_t *pnWidth, uint32_t *pnHeight);
 
@@ -42,14 +52,31 @@ public:
 
     virtual vr::DriverPose_t GetPose();
 
-    void RunFrame();
+    virtual vr::ETrackedDeviceClass GetDeviceClass() const { return vr::TrackedDeviceClass_HMD; }
 
-    std::string GetSerialNumber() const { return m_sSerialNumber; }
+    virtual const std::string &GetSerialNumber() const { return m_sSerialNumber; }
+
+    virtual bool IsKeyboardDriven() const { return m_nHmdIndex == 1; }
+
+    static void PollKeyboard();
 
 private:
-    vr::TrackedDeviceIndex_t m_unObjectId;
+    /** places the lenses on the panel and derives the per-eye frustum from what they show */
+    void SetupLensGeometry();
+
+    void PublishHiddenArea();
+
+    /** render target that puts one rendered pixel on every panel pixel at the lens centre, times renderQuality */
+    void ComputeRenderTargetSize();
+
+    void ApplyAdaptiveRender();
+
+    /** RunFrame() changes the size while the compositor asks for it, so both go into one atomic */
+    void SetRenderSize(int32_t nWidth, int32_t nHeight);
+
     vr::PropertyContainerHandle_t m_ulPropertyContainer;
 
+    int32_t m_nHmdIndex;
     std::string m_sSerialNumber;
     std::string m_sModelNumber;
 
@@ -57,11 +84,34 @@ private:
     int32_t m_nWindowY;
     int32_t m_nWindowWidth;
     int32_t m_nWindowHeight;
-    int32_t m_nRenderWidth;
-    int32_t m_nRenderHeight;
+    std::atomic<uint64_t> m_ulRenderSize;   // width in the high 32 bits, height in the low
     float m_flSecondsFromVsyncToPhotons;
     float m_flDisplayFrequency;
     float m_flIPD;
+
+    bool m_bVirtualDisplay;
+    std::string m_sFrameExportName;
+    bool m_bSoftwareVsync;
+    bool m_bVsyncJitterStats;
+    CSampleVsyncClock m_vsyncClock;
+    CSampleVirtualDisplay m_virtualDisplay;
+
+    bool m_bAdaptiveRender;
+    CSampleAdaptiveRender m_adaptiveRender;
+    int32_t m_nFullRenderWidth;   // at adaptive scale 1
+    int32_t m_nFullRenderHeight;
+    SampleFrameTiming_t m_lastFrameTiming;
+
+    CSampleLensModel m_lensModel;
+    uint32_t m_unLensLutResolution;
+    float m_flPanelWidth;
+    float m_flPanelHeight;
+    float m_flLensFocalLength;
+    float m_flLensSeparation;
+    float m_flLensMaxRadius;
+
+    // tangents of the half angles per eye, in GetProjectionRaw order: left, right, top, bottom
+    float m_rgflProjection[2][4];
 };
 
 #endif // CSAMPLEDEVICEDRIVER_H
@@ -0,0 +1,241 @@
+#include "csampledeviceregistry.h"
+
+#include "basics.h"
+#include "csampleframemonitor.h"
+#include "csampletrace.h"
+#include "csampletuning.h"
+#include "driverlog.h"
+
+#include <chrono>
+
+using namespace vr;
+
+static int32_t ClaimSlots(int32_t nCount, int32_t *pnFreeSlots)
+{
+    if (nCount < 0) {
+        nCount = 0;
+    }
+    if (nCount > *pnFreeSlots) {
+        nCount = *pnFreeSlots;
+    }
+    *pnFreeSlots -= nCount;
+    return nCount;
+}
+
+CSampleDeviceRegistry::CSampleDeviceRegistry()
+    : m_bPoseThreadRunning(false), m_bStandby(false)
+{
+    m_bKeyboardInput = true;
+    m_unAddedDevices = 0;
+    m_pWorkerPool = nullptr;
+    m_pPoseThread = nullptr;
+}
+
+CSampleDeviceRegistry::~CSampleDeviceRegistry()
+{
+    StopPoseThread();
+    Clear();
+}
+
+void CSampleDeviceRegistry::CreateDevicesFromSettings()
+{
+    Clear();
+
+    int32_t nHmdCount = GetSampleSettingInt32(k_pch_Sample_HmdCount_Int32, 1);
+    int32_t nControllerCount = GetSampleSettingInt32(k_pch_Sample_ControllerCount_Int32, 2);
+    int32_t nTrackerCount = GetSampleSettingInt32(k_pch_Sample_TrackerCount_Int32, 0);
+    float flDeviceTimeout = GetSampleSettingFloat(k_pch_Sample_DeviceTimeout_Float, 0.5f);
+    m_bKeyboardInput = GetSampleSettingBool(k_pch_Sample_KeyboardInput_Bool, true);
+    float flStandbyPoseRate = GetSampleSettingFloat(k_pch_Sample_StandbyPoseRate_Float, 1.0f);
+    SetSampleTuning(SampleTuning_StandbyPoseRate, flStandbyPoseRate > 0.01f ? flStandbyPoseRate : 0.01f);
+
+    // SteamVR can't track more than k_unMaxTrackedDeviceCount devices, so don't create more than that
+    int32_t nFreeSlots = (int32_t)vr::k_unMaxTrackedDeviceCount;
+    nHmdCount = ClaimSlots(nHmdCount, &nFreeSlots);
+    nControllerCount = ClaimSlots(nControllerCount, &nFreeSlots);
+    nTrackerCount = ClaimSlots(nTrackerCount, &nFreeSlots);
+
+    m_vecDevices.reserve(nHmdCount + nControllerCount + nTrackerCount);
+
+    if (nHmdCount > 0) {
+        m_pHmds.reset(new CSampleDeviceDriver[nHmdCount]);
+        for (int32_t i = 0; i < nHmdCount; i++) {
+            m_pHmds[i].SetHmdIndex(i + 1);
+            m_vecDevices.push_back(&m_pHmds[i]);
+        }
+    }
+
+    if (nControllerCount > 0) {
+        m_pControllers.reset(new CSampleControllerDriver[nControllerCount]);
+        for (int32_t i = 0; i < nControllerCount; i++) {
+            m_pControllers[i].SetControllerIndex(i + 1);
+            m_vecDevices.push_back(&m_pControllers[i]);
+        }
+    }
+
+    if (nTrackerCount > 0) {
+        m_pTrackers.reset(new CSampleTrackerDriver[nTrackerCount]);
+        for (int32_t i = 0; i < nTrackerCount; i++) {
+            m_pTrackers[i].SetTrackerIndex(i + 1);
+            m_vecDevices.push_back(&m_pTrackers[i]);
+        }
+    }
+
+    for (CSampleTrackedDevice *pDevice : m_vecDevices) {
+        pDevice->SetConnectionTimeout(flDeviceTimeout);
+    }
+}
+
+void CSampleDeviceRegistry::Clear()
+{
+    m_vecDevices.clear();
+    m_unAddedDevices = 0;
+    m_pHmds.reset();
+    m_pControllers.reset();
+    m_pTrackers.reset();
+}
+
+void CSampleDeviceRegistry::RunFrame()
+{
+    // no input polling while in standby, devices that show up meanwhile are added on the way out
+    if (m_bStandby) {
+        return;
+    }
+
+    for (CSampleTrackedDevice *pDevice : m_vecDevices) {
+        if (!pDevice->IsAddedToHost()) {
+            if (!pDevice->HasReceivedData()) {
+                continue;
+            }
+            DRIVERLOG_INFO(DriverLogCategory_Tracking, "driver_null: adding %s\n", pDevice->GetSerialNumber().c_str());
+            vr::VRServerDriverHost()->TrackedDeviceAdded(pDevice->GetSerialNumber().c_str(), pDevice->GetDeviceClass(), pDevice);
+            pDevice->SetAddedToHost();
+            m_unAddedDevices++;
+        }
+
+        CSampleTraceScope scope(SampleTraceScope_DeviceRunFrame, pDevice->GetObjectId());
+        CSampleActivityScope activity(SampleActivityThread_Server, SampleTraceScope_DeviceRunFrame);
+        pDevice->RunFrame();
+    }
+}
+
+void CSampleDeviceRegistry::StartPoseThread(CSampleWorkerPool *pWorkerPool, float flPoseRate)
+{
+    StopPoseThread();
+
+    m_pWorkerPool = pWorkerPool;
+    SetSampleTuning(SampleTuning_PoseRate, flPoseRate > 1.0f ? flPoseRate : 1.0f);
+    m_bPoseThreadRunning = true;
+    m_pPoseThread = new std::thread(&CSampleDeviceRegistry::PoseThreadFunction, this);
+}
+
+void CSampleDeviceRegistry::StopPoseThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_poseThreadMutex);
+        m_bPoseThreadRunning = false;
+    }
+    m_poseThreadWake.notify_all();
+    if (m_pPoseThread) {
+        m_pPoseThread->join();
+        delete m_pPoseThread;
+        m_pPoseThread = nullptr;
+    }
+}
+
+void CSampleDeviceRegistry::SetStandby(bool bStandby)
+{
+    if (!bStandby) {
+        for (CSampleTrackedDevice *pDevice : m_vecDevices) {
+            pDevice->LeaveStandby();
+        }
+    }
+
+    // wake the pose thread right away so it picks up the new rate instead of finishing a long standby sleep
+    {
+        std::lock_guard<std::mutex> lock(m_poseThreadMutex);
+        m_bStandby = bStandby;
+    }
+    m_poseThreadWake.notify_all();
+}
+
+void CSampleDeviceRegistry::UpdatePoseChunk(void *pContext, uint32_t unChunk)
+{
+    CSampleDeviceRegistry *pRegistry = (CSampleDeviceRegistry *)pContext;
+    CSampleTraceScope scope(SampleTraceScope_PoseChunk, unChunk);
+
+    uint32_t unBegin = unChunk * k_unDevicesPerChunk;
+    uint32_t unEnd = unBegin + k_unDevicesPerChunk;
+    if (unEnd > pRegistry->GetDeviceCount()) {
+        unEnd = pRegistry->GetDeviceCount();
+    }
+    for (uint32_t i = unBegin; i < unEnd; i++) {
+        CSampleTrackedDevice *pDevice = pRegistry->m_vecDevices[i];
+        if (!pDevice->IsInStandby()) {
+            pDevice->UpdatePose();
+        }
+    }
+}
+
+void CSampleDeviceRegistry::UpdatePoses()
+{
+    CSampleTraceScope scope(SampleTraceScope_PoseTick);
+    CSampleActivityScope activity(SampleActivityThread_Pose, SampleTraceScope_PoseTick);
+
+    // the keyboard emulation is a local transport that always has data
+    if (m_bKeyboardInput) {
+        CSampleDeviceDriver::PollKeyboard();
+        CSampleControllerDriver::PollKeyboard();
+        for (CSampleTrackedDevice *pDevice : m_vecDevices) {
+            if (pDevice->IsKeyboardDriven()) {
+                pDevice->OnTransportData();
+            }
+        }
+    }
+
+    // neighbouring devices share a chunk, so a worker walks a contiguous run of the device arrays
+    // a standby heartbeat is not worth waking the workers for
+    uint32_t unChunkCount = (GetDeviceCount() + k_unDevicesPerChunk - 1) / k_unDevicesPerChunk;
+    if (m_pWorkerPool && !m_bStandby) {
+        m_pWorkerPool->ParallelFor(unChunkCount, &CSampleDeviceRegistry::UpdatePoseChunk, this);
+    } else {
+        for (uint32_t i = 0; i < unChunkCount; i++) {
+            UpdatePoseChunk(this, i);
+        }
+    }
+
+    CSampleTraceScope submitScope(SampleTraceScope_PoseSubmitAll);
+    CSampleActivityScope submitActivity(SampleActivityThread_Pose, SampleTraceScope_PoseSubmitAll);
+    for (CSampleTrackedDevice *pDevice : m_vecDevices) {
+        if (!pDevice->IsInStandby()) {
+            pDevice->SubmitPose();
+        }
+    }
+}
+
+void CSampleDeviceRegistry::PoseThreadFunction()
+{
+    std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+    SetSampleTraceThreadName("pose");
+
+    while (m_bPoseThreadRunning) {
+        bool bStandby = m_bStandby;
+        UpdatePoses();
+
+        // ticks are on a fixed grid, if we fell behind skip ahead instead of bursting. The rates can be tuned
+        // at any time, a change takes effect from the next tick on
+        double flInterval = 1.0 / GetSampleTuning(bStandby ? SampleTuning_StandbyPoseRate : SampleTuning_PoseRate);
+        nextTick += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(flInterval));
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (nextTick < now) {
+            DRIVERLOG_VERBOSE(DriverLogCategory_Tracking, "driver_null: pose tick %.2f ms late\n", std::chrono::duration<double, std::milli>(now - nextTick).count());
+            nextTick = now;
+        }
+
+        std::unique_lock<std::mutex> lock(m_poseThreadMutex);
+        m_poseThreadWake.wait_until(lock, nextTick, [&] { return !m_bPoseThreadRunning || m_bStandby != bStandby; });
+        if (m_bStandby != bStandby) {
+            nextTick = std::chrono::steady_clock::now();
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef CSAMPLEDEVICEREGISTRY_H
+#define CSAMPLEDEVICEREGISTRY_H
+
+#include <openvr_driver.h>
+#include "csampledevicedriver.h"
+#include "csamplecontrollerdriver.h"
+#include "csampletrackerdriver.h"
+#include "csampleworkerpool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Purpose: Owns every device of the driver. The number of HMDs, controllers
+// and generic trackers comes from the settings; each class lives in one
+// contiguous array and all devices are also reachable through a flat list.
+// Devices are only added to SteamVR once their transport delivered data.
+// Poses are evaluated on an own pose thread, fanned out over the worker pool
+// in chunks of neighbouring devices and submitted once all chunks are done.
+//-----------------------------------------------------------------------------
+class CSampleDeviceRegistry
+{
+public:
+    CSampleDeviceRegistry();
+
+    ~CSampleDeviceRegistry();
+
+    void CreateDevicesFromSettings();
+
+    void Clear();
+
+    void RunFrame();
+
+    void StartPoseThread(CSampleWorkerPool *pWorkerPool, float flPoseRate);
+
+    void StopPoseThread();
+
+    /** in standby the pose thread drops to a heartbeat and no device submits poses */
+    void SetStandby(bool bStandby);
+
+    /** one tick of the pose thread */
+    void UpdatePoses();
+
+    uint32_t GetDeviceCount() const { return (uint32_t)m_vecDevices.size(); }
+
+    CSampleTrackedDevice *GetDevice(uint32_t unSlot) const { return m_vecDevices[unSlot]; }
+
+    /** devices handed to SteamVR so far, a silent one never counts */
+    uint32_t GetAddedDeviceCount() const { return m_unAddedDevices; }
+
+private:
+    static const uint32_t k_unDevicesPerChunk = 4;
+
+    static void UpdatePoseChunk(void *pContext, uint32_t unChunk);
+
+    void PoseThreadFunction();
+
+    std::unique_ptr<CSampleDeviceDriver[]> m_pHmds;
+    std::unique_ptr<CSampleControllerDriver[]> m_pControllers;
+    std::unique_ptr<CSampleTrackerDriver[]> m_pTrackers;
+
+    std::vector<CSampleTrackedDevice *> m_vecDevices;
+    uint32_t m_unAddedDevices;   // RunFrame thread only
+
+    bool m_bKeyboardInput;
+
+    CSampleWorkerPool *m_pWorkerPool;
+    std::thread *m_pPoseThread;
+    std::atomic<bool> m_bPoseThreadRunning;
+    std::atomic<bool> m_bStandby;
+    std::mutex m_poseThreadMutex;
+    std::condition_variable m_poseThreadWake;
+};
+
+#endif // CSAMPLEDEVICEREGISTRY_H
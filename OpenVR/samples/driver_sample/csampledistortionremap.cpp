@@ -0,0 +1,477 @@
+#include "csampledistortionremap.h"
+#include "csamplelensmodel.h"
+#include "csampleworkerpool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SAMPLE_REMAP_SSE2
+#endif
+
+using namespace vr;
+
+static const int32_t k_nFixedOne = 1 << 16;
+
+// texel range of one eye in the source, 16.16 fixed point
+struct EyeBounds_t
+{
+    int32_t nMinX;
+    int32_t nMaxX;
+    int32_t nMinY;
+    int32_t nMaxY;
+};
+
+// keeps a tap inside the eye so both texels of the bilinear footprint exist, false if it's off the image
+static inline bool ClampTap(int32_t &nPos, int32_t nMin, int32_t nMax)
+{
+    if (nPos < nMin) {
+        if (nPos < nMin - k_nFixedOne) {
+            return false;
+        }
+        nPos = nMin;
+    } else if (nPos >= nMax) {
+        if (nPos > nMax + k_nFixedOne) {
+            return false;
+        }
+        nPos = nMax - 1;
+    }
+    return true;
+}
+
+// bilinear with fractions rounded to 1/128, 0 to 128 so a tap clamped to the last texel takes all of it.
+// Across first, so the products fit 16 bits for the SSE2 path. The weights sum to 1 << 14.
+static inline uint32_t SampleChannelScalar(const uint8_t *pSource, uint32_t unStride, int32_t nX, int32_t nY, uint32_t unByte)
+{
+    const uint8_t *p = pSource + (size_t)(nY >> 16) * unStride + (uint32_t)(nX >> 16) * 4 + unByte;
+    int32_t nFracX = ((nX & 0xFFFF) + 256) >> 9;
+    int32_t nFracY = ((nY & 0xFFFF) + 256) >> 9;
+    int32_t nTop = p[0] * (128 - nFracX) + p[4] * nFracX;
+    int32_t nBottom = p[unStride] * (128 - nFracX) + p[unStride + 4] * nFracX;
+    return (uint32_t)((nTop * (128 - nFracY) + nBottom * nFracY + 8192) >> 14);
+}
+
+// one target pixel from taps that are already inside the eye, pbInside false for off image taps
+template <uint32_t CHANNELS>
+static inline uint32_t SamplePixel(const uint8_t *pSource, uint32_t unStride, const int32_t *pnX, const int32_t *pnY, const bool *pbInside)
+{
+    uint32_t unPixel = 0xFF000000u;
+    if (CHANNELS == 1) {
+        // a single channel table samples all colours at the green position
+        if (pbInside[0]) {
+            for (uint32_t b = 0; b < 3; b++) {
+                unPixel |= SampleChannelScalar(pSource, unStride, pnX[0], pnY[0], b) << (b * 8);
+            }
+        }
+        return unPixel;
+    }
+    for (uint32_t c = 0; c < 3; c++) {
+        if (pbInside[c]) {
+            unPixel |= SampleChannelScalar(pSource, unStride, pnX[c], pnY[c], c) << (c * 8);
+        }
+    }
+    return unPixel;
+}
+
+#if defined(SAMPLE_REMAP_SSE2)
+// the two horizontally neighbouring texels at four places as a left and a right vector. One 64 bit
+// load per pair and two shuffles per vector, which keeps the shuffle port out of the way.
+static inline void LoadQuadPairsSse2(const uint8_t *const rgpTexels[4], size_t unOffset, __m128i *pvLeft, __m128i *pvRight)
+{
+    __m128 v01 = _mm_castsi128_ps(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(rgpTexels[0] + unOffset)), _mm_loadl_epi64((const __m128i *)(rgpTexels[1] + unOffset))));
+    __m128 v23 = _mm_castsi128_ps(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(rgpTexels[2] + unOffset)), _mm_loadl_epi64((const __m128i *)(rgpTexels[3] + unOffset))));
+    *pvLeft = _mm_castps_si128(_mm_shuffle_ps(v01, v23, _MM_SHUFFLE(2, 0, 2, 0)));
+    *pvRight = _mm_castps_si128(_mm_shuffle_ps(v01, v23, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+// four neighbouring target pixels at once, all taps inside the eye. The texels are fetched with
+// a load per pixel and row (SSE2 has no gather), the filtering runs on the four pixels in parallel: first
+// across with 16 bit multiplies, then down with madd. Same integer result as the scalar path.
+template <uint32_t CHANNELS>
+static inline void SampleQuadSse2(const uint8_t *pSource, uint32_t unStride, const int32_t *pnX, const int32_t *pnY,
+    const int32_t *pnStepX, const int32_t *pnStepY, uint32_t *pTarget)
+{
+    const __m128i vByteMask = _mm_set1_epi32(0xFF);
+    const __m128i v128 = _mm_set1_epi32(128);
+    const __m128i vFracMask = _mm_set1_epi32(0xFFFF);
+    __m128i vPixels = _mm_set1_epi32((int)0xFF000000u);
+
+    for (uint32_t c = 0; c < CHANNELS; c++) {
+        const uint8_t *rgpTexels[4];
+        int32_t nX = pnX[c], nY = pnY[c];
+        for (uint32_t i = 0; i < 4; i++) {
+            rgpTexels[i] = pSource + (size_t)(nY >> 16) * unStride + (uint32_t)(nX >> 16) * 4;
+            nX += pnStepX[c];
+            nY += pnStepY[c];
+        }
+        __m128i vTopLeft, vTopRight, vBottomLeft, vBottomRight;
+        LoadQuadPairsSse2(rgpTexels, 0, &vTopLeft, &vTopRight);
+        LoadQuadPairsSse2(rgpTexels, unStride, &vBottomLeft, &vBottomRight);
+
+        __m128i vX = _mm_add_epi32(_mm_set1_epi32(pnX[c]), _mm_set_epi32(pnStepX[c] * 3, pnStepX[c] * 2, pnStepX[c], 0));
+        __m128i vY = _mm_add_epi32(_mm_set1_epi32(pnY[c]), _mm_set_epi32(pnStepY[c] * 3, pnStepY[c] * 2, pnStepY[c], 0));
+        __m128i vFracX = _mm_srli_epi32(_mm_add_epi32(_mm_and_si128(vX, vFracMask), _mm_set1_epi32(256)), 9);
+        __m128i vFracY = _mm_srli_epi32(_mm_add_epi32(_mm_and_si128(vY, vFracMask), _mm_set1_epi32(256)), 9);
+        __m128i vWeightX = _mm_sub_epi32(v128, vFracX);
+        __m128i vWeightsY = _mm_or_si128(_mm_sub_epi32(v128, vFracY), _mm_slli_epi32(vFracY, 16));
+
+        // a single channel table samples all colours at the green position
+        uint32_t unFirstByte = CHANNELS == 1 ? 0 : c;
+        uint32_t unEndByte = CHANNELS == 1 ? 3 : c + 1;
+        for (uint32_t b = unFirstByte; b < unEndByte; b++) {
+            __m128i vShift = _mm_cvtsi32_si128((int)(b * 8));
+            __m128i vTop = _mm_add_epi32(
+                _mm_mullo_epi16(_mm_and_si128(_mm_srl_epi32(vTopLeft, vShift), vByteMask), vWeightX),
+                _mm_mullo_epi16(_mm_and_si128(_mm_srl_epi32(vTopRight, vShift), vByteMask), vFracX));
+            __m128i vBottom = _mm_add_epi32(
+                _mm_mullo_epi16(_mm_and_si128(_mm_srl_epi32(vBottomLeft, vShift), vByteMask), vWeightX),
+                _mm_mullo_epi16(_mm_and_si128(_mm_srl_epi32(vBottomRight, vShift), vByteMask), vFracX));
+            __m128i vSum = _mm_madd_epi16(_mm_or_si128(vTop, _mm_slli_epi32(vBottom, 16)), vWeightsY);
+            __m128i vValue = _mm_srli_epi32(_mm_add_epi32(vSum, _mm_set1_epi32(8192)), 14);
+            vPixels = _mm_or_si128(vPixels, _mm_sll_epi32(vValue, vShift));
+        }
+    }
+    _mm_storeu_si128((__m128i *)pTarget, vPixels);
+}
+#endif
+
+// one span of up to k_unCellSize pixels of a row, with positions stepping linearly from the left end
+template <uint32_t CHANNELS, bool SIMD>
+static void RemapSpan(const uint8_t *pSource, uint32_t unStride, uint32_t *pTarget, uint32_t unCount, const int32_t *pnX, const int32_t *pnY,
+    const int32_t *pnStepX, const int32_t *pnStepY, const EyeBounds_t &bounds)
+{
+    // locals, so the stores to the target can't alias them and force reloads
+    int32_t rgnX[CHANNELS], rgnY[CHANNELS], rgnStepX[CHANNELS], rgnStepY[CHANNELS];
+    bool rgbInside[CHANNELS];
+    bool bInside = true;
+    bool bOutside = true;
+    for (uint32_t c = 0; c < CHANNELS; c++) {
+        rgnX[c] = pnX[c];
+        rgnY[c] = pnY[c];
+        rgnStepX[c] = pnStepX[c];
+        rgnStepY[c] = pnStepY[c];
+        rgbInside[c] = true;
+
+        // the positions are linear across the span, so checking both ends tells whether any tap needs clamping
+        int32_t nLastX = rgnX[c] + rgnStepX[c] * (int32_t)(unCount - 1);
+        int32_t nLastY = rgnY[c] + rgnStepY[c] * (int32_t)(unCount - 1);
+        if (rgnX[c] < bounds.nMinX || rgnX[c] >= bounds.nMaxX || nLastX < bounds.nMinX || nLastX >= bounds.nMaxX ||
+            rgnY[c] < bounds.nMinY || rgnY[c] >= bounds.nMaxY || nLastY < bounds.nMinY || nLastY >= bounds.nMaxY) {
+            bInside = false;
+        }
+        // off the image past the bilinear footprint from end to end, beyond the hidden area usually
+        if (!((rgnX[c] < bounds.nMinX - k_nFixedOne && nLastX < bounds.nMinX - k_nFixedOne) ||
+            (rgnX[c] > bounds.nMaxX + k_nFixedOne && nLastX > bounds.nMaxX + k_nFixedOne) ||
+            (rgnY[c] < bounds.nMinY - k_nFixedOne && nLastY < bounds.nMinY - k_nFixedOne) ||
+            (rgnY[c] > bounds.nMaxY + k_nFixedOne && nLastY > bounds.nMaxY + k_nFixedOne))) {
+            bOutside = false;
+        }
+    }
+
+    if (bOutside) {
+        for (uint32_t i = 0; i < unCount; i++) {
+            pTarget[i] = 0xFF000000u;
+        }
+        return;
+    }
+
+    if (bInside) {
+        uint32_t i = 0;
+#if defined(SAMPLE_REMAP_SSE2)
+        if (SIMD) {
+            for (; i + 4 <= unCount; i += 4) {
+                SampleQuadSse2<CHANNELS>(pSource, unStride, rgnX, rgnY, rgnStepX, rgnStepY, pTarget + i);
+                for (uint32_t c = 0; c < CHANNELS; c++) {
+                    rgnX[c] += rgnStepX[c] * 4;
+                    rgnY[c] += rgnStepY[c] * 4;
+                }
+            }
+        }
+#endif
+        for (; i < unCount; i++) {
+            pTarget[i] = SamplePixel<CHANNELS>(pSource, unStride, rgnX, rgnY, rgbInside);
+            for (uint32_t c = 0; c < CHANNELS; c++) {
+                rgnX[c] += rgnStepX[c];
+                rgnY[c] += rgnStepY[c];
+            }
+        }
+        return;
+    }
+
+    // near the edge of the eye, clamp every tap
+    for (uint32_t i = 0; i < unCount; i++) {
+        int32_t rgnTapX[CHANNELS], rgnTapY[CHANNELS];
+        for (uint32_t c = 0; c < CHANNELS; c++) {
+            rgnTapX[c] = rgnX[c];
+            rgnTapY[c] = rgnY[c];
+            rgbInside[c] = ClampTap(rgnTapX[c], bounds.nMinX, bounds.nMaxX) && ClampTap(rgnTapY[c], bounds.nMinY, bounds.nMaxY);
+            rgnX[c] += rgnStepX[c];
+            rgnY[c] += rgnStepY[c];
+        }
+        pTarget[i] = SamplePixel<CHANNELS>(pSource, unStride, rgnTapX, rgnTapY, rgbInside);
+    }
+}
+
+CSampleDistortionRemap::CSampleDistortionRemap()
+{
+    m_unSourceWidth = 0;
+    m_unSourceHeight = 0;
+    m_unTargetWidth = 0;
+    m_unTargetHeight = 0;
+    m_unCellColumns = 0;
+    m_unCellRows = 0;
+    m_bChromatic = false;
+    m_bHasProjection = false;
+    memset(m_rgflProjection, 0, sizeof(m_rgflProjection));
+}
+
+bool CSampleDistortionRemap::Matches(uint32_t unSourceWidth, uint32_t unSourceHeight, uint32_t unTargetWidth, uint32_t unTargetHeight) const
+{
+    return IsBuilt() && m_unSourceWidth == unSourceWidth && m_unSourceHeight == unSourceHeight && m_unTargetWidth == unTargetWidth && m_unTargetHeight == unTargetHeight;
+}
+
+void CSampleDistortionRemap::SetProjection(const float rgflProjection[2][4])
+{
+    memcpy(m_rgflProjection, rgflProjection, sizeof(m_rgflProjection));
+    m_bHasProjection = true;
+
+    // the directions come with the next Build()
+    m_vecNodes.clear();
+    m_vecTangents.clear();
+}
+
+inline void CSampleDistortionRemap::SetNodeChannel(Node_t &node, uint32_t unChannel, uint32_t unEye, float fU, float fV) const
+{
+    // texel centres sit on integers, positions far outside only need to stay black
+    // and keep the difference of two nodes within 32 bits
+    // (plain compares and casts, the libm versions are calls once they have to honour errno)
+    float flSourceEyeWidth = (float)(m_unSourceWidth / 2);
+    float flX = fU * flSourceEyeWidth - 0.5f + unEye * flSourceEyeWidth;
+    float flY = fV * m_unSourceHeight - 0.5f;
+    flX = flX < -8192.0f ? -8192.0f : (flX > 16383.0f ? 16383.0f : flX);
+    flY = flY < -8192.0f ? -8192.0f : (flY > 16383.0f ? 16383.0f : flY);
+    node.rgnX[unChannel] = (int32_t)(flX * k_nFixedOne + (flX < 0.0f ? -0.5f : 0.5f));
+    node.rgnY[unChannel] = (int32_t)(flY * k_nFixedOne + (flY < 0.0f ? -0.5f : 0.5f));
+}
+
+void CSampleDistortionRemap::Build(const CSampleLensModel &lensModel, uint32_t unSourceWidth, uint32_t unSourceHeight, uint32_t unTargetWidth, uint32_t unTargetHeight)
+{
+    m_unSourceWidth = unSourceWidth;
+    m_unSourceHeight = unSourceHeight;
+    m_unTargetWidth = unTargetWidth;
+    m_unTargetHeight = unTargetHeight;
+
+    // nodes go one past the last pixel so every cell has four corners, even a partial one at the edge
+    uint32_t unEyeWidth = unTargetWidth / 2;
+    m_unCellColumns = (unEyeWidth + k_unCellSize - 1) / k_unCellSize;
+    m_unCellRows = (unTargetHeight + k_unCellSize - 1) / k_unCellSize;
+    m_vecNodes.resize(2 * (m_unCellColumns + 1) * (m_unCellRows + 1));
+    m_vecTangents.resize(m_bHasProjection ? m_vecNodes.size() : 0);
+
+    m_bChromatic = false;
+    for (uint32_t unEye = 0; unEye < 2; unEye++) {
+        const float *pflProjection = m_rgflProjection[unEye];
+        for (uint32_t unRow = 0; unRow <= m_unCellRows; unRow++) {
+            for (uint32_t unColumn = 0; unColumn <= m_unCellColumns; unColumn++) {
+                float fU = (unColumn * k_unCellSize + 0.5f) / unEyeWidth;
+                float fV = (unRow * k_unCellSize + 0.5f) / unTargetHeight;
+                DistortionCoordinates_t coordinates = lensModel.Evaluate((EVREye)unEye, fU, fV);
+                const float *rgpfChannels[3] = { coordinates.rfRed, coordinates.rfGreen, coordinates.rfBlue };
+
+                uint32_t unNode = (unEye * (m_unCellRows + 1) + unRow) * (m_unCellColumns + 1) + unColumn;
+                Node_t &node = m_vecNodes[unNode];
+                for (uint32_t c = 0; c < 3; c++) {
+                    SetNodeChannel(node, c, unEye, rgpfChannels[c][0], rgpfChannels[c][1]);
+
+                    // where the channel looks in the rendered eye, for Reproject()
+                    if (m_bHasProjection) {
+                        m_vecTangents[unNode].rgflX[c] = pflProjection[0] + rgpfChannels[c][0] * (pflProjection[1] - pflProjection[0]);
+                        m_vecTangents[unNode].rgflY[c] = pflProjection[2] + rgpfChannels[c][1] * (pflProjection[3] - pflProjection[2]);
+                    }
+                }
+
+                // under 1/1024 of a texel apart is the same spot as far as 1/128 weights go
+                for (uint32_t c = 0; c < 3; c += 2) {
+                    if (abs(node.rgnX[c] - node.rgnX[1]) > 64 || abs(node.rgnY[c] - node.rgnY[1]) > 64) {
+                        m_bChromatic = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+struct ReprojectContext_t
+{
+    CSampleDistortionRemap *pRemap;
+    float rgflRotation[3][3];
+};
+
+void CSampleDistortionRemap::ReprojectChunk(void *pContext, uint32_t unChunk)
+{
+    ReprojectContext_t *pReprojectContext = (ReprojectContext_t *)pContext;
+    pReprojectContext->pRemap->ReprojectNodeRow(pReprojectContext->rgflRotation, unChunk);
+}
+
+void CSampleDistortionRemap::Reproject(const HmdQuaternion_t &qDelta, CSampleWorkerPool *pPool)
+{
+    if (m_vecTangents.empty()) {
+        return;
+    }
+
+    ReprojectContext_t context;
+    context.pRemap = this;
+    double w = qDelta.w, x = qDelta.x, y = qDelta.y, z = qDelta.z;
+    context.rgflRotation[0][0] = (float)(1 - 2 * (y * y + z * z));
+    context.rgflRotation[0][1] = (float)(2 * (x * y - w * z));
+    context.rgflRotation[0][2] = (float)(2 * (x * z + w * y));
+    context.rgflRotation[1][0] = (float)(2 * (x * y + w * z));
+    context.rgflRotation[1][1] = (float)(1 - 2 * (x * x + z * z));
+    context.rgflRotation[1][2] = (float)(2 * (y * z - w * x));
+    context.rgflRotation[2][0] = (float)(2 * (x * z - w * y));
+    context.rgflRotation[2][1] = (float)(2 * (y * z + w * x));
+    context.rgflRotation[2][2] = (float)(1 - 2 * (x * x + y * y));
+
+    // one chunk per node row of both eyes
+    uint32_t unChunks = 2 * (m_unCellRows + 1);
+    if (pPool) {
+        pPool->ParallelFor(unChunks, ReprojectChunk, &context);
+    } else {
+        for (uint32_t i = 0; i < unChunks; i++) {
+            ReprojectChunk(&context, i);
+        }
+    }
+}
+
+void CSampleDistortionRemap::ReprojectNodeRow(const float rgflRotation[3][3], uint32_t unNodeRow)
+{
+    uint32_t unEye = unNodeRow / (m_unCellRows + 1);
+    const float *pflProjection = m_rgflProjection[unEye];
+    float flInvWidth = 1.0f / (pflProjection[1] - pflProjection[0]);
+    float flInvHeight = 1.0f / (pflProjection[3] - pflProjection[2]);
+
+    uint32_t unFirst = unNodeRow * (m_unCellColumns + 1);
+    for (uint32_t unNode = unFirst; unNode < unFirst + m_unCellColumns + 1; unNode++) {
+        const Tangents_t &tangents = m_vecTangents[unNode];
+        Node_t &node = m_vecNodes[unNode];
+        for (uint32_t c = 0; c < 3; c++) {
+            // view direction with +y up and -z forward, turned from the display's head into the rendered one
+            float flX = tangents.rgflX[c], flY = -tangents.rgflY[c];
+            float flRotatedX = rgflRotation[0][0] * flX + rgflRotation[0][1] * flY - rgflRotation[0][2];
+            float flRotatedY = rgflRotation[1][0] * flX + rgflRotation[1][1] * flY - rgflRotation[1][2];
+            float flRotatedZ = rgflRotation[2][0] * flX + rgflRotation[2][1] * flY - rgflRotation[2][2];
+
+            // behind the rendered eye there's nothing to show
+            if (flRotatedZ > -1e-3f) {
+                node.rgnX[c] = -8192 * k_nFixedOne;
+                node.rgnY[c] = -8192 * k_nFixedOne;
+                continue;
+            }
+            float flInvDepth = -1.0f / flRotatedZ;
+            float flTangentX = flRotatedX * flInvDepth;
+            float flTangentY = -flRotatedY * flInvDepth;
+            SetNodeChannel(node, c, unEye, (flTangentX - pflProjection[0]) * flInvWidth, (flTangentY - pflProjection[2]) * flInvHeight);
+        }
+    }
+}
+
+struct RemapContext_t
+{
+    const CSampleDistortionRemap *pRemap;
+    const uint8_t *pSource;
+    uint32_t unSourceStride;
+    uint8_t *pTarget;
+    uint32_t unTargetStride;
+};
+
+static void RemapBandChunk(void *pContext, uint32_t unChunk)
+{
+    RemapContext_t *pRemapContext = (RemapContext_t *)pContext;
+#if defined(SAMPLE_REMAP_SSE2)
+    const bool bSimd = true;
+#else
+    const bool bSimd = false;
+#endif
+    pRemapContext->pRemap->RemapBand(pRemapContext->pSource, pRemapContext->unSourceStride, pRemapContext->pTarget, pRemapContext->unTargetStride, unChunk, bSimd);
+}
+
+void CSampleDistortionRemap::Remap(const uint8_t *pSource, uint32_t unSourceStride, uint8_t *pTarget, uint32_t unTargetStride, CSampleWorkerPool *pPool) const
+{
+    RemapContext_t context = { this, pSource, unSourceStride, pTarget, unTargetStride };
+    if (pPool) {
+        pPool->ParallelFor(m_unCellRows, RemapBandChunk, &context);
+    } else {
+        for (uint32_t i = 0; i < m_unCellRows; i++) {
+            RemapBandChunk(&context, i);
+        }
+    }
+}
+
+void CSampleDistortionRemap::RemapBand(const uint8_t *pSource, uint32_t unSourceStride, uint8_t *pTarget, uint32_t unTargetStride, uint32_t unCellRow, bool bSimd) const
+{
+#if defined(SAMPLE_REMAP_SSE2)
+    if (bSimd) {
+        if (m_bChromatic) {
+            RemapBandChannels<3, true>(pSource, unSourceStride, pTarget, unTargetStride, unCellRow);
+        } else {
+            RemapBandChannels<1, true>(pSource, unSourceStride, pTarget, unTargetStride, unCellRow);
+        }
+        return;
+    }
+#endif
+    if (m_bChromatic) {
+        RemapBandChannels<3, false>(pSource, unSourceStride, pTarget, unTargetStride, unCellRow);
+    } else {
+        RemapBandChannels<1, false>(pSource, unSourceStride, pTarget, unTargetStride, unCellRow);
+    }
+}
+
+template <uint32_t CHANNELS, bool SIMD>
+void CSampleDistortionRemap::RemapBandChannels(const uint8_t *pSource, uint32_t unSourceStride, uint8_t *pTarget, uint32_t unTargetStride, uint32_t unCellRow) const
+{
+    uint32_t unEyeWidth = m_unTargetWidth / 2;
+    uint32_t unSourceEyeWidth = m_unSourceWidth / 2;
+    uint32_t unFirstChannel = CHANNELS == 3 ? 0 : 1;
+
+    uint32_t unFirstRow = unCellRow * k_unCellSize;
+    uint32_t unEndRow = unFirstRow + k_unCellSize < m_unTargetHeight ? unFirstRow + k_unCellSize : m_unTargetHeight;
+
+    for (uint32_t unEye = 0; unEye < 2; unEye++) {
+        EyeBounds_t bounds;
+        bounds.nMinX = (int32_t)(unEye * unSourceEyeWidth) << 16;
+        bounds.nMaxX = (int32_t)((unEye + 1) * unSourceEyeWidth - 1) << 16;
+        bounds.nMinY = 0;
+        bounds.nMaxY = (int32_t)(m_unSourceHeight - 1) << 16;
+
+        for (uint32_t y = unFirstRow; y < unEndRow; y++) {
+            int32_t nT = (int32_t)(y - unFirstRow);
+            uint32_t *pRow = (uint32_t *)(pTarget + (size_t)y * unTargetStride) + unEye * unEyeWidth;
+
+            for (uint32_t unColumn = 0; unColumn < m_unCellColumns; unColumn++) {
+                const Node_t &topLeft = GetNode(unEye, unColumn, unCellRow);
+                const Node_t &topRight = GetNode(unEye, unColumn + 1, unCellRow);
+                const Node_t &bottomLeft = GetNode(unEye, unColumn, unCellRow + 1);
+                const Node_t &bottomRight = GetNode(unEye, unColumn + 1, unCellRow + 1);
+
+                // ends of this row inside the cell, then equal steps across it
+                int32_t rgnX[CHANNELS], rgnY[CHANNELS], rgnStepX[CHANNELS], rgnStepY[CHANNELS];
+                for (uint32_t c = 0; c < CHANNELS; c++) {
+                    uint32_t n = unFirstChannel + c;
+                    int32_t nLeftX = topLeft.rgnX[n] + (bottomLeft.rgnX[n] - topLeft.rgnX[n]) / (int32_t)k_unCellSize * nT;
+                    int32_t nLeftY = topLeft.rgnY[n] + (bottomLeft.rgnY[n] - topLeft.rgnY[n]) / (int32_t)k_unCellSize * nT;
+                    int32_t nRightX = topRight.rgnX[n] + (bottomRight.rgnX[n] - topRight.rgnX[n]) / (int32_t)k_unCellSize * nT;
+                    int32_t nRightY = topRight.rgnY[n] + (bottomRight.rgnY[n] - topRight.rgnY[n]) / (int32_t)k_unCellSize * nT;
+                    rgnX[c] = nLeftX;
+                    rgnY[c] = nLeftY;
+                    rgnStepX[c] = (nRightX - nLeftX) / (int32_t)k_unCellSize;
+                    rgnStepY[c] = (nRightY - nLeftY) / (int32_t)k_unCellSize;
+                }
+
+                uint32_t unFirstX = unColumn * k_unCellSize;
+                uint32_t unCount = unFirstX + k_unCellSize < unEyeWidth ? k_unCellSize : unEyeWidth - unFirstX;
+                RemapSpan<CHANNELS, SIMD>(pSource, unSourceStride, pRow + unFirstX, unCount, rgnX, rgnY, rgnStepX, rgnStepY, bounds);
+            }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef CSAMPLEDISTORTIONREMAP_H
+#define CSAMPLEDISTORTIONREMAP_H
+
+#include <openvr_driver.h>
+
+#include <stdint.h>
+#include <vector>
+
+class CSampleLensModel;
+class CSampleWorkerPool;
+
+//-----------------------------------------------------------------------------
+// Purpose: Applies the lens distortion and chromatic aberration to a side by
+// side RGBA frame on the CPU, for displays that can't pre-warp themselves.
+// The lens is evaluated once per node of a grid every k_unCellSize target
+// pixels and stored as 16.16 fixed point source positions per colour
+// channel. Remap() walks each cell with integer steps and samples the
+// source bilinearly, four pixels at a time with SSE2 where available, in
+// bands of one cell row spread over the worker pool. Spans that land off
+// the source entirely are filled black without sampling.
+// With the render projection set, Build() also keeps the view direction
+// of every node and Reproject() turns the nodes by the head rotation since
+// the frame was rendered, so the late rotation costs one pass over the
+// nodes and nothing per pixel.
+//-----------------------------------------------------------------------------
+class CSampleDistortionRemap
+{
+public:
+    static const uint32_t k_unCellSize = 8;
+
+    CSampleDistortionRemap();
+
+    /** tangents of the rendered eyes in GetProjectionRaw order (left, right, top, bottom), set before Build() to allow Reproject() */
+    void SetProjection(const float rgflProjection[2][4]);
+
+    /** evaluates the lens for a source and target of the given sizes, both holding the two eyes side by side */
+    void Build(const CSampleLensModel &lensModel, uint32_t unSourceWidth, uint32_t unSourceHeight, uint32_t unTargetWidth, uint32_t unTargetHeight);
+
+    bool IsBuilt() const { return !m_vecNodes.empty(); }
+
+    bool Matches(uint32_t unSourceWidth, uint32_t unSourceHeight, uint32_t unTargetWidth, uint32_t unTargetHeight) const;
+
+    /** strides are in bytes, pPool may be null to run on the calling thread only */
+    void Remap(const uint8_t *pSource, uint32_t unSourceStride, uint8_t *pTarget, uint32_t unTargetStride, CSampleWorkerPool *pPool) const;
+
+    /** one band of cell rows, what Remap() hands to each chunk of the pool */
+    void RemapBand(const uint8_t *pSource, uint32_t unSourceStride, uint8_t *pTarget, uint32_t unTargetStride, uint32_t unCellRow, bool bSimd) const;
+
+    uint32_t GetBandCount() const { return m_unCellRows; }
+
+    bool CanReproject() const { return !m_vecTangents.empty(); }
+
+    /** rebuilds the nodes for a display head turned by qDelta against the rendered one (conj(render) * latest) */
+    void Reproject(const vr::HmdQuaternion_t &qDelta, CSampleWorkerPool *pPool);
+
+private:
+    // source position of one grid node per colour channel, 16.16 fixed point in source pixels
+    struct Node_t
+    {
+        int32_t rgnX[3];
+        int32_t rgnY[3];
+    };
+
+    // view tangents of one node per colour channel in the rendered eye, +y down like the projection
+    struct Tangents_t
+    {
+        float rgflX[3];
+        float rgflY[3];
+    };
+
+    static void ReprojectChunk(void *pContext, uint32_t unChunk);
+
+    void ReprojectNodeRow(const float rgflRotation[3][3], uint32_t unNodeRow);
+
+    /** converts a position in the rendered eye (0..1) into the fixed point source position of one channel */
+    void SetNodeChannel(Node_t &node, uint32_t unChannel, uint32_t unEye, float fU, float fV) const;
+
+    template <uint32_t CHANNELS, bool SIMD>
+    void RemapBandChannels(const uint8_t *pSource, uint32_t unSourceStride, uint8_t *pTarget, uint32_t unTargetStride, uint32_t unCellRow) const;
+
+    const Node_t &GetNode(uint32_t unEye, uint32_t unColumn, uint32_t unRow) const
+    {
+        return m_vecNodes[(unEye * (m_unCellRows + 1) + unRow) * (m_unCellColumns + 1) + unColumn];
+    }
+
+    uint32_t m_unSourceWidth;
+    uint32_t m_unSourceHeight;
+    uint32_t m_unTargetWidth;
+    uint32_t m_unTargetHeight;
+    uint32_t m_unCellColumns; // per eye
+    uint32_t m_unCellRows;
+    bool m_bChromatic;        // false when all channels sample the same spot, then only green is fetched
+
+    std::vector<Node_t> m_vecNodes;
+
+    bool m_bHasProjection;
+    float m_rgflProjection[2][4];
+    std::vector<Tangents_t> m_vecTangents;
+};
+
+#endif // CSAMPLEDISTORTIONREMAP_H
@@ -0,0 +1,214 @@
+#include "csampleeventdispatcher.h"
+#include "csampledeviceregistry.h"
+
+#include "basics.h"
+
+#include <stdio.h>
+
+#if defined(_WINDOWS)
+#include <intrin.h>
+#endif
+
+using namespace vr;
+
+static std::atomic<CSampleEventDispatcher *> s_pEventDispatcher(nullptr);
+
+void SetSampleEventDispatcher(CSampleEventDispatcher *pDispatcher)
+{
+    s_pEventDispatcher.store(pDispatcher, std::memory_order_release);
+}
+
+CSampleEventDispatcher *GetSampleEventDispatcher()
+{
+    return s_pEventDispatcher.load(std::memory_order_acquire);
+}
+
+static uint32_t LowestSetBit(uint64_t ulMask)
+{
+#if defined(_WINDOWS)
+    unsigned long unIndex;
+    _BitScanForward64(&unIndex, ulMask);
+    return unIndex;
+#else
+    return (uint32_t)__builtin_ctzll(ulMask);
+#endif
+}
+
+static void AddTiming(std::atomic<uint64_t> &ulCount, std::atomic<uint64_t> &ulTotalNs, std::atomic<uint64_t> &ulMaxNs, uint64_t ulNs)
+{
+    // only the RunFrame thread writes, readers just need untorn values
+    ulCount.store(ulCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    ulTotalNs.store(ulTotalNs.load(std::memory_order_relaxed) + ulNs, std::memory_order_relaxed);
+    if (ulNs > ulMaxNs.load(std::memory_order_relaxed)) {
+        ulMaxNs.store(ulNs, std::memory_order_relaxed);
+    }
+}
+
+CSampleEventDispatcher::CSampleEventDispatcher()
+{
+    Clear();
+}
+
+void CSampleEventDispatcher::Clear()
+{
+    for (uint32_t i = 0; i < vr::k_unMaxTrackedDeviceCount; i++) {
+        m_rgpDevices[i] = nullptr;
+    }
+    m_unSyncedDevices = 0;
+
+    for (uint32_t i = 0; i < k_unTypeSlots; i++) {
+        m_rgTypeSlots[i].unEventType = 0;
+        m_rgTypeSlots[i].ulSubscribers = 0;
+    }
+    m_overflowSlot.unEventType = 0;
+    m_overflowSlot.ulSubscribers = 0;
+    ResetEventStats();
+}
+
+void CSampleEventDispatcher::SyncDevices(const CSampleDeviceRegistry &registry)
+{
+    // every added device known already, which is the common case after startup. Configured devices that never
+    // sent data aren't added and don't count, an added one is only synced once SteamVR activated it
+    if (m_unSyncedDevices == registry.GetAddedDeviceCount()) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < registry.GetDeviceCount(); i++) {
+        CSampleTrackedDevice *pDevice = registry.GetDevice(i);
+        vr::TrackedDeviceIndex_t unObjectId = pDevice->GetObjectId();
+        if (unObjectId >= vr::k_unMaxTrackedDeviceCount || m_rgpDevices[unObjectId] == pDevice) {
+            continue;
+        }
+
+        m_rgpDevices[unObjectId] = pDevice;
+        m_unSyncedDevices++;
+
+        const uint32_t *punEventTypes = nullptr;
+        uint32_t unEventTypeCount = pDevice->GetEventSubscriptions(&punEventTypes);
+        for (uint32_t j = 0; j < unEventTypeCount; j++) {
+            Subscribe(unObjectId, punEventTypes[j]);
+        }
+    }
+}
+
+void CSampleEventDispatcher::PumpEvents()
+{
+    vr::VREvent_t vrEvent;
+    while (vr::VRServerDriverHost()->PollNextEvent(&vrEvent, sizeof(vrEvent))) {
+        Dispatch(vrEvent);
+    }
+}
+
+void CSampleEventDispatcher::Dispatch(const vr::VREvent_t &vrEvent)
+{
+    uint64_t ulStart = GetTimestampNs();
+
+    TypeSlot_t *pSlot = FindSlot(vrEvent.eventType, true);
+    if (!pSlot) {
+        pSlot = &m_overflowSlot;
+    }
+
+    // an event about one device only goes to that device, the rest to every subscriber
+    uint64_t ulTargets = pSlot->ulSubscribers;
+    if (vrEvent.trackedDeviceIndex < vr::k_unMaxTrackedDeviceCount) {
+        ulTargets &= 1ULL << vrEvent.trackedDeviceIndex;
+    }
+    while (ulTargets) {
+        m_rgpDevices[LowestSetBit(ulTargets)]->ProcessEvent(vrEvent);
+        ulTargets &= ulTargets - 1;
+    }
+
+    AddTiming(pSlot->ulCount, pSlot->ulTotalNs, pSlot->ulMaxNs, GetTimestampNs() - ulStart);
+}
+
+uint32_t CSampleEventDispatcher::GetEventStats(SampleEventStats_t *pStats, uint32_t unMaxStats) const
+{
+    uint32_t unCount = 0;
+    for (uint32_t i = 0; i <= k_unTypeSlots && unCount < unMaxStats; i++) {
+        const TypeSlot_t &slot = i < k_unTypeSlots ? m_rgTypeSlots[i] : m_overflowSlot;
+        uint64_t ulEvents = slot.ulCount.load(std::memory_order_relaxed);
+        if (ulEvents == 0) {
+            continue;
+        }
+        pStats[unCount].unEventType = slot.unEventType.load(std::memory_order_acquire);
+        pStats[unCount].ulCount = ulEvents;
+        pStats[unCount].ulTotalNs = slot.ulTotalNs.load(std::memory_order_relaxed);
+        pStats[unCount].ulMaxNs = slot.ulMaxNs.load(std::memory_order_relaxed);
+        unCount++;
+    }
+    return unCount;
+}
+
+bool CSampleEventDispatcher::FormatEventStatsJson(char *pchBuffer, uint32_t unBufferSize) const
+{
+    if (unBufferSize == 0) {
+        return false;
+    }
+
+    // event types by number, an overflowed type shows up as 0
+    SampleEventStats_t rgStats[k_unMaxEventStats];
+    uint32_t unStats = GetEventStats(rgStats, k_unMaxEventStats);
+    uint32_t cbUsed = 0;
+    int nWritten = snprintf(pchBuffer, unBufferSize, "{\"types\":{");
+    for (uint32_t i = 0; i < unStats && nWritten >= 0 && cbUsed + (uint32_t)nWritten < unBufferSize; i++) {
+        cbUsed += (uint32_t)nWritten;
+        const SampleEventStats_t &stats = rgStats[i];
+        nWritten = snprintf(pchBuffer + cbUsed, unBufferSize - cbUsed, "%s\"%u\":{\"count\":%llu,\"mean_us\":%.1f,\"max_us\":%.1f}",
+            i ? "," : "", stats.unEventType, (unsigned long long)stats.ulCount, stats.ulTotalNs * 1e-3 / stats.ulCount, stats.ulMaxNs * 1e-3);
+    }
+    if (nWritten < 0 || cbUsed + (uint32_t)nWritten >= unBufferSize) {
+        pchBuffer[0] = 0;
+        return false;
+    }
+    cbUsed += (uint32_t)nWritten;
+    nWritten = snprintf(pchBuffer + cbUsed, unBufferSize - cbUsed, "}}");
+    if (nWritten < 0 || cbUsed + (uint32_t)nWritten >= unBufferSize) {
+        pchBuffer[0] = 0;
+        return false;
+    }
+    return true;
+}
+
+void CSampleEventDispatcher::ResetEventStats()
+{
+    for (uint32_t i = 0; i <= k_unTypeSlots; i++) {
+        TypeSlot_t &slot = i < k_unTypeSlots ? m_rgTypeSlots[i] : m_overflowSlot;
+        slot.ulCount.store(0, std::memory_order_relaxed);
+        slot.ulTotalNs.store(0, std::memory_order_relaxed);
+        slot.ulMaxNs.store(0, std::memory_order_relaxed);
+    }
+}
+
+CSampleEventDispatcher::TypeSlot_t *CSampleEventDispatcher::FindSlot(uint32_t unEventType, bool bInsert)
+{
+    // VREvent_None is never delivered, which lets 0 mark free slots
+    if (unEventType == 0) {
+        return nullptr;
+    }
+
+    uint32_t unHash = (unEventType * 2654435761u) >> 24;
+    for (uint32_t i = 0; i < k_unTypeSlots; i++) {
+        TypeSlot_t &slot = m_rgTypeSlots[(unHash + i) % k_unTypeSlots];
+        uint32_t unSlotType = slot.unEventType.load(std::memory_order_relaxed);
+        if (unSlotType == unEventType) {
+            return &slot;
+        }
+        if (unSlotType == 0) {
+            if (!bInsert) {
+                return nullptr;
+            }
+            slot.ulSubscribers = 0;
+            slot.unEventType.store(unEventType, std::memory_order_release);
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+void CSampleEventDispatcher::Subscribe(vr::TrackedDeviceIndex_t unObjectId, uint32_t unEventType)
+{
+    TypeSlot_t *pSlot = FindSlot(unEventType, true);
+    if (pSlot) {
+        pSlot->ulSubscribers |= 1ULL << unObjectId;
+    }
+}
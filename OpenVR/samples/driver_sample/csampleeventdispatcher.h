@@ -0,0 +1,82 @@
+#ifndef CSAMPLEEVENTDISPATCHER_H
+#define CSAMPLEEVENTDISPATCHER_H
+
+#include <openvr_driver.h>
+
+#include <atomic>
+#include <stdint.h>
+
+class CSampleDeviceRegistry;
+class CSampleTrackedDevice;
+
+// counters of one event type, as handed out by GetEventStats()
+struct SampleEventStats_t
+{
+    uint32_t unEventType;
+    uint64_t ulCount;
+    uint64_t ulTotalNs;
+    uint64_t ulMaxNs;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Drains the server event queue and routes every event straight to
+// the devices that subscribed to its type. Lookup is by event type in a small
+// hash table whose entries hold a bit per tracked device index, so an event
+// costs the same no matter how many devices exist. Counts and handling times
+// are kept per event type.
+//-----------------------------------------------------------------------------
+class CSampleEventDispatcher
+{
+public:
+    CSampleEventDispatcher();
+
+    void Clear();
+
+    /** picks up devices that were activated since the last call, free once every added device is known */
+    void SyncDevices(const CSampleDeviceRegistry &registry);
+
+    /** polls and dispatches every pending event */
+    void PumpEvents();
+
+    void Dispatch(const vr::VREvent_t &vrEvent);
+
+    /** copies the counters of up to unMaxStats event types, returns how many were copied */
+    uint32_t GetEventStats(SampleEventStats_t *pStats, uint32_t unMaxStats) const;
+
+    /** the counters of every event type seen as a JSON object, returns false if it didn't fit */
+    bool FormatEventStatsJson(char *pchBuffer, uint32_t unBufferSize) const;
+
+    /** may race with an event being counted, which then keeps its count */
+    void ResetEventStats();
+
+    /** upper bound for GetEventStats(), every slot plus the overflow one */
+    static const uint32_t k_unMaxEventStats = 257;
+
+private:
+    static const uint32_t k_unTypeSlots = k_unMaxEventStats - 1;
+
+    struct TypeSlot_t
+    {
+        std::atomic<uint32_t> unEventType; // 0 marks a free slot
+        uint64_t ulSubscribers;            // bit n: device with tracked device index n
+        std::atomic<uint64_t> ulCount;
+        std::atomic<uint64_t> ulTotalNs;
+        std::atomic<uint64_t> ulMaxNs;
+    };
+
+    TypeSlot_t *FindSlot(uint32_t unEventType, bool bInsert);
+
+    void Subscribe(vr::TrackedDeviceIndex_t unObjectId, uint32_t unEventType);
+
+    CSampleTrackedDevice *m_rgpDevices[vr::k_unMaxTrackedDeviceCount];
+    uint32_t m_unSyncedDevices;
+
+    TypeSlot_t m_rgTypeSlots[k_unTypeSlots];
+    TypeSlot_t m_overflowSlot;
+};
+
+/** the dispatcher the events debug request reports on, the server sets it for as long as it runs */
+void SetSampleEventDispatcher(CSampleEventDispatcher *pDispatcher);
+CSampleEventDispatcher *GetSampleEventDispatcher();
+
+#endif // CSAMPLEEVENTDISPATCHER_H
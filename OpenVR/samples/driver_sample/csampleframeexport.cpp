@@ -0,0 +1,214 @@
+#if defined(_WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "csampleframeexport.h"
+
+#include <new>
+#include <string.h>
+
+static const size_t k_cbPageAlign = 4096;
+
+static size_t AlignUp(size_t cbSize)
+{
+    return (cbSize + k_cbPageAlign - 1) & ~(k_cbPageAlign - 1);
+}
+
+static std::string GetMappingName(const char *pchName)
+{
+#if defined(_WINDOWS)
+    return std::string("Local\\") + pchName;
+#else
+    return std::string("/") + pchName;
+#endif
+}
+
+CSampleFrameExport::CSampleFrameExport()
+{
+    m_pHeader = nullptr;
+    m_cbMapping = 0;
+    m_bOwner = false;
+    m_hMapping = nullptr;
+    m_unWriteSlot = 0;
+    m_unReadSlot = 0;
+}
+
+CSampleFrameExport::~CSampleFrameExport()
+{
+    Close();
+}
+
+bool CSampleFrameExport::Create(const char *pchName, uint32_t unWidth, uint32_t unHeight, bool bPixels)
+{
+    Close();
+
+    uint32_t unStride = unWidth * 4;
+    size_t cbHeader = AlignUp(sizeof(SampleFrameExportHeader_t));
+    size_t cbSlot = bPixels ? AlignUp((size_t)unStride * unHeight) : 0;
+    if (!Map(pchName, cbHeader + cbSlot * k_unSampleFrameExportSlots, true)) {
+        return false;
+    }
+    m_bOwner = true;
+
+    // the atomics need constructing, a fresh mapping is only zeroed bytes
+    new (m_pHeader) SampleFrameExportHeader_t();
+    m_pHeader->unVersion = k_unSampleFrameExportVersion;
+    m_pHeader->unWidth = unWidth;
+    m_pHeader->unHeight = unHeight;
+    m_pHeader->unStride = unStride;
+    m_pHeader->ulPixelOffset = cbHeader;
+    m_pHeader->ulSlotBytes = cbSlot;
+
+    // the producer starts on slot 0, slot 1 is in the middle and the consumer holds slot 2
+    m_unWriteSlot = 0;
+    m_unReadSlot = 2;
+    m_pHeader->unMiddleSlot.store(1, std::memory_order_relaxed);
+    m_pHeader->unConsumerSlot.store(2, std::memory_order_relaxed);
+    m_pHeader->ulPublishedFrames.store(0, std::memory_order_relaxed);
+    m_pHeader->ulConsumedFrames.store(0, std::memory_order_relaxed);
+
+    // consumers check the magic, so it goes in last
+    std::atomic_thread_fence(std::memory_order_release);
+    m_pHeader->unMagic = k_unSampleFrameExportMagic;
+    return true;
+}
+
+bool CSampleFrameExport::Open(const char *pchName)
+{
+    Close();
+
+    if (!Map(pchName, 0, false)) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_cbMapping < sizeof(SampleFrameExportHeader_t) || m_pHeader->unMagic != k_unSampleFrameExportMagic || m_pHeader->unVersion != k_unSampleFrameExportVersion
+        || m_pHeader->ulPixelOffset + m_pHeader->ulSlotBytes * k_unSampleFrameExportSlots > m_cbMapping) {
+        Close();
+        return false;
+    }
+
+    // carry on with the slot an earlier consumer left behind
+    m_unReadSlot = m_pHeader->unConsumerSlot.load(std::memory_order_relaxed);
+    return true;
+}
+
+void CSampleFrameExport::Close()
+{
+    if (!m_pHeader) {
+        return;
+    }
+
+#if defined(_WINDOWS)
+    UnmapViewOfFile(m_pHeader);
+    CloseHandle((HANDLE)m_hMapping);
+    m_hMapping = nullptr;
+#else
+    munmap(m_pHeader, m_cbMapping);
+    if (m_bOwner) {
+        shm_unlink(m_sName.c_str());
+    }
+#endif
+    m_pHeader = nullptr;
+    m_cbMapping = 0;
+    m_bOwner = false;
+}
+
+void CSampleFrameExport::Publish()
+{
+    uint32_t unPrevious = m_pHeader->unMiddleSlot.exchange(m_unWriteSlot | k_unFreshBit, std::memory_order_acq_rel);
+    m_unWriteSlot = unPrevious & ~k_unFreshBit;
+    m_pHeader->ulPublishedFrames.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool CSampleFrameExport::AcquireLatest()
+{
+    if (!(m_pHeader->unMiddleSlot.load(std::memory_order_relaxed) & k_unFreshBit)) {
+        return false;
+    }
+
+    uint32_t unPrevious = m_pHeader->unMiddleSlot.exchange(m_unReadSlot, std::memory_order_acq_rel);
+    m_unReadSlot = unPrevious & ~k_unFreshBit;
+    m_pHeader->unConsumerSlot.store(m_unReadSlot, std::memory_order_relaxed);
+    m_pHeader->ulConsumedFrames.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool CSampleFrameExport::Map(const char *pchName, size_t cbSize, bool bCreate)
+{
+    m_sName = GetMappingName(pchName);
+
+#if defined(_WINDOWS)
+    HANDLE hMapping;
+    if (bCreate) {
+        hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)cbSize >> 32), (DWORD)cbSize, m_sName.c_str());
+    } else {
+        hMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, m_sName.c_str());
+    }
+    if (!hMapping) {
+        return false;
+    }
+
+    void *pView = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, cbSize);
+    if (!pView) {
+        CloseHandle(hMapping);
+        return false;
+    }
+    if (!bCreate) {
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(pView, &info, sizeof(info));
+        cbSize = info.RegionSize;
+    }
+    m_hMapping = hMapping;
+#else
+    int nFd;
+    if (bCreate) {
+        // a stale mapping from a crashed run may have the wrong size, start over
+        shm_unlink(m_sName.c_str());
+        nFd = shm_open(m_sName.c_str(), O_CREAT | O_RDWR, 0600);
+        if (nFd >= 0 && ftruncate(nFd, (off_t)cbSize) != 0) {
+            close(nFd);
+            shm_unlink(m_sName.c_str());
+            return false;
+        }
+    } else {
+        nFd = shm_open(m_sName.c_str(), O_RDWR, 0);
+        struct stat st;
+        if (nFd >= 0 && fstat(nFd, &st) == 0) {
+            cbSize = (size_t)st.st_size;
+        }
+    }
+    if (nFd < 0) {
+        return false;
+    }
+    if (cbSize == 0) {
+        close(nFd);
+        return false;
+    }
+
+    void *pView = mmap(NULL, cbSize, PROT_READ | PROT_WRITE, MAP_SHARED, nFd, 0);
+    close(nFd);
+    if (pView == MAP_FAILED) {
+        if (bCreate) {
+            shm_unlink(m_sName.c_str());
+        }
+        return false;
+    }
+#endif
+
+    m_pHeader = (SampleFrameExportHeader_t *)pView;
+    m_cbMapping = cbSize;
+    return true;
+}
+
+uint8_t *CSampleFrameExport::GetSlotPixels(uint32_t unSlot) const
+{
+    if (m_pHeader->ulSlotBytes == 0) {
+        return nullptr;
+    }
+    return (uint8_t *)m_pHeader + m_pHeader->ulPixelOffset + m_pHeader->ulSlotBytes * unSlot;
+}
@@ -0,0 +1,111 @@
+#ifndef CSAMPLEFRAMEEXPORT_H
+#define CSAMPLEFRAMEEXPORT_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+static const uint32_t k_unSampleFrameExportMagic = 0x58465944; // "DYFX"
+static const uint32_t k_unSampleFrameExportVersion = 1;
+static const uint32_t k_unSampleFrameExportSlots = 3;
+
+// metadata of one exported frame, lives in the shared memory next to its pixels
+struct SampleFrameInfo_t
+{
+    uint64_t ulFrameId;           // compositor frame id from PresentInfo_t
+    uint64_t ulSharedTexture;     // backbuffer handle, for consumers that can open it on the GPU
+    double flVsyncTimeInSeconds;  // as passed to Present
+    uint64_t ulPresentNs;         // GetTimestampNs() when the frame was published
+    uint32_t unPixelsValid;       // 0 when only the metadata of the frame was exported
+    uint32_t unWarpMicroseconds;  // CPU time spent reprojecting and distorting the pixels, 0 if they were copied
+};
+
+// start of the shared memory, the pixel slots follow at ulPixelOffset. ulSlotBytes is 0 when the producer only
+// exports metadata
+struct SampleFrameExportHeader_t
+{
+    uint32_t unMagic;
+    uint32_t unVersion;
+    uint32_t unWidth;
+    uint32_t unHeight;
+    uint32_t unStride;            // bytes per row, RGBA8
+    uint32_t unReserved;
+    uint64_t ulPixelOffset;
+    uint64_t ulSlotBytes;
+
+    // slot handed between producer and consumer, k_unFreshBit set while the consumer hasn't taken it
+    std::atomic<uint32_t> unMiddleSlot;
+    std::atomic<uint32_t> unConsumerSlot; // so a consumer that reconnects knows which slot it owns
+    std::atomic<uint64_t> ulPublishedFrames;
+    std::atomic<uint64_t> ulConsumedFrames;
+
+    SampleFrameInfo_t rgSlots[k_unSampleFrameExportSlots];
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Named shared memory holding a triple buffer of RGBA frames. One
+// process creates it and publishes, one other process opens it and always
+// reads the newest complete frame. Neither side ever waits for the other:
+// the producer swaps its finished slot with the middle one, the consumer
+// swaps its slot with the middle one when that holds a fresh frame.
+//-----------------------------------------------------------------------------
+class CSampleFrameExport
+{
+public:
+    static const uint32_t k_unFreshBit = 0x80000000u;
+
+    CSampleFrameExport();
+
+    ~CSampleFrameExport();
+
+    /** producer side, creates (or replaces) the shared memory. Without bPixels only the frame metadata is mapped */
+    bool Create(const char *pchName, uint32_t unWidth, uint32_t unHeight, bool bPixels);
+
+    /** consumer side, maps shared memory created by another process */
+    bool Open(const char *pchName);
+
+    void Close();
+
+    bool IsOpen() const { return m_pHeader != nullptr; }
+
+    uint32_t GetWidth() const { return m_pHeader->unWidth; }
+
+    uint32_t GetHeight() const { return m_pHeader->unHeight; }
+
+    uint32_t GetStride() const { return m_pHeader->unStride; }
+
+    bool HasPixels() const { return m_pHeader->ulSlotBytes != 0; }
+
+    const SampleFrameExportHeader_t *GetHeader() const { return m_pHeader; }
+
+    /** slot the producer fills next, only valid until Publish(). The pixels are null without pixel slots */
+    SampleFrameInfo_t *GetWriteInfo() { return &m_pHeader->rgSlots[m_unWriteSlot]; }
+
+    uint8_t *GetWritePixels() { return GetSlotPixels(m_unWriteSlot); }
+
+    void Publish();
+
+    /** returns true when a newer frame than the last one became readable */
+    bool AcquireLatest();
+
+    const SampleFrameInfo_t *GetReadInfo() const { return &m_pHeader->rgSlots[m_unReadSlot]; }
+
+    const uint8_t *GetReadPixels() const { return GetSlotPixels(m_unReadSlot); }
+
+private:
+    bool Map(const char *pchName, size_t cbSize, bool bCreate);
+
+    uint8_t *GetSlotPixels(uint32_t unSlot) const;
+
+    SampleFrameExportHeader_t *m_pHeader;
+    size_t m_cbMapping;
+    bool m_bOwner;
+    std::string m_sName;
+    void *m_hMapping;
+
+    uint32_t m_unWriteSlot;
+    uint32_t m_unReadSlot;
+};
+
+#endif // CSAMPLEFRAMEEXPORT_H
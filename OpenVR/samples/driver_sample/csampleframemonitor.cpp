@@ -0,0 +1,261 @@
+#include "csampleframemonitor.h"
+
+#include "basics.h"
+#include "csamplelatencystats.h"
+#include "driverlog.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+
+std::atomic<uint32_t> g_rgunSampleActivity[SampleActivityThread_Count];
+
+static std::atomic<uint64_t> s_ulStallNs(0);
+static uint64_t s_ulWarnIntervalNs = 0;
+
+// written by the thread that calls RunFrame, read by the watchdog and debug requests
+static std::atomic<uint64_t> s_ulBeginNs(0);
+static std::atomic<uint64_t> s_ulEndNs(0);
+static std::atomic<uint64_t> s_ulFrames(0);
+static std::atomic<uint64_t> s_ulStalls(0);
+static std::atomic<uint64_t> s_ulHostStalls(0);
+static std::atomic<uint64_t> s_ulMaxIntervalNs(0);
+static std::atomic<uint64_t> s_ulLastStallNs(0);
+static std::atomic<uint64_t> s_ulLastStallOwnNs(0);
+static std::atomic<uint64_t> s_ulLastStallAtNs(0);
+static std::atomic<uint32_t> s_rgunLastStallActivity[SampleActivityThread_Count];
+
+// what our threads were doing when the watchdog saw the gap after frame s_ulSnapshotFrame pass the threshold
+static std::atomic<uint64_t> s_ulSnapshotFrame(0);
+static std::atomic<uint32_t> s_rgunSnapshotActivity[SampleActivityThread_Count];
+
+// the RunFrame thread only
+static uint64_t s_ulLastWarnNs = 0;
+static uint32_t s_unSuppressedWarnings = 0;
+
+static std::thread *s_pWatchdogThread = nullptr;
+static std::mutex s_watchdogMutex;
+static std::condition_variable s_watchdogWake;
+static bool s_bWatchdogRunning = false;
+static bool s_bWatchdogStandby = false;
+
+// set while the watchdog waits without a timeout for the next RunFrame, which then wakes it
+static std::atomic<bool> s_bWatchdogIdle(false);
+
+static const char *GetActivityName(uint32_t unActivity)
+{
+    const char *pchName = unActivity ? GetSampleTraceScopeName(unActivity - 1) : "idle";
+    return pchName ? pchName : "unknown";
+}
+
+static void WatchdogThreadFunction()
+{
+    std::unique_lock<std::mutex> lock(s_watchdogMutex);
+    while (s_bWatchdogRunning) {
+        // the frame counter first, a RunFrame that starts after it is a different gap
+        uint64_t ulFrame = s_ulFrames.load(std::memory_order_seq_cst);
+        uint64_t ulBegin = s_ulBeginNs.load(std::memory_order_relaxed);
+
+        // no gap open, or this one is already caught: sleep until OnSampleRunFrameBegin() arms us.
+        // seq_cst pairs with its frame counter, so either we see the new frame or it sees us idle
+        if (ulBegin == 0 || s_bWatchdogStandby || s_ulSnapshotFrame.load(std::memory_order_relaxed) == ulFrame) {
+            s_bWatchdogIdle.store(true, std::memory_order_seq_cst);
+            if (s_ulFrames.load(std::memory_order_seq_cst) == ulFrame || s_bWatchdogStandby) {
+                s_watchdogWake.wait(lock);
+            }
+            s_bWatchdogIdle.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        // a newer RunFrame moves the deadline, we find out when the old one passes
+        uint64_t ulDeadline = ulBegin + s_ulStallNs.load(std::memory_order_relaxed);
+        if (GetTimestampNs() <= ulDeadline) {
+            s_watchdogWake.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(ulDeadline + 1)));
+            continue;
+        }
+        for (uint32_t i = 0; i < SampleActivityThread_Count; i++) {
+            s_rgunSnapshotActivity[i].store(g_rgunSampleActivity[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        s_ulSnapshotFrame.store(ulFrame, std::memory_order_release);
+    }
+}
+
+void StartSampleFrameMonitor(float flStallMs, float flWarnIntervalSeconds)
+{
+    StopSampleFrameMonitor();
+    ResetSampleFrameMonitor();
+    if (flStallMs <= 0) {
+        s_ulStallNs.store(0, std::memory_order_relaxed);
+        return;
+    }
+
+    s_ulStallNs.store((uint64_t)(flStallMs * 1e6), std::memory_order_relaxed);
+    s_ulWarnIntervalNs = flWarnIntervalSeconds > 0 ? (uint64_t)(flWarnIntervalSeconds * 1e9) : 0;
+    s_ulLastWarnNs = 0;
+    s_unSuppressedWarnings = 0;
+    s_bWatchdogRunning = true;
+    s_bWatchdogStandby = false;
+    s_pWatchdogThread = new std::thread(WatchdogThreadFunction);
+}
+
+void StopSampleFrameMonitor()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_watchdogMutex);
+        s_bWatchdogRunning = false;
+    }
+    s_watchdogWake.notify_all();
+    if (s_pWatchdogThread) {
+        s_pWatchdogThread->join();
+        delete s_pWatchdogThread;
+        s_pWatchdogThread = nullptr;
+    }
+}
+
+static void OnStall(uint64_t ulNow, uint64_t ulInterval, uint64_t ulOwnNs, uint64_t ulFrame)
+{
+    // if the watchdog caught the gap it knows what we were doing in it, otherwise all we have is now
+    uint32_t rgunActivity[SampleActivityThread_Count];
+    bool bSnapshot = s_ulSnapshotFrame.load(std::memory_order_acquire) == ulFrame;
+    for (uint32_t i = 0; i < SampleActivityThread_Count; i++) {
+        rgunActivity[i] = (bSnapshot ? s_rgunSnapshotActivity[i] : g_rgunSampleActivity[i]).load(std::memory_order_relaxed);
+        s_rgunLastStallActivity[i].store(rgunActivity[i], std::memory_order_relaxed);
+    }
+
+    // most of the gap inside our RunFrame is ours, otherwise SteamVR's thread was busy with something else
+    bool bOwn = ulOwnNs * 2 > ulInterval;
+    if (!bSnapshot && bOwn) {
+        rgunActivity[SampleActivityThread_Server] = SampleTraceScope_RunFrame + 1;
+        s_rgunLastStallActivity[SampleActivityThread_Server].store(rgunActivity[SampleActivityThread_Server], std::memory_order_relaxed);
+    }
+    s_ulStalls.store(s_ulStalls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (!bOwn) {
+        s_ulHostStalls.store(s_ulHostStalls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    s_ulLastStallNs.store(ulInterval, std::memory_order_relaxed);
+    s_ulLastStallOwnNs.store(ulOwnNs, std::memory_order_relaxed);
+    s_ulLastStallAtNs.store(ulNow, std::memory_order_relaxed);
+
+    if (s_ulLastWarnNs && ulNow - s_ulLastWarnNs < s_ulWarnIntervalNs) {
+        s_unSuppressedWarnings++;
+        return;
+    }
+    char rgchSuppressed[64] = "";
+    if (s_unSuppressedWarnings) {
+        snprintf(rgchSuppressed, sizeof(rgchSuppressed), ", %u more since the last warning", s_unSuppressedWarnings);
+    }
+    if (bOwn) {
+        DRIVERLOG_WARNING(DriverLogCategory_General, "driver_null: RunFrame stalled %.1f ms, %.1f ms of it in our %s (pose thread: %s, transport: %s)%s\n",
+            ulInterval * 1e-6, ulOwnNs * 1e-6, GetActivityName(rgunActivity[SampleActivityThread_Server]),
+            GetActivityName(rgunActivity[SampleActivityThread_Pose]), GetActivityName(rgunActivity[SampleActivityThread_Transport]), (const char *)rgchSuppressed);
+    } else {
+        DRIVERLOG_WARNING(DriverLogCategory_General, "driver_null: RunFrame stalled %.1f ms, only %.2f ms of it in our code, the host or another driver held the thread (pose thread: %s, transport: %s)%s\n",
+            ulInterval * 1e-6, ulOwnNs * 1e-6, GetActivityName(rgunActivity[SampleActivityThread_Pose]),
+            GetActivityName(rgunActivity[SampleActivityThread_Transport]), (const char *)rgchSuppressed);
+    }
+    s_ulLastWarnNs = ulNow;
+    s_unSuppressedWarnings = 0;
+}
+
+void OnSampleRunFrameBegin()
+{
+    uint64_t ulNow = GetTimestampNs();
+    uint64_t ulBegin = s_ulBeginNs.load(std::memory_order_relaxed);
+    uint64_t ulFrame = s_ulFrames.load(std::memory_order_relaxed);
+    if (ulBegin) {
+        uint64_t ulInterval = ulNow - ulBegin;
+        RecordSampleLatency(SampleLatencyStage_RunFrameInterval, ulInterval);
+        if (ulInterval > s_ulMaxIntervalNs.load(std::memory_order_relaxed)) {
+            s_ulMaxIntervalNs.store(ulInterval, std::memory_order_relaxed);
+        }
+        uint64_t ulStallNs = s_ulStallNs.load(std::memory_order_relaxed);
+        uint64_t ulEnd = s_ulEndNs.load(std::memory_order_relaxed);
+        if (ulStallNs && ulInterval > ulStallNs) {
+            OnStall(ulNow, ulInterval, ulEnd > ulBegin ? ulEnd - ulBegin : 0, ulFrame);
+        }
+    }
+    s_ulBeginNs.store(ulNow, std::memory_order_relaxed);
+    s_ulFrames.store(ulFrame + 1, std::memory_order_seq_cst);
+
+    // a new gap opens, only an idle watchdog needs the wake and only the first RunFrame after it went idle sends it
+    if (s_bWatchdogIdle.load(std::memory_order_seq_cst) && s_bWatchdogIdle.exchange(false, std::memory_order_relaxed)) {
+        {
+            std::lock_guard<std::mutex> lock(s_watchdogMutex);
+        }
+        s_watchdogWake.notify_one();
+    }
+}
+
+void OnSampleRunFrameEnd()
+{
+    uint64_t ulNow = GetTimestampNs();
+    uint64_t ulBegin = s_ulBeginNs.load(std::memory_order_relaxed);
+    s_ulEndNs.store(ulNow, std::memory_order_relaxed);
+    if (ulBegin) {
+        RecordSampleLatency(SampleLatencyStage_RunFrameDuration, ulNow - ulBegin);
+    }
+}
+
+void ResetSampleFrameMonitor()
+{
+    s_ulBeginNs.store(0, std::memory_order_relaxed);
+    s_ulEndNs.store(0, std::memory_order_relaxed);
+}
+
+void SetSampleFrameMonitorStandby(bool bStandby)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_watchdogMutex);
+        s_bWatchdogStandby = bStandby;
+    }
+    ResetSampleFrameMonitor();
+    s_watchdogWake.notify_one();
+}
+
+void GetSampleFrameMonitorCounters(SampleFrameMonitorCounters_t *pCounters)
+{
+    pCounters->ulFrames = s_ulFrames.load(std::memory_order_relaxed);
+    pCounters->ulStalls = s_ulStalls.load(std::memory_order_relaxed);
+    pCounters->ulHostStalls = s_ulHostStalls.load(std::memory_order_relaxed);
+    pCounters->ulMaxIntervalNs = s_ulMaxIntervalNs.load(std::memory_order_relaxed);
+}
+
+bool FormatSampleFrameMonitorJson(char *pchBuffer, uint32_t unBufferSize)
+{
+    if (unBufferSize == 0) {
+        return false;
+    }
+
+    uint64_t ulStalls = s_ulStalls.load(std::memory_order_relaxed);
+    uint64_t ulHostStalls = s_ulHostStalls.load(std::memory_order_relaxed);
+    int nWritten = snprintf(pchBuffer, unBufferSize, "{\"frames\":%llu,\"stall_threshold_ms\":%.1f,\"max_interval_ms\":%.2f,\"stalls\":%llu,\"host_stalls\":%llu,\"own_stalls\":%llu,\"last_stall\":",
+        (unsigned long long)s_ulFrames.load(std::memory_order_relaxed), s_ulStallNs.load(std::memory_order_relaxed) * 1e-6,
+        s_ulMaxIntervalNs.load(std::memory_order_relaxed) * 1e-6, (unsigned long long)ulStalls, (unsigned long long)ulHostStalls,
+        (unsigned long long)(ulStalls - ulHostStalls));
+    if (nWritten < 0 || (uint32_t)nWritten >= unBufferSize) {
+        pchBuffer[0] = 0;
+        return false;
+    }
+
+    uint32_t cbUsed = (uint32_t)nWritten;
+    uint64_t ulLastAt = s_ulLastStallAtNs.load(std::memory_order_relaxed);
+    if (!ulLastAt) {
+        nWritten = snprintf(pchBuffer + cbUsed, unBufferSize - cbUsed, "null}");
+    } else {
+        uint64_t ulLength = s_ulLastStallNs.load(std::memory_order_relaxed);
+        uint64_t ulOwn = s_ulLastStallOwnNs.load(std::memory_order_relaxed);
+        nWritten = snprintf(pchBuffer + cbUsed, unBufferSize - cbUsed,
+            "{\"ms\":%.2f,\"own_ms\":%.2f,\"seconds_ago\":%.1f,\"cause\":\"%s\",\"server\":\"%s\",\"pose\":\"%s\",\"transport\":\"%s\"}}",
+            ulLength * 1e-6, ulOwn * 1e-6, (GetTimestampNs() - ulLastAt) * 1e-9, ulOwn * 2 > ulLength ? "driver" : "host",
+            GetActivityName(s_rgunLastStallActivity[SampleActivityThread_Server].load(std::memory_order_relaxed)),
+            GetActivityName(s_rgunLastStallActivity[SampleActivityThread_Pose].load(std::memory_order_relaxed)),
+            GetActivityName(s_rgunLastStallActivity[SampleActivityThread_Transport].load(std::memory_order_relaxed)));
+    }
+    if (nWritten < 0 || cbUsed + (uint32_t)nWritten >= unBufferSize) {
+        pchBuffer[0] = 0;
+        return false;
+    }
+    return true;
+}
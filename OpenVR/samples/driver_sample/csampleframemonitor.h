@@ -0,0 +1,78 @@
+#ifndef CSAMPLEFRAMEMONITOR_H
+#define CSAMPLEFRAMEMONITOR_H
+
+#include "csampletrace.h"
+
+#include <atomic>
+#include <stdint.h>
+
+// the threads of ours whose current stage the frame monitor looks at during a stall
+enum ESampleActivityThread
+{
+    SampleActivityThread_Server,       // SteamVR's thread while it is in our RunFrame
+    SampleActivityThread_Pose,
+    SampleActivityThread_Transport,
+    SampleActivityThread_Count
+};
+
+// ESampleTraceScope + 1 of what each thread is doing, 0 when it is outside our code or waiting
+extern std::atomic<uint32_t> g_rgunSampleActivity[SampleActivityThread_Count];
+
+//-----------------------------------------------------------------------------
+// Purpose: Marks a stage of one of our threads for the frame monitor while
+// the object lives, and restores the outer stage afterwards. Two relaxed
+// stores, so it can sit next to every trace scope of the thread.
+//-----------------------------------------------------------------------------
+class CSampleActivityScope
+{
+public:
+    CSampleActivityScope(ESampleActivityThread eThread, ESampleTraceScope eStage)
+    {
+        m_eThread = eThread;
+        m_unOuter = g_rgunSampleActivity[eThread].load(std::memory_order_relaxed);
+        g_rgunSampleActivity[eThread].store((uint32_t)eStage + 1, std::memory_order_relaxed);
+    }
+
+    ~CSampleActivityScope()
+    {
+        g_rgunSampleActivity[m_eThread].store(m_unOuter, std::memory_order_relaxed);
+    }
+
+private:
+    CSampleActivityScope(const CSampleActivityScope &) = delete;
+    CSampleActivityScope &operator=(const CSampleActivityScope &) = delete;
+
+    ESampleActivityThread m_eThread;
+    uint32_t m_unOuter;
+};
+
+/** starts the watchdog thread. A gap between two RunFrame calls longer than flStallMs is a stall, warnings about
+ * stalls are logged at most once every flWarnIntervalSeconds. flStallMs of 0 or less disables the monitor */
+void StartSampleFrameMonitor(float flStallMs, float flWarnIntervalSeconds);
+
+void StopSampleFrameMonitor();
+
+/** first and last thing of CServerDriver_Sample::RunFrame */
+void OnSampleRunFrameBegin();
+void OnSampleRunFrameEnd();
+
+/** forgets the last RunFrame, so the gap of a standby isn't taken for a stall */
+void ResetSampleFrameMonitor();
+
+/** parks the watchdog until SteamVR leaves standby, and forgets the last RunFrame on the way in and out */
+void SetSampleFrameMonitorStandby(bool bStandby);
+
+struct SampleFrameMonitorCounters_t
+{
+    uint64_t ulFrames;
+    uint64_t ulStalls;
+    uint64_t ulHostStalls;
+    uint64_t ulMaxIntervalNs;
+};
+
+void GetSampleFrameMonitorCounters(SampleFrameMonitorCounters_t *pCounters);
+
+/** frame and stall counters and the last stall as a JSON object, returns false if it didn't fit */
+bool FormatSampleFrameMonitorJson(char *pchBuffer, uint32_t unBufferSize);
+
+#endif // CSAMPLEFRAMEMONITOR_H
@@ -0,0 +1,154 @@
+#include "csamplelatencystats.h"
+
+#include "basics.h"
+
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static uint32_t HighestBit(uint64_t ulValue)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long unIndex;
+    _BitScanReverse64(&unIndex, ulValue);
+    return (uint32_t)unIndex;
+#elif defined(_MSC_VER)
+    unsigned long unIndex;
+    if (_BitScanReverse(&unIndex, (unsigned long)(ulValue >> 32))) {
+        return (uint32_t)unIndex + 32;
+    }
+    _BitScanReverse(&unIndex, (unsigned long)ulValue);
+    return (uint32_t)unIndex;
+#else
+    return 63 - (uint32_t)__builtin_clzll(ulValue);
+#endif
+}
+
+CSampleLatencyHistogram::CSampleLatencyHistogram()
+{
+    Reset();
+}
+
+uint32_t CSampleLatencyHistogram::GetBucket(uint64_t ulNs)
+{
+    if (ulNs < k_unSampleLatencySubBuckets) {
+        return (uint32_t)ulNs;
+    }
+    uint32_t unExponent = HighestBit(ulNs);
+    if (unExponent > k_unSampleLatencyMaxExponent) {
+        return k_unSampleLatencyBuckets - 1;
+    }
+    uint32_t unShift = unExponent - k_unSampleLatencySubBucketBits;
+    uint32_t unSub = (uint32_t)(ulNs >> unShift) - k_unSampleLatencySubBuckets;
+    return (unShift + 1) * k_unSampleLatencySubBuckets + unSub;
+}
+
+uint64_t CSampleLatencyHistogram::GetBucketUpperNs(uint32_t unBucket)
+{
+    if (unBucket < k_unSampleLatencySubBuckets) {
+        return unBucket;
+    }
+    uint32_t unShift = unBucket / k_unSampleLatencySubBuckets - 1;
+    uint64_t ulLower = (uint64_t)(k_unSampleLatencySubBuckets + unBucket % k_unSampleLatencySubBuckets) << unShift;
+    return ulLower + ((uint64_t)1 << unShift) - 1;
+}
+
+void CSampleLatencyHistogram::Reset()
+{
+    for (uint32_t i = 0; i < k_unSampleLatencyBuckets; i++) {
+        m_rgulBuckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_ulTotalNs.store(0, std::memory_order_relaxed);
+    m_ulMaxNs.store(0, std::memory_order_relaxed);
+}
+
+void CSampleLatencyHistogram::GetSummary(SampleLatencySummary_t *pSummary) const
+{
+    // the count is the sum of the buckets, so the percentiles always agree with it
+    uint64_t ulCount = 0;
+    uint64_t rgulCounts[k_unSampleLatencyBuckets];
+    for (uint32_t i = 0; i < k_unSampleLatencyBuckets; i++) {
+        rgulCounts[i] = m_rgulBuckets[i].load(std::memory_order_relaxed);
+        ulCount += rgulCounts[i];
+    }
+
+    uint64_t ulMax = m_ulMaxNs.load(std::memory_order_relaxed);
+    uint64_t ulTotal = m_ulTotalNs.load(std::memory_order_relaxed);
+    pSummary->ulCount = ulCount;
+    pSummary->ulTotalNs = ulTotal;
+    pSummary->ulMeanNs = ulCount ? ulTotal / ulCount : 0;
+    pSummary->ulMaxNs = ulMax;
+
+    const double rgflQuantiles[4] = { 0.5, 0.9, 0.99, 0.999 };
+    uint64_t *rgpulOut[4] = { &pSummary->ulP50Ns, &pSummary->ulP90Ns, &pSummary->ulP99Ns, &pSummary->ulP999Ns };
+    uint64_t ulSeen = 0;
+    uint32_t unBucket = 0;
+    for (uint32_t q = 0; q < 4; q++) {
+        uint64_t ulRank = (uint64_t)(rgflQuantiles[q] * ulCount + 0.999999);
+        if (ulRank < 1) {
+            ulRank = 1;
+        }
+        while (unBucket < k_unSampleLatencyBuckets && ulSeen + rgulCounts[unBucket] < ulRank) {
+            ulSeen += rgulCounts[unBucket];
+            unBucket++;
+        }
+        uint64_t ulValue = ulCount && unBucket < k_unSampleLatencyBuckets ? GetBucketUpperNs(unBucket) : 0;
+        *rgpulOut[q] = ulValue < ulMax ? ulValue : ulMax;
+    }
+}
+
+static CSampleLatencyHistogram s_rgStages[SampleLatencyStage_Count];
+static std::atomic<uint64_t> s_ulResetNs(0);
+static const char *const k_rgpchStageNames[SampleLatencyStage_Count] = { "input_to_state", "sample_to_submit", "runframe_interval", "runframe_duration", "transport_decode", "pose_evaluate" };
+
+CSampleLatencyHistogram &GetSampleLatencyStats(ESampleLatencyStage eStage)
+{
+    return s_rgStages[eStage];
+}
+
+const char *GetSampleLatencyStageName(ESampleLatencyStage eStage)
+{
+    return k_rgpchStageNames[eStage];
+}
+
+bool FormatSampleLatencyStatsJson(char *pchBuffer, uint32_t unBufferSize)
+{
+    if (unBufferSize == 0) {
+        return false;
+    }
+
+    uint64_t ulResetNs = s_ulResetNs.load(std::memory_order_relaxed);
+    uint64_t ulNow = GetTimestampNs();
+    uint32_t cbUsed = 0;
+    int nWritten = snprintf(pchBuffer, unBufferSize, "{\"seconds\":%.1f,\"stages\":{", ulResetNs ? (ulNow - ulResetNs) * 1e-9 : 0.0);
+    for (uint32_t i = 0; i < SampleLatencyStage_Count && nWritten >= 0 && cbUsed + (uint32_t)nWritten < unBufferSize; i++) {
+        cbUsed += (uint32_t)nWritten;
+        SampleLatencySummary_t summary;
+        s_rgStages[i].GetSummary(&summary);
+        nWritten = snprintf(pchBuffer + cbUsed, unBufferSize - cbUsed,
+            "%s\"%s\":{\"count\":%llu,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f}",
+            i ? "," : "", k_rgpchStageNames[i], (unsigned long long)summary.ulCount, summary.ulMeanNs * 1e-3, summary.ulP50Ns * 1e-3,
+            summary.ulP90Ns * 1e-3, summary.ulP99Ns * 1e-3, summary.ulP999Ns * 1e-3, summary.ulMaxNs * 1e-3);
+    }
+    if (nWritten < 0 || cbUsed + (uint32_t)nWritten >= unBufferSize) {
+        pchBuffer[0] = 0;
+        return false;
+    }
+    cbUsed += (uint32_t)nWritten;
+    nWritten = snprintf(pchBuffer + cbUsed, unBufferSize - cbUsed, "}}");
+    if (nWritten < 0 || cbUsed + (uint32_t)nWritten >= unBufferSize) {
+        pchBuffer[0] = 0;
+        return false;
+    }
+    return true;
+}
+
+void ResetSampleLatencyStats()
+{
+    for (uint32_t i = 0; i < SampleLatencyStage_Count; i++) {
+        s_rgStages[i].Reset();
+    }
+    s_ulResetNs.store(GetTimestampNs(), std::memory_order_relaxed);
+}
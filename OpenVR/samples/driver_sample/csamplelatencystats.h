@@ -0,0 +1,91 @@
+#ifndef CSAMPLELATENCYSTATS_H
+#define CSAMPLELATENCYSTATS_H
+
+#include <atomic>
+#include <stdint.h>
+
+// values below 2^k_unSampleLatencySubBucketBits nanoseconds are exact, above that every
+// power of two is split into 2^k_unSampleLatencySubBucketBits buckets, about 6% wide
+static const uint32_t k_unSampleLatencySubBucketBits = 4;
+static const uint32_t k_unSampleLatencySubBuckets = 1u << k_unSampleLatencySubBucketBits;
+static const uint32_t k_unSampleLatencyMaxExponent = 40; // about 18 minutes, longer values land in the last bucket
+static const uint32_t k_unSampleLatencyBuckets = (k_unSampleLatencyMaxExponent - k_unSampleLatencySubBucketBits + 2) * k_unSampleLatencySubBuckets;
+
+struct SampleLatencySummary_t
+{
+    uint64_t ulCount;
+    uint64_t ulTotalNs;
+    uint64_t ulMeanNs;
+    uint64_t ulP50Ns;
+    uint64_t ulP90Ns;
+    uint64_t ulP99Ns;
+    uint64_t ulP999Ns;
+    uint64_t ulMaxNs;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Log-linear histogram of durations in nanoseconds, in the style of
+// HdrHistogram: constant relative precision from nanoseconds to minutes in a
+// few KB. Record() is a handful of relaxed atomic adds, so any number of
+// threads can record into it while another one reads a summary. Reset()
+// racing a Record() may lose that one value.
+//-----------------------------------------------------------------------------
+class CSampleLatencyHistogram
+{
+public:
+    CSampleLatencyHistogram();
+
+    void Record(uint64_t ulNs)
+    {
+        m_rgulBuckets[GetBucket(ulNs)].fetch_add(1, std::memory_order_relaxed);
+        m_ulTotalNs.fetch_add(ulNs, std::memory_order_relaxed);
+        uint64_t ulMax = m_ulMaxNs.load(std::memory_order_relaxed);
+        while (ulNs > ulMax && !m_ulMaxNs.compare_exchange_weak(ulMax, ulNs, std::memory_order_relaxed)) {
+        }
+    }
+
+    void Reset();
+
+    /** percentiles are the upper edge of their bucket, clamped to the largest value seen */
+    void GetSummary(SampleLatencySummary_t *pSummary) const;
+
+    static uint32_t GetBucket(uint64_t ulNs);
+
+    /** the largest value that falls into a bucket */
+    static uint64_t GetBucketUpperNs(uint32_t unBucket);
+
+private:
+    std::atomic<uint64_t> m_rgulBuckets[k_unSampleLatencyBuckets];
+    std::atomic<uint64_t> m_ulTotalNs;
+    std::atomic<uint64_t> m_ulMaxNs;
+};
+
+// the stages of the driver that are always measured
+enum ESampleLatencyStage
+{
+    SampleLatencyStage_InputToState,      // input read until SteamVR has the new component state
+    SampleLatencyStage_SampleToSubmit,    // last transport data of a device until its pose went to SteamVR
+    SampleLatencyStage_RunFrameInterval,  // between two RunFrame calls of the server
+    SampleLatencyStage_RunFrameDuration,  // from entering the server's RunFrame until it returns
+    SampleLatencyStage_TransportDecode,   // datagram received until its packets are applied to the devices
+    SampleLatencyStage_PoseEvaluate,      // GetPose of one device: transport pose, filtering and prediction
+    SampleLatencyStage_Count
+};
+
+/** the histogram of a stage, shared by the whole driver */
+CSampleLatencyHistogram &GetSampleLatencyStats(ESampleLatencyStage eStage);
+
+inline void RecordSampleLatency(ESampleLatencyStage eStage, uint64_t ulNs)
+{
+    GetSampleLatencyStats(eStage).Record(ulNs);
+}
+
+/** name of a stage in the JSON and metrics */
+const char *GetSampleLatencyStageName(ESampleLatencyStage eStage);
+
+/** writes every stage as a JSON object, returns false if it didn't fit */
+bool FormatSampleLatencyStatsJson(char *pchBuffer, uint32_t unBufferSize);
+
+void ResetSampleLatencyStats();
+
+#endif // CSAMPLELATENCYSTATS_H
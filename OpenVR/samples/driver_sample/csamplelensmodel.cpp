@@ -0,0 +1,438 @@
+#include "csamplelensmodel.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SAMPLE_LENS_SSE2
+#endif
+
+using namespace vr;
+
+CSampleLensModel::CSampleLensModel()
+{
+    m_eModel = SampleLensModel_None;
+    memset(m_rgflCoefficients, 0, sizeof(m_rgflCoefficients));
+    for (uint32_t i = 0; i < 2; i++) {
+        m_rgflCenterU[i] = 0.5f;
+        m_rgflCenterV[i] = 0.5f;
+    }
+    m_flAspect = 1.0f;
+    m_unLutResolution = 0;
+    for (uint32_t i = 0; i < 2; i++) {
+        m_rgbHasOutputBounds[i] = false;
+        UpdateOutputTransform((EVREye)i);
+    }
+}
+
+void CSampleLensModel::SetCoefficients(ESampleLensChannel eChannel, const float rfCoefficients[k_unSampleLensCoefficients])
+{
+    memcpy(m_rgflCoefficients[eChannel], rfCoefficients, sizeof(m_rgflCoefficients[eChannel]));
+}
+
+void CSampleLensModel::SetCenterOffset(EVREye eEye, float flOffsetU, float flOffsetV)
+{
+    m_rgflCenterU[eEye] = 0.5f + flOffsetU;
+    m_rgflCenterV[eEye] = 0.5f + flOffsetV;
+    UpdateOutputTransform(eEye);
+}
+
+void CSampleLensModel::SetAspect(float flAspect)
+{
+    m_flAspect = flAspect;
+    UpdateOutputTransform(Eye_Left);
+    UpdateOutputTransform(Eye_Right);
+}
+
+void CSampleLensModel::SetOutputBounds(EVREye eEye, const SampleLensBounds_t &bounds)
+{
+    m_rgOutputBounds[eEye] = bounds;
+    m_rgbHasOutputBounds[eEye] = true;
+    UpdateOutputTransform(eEye);
+}
+
+void CSampleLensModel::UpdateOutputTransform(EVREye eEye)
+{
+    // without explicit bounds the rendered image covers the undistorted panel, so no lens means identity
+    SampleLensBounds_t bounds;
+    if (m_rgbHasOutputBounds[eEye]) {
+        bounds = m_rgOutputBounds[eEye];
+    } else {
+        bounds.flLeft = -m_rgflCenterU[eEye] * 2.0f * m_flAspect;
+        bounds.flRight = (1.0f - m_rgflCenterU[eEye]) * 2.0f * m_flAspect;
+        bounds.flTop = -m_rgflCenterV[eEye] * 2.0f;
+        bounds.flBottom = (1.0f - m_rgflCenterV[eEye]) * 2.0f;
+    }
+    m_rgflOutScaleU[eEye] = 1.0f / (bounds.flRight - bounds.flLeft);
+    m_rgflOutOffsetU[eEye] = -bounds.flLeft * m_rgflOutScaleU[eEye];
+    m_rgflOutScaleV[eEye] = 1.0f / (bounds.flBottom - bounds.flTop);
+    m_rgflOutOffsetV[eEye] = -bounds.flTop * m_rgflOutScaleV[eEye];
+}
+
+float CSampleLensModel::GetRadius(EVREye eEye, float fU, float fV) const
+{
+    float flX = (fU - m_rgflCenterU[eEye]) * 2.0f * m_flAspect;
+    float flY = (fV - m_rgflCenterV[eEye]) * 2.0f;
+    return sqrtf(flX * flX + flY * flY);
+}
+
+void CSampleLensModel::EvaluateChannel(ESampleLensChannel eChannel, float flX, float flY, float *pflX, float *pflY) const
+{
+    const float *k = m_rgflCoefficients[eChannel];
+    float flR2 = flX * flX + flY * flY;
+
+    if (m_eModel == SampleLensModel_BrownConrady) {
+        float flRadial = 1.0f + flR2 * (k[0] + flR2 * (k[1] + flR2 * k[2]));
+        *pflX = flX * flRadial + 2.0f * k[3] * flX * flY + k[4] * (flR2 + 2.0f * flX * flX);
+        *pflY = flY * flRadial + k[3] * (flR2 + 2.0f * flY * flY) + 2.0f * k[4] * flX * flY;
+    } else if (m_eModel == SampleLensModel_Polynomial) {
+        float flR = sqrtf(flR2);
+        float flScale = k[0] + flR * (k[1] + flR * (k[2] + flR * (k[3] + flR * k[4])));
+        *pflX = flX * flScale;
+        *pflY = flY * flScale;
+    } else {
+        *pflX = flX;
+        *pflY = flY;
+    }
+}
+
+DistortionCoordinates_t CSampleLensModel::Evaluate(EVREye eEye, float fU, float fV) const
+{
+    float flCenterU = m_rgflCenterU[eEye];
+    float flCenterV = m_rgflCenterV[eEye];
+    float flX = (fU - flCenterU) * 2.0f * m_flAspect;
+    float flY = (fV - flCenterV) * 2.0f;
+
+    float *rgpflOut[SampleLensChannel_Count];
+    DistortionCoordinates_t coordinates;
+    rgpflOut[SampleLensChannel_Red] = coordinates.rfRed;
+    rgpflOut[SampleLensChannel_Green] = coordinates.rfGreen;
+    rgpflOut[SampleLensChannel_Blue] = coordinates.rfBlue;
+
+    for (uint32_t i = 0; i < SampleLensChannel_Count; i++) {
+        float flOutX, flOutY;
+        EvaluateChannel((ESampleLensChannel)i, flX, flY, &flOutX, &flOutY);
+        rgpflOut[i][0] = flOutX * m_rgflOutScaleU[eEye] + m_rgflOutOffsetU[eEye];
+        rgpflOut[i][1] = flOutY * m_rgflOutScaleV[eEye] + m_rgflOutOffsetV[eEye];
+    }
+    return coordinates;
+}
+
+void CSampleLensModel::EvaluateBatch(EVREye eEye, const float *pfU, const float *pfV, uint32_t unCount, DistortionCoordinates_t *pCoordinates) const
+{
+    uint32_t i = 0;
+
+#if defined(SAMPLE_LENS_SSE2)
+    if (m_eModel == SampleLensModel_BrownConrady) {
+        const __m128 vCenterU = _mm_set1_ps(m_rgflCenterU[eEye]);
+        const __m128 vCenterV = _mm_set1_ps(m_rgflCenterV[eEye]);
+        const __m128 vToX = _mm_set1_ps(2.0f * m_flAspect);
+        const __m128 vScaleU = _mm_set1_ps(m_rgflOutScaleU[eEye]);
+        const __m128 vOffsetU = _mm_set1_ps(m_rgflOutOffsetU[eEye]);
+        const __m128 vScaleV = _mm_set1_ps(m_rgflOutScaleV[eEye]);
+        const __m128 vOffsetV = _mm_set1_ps(m_rgflOutOffsetV[eEye]);
+        const __m128 vOne = _mm_set1_ps(1.0f);
+        const __m128 vTwo = _mm_set1_ps(2.0f);
+
+        for (; i + 4 <= unCount; i += 4) {
+            __m128 vX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pfU + i), vCenterU), vToX);
+            __m128 vY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pfV + i), vCenterV), vTwo);
+            __m128 vXX = _mm_mul_ps(vX, vX);
+            __m128 vYY = _mm_mul_ps(vY, vY);
+            __m128 vXY2 = _mm_mul_ps(vTwo, _mm_mul_ps(vX, vY));
+            __m128 vR2 = _mm_add_ps(vXX, vYY);
+
+            float rgflOut[SampleLensChannel_Count][2][4];
+            for (uint32_t c = 0; c < SampleLensChannel_Count; c++) {
+                const float *k = m_rgflCoefficients[c];
+                __m128 vRadial = _mm_add_ps(_mm_set1_ps(k[1]), _mm_mul_ps(vR2, _mm_set1_ps(k[2])));
+                vRadial = _mm_add_ps(_mm_set1_ps(k[0]), _mm_mul_ps(vR2, vRadial));
+                vRadial = _mm_add_ps(vOne, _mm_mul_ps(vR2, vRadial));
+
+                __m128 vP1 = _mm_set1_ps(k[3]);
+                __m128 vP2 = _mm_set1_ps(k[4]);
+                __m128 vOutX = _mm_add_ps(_mm_mul_ps(vX, vRadial), _mm_mul_ps(vP1, vXY2));
+                vOutX = _mm_add_ps(vOutX, _mm_mul_ps(vP2, _mm_add_ps(vR2, _mm_mul_ps(vTwo, vXX))));
+                __m128 vOutY = _mm_add_ps(_mm_mul_ps(vY, vRadial), _mm_mul_ps(vP2, vXY2));
+                vOutY = _mm_add_ps(vOutY, _mm_mul_ps(vP1, _mm_add_ps(vR2, _mm_mul_ps(vTwo, vYY))));
+
+                _mm_storeu_ps(rgflOut[c][0], _mm_add_ps(vOffsetU, _mm_mul_ps(vOutX, vScaleU)));
+                _mm_storeu_ps(rgflOut[c][1], _mm_add_ps(vOffsetV, _mm_mul_ps(vOutY, vScaleV)));
+            }
+
+            for (uint32_t j = 0; j < 4; j++) {
+                DistortionCoordinates_t &coordinates = pCoordinates[i + j];
+                coordinates.rfRed[0] = rgflOut[SampleLensChannel_Red][0][j];
+                coordinates.rfRed[1] = rgflOut[SampleLensChannel_Red][1][j];
+                coordinates.rfGreen[0] = rgflOut[SampleLensChannel_Green][0][j];
+                coordinates.rfGreen[1] = rgflOut[SampleLensChannel_Green][1][j];
+                coordinates.rfBlue[0] = rgflOut[SampleLensChannel_Blue][0][j];
+                coordinates.rfBlue[1] = rgflOut[SampleLensChannel_Blue][1][j];
+            }
+        }
+    }
+#endif
+
+    // the polynomial model, the tail and machines without SSE2 take the scalar path
+    for (; i < unCount; i++) {
+        pCoordinates[i] = Evaluate(eEye, pfU[i], pfV[i]);
+    }
+}
+
+void CSampleLensModel::TraceVisibleOutline(EVREye eEye, float flMaxRadius, float *pflX, float *pflY) const
+{
+    // the panel in lens space, the lens centre is assumed to be somewhere on it
+    float flPanelLeft = -m_rgflCenterU[eEye] * 2.0f * m_flAspect;
+    float flPanelRight = (1.0f - m_rgflCenterU[eEye]) * 2.0f * m_flAspect;
+    float flPanelTop = -m_rgflCenterV[eEye] * 2.0f;
+    float flPanelBottom = (1.0f - m_rgflCenterV[eEye]) * 2.0f;
+
+    for (uint32_t i = 0; i < k_unOutlinePoints; i++) {
+        // k_unOutlinePoints is a multiple of 4 so straight left, right, up and down are hit exactly
+        float flAngle = 2.0f * 3.14159265f * i / k_unOutlinePoints;
+        float flDirX = cosf(flAngle);
+        float flDirY = sinf(flAngle);
+
+        float flDistance = 1e9f;
+        if (flDirX > 1e-6f) {
+            flDistance = fminf(flDistance, flPanelRight / flDirX);
+        } else if (flDirX < -1e-6f) {
+            flDistance = fminf(flDistance, flPanelLeft / flDirX);
+        }
+        if (flDirY > 1e-6f) {
+            flDistance = fminf(flDistance, flPanelBottom / flDirY);
+        } else if (flDirY < -1e-6f) {
+            flDistance = fminf(flDistance, flPanelTop / flDirY);
+        }
+        flDistance = fmaxf(flDistance, 0.0f);
+
+        // a pixel stays visible as long as any channel still samples it, so keep the outermost
+        float flBestX = 0.0f, flBestY = 0.0f, flBestR2 = -1.0f;
+        for (uint32_t c = 0; c < SampleLensChannel_Count; c++) {
+            float flX, flY;
+            EvaluateChannel((ESampleLensChannel)c, flDirX * flDistance, flDirY * flDistance, &flX, &flY);
+            float flR2 = flX * flX + flY * flY;
+            if (flR2 > flBestR2) {
+                flBestX = flX;
+                flBestY = flY;
+                flBestR2 = flR2;
+            }
+        }
+
+        if (flMaxRadius > 0.0f && flBestR2 > flMaxRadius * flMaxRadius) {
+            float flScale = flMaxRadius / sqrtf(flBestR2);
+            flBestX *= flScale;
+            flBestY *= flScale;
+        }
+        pflX[i] = flBestX;
+        pflY[i] = flBestY;
+    }
+}
+
+SampleLensBounds_t CSampleLensModel::ComputeVisibleBounds(EVREye eEye, float flMaxRadius) const
+{
+    float rgflX[k_unOutlinePoints];
+    float rgflY[k_unOutlinePoints];
+    TraceVisibleOutline(eEye, flMaxRadius, rgflX, rgflY);
+
+    SampleLensBounds_t bounds = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (uint32_t i = 0; i < k_unOutlinePoints; i++) {
+        bounds.flLeft = fminf(bounds.flLeft, rgflX[i]);
+        bounds.flRight = fmaxf(bounds.flRight, rgflX[i]);
+        bounds.flTop = fminf(bounds.flTop, rgflY[i]);
+        bounds.flBottom = fmaxf(bounds.flBottom, rgflY[i]);
+    }
+    return bounds;
+}
+
+void CSampleLensModel::BuildHiddenAreaMesh(EVREye eEye, float flMaxRadius, std::vector<HmdVector2_t> &vecVertices) const
+{
+    vecVertices.clear();
+
+    float rgflX[k_unOutlinePoints];
+    float rgflY[k_unOutlinePoints];
+    TraceVisibleOutline(eEye, flMaxRadius, rgflX, rgflY);
+
+    // where the ray through every outline point leaves the rendered image
+    float flLeft = -m_rgflOutOffsetU[eEye] / m_rgflOutScaleU[eEye];
+    float flRight = flLeft + 1.0f / m_rgflOutScaleU[eEye];
+    float flTop = -m_rgflOutOffsetV[eEye] / m_rgflOutScaleV[eEye];
+    float flBottom = flTop + 1.0f / m_rgflOutScaleV[eEye];
+    float rgflEdgeX[k_unOutlinePoints];
+    float rgflEdgeY[k_unOutlinePoints];
+    for (uint32_t i = 0; i < k_unOutlinePoints; i++) {
+        float flScale = 1e9f;
+        if (rgflX[i] > 1e-6f) {
+            flScale = fminf(flScale, flRight / rgflX[i]);
+        } else if (rgflX[i] < -1e-6f) {
+            flScale = fminf(flScale, flLeft / rgflX[i]);
+        }
+        if (rgflY[i] > 1e-6f) {
+            flScale = fminf(flScale, flBottom / rgflY[i]);
+        } else if (rgflY[i] < -1e-6f) {
+            flScale = fminf(flScale, flTop / rgflY[i]);
+        }
+        rgflEdgeX[i] = rgflX[i] * flScale;
+        rgflEdgeY[i] = rgflY[i] * flScale;
+    }
+
+    const float rgflCornerX[4] = { flRight, flLeft, flLeft, flRight };
+    const float rgflCornerY[4] = { flBottom, flBottom, flTop, flTop };
+
+    const float flMinArea = 1e-6f;
+    for (uint32_t i = 0; i < k_unOutlinePoints; i++) {
+        uint32_t j = (i + 1) % k_unOutlinePoints;
+
+        // the border between two rays, with the image corner in between if there is one
+        float rgflChainX[3], rgflChainY[3];
+        uint32_t unChain = 0;
+        rgflChainX[unChain] = rgflEdgeX[i];
+        rgflChainY[unChain++] = rgflEdgeY[i];
+        for (uint32_t c = 0; c < 4; c++) {
+            float flCrossStart = rgflEdgeX[i] * rgflCornerY[c] - rgflEdgeY[i] * rgflCornerX[c];
+            float flCrossEnd = rgflCornerX[c] * rgflEdgeY[j] - rgflCornerY[c] * rgflEdgeX[j];
+            if (flCrossStart > 0.0f && flCrossEnd > 0.0f) {
+                rgflChainX[unChain] = rgflCornerX[c];
+                rgflChainY[unChain++] = rgflCornerY[c];
+                break;
+            }
+        }
+        rgflChainX[unChain] = rgflEdgeX[j];
+        rgflChainY[unChain++] = rgflEdgeY[j];
+
+        // fan from the outline point over the border, then close the quad back to the next outline point
+        float rgflTriangles[3][3][2];
+        uint32_t unTriangles = 0;
+        for (uint32_t k = 0; k + 1 < unChain; k++) {
+            float (*pTriangle)[2] = rgflTriangles[unTriangles++];
+            pTriangle[0][0] = rgflX[i];
+            pTriangle[0][1] = rgflY[i];
+            pTriangle[1][0] = rgflChainX[k];
+            pTriangle[1][1] = rgflChainY[k];
+            pTriangle[2][0] = rgflChainX[k + 1];
+            pTriangle[2][1] = rgflChainY[k + 1];
+        }
+        float (*pTriangle)[2] = rgflTriangles[unTriangles++];
+        pTriangle[0][0] = rgflX[i];
+        pTriangle[0][1] = rgflY[i];
+        pTriangle[1][0] = rgflEdgeX[j];
+        pTriangle[1][1] = rgflEdgeY[j];
+        pTriangle[2][0] = rgflX[j];
+        pTriangle[2][1] = rgflY[j];
+
+        for (uint32_t t = 0; t < unTriangles; t++) {
+            float (*p)[2] = rgflTriangles[t];
+            float flArea = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[2][0] - p[0][0]) * (p[1][1] - p[0][1]);
+            if (fabsf(flArea) < flMinArea) {
+                continue;
+            }
+            for (uint32_t v = 0; v < 3; v++) {
+                HmdVector2_t vertex;
+                vertex.v[0] = p[v][0] * m_rgflOutScaleU[eEye] + m_rgflOutOffsetU[eEye];
+                vertex.v[1] = p[v][1] * m_rgflOutScaleV[eEye] + m_rgflOutOffsetV[eEye];
+                vecVertices.push_back(vertex);
+            }
+        }
+    }
+}
+
+void CSampleLensModel::GetCenterMagnification(EVREye eEye, float *pflScaleU, float *pflScaleV) const
+{
+    // central difference of the green channel, small enough to stay in the linear part of any sane lens
+    const float flStep = 1e-3f;
+    float flCenterU = m_rgflCenterU[eEye];
+    float flCenterV = m_rgflCenterV[eEye];
+    DistortionCoordinates_t left = Evaluate(eEye, flCenterU - flStep, flCenterV);
+    DistortionCoordinates_t right = Evaluate(eEye, flCenterU + flStep, flCenterV);
+    DistortionCoordinates_t top = Evaluate(eEye, flCenterU, flCenterV - flStep);
+    DistortionCoordinates_t bottom = Evaluate(eEye, flCenterU, flCenterV + flStep);
+    *pflScaleU = fabsf(right.rfGreen[0] - left.rfGreen[0]) / (2.0f * flStep);
+    *pflScaleV = fabsf(bottom.rfGreen[1] - top.rfGreen[1]) / (2.0f * flStep);
+}
+
+void CSampleLensModel::GetRenderTargetSize(float flEyeWidth, float flEyeHeight, float flQuality, int32_t *pnWidth, int32_t *pnHeight) const
+{
+    // one panel pixel covers 1 / eye pixels of panel UV, the lens stretches that by the magnification,
+    // so that many rendered pixels fit into the image where the lens shows the most detail
+    float flWidth = 0.0f;
+    float flHeight = 0.0f;
+    for (uint32_t unEye = 0; unEye < 2; unEye++) {
+        float flScaleU, flScaleV;
+        GetCenterMagnification((EVREye)unEye, &flScaleU, &flScaleV);
+        if (flScaleU > 1e-3f) {
+            flWidth = fmaxf(flWidth, flEyeWidth / flScaleU);
+        }
+        if (flScaleV > 1e-3f) {
+            flHeight = fmaxf(flHeight, flEyeHeight / flScaleV);
+        }
+    }
+
+    // the central difference is only good to about 1e-5 of the size, which must not round an identity lens up a pixel
+    const float flTolerance = 1.0f - 1e-4f;
+    *pnWidth = (int32_t)ceilf(flWidth * flQuality * flTolerance);
+    *pnHeight = (int32_t)ceilf(flHeight * flQuality * flTolerance);
+    if (*pnWidth <= 0 || *pnHeight <= 0) {
+        *pnWidth = (int32_t)flEyeWidth > 0 ? (int32_t)flEyeWidth : 1;
+        *pnHeight = (int32_t)flEyeHeight > 0 ? (int32_t)flEyeHeight : 1;
+    }
+}
+
+void CSampleLensModel::BakeLut(uint32_t unResolution)
+{
+    if (unResolution < 2) {
+        unResolution = 2;
+    }
+    m_unLutResolution = unResolution;
+
+    uint32_t unPointsPerRow = unResolution + 1;
+    std::vector<float> vecU(unPointsPerRow);
+    std::vector<float> vecV(unPointsPerRow);
+
+    for (uint32_t unEye = 0; unEye < 2; unEye++) {
+        m_vecLut[unEye].resize(unPointsPerRow * unPointsPerRow);
+        for (uint32_t y = 0; y < unPointsPerRow; y++) {
+            for (uint32_t x = 0; x < unPointsPerRow; x++) {
+                vecU[x] = (float)x / unResolution;
+                vecV[x] = (float)y / unResolution;
+            }
+            EvaluateBatch((EVREye)unEye, vecU.data(), vecV.data(), unPointsPerRow, &m_vecLut[unEye][y * unPointsPerRow]);
+        }
+    }
+}
+
+DistortionCoordinates_t CSampleLensModel::Lookup(EVREye eEye, float fU, float fV) const
+{
+    if (m_unLutResolution == 0) {
+        return Evaluate(eEye, fU, fV);
+    }
+
+    // clamp first so truncation is a floor and the cell is always inside the grid
+    float flMax = (float)m_unLutResolution;
+    float flX = fU * flMax;
+    float flY = fV * flMax;
+    flX = flX < 0.0f ? 0.0f : (flX > flMax ? flMax : flX);
+    flY = flY < 0.0f ? 0.0f : (flY > flMax ? flMax : flY);
+    uint32_t unX = (uint32_t)flX;
+    uint32_t unY = (uint32_t)flY;
+    unX = unX < m_unLutResolution ? unX : m_unLutResolution - 1;
+    unY = unY < m_unLutResolution ? unY : m_unLutResolution - 1;
+    float flTx = flX - unX;
+    float flTy = flY - unY;
+
+    uint32_t unPointsPerRow = m_unLutResolution + 1;
+    const float *p00 = (const float *)&m_vecLut[eEye][unY * unPointsPerRow + unX];
+    const float *p10 = (const float *)&m_vecLut[eEye][unY * unPointsPerRow + unX + 1];
+    const float *p01 = (const float *)&m_vecLut[eEye][(unY + 1) * unPointsPerRow + unX];
+    const float *p11 = (const float *)&m_vecLut[eEye][(unY + 1) * unPointsPerRow + unX + 1];
+
+    // DistortionCoordinates_t is just six floats, blend them all the same way
+    DistortionCoordinates_t coordinates;
+    float *pOut = (float *)&coordinates;
+    for (uint32_t i = 0; i < 6; i++) {
+        float flTop = p00[i] + (p10[i] - p00[i]) * flTx;
+        float flBottom = p01[i] + (p11[i] - p01[i]) * flTx;
+        pOut[i] = flTop + (flBottom - flTop) * flTy;
+    }
+    return coordinates;
+}
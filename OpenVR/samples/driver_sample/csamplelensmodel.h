@@ -0,0 +1,118 @@
+#ifndef CSAMPLELENSMODEL_H
+#define CSAMPLELENSMODEL_H
+
+#include <openvr_driver.h>
+
+#include <vector>
+
+enum ESampleLensModel
+{
+    SampleLensModel_None = 0,
+    SampleLensModel_BrownConrady,   // k1 k2 k3 radial, p1 p2 tangential
+    SampleLensModel_Polynomial,     // scale = c0 + c1 r + c2 r^2 + c3 r^3 + c4 r^4
+};
+
+enum ESampleLensChannel
+{
+    SampleLensChannel_Red = 0,
+    SampleLensChannel_Green,
+    SampleLensChannel_Blue,
+    SampleLensChannel_Count
+};
+
+static const uint32_t k_unSampleLensCoefficients = 5;
+
+// a rectangle in lens space, where the lens centre is the origin, +y points down
+// and one unit is half the height of the eye's viewport
+struct SampleLensBounds_t
+{
+    float flLeft;
+    float flRight;
+    float flTop;
+    float flBottom;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Lens distortion with per-channel coefficients (chromatic aberration)
+// and a per-eye lens centre. Maps a UV on the panel to the UV of the rendered
+// image that shows through the lens there. Evaluating the model directly is
+// kept for baking and benchmarking, ComputeDistortion is answered from a grid
+// baked once by BakeLut() with a bilinear lookup.
+//-----------------------------------------------------------------------------
+class CSampleLensModel
+{
+public:
+    CSampleLensModel();
+
+    void SetModel(ESampleLensModel eModel) { m_eModel = eModel; }
+
+    ESampleLensModel GetModel() const { return m_eModel; }
+
+    void SetCoefficients(ESampleLensChannel eChannel, const float rfCoefficients[k_unSampleLensCoefficients]);
+
+    /** offset of the lens centre from the middle of the eye's viewport, in UV */
+    void SetCenterOffset(vr::EVREye eEye, float flOffsetU, float flOffsetV);
+
+    /** width / height of one eye's viewport, so the radius is round on the panel */
+    void SetAspect(float flAspect);
+
+    /** part of lens space the rendered image covers, by default exactly what the panel shows undistorted */
+    void SetOutputBounds(vr::EVREye eEye, const SampleLensBounds_t &bounds);
+
+    /** extents of the panel seen through the lens, cut off at flMaxRadius (the edge of the lens) */
+    SampleLensBounds_t ComputeVisibleBounds(vr::EVREye eEye, float flMaxRadius) const;
+
+    /**
+     * Triangle list in UV of the rendered image covering everything outside the visible
+     * outline, written into vecVertices. Empty when the lens shows the whole image.
+     */
+    void BuildHiddenAreaMesh(vr::EVREye eEye, float flMaxRadius, std::vector<vr::HmdVector2_t> &vecVertices) const;
+
+    /** radius of the lens centre (in UV of the eye's height) at which the distortion is sampled */
+    float GetRadius(vr::EVREye eEye, float fU, float fV) const;
+
+    /** how far the rendered image UV moves per panel UV at the lens centre, where the lens magnifies most finely */
+    void GetCenterMagnification(vr::EVREye eEye, float *pflScaleU, float *pflScaleV) const;
+
+    /** render target per eye that puts one rendered pixel on every panel pixel at the lens centre of either eye, times flQuality */
+    void GetRenderTargetSize(float flEyeWidth, float flEyeHeight, float flQuality, int32_t *pnWidth, int32_t *pnHeight) const;
+
+    void BakeLut(uint32_t unResolution);
+
+    vr::DistortionCoordinates_t Evaluate(vr::EVREye eEye, float fU, float fV) const;
+
+    /** evaluates the model for many points at once, four at a time where SSE2 is there */
+    void EvaluateBatch(vr::EVREye eEye, const float *pfU, const float *pfV, uint32_t unCount, vr::DistortionCoordinates_t *pCoordinates) const;
+
+    /** bilinear lookup in the baked grid, falls back to Evaluate() before BakeLut() */
+    vr::DistortionCoordinates_t Lookup(vr::EVREye eEye, float fU, float fV) const;
+
+private:
+    static const uint32_t k_unOutlinePoints = 64;
+
+    void EvaluateChannel(ESampleLensChannel eChannel, float flX, float flY, float *pflX, float *pflY) const;
+
+    void UpdateOutputTransform(vr::EVREye eEye);
+
+    /** outermost point the panel edge is seen at, for k_unOutlinePoints directions around the lens centre */
+    void TraceVisibleOutline(vr::EVREye eEye, float flMaxRadius, float *pflX, float *pflY) const;
+
+    ESampleLensModel m_eModel;
+    float m_rgflCoefficients[SampleLensChannel_Count][k_unSampleLensCoefficients];
+    float m_rgflCenterU[2];
+    float m_rgflCenterV[2];
+    float m_flAspect;
+
+    // lens space to UV of the rendered image, u = x * scale + offset
+    bool m_rgbHasOutputBounds[2];
+    SampleLensBounds_t m_rgOutputBounds[2];
+    float m_rgflOutScaleU[2];
+    float m_rgflOutOffsetU[2];
+    float m_rgflOutScaleV[2];
+    float m_rgflOutOffsetV[2];
+
+    uint32_t m_unLutResolution;
+    std::vector<vr::DistortionCoordinates_t> m_vecLut[2];
+};
+
+#endif // CSAMPLELENSMODEL_H
@@ -0,0 +1,343 @@
+#if defined(_WINDOWS)
+#include <winsock2.h>
+#include <afunix.h>
+#include <io.h>
+#pragma comment(lib, "ws2_32.lib")
+#define unlink _unlink
+#else
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define closesocket close
+#endif
+
+#include "csamplemetricsserver.h"
+#include "csampledeviceregistry.h"
+#include "csampleeventdispatcher.h"
+#include "csampleudptransport.h"
+
+#include "basics.h"
+#include "csampleframemonitor.h"
+#include "csamplelatencystats.h"
+#include "driverlog.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static const intptr_t k_hInvalidSocket = -1;
+
+// reading the request and writing the answer each get this long, so a stuck client can't hold the server
+static const uint64_t k_ulClientDeadlineNs = 250000000;
+
+// a client that has sent nothing by then is taken to want the bare text
+static const uint64_t k_ulRequestWaitNs = 50000000;
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+static bool SetNonBlocking(intptr_t hSocket)
+{
+#if defined(_WINDOWS)
+    u_long unMode = 1;
+    return ioctlsocket((SOCKET)hSocket, FIONBIO, &unMode) == 0;
+#else
+    int nFlags = fcntl((int)hSocket, F_GETFL, 0);
+    return nFlags >= 0 && fcntl((int)hSocket, F_SETFL, nFlags | O_NONBLOCK) == 0;
+#endif
+}
+
+/** waits until the socket is readable (or writable), at most ulTimeoutNs */
+static bool WaitForSocket(intptr_t hSocket, bool bWrite, uint64_t ulTimeoutNs)
+{
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(hSocket, &set);
+    timeval timeout;
+    timeout.tv_sec = (long)(ulTimeoutNs / 1000000000);
+    timeout.tv_usec = (long)(ulTimeoutNs % 1000000000 / 1000);
+    return select((int)hSocket + 1, bWrite ? NULL : &set, bWrite ? &set : NULL, NULL, &timeout) > 0;
+}
+
+static void AppendFormat(std::string &sOut, const char *pchFormat, ...)
+{
+    char rgchLine[512];
+    va_list args;
+    va_start(args, pchFormat);
+    int nWritten = vsnprintf(rgchLine, sizeof(rgchLine), pchFormat, args);
+    va_end(args);
+    if (nWritten > 0) {
+        sOut.append(rgchLine, (size_t)nWritten < sizeof(rgchLine) ? (size_t)nWritten : sizeof(rgchLine) - 1);
+    }
+}
+
+static void AppendHeader(std::string &sOut, const char *pchName, const char *pchType, const char *pchHelp)
+{
+    AppendFormat(sOut, "# HELP %s %s\n# TYPE %s %s\n", pchName, pchHelp, pchName, pchType);
+}
+
+// label values may contain anything the settings allow, the format wants \, " and newlines escaped
+static std::string EscapeLabel(const char *pchValue)
+{
+    std::string sOut;
+    for (const char *pch = pchValue; *pch; pch++) {
+        if (*pch == '\\' || *pch == '"') {
+            sOut += '\\';
+            sOut += *pch;
+        } else if (*pch == '\n') {
+            sOut += "\\n";
+        } else {
+            sOut += *pch;
+        }
+    }
+    return sOut;
+}
+
+static const char *GetDeviceClassLabel(vr::ETrackedDeviceClass eClass)
+{
+    switch (eClass) {
+    case vr::TrackedDeviceClass_HMD:
+        return "hmd";
+    case vr::TrackedDeviceClass_Controller:
+        return "controller";
+    case vr::TrackedDeviceClass_GenericTracker:
+        return "tracker";
+    default:
+        return "other";
+    }
+}
+
+CSampleMetricsServer::CSampleMetricsServer()
+    : m_bRunning(false)
+{
+    m_pTransport = nullptr;
+    m_pEventDispatcher = nullptr;
+    m_hSocket = k_hInvalidSocket;
+    m_pThread = nullptr;
+}
+
+CSampleMetricsServer::~CSampleMetricsServer()
+{
+    Stop();
+}
+
+bool CSampleMetricsServer::Start(const char *pchPath, const CSampleDeviceRegistry *pRegistry, const CSampleUdpTransport *pTransport,
+    const CSampleEventDispatcher *pEventDispatcher)
+{
+    if (m_pThread || !pchPath || !*pchPath) {
+        return false;
+    }
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(pchPath) >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memcpy(addr.sun_path, pchPath, strlen(pchPath));
+
+#if defined(_WINDOWS)
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+#endif
+
+    // a socket file left over from a driver that didn't shut down would fail the bind
+    unlink(pchPath);
+    intptr_t hSocket = (intptr_t)socket(AF_UNIX, SOCK_STREAM, 0);
+    if (hSocket == k_hInvalidSocket || bind(hSocket, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(hSocket, 4) != 0 || !SetNonBlocking(hSocket)) {
+        if (hSocket != k_hInvalidSocket) {
+            closesocket(hSocket);
+        }
+#if defined(_WINDOWS)
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    m_vecDevices.clear();
+    m_vecDeviceLabels.clear();
+    for (uint32_t i = 0; i < pRegistry->GetDeviceCount(); i++) {
+        const CSampleTrackedDevice *pDevice = pRegistry->GetDevice(i);
+        m_vecDevices.push_back(pDevice);
+        m_vecDeviceLabels.push_back("serial=\"" + EscapeLabel(pDevice->GetSerialNumber().c_str()) + "\",class=\"" + GetDeviceClassLabel(pDevice->GetDeviceClass()) + "\"");
+    }
+
+    m_pTransport = pTransport;
+    m_pEventDispatcher = pEventDispatcher;
+    m_sPath = pchPath;
+    m_hSocket = hSocket;
+    m_bRunning = true;
+    m_pThread = new std::thread(&CSampleMetricsServer::ThreadFunction, this);
+    DRIVERLOG_INFO(DriverLogCategory_General, "driver_null: serving metrics on %s\n", pchPath);
+    return true;
+}
+
+void CSampleMetricsServer::Stop()
+{
+    m_bRunning = false;
+    if (m_pThread) {
+        m_pThread->join();
+        delete m_pThread;
+        m_pThread = nullptr;
+    }
+    if (m_hSocket != k_hInvalidSocket) {
+        closesocket(m_hSocket);
+        m_hSocket = k_hInvalidSocket;
+        unlink(m_sPath.c_str());
+#if defined(_WINDOWS)
+        WSACleanup();
+#endif
+    }
+}
+
+void CSampleMetricsServer::FormatMetrics(std::string &sOut) const
+{
+    SampleFrameMonitorCounters_t frames;
+    GetSampleFrameMonitorCounters(&frames);
+    AppendHeader(sOut, "diy_driver_frames_total", "counter", "RunFrame calls from SteamVR.");
+    AppendFormat(sOut, "diy_driver_frames_total %llu\n", (unsigned long long)frames.ulFrames);
+    AppendHeader(sOut, "diy_driver_frame_stalls_total", "counter", "Gaps between RunFrame calls above runFrameStallMs, by who held the thread.");
+    AppendFormat(sOut, "diy_driver_frame_stalls_total{cause=\"host\"} %llu\n", (unsigned long long)frames.ulHostStalls);
+    AppendFormat(sOut, "diy_driver_frame_stalls_total{cause=\"driver\"} %llu\n", (unsigned long long)(frames.ulStalls - frames.ulHostStalls));
+    AppendHeader(sOut, "diy_driver_frame_interval_max_seconds", "gauge", "Longest gap between two RunFrame calls.");
+    AppendFormat(sOut, "diy_driver_frame_interval_max_seconds %.6f\n", frames.ulMaxIntervalNs * 1e-9);
+
+    AppendHeader(sOut, "diy_driver_device_connected", "gauge", "1 while the device's transport delivers data.");
+    for (size_t i = 0; i < m_vecDevices.size(); i++) {
+        AppendFormat(sOut, "diy_driver_device_connected{%s} %d\n", m_vecDeviceLabels[i].c_str(), m_vecDevices[i]->IsConnected() ? 1 : 0);
+    }
+    AppendHeader(sOut, "diy_driver_poses_submitted_total", "counter", "Poses handed to SteamVR, the rate of this is the pose rate.");
+    for (size_t i = 0; i < m_vecDevices.size(); i++) {
+        AppendFormat(sOut, "diy_driver_poses_submitted_total{%s} %llu\n", m_vecDeviceLabels[i].c_str(), (unsigned long long)m_vecDevices[i]->GetPosesSubmitted());
+    }
+
+    SampleTransportCounters_t transport;
+    m_pTransport->GetCounters(&transport);
+    AppendHeader(sOut, "diy_driver_transport_datagrams_total", "counter", "Datagrams received by the UDP transport.");
+    AppendFormat(sOut, "diy_driver_transport_datagrams_total %llu\n", (unsigned long long)transport.ulDatagrams);
+    AppendHeader(sOut, "diy_driver_transport_packets_total", "counter", "Pose and heartbeat packets decoded.");
+    AppendFormat(sOut, "diy_driver_transport_packets_total %llu\n", (unsigned long long)transport.ulPackets);
+    AppendHeader(sOut, "diy_driver_transport_dropped_packets_total", "counter", "Packets that never reached a device.");
+    AppendFormat(sOut, "diy_driver_transport_dropped_packets_total{reason=\"unknown_slot\"} %llu\n", (unsigned long long)transport.ulUnknownSlot);
+    AppendFormat(sOut, "diy_driver_transport_dropped_packets_total{reason=\"sequence_gap\"} %llu\n", (unsigned long long)transport.ulSequenceGaps);
+    AppendFormat(sOut, "diy_driver_transport_dropped_packets_total{reason=\"bad_pose\"} %llu\n", (unsigned long long)transport.ulRejectedPoses);
+    AppendHeader(sOut, "diy_driver_transport_malformed_datagrams_total", "counter", "Datagrams with trailing bytes that were not a packet.");
+    AppendFormat(sOut, "diy_driver_transport_malformed_datagrams_total %llu\n", (unsigned long long)transport.ulTrailingBytes);
+    AppendHeader(sOut, "diy_driver_transport_restart_failures_total", "counter", "Times the transport port couldn't be opened again after standby.");
+    AppendFormat(sOut, "diy_driver_transport_restart_failures_total %llu\n", (unsigned long long)transport.ulRestartFailures);
+
+    SampleEventStats_t rgEventStats[CSampleEventDispatcher::k_unMaxEventStats];
+    uint32_t unEventStats = m_pEventDispatcher->GetEventStats(rgEventStats, CSampleEventDispatcher::k_unMaxEventStats);
+    AppendHeader(sOut, "diy_driver_events_total", "counter", "Server events dispatched, by event type (0 when the type table overflowed).");
+    for (uint32_t i = 0; i < unEventStats; i++) {
+        AppendFormat(sOut, "diy_driver_events_total{type=\"%u\"} %llu\n", rgEventStats[i].unEventType, (unsigned long long)rgEventStats[i].ulCount);
+    }
+    AppendHeader(sOut, "diy_driver_event_seconds_total", "counter", "Time spent dispatching server events, by event type.");
+    for (uint32_t i = 0; i < unEventStats; i++) {
+        AppendFormat(sOut, "diy_driver_event_seconds_total{type=\"%u\"} %.9f\n", rgEventStats[i].unEventType, rgEventStats[i].ulTotalNs * 1e-9);
+    }
+    AppendHeader(sOut, "diy_driver_event_max_seconds", "gauge", "Longest dispatch of one server event, by event type.");
+    for (uint32_t i = 0; i < unEventStats; i++) {
+        AppendFormat(sOut, "diy_driver_event_max_seconds{type=\"%u\"} %.9f\n", rgEventStats[i].unEventType, rgEventStats[i].ulMaxNs * 1e-9);
+    }
+
+    AppendHeader(sOut, "diy_driver_log_queue_depth", "gauge", "Log lines waiting for the log thread.");
+    AppendFormat(sOut, "diy_driver_log_queue_depth %llu\n", (unsigned long long)GetDriverLogQueueDepth());
+    AppendHeader(sOut, "diy_driver_log_dropped_total", "counter", "Log lines dropped because the queue was full.");
+    AppendFormat(sOut, "diy_driver_log_dropped_total %llu\n", (unsigned long long)GetDriverLogDropped());
+
+    AppendHeader(sOut, "diy_driver_latency_seconds", "summary", "Always-on latency histograms, the same as the stats debug request.");
+    for (uint32_t i = 0; i < SampleLatencyStage_Count; i++) {
+        SampleLatencySummary_t summary;
+        GetSampleLatencyStats((ESampleLatencyStage)i).GetSummary(&summary);
+        const char *pchStage = GetSampleLatencyStageName((ESampleLatencyStage)i);
+        const char *const rgpchQuantiles[4] = { "0.5", "0.9", "0.99", "0.999" };
+        const uint64_t rgulValues[4] = { summary.ulP50Ns, summary.ulP90Ns, summary.ulP99Ns, summary.ulP999Ns };
+        for (uint32_t q = 0; q < 4; q++) {
+            AppendFormat(sOut, "diy_driver_latency_seconds{stage=\"%s\",quantile=\"%s\"} %.9f\n", pchStage, rgpchQuantiles[q], rgulValues[q] * 1e-9);
+        }
+        AppendFormat(sOut, "diy_driver_latency_seconds_sum{stage=\"%s\"} %.9f\n", pchStage, summary.ulTotalNs * 1e-9);
+        AppendFormat(sOut, "diy_driver_latency_seconds_count{stage=\"%s\"} %llu\n", pchStage, (unsigned long long)summary.ulCount);
+    }
+}
+
+void CSampleMetricsServer::ServeClient(intptr_t hClient)
+{
+    uint64_t ulStart = GetTimestampNs();
+    uint64_t ulDeadline = ulStart + k_ulClientDeadlineNs;
+
+    // only the request line matters, the rest of an HTTP request is read so the client doesn't get a reset
+    char rgchRequest[2048];
+    rgchRequest[0] = 0;
+    uint32_t cbRequest = 0;
+    for (;;) {
+        uint64_t ulNow = GetTimestampNs();
+        uint32_t cbPrefix = cbRequest < 4 ? cbRequest : 4;
+        bool bHttp = !memcmp(rgchRequest, "GET ", cbPrefix);
+        if (ulNow >= ulDeadline || (cbRequest == 0 && ulNow - ulStart >= k_ulRequestWaitNs) || !bHttp) {
+            break;
+        }
+        if (cbRequest > 0 && strstr(rgchRequest, "\r\n\r\n")) {
+            break;
+        }
+        if (cbRequest + 1 >= sizeof(rgchRequest)) {
+            break;
+        }
+        uint64_t ulWait = cbRequest == 0 ? ulStart + k_ulRequestWaitNs - ulNow : ulDeadline - ulNow;
+        if (!WaitForSocket(hClient, false, ulWait)) {
+            continue;
+        }
+        int cbReceived = (int)recv(hClient, rgchRequest + cbRequest, (int)(sizeof(rgchRequest) - 1 - cbRequest), 0);
+        if (cbReceived <= 0) {
+            break;
+        }
+        cbRequest += (uint32_t)cbReceived;
+        rgchRequest[cbRequest] = 0;
+    }
+
+    std::string sBody;
+    FormatMetrics(sBody);
+    std::string sResponse;
+    if (cbRequest >= 4 && !memcmp(rgchRequest, "GET ", 4)) {
+        AppendFormat(sResponse, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %u\r\nConnection: close\r\n\r\n", (uint32_t)sBody.size());
+    }
+    sResponse += sBody;
+
+    size_t cbSent = 0;
+    ulDeadline = GetTimestampNs() + k_ulClientDeadlineNs;
+    while (cbSent < sResponse.size()) {
+        uint64_t ulNow = GetTimestampNs();
+        if (ulNow >= ulDeadline || !WaitForSocket(hClient, true, ulDeadline - ulNow)) {
+            DRIVERLOG_VERBOSE(DriverLogCategory_General, "driver_null: metrics client too slow, dropped it\n");
+            break;
+        }
+        int nSent = (int)send(hClient, sResponse.data() + cbSent, (int)(sResponse.size() - cbSent), MSG_NOSIGNAL);
+        if (nSent <= 0) {
+            break;
+        }
+        cbSent += (size_t)nSent;
+    }
+}
+
+void CSampleMetricsServer::ThreadFunction()
+{
+    while (m_bRunning) {
+        // wake up regularly so Stop() never waits long for the thread
+        if (!WaitForSocket(m_hSocket, false, 100000000)) {
+            continue;
+        }
+        intptr_t hClient = (intptr_t)accept(m_hSocket, NULL, NULL);
+        if (hClient == k_hInvalidSocket) {
+            continue;
+        }
+        if (SetNonBlocking(hClient)) {
+            ServeClient(hClient);
+        }
+        closesocket(hClient);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CSAMPLEMETRICSSERVER_H
+#define CSAMPLEMETRICSSERVER_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CSampleDeviceRegistry;
+class CSampleEventDispatcher;
+class CSampleTrackedDevice;
+class CSampleUdpTransport;
+
+//-----------------------------------------------------------------------------
+// Purpose: Serves the driver's counters and latency histograms in the
+// Prometheus text exposition format on a Unix domain socket. A client that
+// sends an HTTP GET gets an HTTP response, anything else (or silence) gets
+// the bare text, so `nc -U` works as well as a scraping proxy. The server
+// thread polls with timeouts and only reads values the hot paths publish
+// through atomics; it never takes a lock they take.
+//-----------------------------------------------------------------------------
+class CSampleMetricsServer
+{
+public:
+    CSampleMetricsServer();
+
+    ~CSampleMetricsServer();
+
+    /** creates the socket at pchPath, replacing a stale one. The registry's devices must outlive Stop() */
+    bool Start(const char *pchPath, const CSampleDeviceRegistry *pRegistry, const CSampleUdpTransport *pTransport,
+        const CSampleEventDispatcher *pEventDispatcher);
+
+    void Stop();
+
+    /** the whole exposition text, also used by the server thread for every scrape */
+    void FormatMetrics(std::string &sOut) const;
+
+private:
+    void ThreadFunction();
+
+    void ServeClient(intptr_t hClient);
+
+    // copied at Start, the device list doesn't change while the server runs
+    std::vector<const CSampleTrackedDevice *> m_vecDevices;
+    std::vector<std::string> m_vecDeviceLabels;
+
+    const CSampleUdpTransport *m_pTransport;
+    const CSampleEventDispatcher *m_pEventDispatcher;
+    std::string m_sPath;
+    intptr_t m_hSocket;
+    std::thread *m_pThread;
+    std::atomic<bool> m_bRunning;
+};
+
+#endif // CSAMPLEMETRICSSERVER_H
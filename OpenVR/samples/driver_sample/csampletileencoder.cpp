@@ -0,0 +1,263 @@
+#include "csampletileencoder.h"
+
+#include "basics.h"
+
+#include <string.h>
+
+// op codes of the intra codec, the top two bits select the short ones
+static const uint8_t k_unOpIndex = 0x00;  // 00iiiiii  pixel from the hash table
+static const uint8_t k_unOpDiff = 0x40;   // 01rrggbb  small difference to the previous pixel, bias 2
+static const uint8_t k_unOpLuma = 0x80;   // 10gggggg rrrrbbbb  green difference bias 32, red and blue relative to it bias 8
+static const uint8_t k_unOpRun = 0xC0;    // 11nnnnnn  previous pixel n + 1 times, up to 62
+static const uint8_t k_unOpRgb = 0xFE;
+static const uint8_t k_unOpRgba = 0xFF;
+static const uint8_t k_unOpMask = 0xC0;
+
+static inline uint32_t HashPixel(const uint8_t *p)
+{
+    return (p[0] * 3 + p[1] * 5 + p[2] * 7 + p[3] * 11) & 63;
+}
+
+size_t EncodeSampleTileIntra(const uint8_t *pRgba, uint32_t unStride, uint32_t unWidth, uint32_t unHeight, uint8_t *pData)
+{
+    uint8_t rgIndex[64][4];
+    memset(rgIndex, 0, sizeof(rgIndex));
+    uint8_t rgPrevious[4] = { 0, 0, 0, 255 };
+    uint8_t *pOut = pData;
+    uint32_t unRun = 0;
+
+    for (uint32_t y = 0; y < unHeight; y++) {
+        const uint8_t *p = pRgba + (size_t)y * unStride;
+        for (uint32_t x = 0; x < unWidth; x++, p += 4) {
+            if (!memcmp(p, rgPrevious, 4)) {
+                unRun++;
+                if (unRun == 62) {
+                    *pOut++ = k_unOpRun | (uint8_t)(unRun - 1);
+                    unRun = 0;
+                }
+                continue;
+            }
+            if (unRun) {
+                *pOut++ = k_unOpRun | (uint8_t)(unRun - 1);
+                unRun = 0;
+            }
+
+            uint32_t unHash = HashPixel(p);
+            if (!memcmp(rgIndex[unHash], p, 4)) {
+                *pOut++ = k_unOpIndex | (uint8_t)unHash;
+            } else if (p[3] == rgPrevious[3]) {
+                int8_t nDiffR = (int8_t)(p[0] - rgPrevious[0]);
+                int8_t nDiffG = (int8_t)(p[1] - rgPrevious[1]);
+                int8_t nDiffB = (int8_t)(p[2] - rgPrevious[2]);
+                int8_t nDiffRG = (int8_t)(nDiffR - nDiffG);
+                int8_t nDiffBG = (int8_t)(nDiffB - nDiffG);
+                if (nDiffR >= -2 && nDiffR <= 1 && nDiffG >= -2 && nDiffG <= 1 && nDiffB >= -2 && nDiffB <= 1) {
+                    *pOut++ = k_unOpDiff | (uint8_t)((nDiffR + 2) << 4 | (nDiffG + 2) << 2 | (nDiffB + 2));
+                } else if (nDiffG >= -32 && nDiffG <= 31 && nDiffRG >= -8 && nDiffRG <= 7 && nDiffBG >= -8 && nDiffBG <= 7) {
+                    *pOut++ = k_unOpLuma | (uint8_t)(nDiffG + 32);
+                    *pOut++ = (uint8_t)((nDiffRG + 8) << 4 | (nDiffBG + 8));
+                } else {
+                    *pOut++ = k_unOpRgb;
+                    *pOut++ = p[0];
+                    *pOut++ = p[1];
+                    *pOut++ = p[2];
+                }
+            } else {
+                *pOut++ = k_unOpRgba;
+                memcpy(pOut, p, 4);
+                pOut += 4;
+            }
+            memcpy(rgIndex[unHash], p, 4);
+            memcpy(rgPrevious, p, 4);
+        }
+    }
+    if (unRun) {
+        *pOut++ = k_unOpRun | (uint8_t)(unRun - 1);
+    }
+    return (size_t)(pOut - pData);
+}
+
+bool DecodeSampleTileIntra(const uint8_t *pData, size_t cbData, uint8_t *pRgba, uint32_t unStride, uint32_t unWidth, uint32_t unHeight)
+{
+    uint8_t rgIndex[64][4];
+    memset(rgIndex, 0, sizeof(rgIndex));
+    uint8_t rgPixel[4] = { 0, 0, 0, 255 };
+    const uint8_t *pIn = pData;
+    const uint8_t *pEnd = pData + cbData;
+    uint32_t unRun = 0;
+
+    for (uint32_t y = 0; y < unHeight; y++) {
+        uint8_t *p = pRgba + (size_t)y * unStride;
+        for (uint32_t x = 0; x < unWidth; x++, p += 4) {
+            if (unRun) {
+                unRun--;
+                memcpy(p, rgPixel, 4);
+                continue;
+            }
+            if (pIn >= pEnd) {
+                return false;
+            }
+
+            uint8_t unOp = *pIn++;
+            if (unOp == k_unOpRgb) {
+                if (pEnd - pIn < 3) {
+                    return false;
+                }
+                memcpy(rgPixel, pIn, 3);
+                pIn += 3;
+            } else if (unOp == k_unOpRgba) {
+                if (pEnd - pIn < 4) {
+                    return false;
+                }
+                memcpy(rgPixel, pIn, 4);
+                pIn += 4;
+            } else if ((unOp & k_unOpMask) == k_unOpIndex) {
+                memcpy(rgPixel, rgIndex[unOp], 4);
+            } else if ((unOp & k_unOpMask) == k_unOpDiff) {
+                rgPixel[0] += ((unOp >> 4) & 3) - 2;
+                rgPixel[1] += ((unOp >> 2) & 3) - 2;
+                rgPixel[2] += (unOp & 3) - 2;
+            } else if ((unOp & k_unOpMask) == k_unOpLuma) {
+                if (pIn >= pEnd) {
+                    return false;
+                }
+                int nDiffG = (unOp & 0x3F) - 32;
+                rgPixel[0] += nDiffG + ((*pIn >> 4) & 0x0F) - 8;
+                rgPixel[1] += nDiffG;
+                rgPixel[2] += nDiffG + (*pIn & 0x0F) - 8;
+                pIn++;
+            } else {
+                // this pixel plus the rest of the run
+                unRun = unOp & 0x3F;
+            }
+            memcpy(rgIndex[HashPixel(rgPixel)], rgPixel, 4);
+            memcpy(p, rgPixel, 4);
+        }
+    }
+    return unRun == 0;
+}
+
+CSampleTileEncoder::CSampleTileEncoder()
+{
+    m_unTileSize = 0;
+    m_unWidth = 0;
+    m_unHeight = 0;
+    m_pRgba = nullptr;
+    m_unStride = 0;
+    ResetStats();
+}
+
+CSampleTileEncoder::~CSampleTileEncoder()
+{
+    Stop();
+}
+
+void CSampleTileEncoder::Start(uint32_t unThreads, uint32_t unTileSize)
+{
+    m_workerPool.Stop();
+    m_workerPool.Start(unThreads, -1);
+    m_unTileSize = unTileSize > 0 ? unTileSize : 1;
+    m_unWidth = 0;
+    m_unHeight = 0;
+    m_vecTiles.clear();
+    ResetStats();
+}
+
+void CSampleTileEncoder::Stop()
+{
+    m_workerPool.Stop();
+}
+
+void CSampleTileEncoder::ResetStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void CSampleTileEncoder::LayoutTiles(uint32_t unWidth, uint32_t unHeight)
+{
+    m_unWidth = unWidth;
+    m_unHeight = unHeight;
+    m_vecTiles.clear();
+
+    // tiles never straddle the two eyes
+    uint32_t unEyeWidth = unWidth / 2;
+    for (uint32_t unEye = 0; unEye < 2; unEye++) {
+        uint32_t unEyeX = unEye * unEyeWidth;
+        uint32_t unEyeEnd = unEye == 0 ? unEyeWidth : unWidth;
+        for (uint32_t y = 0; y < unHeight; y += m_unTileSize) {
+            for (uint32_t x = unEyeX; x < unEyeEnd; x += m_unTileSize) {
+                Tile_t tile;
+                tile.unX = (uint16_t)x;
+                tile.unY = (uint16_t)y;
+                tile.unWidth = (uint16_t)(x + m_unTileSize < unEyeEnd ? m_unTileSize : unEyeEnd - x);
+                tile.unHeight = (uint16_t)(y + m_unTileSize < unHeight ? m_unTileSize : unHeight - y);
+                tile.cbEncoded = 0;
+                m_vecTiles.push_back(tile);
+                m_vecTiles.back().vecData.resize(GetSampleTileMaxBytes(tile.unWidth * tile.unHeight));
+            }
+        }
+    }
+}
+
+void CSampleTileEncoder::EncodeTileChunk(void *pContext, uint32_t unChunk)
+{
+    CSampleTileEncoder *pEncoder = (CSampleTileEncoder *)pContext;
+    Tile_t &tile = pEncoder->m_vecTiles[unChunk];
+    const uint8_t *pOrigin = pEncoder->m_pRgba + (size_t)tile.unY * pEncoder->m_unStride + tile.unX * 4;
+    tile.cbEncoded = EncodeSampleTileIntra(pOrigin, pEncoder->m_unStride, tile.unWidth, tile.unHeight, tile.vecData.data());
+}
+
+void CSampleTileEncoder::EncodeFrame(uint64_t ulFrameId, uint64_t ulTimestampNs, const uint8_t *pRgba, uint32_t unStride, uint32_t unWidth, uint32_t unHeight, ISampleTileSink *pSink)
+{
+    // the buffers only get allocated when the frame size changes
+    if (unWidth != m_unWidth || unHeight != m_unHeight) {
+        LayoutTiles(unWidth, unHeight);
+    }
+    if (m_vecTiles.empty()) {
+        return;
+    }
+
+    uint64_t ulStart = GetTimestampNs();
+    m_pRgba = pRgba;
+    m_unStride = unStride;
+    m_workerPool.ParallelFor((uint32_t)m_vecTiles.size(), EncodeTileChunk, this);
+    m_pRgba = nullptr;
+    uint64_t ulEncoded = GetTimestampNs();
+
+    SampleTileFragment_t header;
+    memset(&header, 0, sizeof(header));
+    header.unMagic = k_unSampleTileMagic;
+    header.unFrameId = (uint32_t)ulFrameId;
+    header.unTileCount = (uint16_t)m_vecTiles.size();
+    header.unCodec = k_unSampleTileCodec_Intra;
+    for (size_t i = 0; i < m_vecTiles.size(); i++) {
+        const Tile_t &tile = m_vecTiles[i];
+        header.unTileIndex = (uint16_t)i;
+        header.unX = tile.unX;
+        header.unY = tile.unY;
+        header.unWidth = tile.unWidth;
+        header.unHeight = tile.unHeight;
+        header.unTileBytes = (uint32_t)tile.cbEncoded;
+        header.unOffset = 0;
+        header.unFragmentBytes = (uint32_t)tile.cbEncoded;
+        if (!pSink->WriteTile(header, tile.vecData.data())) {
+            m_stats.ulSinkErrors++;
+        }
+        m_stats.ulEncodedBytes += tile.cbEncoded;
+    }
+    pSink->EndFrame();
+
+    uint64_t ulDone = GetTimestampNs();
+    uint64_t ulEncodeNs = ulEncoded - ulStart;
+    uint64_t ulLatencyNs = ulDone > ulTimestampNs ? ulDone - ulTimestampNs : 0;
+    m_stats.ulFrames++;
+    m_stats.ulRawBytes += (uint64_t)unWidth * unHeight * 4;
+    m_stats.ulEncodeNsTotal += ulEncodeNs;
+    m_stats.ulLatencyNsTotal += ulLatencyNs;
+    if (ulEncodeNs > m_stats.ulEncodeNsMax) {
+        m_stats.ulEncodeNsMax = ulEncodeNs;
+    }
+    if (ulLatencyNs > m_stats.ulLatencyNsMax) {
+        m_stats.ulLatencyNsMax = ulLatencyNs;
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef CSAMPLETILEENCODER_H
+#define CSAMPLETILEENCODER_H
+
+#include "csampleworkerpool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Header in front of every encoded tile, or every piece of one when a sink has to
+// split it. Little endian. The tiles of a frame don't cross the middle of the side
+// by side frame, so a client can decode the eyes independently.
+#pragma pack(push, 1)
+struct SampleTileFragment_t
+{
+    uint32_t unMagic;
+    uint32_t unFrameId;          // low bits of the compositor frame id
+    uint16_t unTileIndex;
+    uint16_t unTileCount;        // tiles of this frame
+    uint16_t unX;                // tile rectangle in the side by side frame
+    uint16_t unY;
+    uint16_t unWidth;
+    uint16_t unHeight;
+    uint32_t unTileBytes;        // encoded size of the whole tile
+    uint32_t unOffset;           // of this piece in the encoded tile
+    uint32_t unFragmentBytes;    // payload following this header
+    uint8_t unCodec;
+    uint8_t unReserved[3];
+};
+#pragma pack(pop)
+
+static const uint32_t k_unSampleTileMagic = 0x54594944; // "DIYT"
+
+// lossless, one byte per run or small difference, five per pixel at worst (QOI style)
+static const uint8_t k_unSampleTileCodec_Intra = 1;
+
+/** worst case encoded size of a tile of unPixels pixels */
+inline size_t GetSampleTileMaxBytes(uint32_t unPixels) { return (size_t)unPixels * 5; }
+
+/** encodes an RGBA rectangle with stride unStride in bytes, returns the bytes written to pData */
+size_t EncodeSampleTileIntra(const uint8_t *pRgba, uint32_t unStride, uint32_t unWidth, uint32_t unHeight, uint8_t *pData);
+
+/** decodes a tile into an RGBA rectangle, returns false if the data is short or malformed */
+bool DecodeSampleTileIntra(const uint8_t *pData, size_t cbData, uint8_t *pRgba, uint32_t unStride, uint32_t unWidth, uint32_t unHeight);
+
+//-----------------------------------------------------------------------------
+// Purpose: Where encoded tiles go. WriteTile() is called once per tile in tile
+// order from the thread that called EncodeFrame(), so sinks don't need to be
+// thread safe.
+//-----------------------------------------------------------------------------
+class ISampleTileSink
+{
+public:
+    virtual ~ISampleTileSink() {}
+
+    virtual bool WriteTile(const SampleTileFragment_t &tile, const uint8_t *pData) = 0;
+
+    /** after the last tile of a frame */
+    virtual void EndFrame() {}
+};
+
+// counters since Start() or the last ResetStats()
+struct SampleEncoderStats_t
+{
+    uint64_t ulFrames;
+    uint64_t ulRawBytes;
+    uint64_t ulEncodedBytes;
+    uint64_t ulEncodeNsTotal;    // splitting and encoding the tiles
+    uint64_t ulEncodeNsMax;
+    uint64_t ulLatencyNsTotal;   // from the frame's timestamp until the sink had every tile
+    uint64_t ulLatencyNsMax;
+    uint64_t ulSinkErrors;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Streams side by side RGBA frames as independently coded tiles. Each
+// eye is cut into square tiles which the worker pool encodes in parallel, every
+// tile into a buffer of its own that is sized for the worst case once and
+// reused for every frame, so encoding a frame allocates nothing. The finished
+// tiles then go to the sink in order.
+//-----------------------------------------------------------------------------
+class CSampleTileEncoder
+{
+public:
+    CSampleTileEncoder();
+
+    ~CSampleTileEncoder();
+
+    /** unThreads extra encoding threads, unTileSize pixels per tile side */
+    void Start(uint32_t unThreads, uint32_t unTileSize);
+
+    void Stop();
+
+    /** encodes one frame and hands it to pSink, ulTimestampNs (GetTimestampNs() based) is where the latency counts from */
+    void EncodeFrame(uint64_t ulFrameId, uint64_t ulTimestampNs, const uint8_t *pRgba, uint32_t unStride, uint32_t unWidth, uint32_t unHeight, ISampleTileSink *pSink);
+
+    void GetStats(SampleEncoderStats_t *pStats) const { *pStats = m_stats; }
+
+    void ResetStats();
+
+private:
+    struct Tile_t
+    {
+        uint16_t unX;
+        uint16_t unY;
+        uint16_t unWidth;
+        uint16_t unHeight;
+        size_t cbEncoded;
+        std::vector<uint8_t> vecData;
+    };
+
+    static void EncodeTileChunk(void *pContext, uint32_t unChunk);
+
+    void LayoutTiles(uint32_t unWidth, uint32_t unHeight);
+
+    CSampleWorkerPool m_workerPool;
+    uint32_t m_unTileSize;
+    uint32_t m_unWidth;
+    uint32_t m_unHeight;
+    std::vector<Tile_t> m_vecTiles;
+
+    // the frame being encoded, for the chunks
+    const uint8_t *m_pRgba;
+    uint32_t m_unStride;
+
+    SampleEncoderStats_t m_stats;
+};
+
+#endif // CSAMPLETILEENCODER_H
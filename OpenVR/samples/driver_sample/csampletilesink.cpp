@@ -0,0 +1,146 @@
+#if defined(_WINDOWS)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define closesocket close
+#endif
+
+#include "csampletilesink.h"
+
+#include <string.h>
+
+static const intptr_t k_hInvalidSocket = -1;
+
+CSampleFileTileSink::CSampleFileTileSink()
+{
+    m_pFile = nullptr;
+}
+
+CSampleFileTileSink::~CSampleFileTileSink()
+{
+    Close();
+}
+
+bool CSampleFileTileSink::Open(const char *pchPath)
+{
+    Close();
+    m_pFile = fopen(pchPath, "wb");
+    return m_pFile != nullptr;
+}
+
+void CSampleFileTileSink::Close()
+{
+    if (m_pFile) {
+        fclose(m_pFile);
+        m_pFile = nullptr;
+    }
+}
+
+bool CSampleFileTileSink::WriteTile(const SampleTileFragment_t &tile, const uint8_t *pData)
+{
+    if (!m_pFile) {
+        return false;
+    }
+    return fwrite(&tile, sizeof(tile), 1, m_pFile) == 1 &&
+        (tile.unFragmentBytes == 0 || fwrite(pData, tile.unFragmentBytes, 1, m_pFile) == 1);
+}
+
+void CSampleFileTileSink::EndFrame()
+{
+    if (m_pFile) {
+        fflush(m_pFile);
+    }
+}
+
+CSampleUdpTileSink::CSampleUdpTileSink()
+{
+    m_hSocket = k_hInvalidSocket;
+    m_ulDatagrams = 0;
+}
+
+CSampleUdpTileSink::~CSampleUdpTileSink()
+{
+    Close();
+}
+
+bool CSampleUdpTileSink::Open(uint16_t usPort)
+{
+    Close();
+
+#if defined(_WINDOWS)
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+#endif
+
+    intptr_t hSocket = (intptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (hSocket == k_hInvalidSocket) {
+        return false;
+    }
+
+    // a frame is a few hundred datagrams, give the kernel room to queue them
+    int nSendBuffer = 4 * 1024 * 1024;
+    setsockopt(hSocket, SOL_SOCKET, SO_SNDBUF, (const char *)&nSendBuffer, sizeof(nSendBuffer));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(usPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(hSocket, (const sockaddr *)&addr, sizeof(addr)) != 0) {
+        closesocket(hSocket);
+        return false;
+    }
+
+    m_hSocket = hSocket;
+    m_vecDatagram.resize(sizeof(SampleTileFragment_t) + k_unMaxPayload);
+    m_ulDatagrams = 0;
+    return true;
+}
+
+void CSampleUdpTileSink::Close()
+{
+    if (m_hSocket != k_hInvalidSocket) {
+        closesocket(m_hSocket);
+        m_hSocket = k_hInvalidSocket;
+#if defined(_WINDOWS)
+        WSACleanup();
+#endif
+    }
+}
+
+bool CSampleUdpTileSink::WriteTile(const SampleTileFragment_t &tile, const uint8_t *pData)
+{
+    if (m_hSocket == k_hInvalidSocket) {
+        return false;
+    }
+
+    // an empty tile still gets one datagram so the receiver can count the frame complete
+    bool bSent = true;
+    SampleTileFragment_t fragment = tile;
+    uint32_t unOffset = 0;
+    do {
+        uint32_t unBytes = tile.unFragmentBytes - unOffset;
+        if (unBytes > k_unMaxPayload) {
+            unBytes = k_unMaxPayload;
+        }
+        fragment.unOffset = tile.unOffset + unOffset;
+        fragment.unFragmentBytes = unBytes;
+        memcpy(m_vecDatagram.data(), &fragment, sizeof(fragment));
+        memcpy(m_vecDatagram.data() + sizeof(fragment), pData + unOffset, unBytes);
+
+        int cbDatagram = (int)(sizeof(fragment) + unBytes);
+        if ((int)send(m_hSocket, (const char *)m_vecDatagram.data(), cbDatagram, 0) != cbDatagram) {
+            bSent = false;
+        }
+        m_ulDatagrams++;
+        unOffset += unBytes;
+    } while (unOffset < tile.unFragmentBytes);
+    return bSent;
+}
@@ -0,0 +1,61 @@
+#ifndef CSAMPLETILESINK_H
+#define CSAMPLETILESINK_H
+
+#include "csampletileencoder.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Purpose: Appends every tile, header and payload, to a file. The file can be
+// replayed later or piped into another process (pass /dev/stdout).
+//-----------------------------------------------------------------------------
+class CSampleFileTileSink : public ISampleTileSink
+{
+public:
+    CSampleFileTileSink();
+
+    virtual ~CSampleFileTileSink();
+
+    bool Open(const char *pchPath);
+
+    void Close();
+
+    virtual bool WriteTile(const SampleTileFragment_t &tile, const uint8_t *pData);
+
+    virtual void EndFrame();
+
+private:
+    FILE *m_pFile;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Sends the tiles as datagrams to a port on localhost, where a bridge
+// process forwards them to the headset. Tiles larger than one datagram are
+// split into pieces of up to k_unMaxPayload bytes, each with its own header.
+//-----------------------------------------------------------------------------
+class CSampleUdpTileSink : public ISampleTileSink
+{
+public:
+    static const uint32_t k_unMaxPayload = 8192;
+
+    CSampleUdpTileSink();
+
+    virtual ~CSampleUdpTileSink();
+
+    bool Open(uint16_t usPort);
+
+    void Close();
+
+    virtual bool WriteTile(const SampleTileFragment_t &tile, const uint8_t *pData);
+
+    uint64_t GetDatagramsSent() const { return m_ulDatagrams; }
+
+private:
+    intptr_t m_hSocket;
+    std::vector<uint8_t> m_vecDatagram;
+    uint64_t m_ulDatagrams;
+};
+
+#endif // CSAMPLETILESINK_H
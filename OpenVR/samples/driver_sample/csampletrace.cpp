@@ -0,0 +1,397 @@
+#if defined(_WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "csampletrace.h"
+#include "driverlog.h"
+
+#include <chrono>
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static_assert(sizeof(SampleTraceRecord_t) == 32, "trace records are expected to be 32 bytes");
+static_assert(sizeof(SampleTraceFileHeader_t) <= k_cbSampleTraceHeader, "trace file header too large");
+
+#define TRACE_FIELD(name, type, kind, member) { name, kind, (uint32_t)offsetof(type, member) }
+
+static const SampleTraceEventInfo_t s_rgEventInfo[SampleTraceEvent_Count] =
+{
+    { "none", 0, {} },
+    { "pose_submit", 5, {
+        TRACE_FIELD("device", SampleTracePoseSubmit_t, SampleTraceField_Uint32, unDevice),
+        TRACE_FIELD("result", SampleTracePoseSubmit_t, SampleTraceField_Hex, unResult),
+        TRACE_FIELD("x", SampleTracePoseSubmit_t, SampleTraceField_Float, rflPosition[0]),
+        TRACE_FIELD("y", SampleTracePoseSubmit_t, SampleTraceField_Float, rflPosition[1]),
+        TRACE_FIELD("z", SampleTracePoseSubmit_t, SampleTraceField_Float, rflPosition[2]) } },
+    { "pose_stage", 3, {
+        TRACE_FIELD("device", SampleTracePoseStage_t, SampleTraceField_Uint32, unDevice),
+        TRACE_FIELD("stage", SampleTracePoseStage_t, SampleTraceField_Uint32, unStage),
+        TRACE_FIELD("duration_ns", SampleTracePoseStage_t, SampleTraceField_Ticks, unTicks) } },
+    { "transport_receive", 4, {
+        TRACE_FIELD("slot", SampleTraceTransportReceive_t, SampleTraceField_Uint32, unSlot),
+        TRACE_FIELD("sequence", SampleTraceTransportReceive_t, SampleTraceField_Uint32, unSequence),
+        TRACE_FIELD("flags", SampleTraceTransportReceive_t, SampleTraceField_Hex, unFlags),
+        TRACE_FIELD("bytes", SampleTraceTransportReceive_t, SampleTraceField_Uint32, unBytes) } },
+    { "input_change", 3, {
+        TRACE_FIELD("device", SampleTraceInputChange_t, SampleTraceField_Uint32, unDevice),
+        TRACE_FIELD("component", SampleTraceInputChange_t, SampleTraceField_Uint32, unComponent),
+        TRACE_FIELD("value", SampleTraceInputChange_t, SampleTraceField_Float, flValue) } },
+    { "scope", 3, {
+        TRACE_FIELD("scope", SampleTraceScope_t, SampleTraceField_Scope, unScope),
+        TRACE_FIELD("arg", SampleTraceScope_t, SampleTraceField_Uint32, unArg),
+        TRACE_FIELD("duration_ns", SampleTraceScope_t, SampleTraceField_Ticks64, rgunTicks) } },
+};
+
+static const char *const k_rgpchScopeNames[SampleTraceScope_Count] =
+{
+    "run_frame", "device_run_frame", "event_pump", "pose_tick", "pose_chunk", "pose_submit_all", "transport_datagram",
+};
+
+#undef TRACE_FIELD
+
+std::atomic<bool> g_bSampleTraceEnabled(false);
+thread_local SampleTraceRing_t *t_pSampleTraceRing = nullptr;
+
+#if defined(DRIVER_SAMPLE_ALLOC_CHECK)
+thread_local uint32_t t_unSampleAllocCheckScope = 0;
+#endif
+
+static thread_local char t_rgchThreadName[32];
+
+// rings are opened once per thread and stay mapped until the process exits, a
+// thread may still be in the middle of a record when tracing is switched off
+static std::mutex s_ringMutex;
+static std::vector<SampleTraceRing_t *> s_vecRings;
+static std::vector<std::string> s_vecPaths;
+static std::string s_sDirectory;
+static uint32_t s_unRecords = 0;
+static bool s_bCalibrated = false;
+static uint64_t s_ulTickBase = 0;
+static uint64_t s_ulNsBase = 0;
+static double s_flNsPerTick = 1.0;
+
+// a thread whose file could not be created writes into this instead, so the failure is only paid once
+static thread_local SampleTraceFileHeader_t t_discardHeader;
+static thread_local SampleTraceRecord_t t_discardRecord;
+static thread_local SampleTraceRing_t t_discardRing;
+
+const SampleTraceEventInfo_t *GetSampleTraceEventInfo(uint32_t unEvent)
+{
+    if (unEvent == SampleTraceEvent_None || unEvent >= SampleTraceEvent_Count) {
+        return nullptr;
+    }
+    return &s_rgEventInfo[unEvent];
+}
+
+const char *GetSampleTraceScopeName(uint32_t unScope)
+{
+    return unScope < SampleTraceScope_Count ? k_rgpchScopeNames[unScope] : nullptr;
+}
+
+static std::string GetTempDirectory()
+{
+#if defined(_WINDOWS)
+    char rgchPath[MAX_PATH];
+    DWORD cchPath = GetTempPathA(sizeof(rgchPath), rgchPath);
+    if (cchPath > 0 && cchPath < sizeof(rgchPath)) {
+        return std::string(rgchPath);
+    }
+    return std::string(".");
+#else
+    const char *pchTemp = getenv("TMPDIR");
+    return std::string(pchTemp && *pchTemp ? pchTemp : "/tmp");
+#endif
+}
+
+static uint32_t GetProcessIdentifier()
+{
+#if defined(_WINDOWS)
+    return (uint32_t)GetCurrentProcessId();
+#else
+    return (uint32_t)getpid();
+#endif
+}
+
+// ticks per nanosecond from two readings of both clocks, only the TSC needs it
+static void CalibrateTicks()
+{
+    s_ulTickBase = GetSampleTraceTicks();
+    s_ulNsBase = GetTimestampNs();
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t ulTicks = GetSampleTraceTicks() - s_ulTickBase;
+    uint64_t ulNs = GetTimestampNs() - s_ulNsBase;
+    s_flNsPerTick = ulTicks > 0 ? (double)ulNs / (double)ulTicks : 1.0;
+#else
+    s_flNsPerTick = 1.0;
+#endif
+    s_bCalibrated = true;
+}
+
+static void *MapRingFile(const char *pchPath, size_t cbSize)
+{
+#if defined(_WINDOWS)
+    HANDLE hFile = CreateFileA(pchPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READWRITE, (DWORD)((uint64_t)cbSize >> 32), (DWORD)cbSize, NULL);
+    CloseHandle(hFile);
+    if (!hMapping) {
+        return nullptr;
+    }
+    void *pView = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, cbSize);
+    CloseHandle(hMapping);
+    return pView;
+#else
+    int nFd = open(pchPath, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (nFd < 0) {
+        return nullptr;
+    }
+    if (ftruncate(nFd, (off_t)cbSize) != 0) {
+        close(nFd);
+        return nullptr;
+    }
+    void *pView = mmap(NULL, cbSize, PROT_READ | PROT_WRITE, MAP_SHARED, nFd, 0);
+    close(nFd);
+    return pView == MAP_FAILED ? nullptr : pView;
+#endif
+}
+
+SampleTraceRing_t *OpenSampleTraceRing()
+{
+    std::lock_guard<std::mutex> lock(s_ringMutex);
+
+    uint32_t unThreadIndex = (uint32_t)s_vecRings.size();
+    uint32_t unProcessId = GetProcessIdentifier();
+    char rgchPath[1024];
+    snprintf(rgchPath, sizeof(rgchPath), "%s/diy_trace_%u_%u.bin", s_sDirectory.c_str(), unProcessId, unThreadIndex);
+
+    size_t cbFile = k_cbSampleTraceHeader + (size_t)s_unRecords * sizeof(SampleTraceRecord_t);
+    void *pView = s_unRecords ? MapRingFile(rgchPath, cbFile) : nullptr;
+    if (!pView) {
+        DRIVERLOG_ERROR(DriverLogCategory_General, "driver_null: could not create trace file %s\n", (const char *)rgchPath);
+        t_discardRing.pHeader = &t_discardHeader;
+        t_discardRing.pRecords = &t_discardRecord;
+        t_discardRing.ulMask = 0;
+        t_discardRing.ulWriteIndex = 0;
+        t_pSampleTraceRing = &t_discardRing;
+        return t_pSampleTraceRing;
+    }
+
+    // the pages come zeroed from the file, so records that were never written read as event 0
+    SampleTraceFileHeader_t *pHeader = (SampleTraceFileHeader_t *)pView;
+    pHeader->unMagic = k_unSampleTraceMagic;
+    pHeader->unVersion = k_unSampleTraceVersion;
+    pHeader->unRecordBytes = sizeof(SampleTraceRecord_t);
+    pHeader->unRecords = s_unRecords;
+    pHeader->unProcessId = unProcessId;
+    pHeader->unThreadIndex = unThreadIndex;
+    memcpy(pHeader->rgchThreadName, t_rgchThreadName, sizeof(pHeader->rgchThreadName));
+    pHeader->ulTickBase = s_ulTickBase;
+    pHeader->ulNsBase = s_ulNsBase;
+    pHeader->flNsPerTick = s_flNsPerTick;
+    pHeader->ulWriteIndex.store(0, std::memory_order_release);
+
+    SampleTraceRing_t *pRing = new SampleTraceRing_t;
+    pRing->pHeader = pHeader;
+    pRing->pRecords = (SampleTraceRecord_t *)((uint8_t *)pView + k_cbSampleTraceHeader);
+    pRing->ulMask = s_unRecords - 1;
+    pRing->ulWriteIndex = 0;
+    s_vecRings.push_back(pRing);
+    s_vecPaths.push_back(rgchPath);
+    t_pSampleTraceRing = pRing;
+
+    DRIVERLOG_INFO(DriverLogCategory_General, "driver_null: tracing thread %u to %s\n", unThreadIndex, (const char *)rgchPath);
+    return pRing;
+}
+
+void StartSampleTrace(const char *pchDirectory, uint32_t unRecords)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_ringMutex);
+
+        // rings that are already open keep their file and size
+        s_sDirectory = pchDirectory && *pchDirectory ? std::string(pchDirectory) : GetTempDirectory();
+        uint32_t unCapacity = 1024;
+        while (unCapacity < unRecords && unCapacity < (1u << 26)) {
+            unCapacity <<= 1;
+        }
+        s_unRecords = unCapacity;
+        if (!s_bCalibrated) {
+            CalibrateTicks();
+        }
+    }
+
+    g_bSampleTraceEnabled.store(true, std::memory_order_relaxed);
+}
+
+void StopSampleTrace()
+{
+    g_bSampleTraceEnabled.store(false, std::memory_order_relaxed);
+}
+
+void GetSampleTraceFiles(std::vector<std::string> &vecPaths)
+{
+    std::lock_guard<std::mutex> lock(s_ringMutex);
+    vecPaths = s_vecPaths;
+}
+
+void SetSampleTraceThreadName(const char *pchName)
+{
+    snprintf(t_rgchThreadName, sizeof(t_rgchThreadName), "%s", pchName ? pchName : "");
+    if (t_pSampleTraceRing) {
+        memcpy(t_pSampleTraceRing->pHeader->rgchThreadName, t_rgchThreadName, sizeof(t_rgchThreadName));
+    }
+}
+
+static double GetRecordTimeUs(const SampleTraceFileHeader_t &header, uint64_t ulTicks)
+{
+    return ((double)header.ulNsBase + (double)(int64_t)(ulTicks - header.ulTickBase) * header.flNsPerTick) * 1e-3;
+}
+
+static void WriteChromeArgs(FILE *pFile, const SampleTraceEventInfo_t &info, const SampleTraceRecord_t &record, double flNsPerTick)
+{
+    fprintf(pFile, ",\"args\":{");
+    for (uint32_t i = 0; i < info.unFields; i++) {
+        const SampleTraceField_t &field = info.rgFields[i];
+        uint32_t rgunValue[2] = { 0, 0 };
+        float flValue;
+        memcpy(rgunValue, record.rgPayload + field.unOffset, field.unType == SampleTraceField_Ticks64 ? 8 : 4);
+        memcpy(&flValue, record.rgPayload + field.unOffset, sizeof(flValue));
+        fprintf(pFile, "%s\"%s\":", i ? "," : "", field.pchName);
+        switch (field.unType) {
+        case SampleTraceField_Float:
+            // JSON has no NaN or infinity
+            fprintf(pFile, isfinite(flValue) ? "%.6g" : "null", flValue);
+            break;
+        case SampleTraceField_Ticks:
+            fprintf(pFile, "%.0f", rgunValue[0] * flNsPerTick);
+            break;
+        case SampleTraceField_Ticks64:
+            fprintf(pFile, "%.0f", (double)(((uint64_t)rgunValue[1] << 32) | rgunValue[0]) * flNsPerTick);
+            break;
+        case SampleTraceField_Hex:
+            fprintf(pFile, "\"0x%x\"", rgunValue[0]);
+            break;
+        case SampleTraceField_Scope:
+            fprintf(pFile, "\"%s\"", GetSampleTraceScopeName(rgunValue[0]) ? GetSampleTraceScopeName(rgunValue[0]) : "unknown");
+            break;
+        default:
+            fprintf(pFile, "%u", rgunValue[0]);
+            break;
+        }
+    }
+    fprintf(pFile, "}");
+}
+
+bool WriteSampleTraceChromeJson(const char *pchPath, const SampleTraceRingView_t *pRings, uint32_t unRings)
+{
+    FILE *pFile = fopen(pchPath, "w");
+    if (!pFile) {
+        return false;
+    }
+
+    fprintf(pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool bFirst = true;
+    for (uint32_t r = 0; r < unRings; r++) {
+        const SampleTraceRingView_t &ring = pRings[r];
+        const SampleTraceFileHeader_t &header = *ring.pHeader;
+        // thread 0 is taken by the process in some viewers
+        uint32_t unTid = header.unThreadIndex + 1;
+
+        char rgchName[sizeof(header.rgchThreadName) + 1];
+        memcpy(rgchName, header.rgchThreadName, sizeof(header.rgchThreadName));
+        rgchName[sizeof(header.rgchThreadName)] = 0;
+        for (char *pch = rgchName; *pch; pch++) {
+            if (*pch == '"' || *pch == '\\' || (unsigned char)*pch < 0x20) {
+                *pch = '_';
+            }
+        }
+        if (!rgchName[0]) {
+            snprintf(rgchName, sizeof(rgchName), "thread %u", header.unThreadIndex);
+        }
+        fprintf(pFile, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            bFirst ? "" : ",", header.unProcessId, unTid, (const char *)rgchName);
+        bFirst = false;
+
+        for (uint64_t i = ring.ulFirst; i < ring.ulEnd; i++) {
+            const SampleTraceRecord_t &record = ring.pRecords[i & (header.unRecords - 1)];
+            const SampleTraceEventInfo_t *pInfo = GetSampleTraceEventInfo(record.unEvent);
+            if (!pInfo) {
+                continue;
+            }
+
+            if (record.unEvent == SampleTraceEvent_Scope) {
+                SampleTraceScope_t scope;
+                memcpy(&scope, record.rgPayload, sizeof(scope));
+                const char *pchScope = GetSampleTraceScopeName(scope.unScope);
+                uint64_t ulTicks = ((uint64_t)scope.rgunTicks[1] << 32) | scope.rgunTicks[0];
+                fprintf(pFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg\":%u}}",
+                    pchScope ? pchScope : "unknown", header.unProcessId, unTid, GetRecordTimeUs(header, record.ulTicks - ulTicks),
+                    (double)ulTicks * header.flNsPerTick * 1e-3, scope.unArg);
+            } else {
+                fprintf(pFile, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f",
+                    pInfo->pchName, header.unProcessId, unTid, GetRecordTimeUs(header, record.ulTicks));
+                WriteChromeArgs(pFile, *pInfo, record, header.flNsPerTick);
+                fprintf(pFile, "}");
+            }
+        }
+    }
+    fprintf(pFile, "\n]}\n");
+
+    bool bOk = !ferror(pFile);
+    return fclose(pFile) == 0 && bOk;
+}
+
+bool ExportSampleTraceChromeJson(const char *pchPath, char *pchWrittenPath, uint32_t unWrittenPathSize)
+{
+    std::string sPath;
+    // a copy of each ring, then only the records the writer can't have overwritten while we copied
+    std::vector<std::vector<SampleTraceRecord_t>> vecCopies;
+    std::vector<SampleTraceRingView_t> vecViews;
+    {
+        std::lock_guard<std::mutex> lock(s_ringMutex);
+        if (pchPath && *pchPath) {
+            sPath = pchPath;
+        } else {
+            char rgchName[64];
+            snprintf(rgchName, sizeof(rgchName), "/diy_trace_%u.json", GetProcessIdentifier());
+            sPath = (s_sDirectory.empty() ? GetTempDirectory() : s_sDirectory) + rgchName;
+        }
+
+        vecCopies.resize(s_vecRings.size());
+        for (size_t r = 0; r < s_vecRings.size(); r++) {
+            SampleTraceFileHeader_t *pHeader = s_vecRings[r]->pHeader;
+            uint64_t ulEnd = pHeader->ulWriteIndex.load(std::memory_order_acquire);
+            vecCopies[r].assign(s_vecRings[r]->pRecords, s_vecRings[r]->pRecords + pHeader->unRecords);
+            uint64_t ulWrittenAfter = pHeader->ulWriteIndex.load(std::memory_order_acquire);
+
+            // the slot at the write index may be half written, everything from there on was overwritten
+            uint64_t ulFirst = ulWrittenAfter >= pHeader->unRecords ? ulWrittenAfter - pHeader->unRecords + 1 : 0;
+            SampleTraceRingView_t view = { pHeader, vecCopies[r].data(), ulFirst < ulEnd ? ulFirst : ulEnd, ulEnd };
+            vecViews.push_back(view);
+        }
+    }
+
+    if (pchWrittenPath && unWrittenPathSize > 0) {
+        snprintf(pchWrittenPath, unWrittenPathSize, "%s", sPath.c_str());
+    }
+    bool bOk = WriteSampleTraceChromeJson(sPath.c_str(), vecViews.data(), (uint32_t)vecViews.size());
+    if (bOk) {
+        DRIVERLOG_INFO(DriverLogCategory_General, "driver_null: wrote trace of %u threads to %s\n", (uint32_t)vecViews.size(), sPath.c_str());
+    } else {
+        DRIVERLOG_ERROR(DriverLogCategory_General, "driver_null: could not write trace to %s\n", sPath.c_str());
+    }
+    return bOk;
+}
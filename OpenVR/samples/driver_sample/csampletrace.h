@@ -0,0 +1,301 @@
+#ifndef CSAMPLETRACE_H
+#define CSAMPLETRACE_H
+
+#include "basics.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static const uint32_t k_unSampleTraceMagic = 0x52544944; // "DITR"
+static const uint32_t k_unSampleTraceVersion = 1;
+static const uint32_t k_cbSampleTracePayload = 20;
+
+// every event id is fixed at compile time, the decoder knows the payload of each from GetSampleTraceEventInfo()
+enum ESampleTraceEvent
+{
+    SampleTraceEvent_None = 0,
+    SampleTraceEvent_PoseSubmit,
+    SampleTraceEvent_PoseStage,
+    SampleTraceEvent_TransportReceive,
+    SampleTraceEvent_InputChange,
+    SampleTraceEvent_Scope,
+    SampleTraceEvent_Count
+};
+
+enum ESampleTracePoseStage
+{
+    SampleTracePoseStage_Evaluate = 0, // GetPose: transport pose, filtering and prediction
+    SampleTracePoseStage_Submit = 1,   // TrackedDevicePoseUpdated
+};
+
+// the code regions CSampleTraceScope measures, named in GetSampleTraceScopeName()
+enum ESampleTraceScope
+{
+    SampleTraceScope_RunFrame = 0,      // CServerDriver_Sample::RunFrame
+    SampleTraceScope_DeviceRunFrame,    // input and other per frame work of one device, arg is the object id
+    SampleTraceScope_EventPump,         // draining the SteamVR event queue
+    SampleTraceScope_PoseTick,          // one tick of the pose thread
+    SampleTraceScope_PoseChunk,         // evaluating the poses of one chunk of devices, arg is the chunk
+    SampleTraceScope_PoseSubmitAll,     // handing every pose of a tick to SteamVR
+    SampleTraceScope_TransportDatagram, // decoding one datagram, arg is its size
+    SampleTraceScope_Count
+};
+
+// payloads, made of 4 byte fields so the decoder can describe them
+struct SampleTracePoseSubmit_t
+{
+    static const uint16_t k_unEvent = SampleTraceEvent_PoseSubmit;
+    uint32_t unDevice;
+    uint32_t unResult;             // ETrackingResult, bit 31 set when poseIsValid
+    float rflPosition[3];
+};
+
+struct SampleTracePoseStage_t
+{
+    static const uint16_t k_unEvent = SampleTraceEvent_PoseStage;
+    uint32_t unDevice;
+    uint32_t unStage;              // ESampleTracePoseStage
+    uint32_t unTicks;              // duration in trace ticks
+};
+
+struct SampleTraceTransportReceive_t
+{
+    static const uint16_t k_unEvent = SampleTraceEvent_TransportReceive;
+    uint32_t unSlot;
+    uint32_t unSequence;
+    uint32_t unFlags;
+    uint32_t unBytes;              // of the datagram the packet came in
+};
+
+struct SampleTraceInputChange_t
+{
+    static const uint16_t k_unEvent = SampleTraceEvent_InputChange;
+    uint32_t unDevice;
+    uint32_t unComponent;          // index of the component in the device's input table
+    float flValue;
+};
+
+struct SampleTraceScope_t
+{
+    static const uint16_t k_unEvent = SampleTraceEvent_Scope;
+    uint32_t unScope;              // ESampleTraceScope
+    uint32_t unArg;
+    uint32_t rgunTicks[2];         // duration in trace ticks, the record's time stamp is the end
+};
+
+enum ESampleTraceFieldType
+{
+    SampleTraceField_Uint32,
+    SampleTraceField_Float,
+    SampleTraceField_Ticks,        // a duration, printed in nanoseconds
+    SampleTraceField_Hex,
+    SampleTraceField_Ticks64,      // a duration in two fields, low word first
+    SampleTraceField_Scope,        // an ESampleTraceScope
+};
+
+struct SampleTraceField_t
+{
+    const char *pchName;
+    uint32_t unType;
+    uint32_t unOffset;
+};
+
+struct SampleTraceEventInfo_t
+{
+    const char *pchName;
+    uint32_t unFields;
+    SampleTraceField_t rgFields[k_cbSampleTracePayload / 4];
+};
+
+/** name and payload layout of an event, null for ids this build doesn't know */
+const SampleTraceEventInfo_t *GetSampleTraceEventInfo(uint32_t unEvent);
+
+/** name of a scope, null for ids this build doesn't know */
+const char *GetSampleTraceScopeName(uint32_t unScope);
+
+// one record, 32 bytes so two share a cache line
+struct SampleTraceRecord_t
+{
+    uint64_t ulTicks;
+    uint16_t unEvent;
+    uint16_t unReserved;
+    uint8_t rgPayload[k_cbSampleTracePayload];
+};
+
+// start of every ring file, the records follow at k_cbSampleTraceHeader
+struct SampleTraceFileHeader_t
+{
+    uint32_t unMagic;
+    uint32_t unVersion;
+    uint32_t unRecordBytes;
+    uint32_t unRecords;            // ring capacity, a power of two
+    uint32_t unProcessId;
+    uint32_t unThreadIndex;
+    char rgchThreadName[32];
+    uint64_t ulTickBase;           // ticks and GetTimestampNs() at the same moment
+    uint64_t ulNsBase;
+    double flNsPerTick;
+    std::atomic<uint64_t> ulWriteIndex; // records ever written, the newest is at (ulWriteIndex - 1) % unRecords
+};
+
+static const size_t k_cbSampleTraceHeader = 4096;
+
+// the ring of the calling thread, owned by the trace module
+struct SampleTraceRing_t
+{
+    SampleTraceFileHeader_t *pHeader;
+    SampleTraceRecord_t *pRecords;
+    uint64_t ulMask;
+    uint64_t ulWriteIndex;
+};
+
+extern std::atomic<bool> g_bSampleTraceEnabled;
+extern thread_local SampleTraceRing_t *t_pSampleTraceRing;
+
+#if defined(DRIVER_SAMPLE_ALLOC_CHECK)
+// innermost CSampleTraceScope of the calling thread + 1, 0 outside of all of them. Only kept in the alloc_check build,
+// which counts the allocations made inside a scope
+extern thread_local uint32_t t_unSampleAllocCheckScope;
+#endif
+
+/** maps a ring file for the calling thread, null if that fails */
+SampleTraceRing_t *OpenSampleTraceRing();
+
+/** starts recording, every thread that traces gets its own ring of unRecords records in a file in pchDirectory (temp when empty) */
+void StartSampleTrace(const char *pchDirectory, uint32_t unRecords);
+
+/** stops recording, the files stay mapped and complete for the decoder */
+void StopSampleTrace();
+
+/** paths of the ring files this process has opened so far */
+void GetSampleTraceFiles(std::vector<std::string> &vecPaths);
+
+// the records of one ring from ulFirst up to ulEnd, counted since the ring was opened
+struct SampleTraceRingView_t
+{
+    const SampleTraceFileHeader_t *pHeader;
+    const SampleTraceRecord_t *pRecords;
+    uint64_t ulFirst;
+    uint64_t ulEnd;
+};
+
+/** writes the records of the rings as Chrome trace_event JSON, which Perfetto and chrome://tracing open. Scopes become
+ * complete events, everything else instant events with the payload as arguments */
+bool WriteSampleTraceChromeJson(const char *pchPath, const SampleTraceRingView_t *pRings, uint32_t unRings);
+
+/** takes a consistent copy of the rings of this process and writes them with WriteSampleTraceChromeJson(). Works
+ * with tracing on or off; the threads keep recording meanwhile. An empty path writes diy_trace_<pid>.json next to the
+ * ring files, the path used goes to pchWrittenPath */
+bool ExportSampleTraceChromeJson(const char *pchPath, char *pchWrittenPath, uint32_t unWrittenPathSize);
+
+/** names the calling thread in its ring file */
+void SetSampleTraceThreadName(const char *pchName);
+
+inline bool IsSampleTraceEnabled()
+{
+    return g_bSampleTraceEnabled.load(std::memory_order_relaxed);
+}
+
+/** the time stamp of the records, the TSC where there is one */
+inline uint64_t GetSampleTraceTicks()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return GetTimestampNs();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Records one event into the calling thread's ring at ulTicks.
+// Nothing is formatted and nothing is shared with other threads: a time stamp, the id
+// and a copy of the payload go into the next slot of a memory mapped file,
+// which the OS writes out even if the process dies. SampleTrace() stamps
+// the current time and costs a flag check when tracing is off.
+//-----------------------------------------------------------------------------
+template <typename T>
+inline void SampleTraceAt(const T &payload, uint64_t ulTicks)
+{
+    static_assert(sizeof(T) <= k_cbSampleTracePayload, "trace payload too large");
+
+    SampleTraceRing_t *pRing = t_pSampleTraceRing;
+    if (!pRing) {
+        pRing = OpenSampleTraceRing();
+        if (!pRing) {
+            return;
+        }
+    }
+
+    SampleTraceRecord_t &record = pRing->pRecords[pRing->ulWriteIndex & pRing->ulMask];
+    record.ulTicks = ulTicks;
+    record.unEvent = T::k_unEvent;
+    record.unReserved = 0;
+    memcpy(record.rgPayload, &payload, sizeof(T));
+    pRing->ulWriteIndex++;
+    pRing->pHeader->ulWriteIndex.store(pRing->ulWriteIndex, std::memory_order_release);
+}
+
+template <typename T>
+inline void SampleTrace(const T &payload)
+{
+    if (IsSampleTraceEnabled()) {
+        SampleTraceAt(payload, GetSampleTraceTicks());
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Measures the lifetime of the object as one scope record of the
+// calling thread. With tracing off it costs a flag check in the constructor
+// and a branch in the destructor; scopes that began while it was off are not
+// recorded when it is switched on halfway.
+//-----------------------------------------------------------------------------
+class CSampleTraceScope
+{
+public:
+    explicit CSampleTraceScope(ESampleTraceScope eScope, uint32_t unArg = 0)
+    {
+        m_ulBeginTicks = IsSampleTraceEnabled() ? GetSampleTraceTicks() : 0;
+        m_unScope = (uint32_t)eScope;
+        m_unArg = unArg;
+#if defined(DRIVER_SAMPLE_ALLOC_CHECK)
+        m_unOuterAllocCheckScope = t_unSampleAllocCheckScope;
+        t_unSampleAllocCheckScope = m_unScope + 1;
+#endif
+    }
+
+    ~CSampleTraceScope()
+    {
+#if defined(DRIVER_SAMPLE_ALLOC_CHECK)
+        t_unSampleAllocCheckScope = m_unOuterAllocCheckScope;
+#endif
+        if (m_ulBeginTicks && IsSampleTraceEnabled()) {
+            uint64_t ulEndTicks = GetSampleTraceTicks();
+            uint64_t ulTicks = ulEndTicks - m_ulBeginTicks;
+            SampleTraceScope_t scope = { m_unScope, m_unArg, { (uint32_t)ulTicks, (uint32_t)(ulTicks >> 32) } };
+            SampleTraceAt(scope, ulEndTicks);
+        }
+    }
+
+private:
+    CSampleTraceScope(const CSampleTraceScope &) = delete;
+    CSampleTraceScope &operator=(const CSampleTraceScope &) = delete;
+
+    uint64_t m_ulBeginTicks;
+    uint32_t m_unScope;
+    uint32_t m_unArg;
+#if defined(DRIVER_SAMPLE_ALLOC_CHECK)
+    uint32_t m_unOuterAllocCheckScope;
+#endif
+};
+
+#endif // CSAMPLETRACE_H
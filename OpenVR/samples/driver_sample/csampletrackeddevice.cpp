@@ -0,0 +1,271 @@
+#include "csampletrackeddevice.h"
+
+#include "basics.h"
+#include "csampledebugcommand.h"
+#include "csampleeventdispatcher.h"
+#include "csampleframemonitor.h"
+#include "csamplelatencystats.h"
+#include "csampletrace.h"
+#include "csampletuning.h"
+#include "driverlog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace vr;
+
+CSampleTrackedDevice::CSampleTrackedDevice()
+    : m_unObjectId(vr::k_unTrackedDeviceIndexInvalid), m_ulLastDataTimeNs(0), m_bStandby(false), m_ulPosesSubmitted(0)
+{
+    m_ulConnectionTimeoutNs = 500000000;
+    m_bAddedToHost = false;
+    m_bReportedConnected = false;
+    memset(&m_pose, 0, sizeof(m_pose));
+    m_ulPoseSampleTimeNs = 0;
+
+    m_ulTransportPoseTimeNs = 0;
+    m_rdTransportPosition[0] = 0;
+    m_rdTransportPosition[1] = 0;
+    m_rdTransportPosition[2] = 0;
+    m_qTransportRotation = HmdQuaternion_Init(1, 0, 0, 0);
+}
+
+void CSampleTrackedDevice::OnTransportData()
+{
+    m_ulLastDataTimeNs.store(GetTimestampNs(), std::memory_order_relaxed);
+}
+
+void CSampleTrackedDevice::OnTransportPose(const double rdPosition[3], const vr::HmdQuaternion_t &qRotation)
+{
+    uint64_t ulNow = GetTimestampNs();
+    {
+        std::lock_guard<std::mutex> lock(m_transportPoseMutex);
+        m_ulTransportPoseTimeNs = ulNow;
+        m_rdTransportPosition[0] = rdPosition[0];
+        m_rdTransportPosition[1] = rdPosition[1];
+        m_rdTransportPosition[2] = rdPosition[2];
+        m_qTransportRotation = qRotation;
+    }
+    m_ulLastDataTimeNs.store(ulNow, std::memory_order_relaxed);
+}
+
+static const char *GetDeviceClassName(vr::ETrackedDeviceClass eClass)
+{
+    switch (eClass) {
+    case TrackedDeviceClass_HMD:
+        return "hmd";
+    case TrackedDeviceClass_Controller:
+        return "controller";
+    case TrackedDeviceClass_GenericTracker:
+        return "tracker";
+    default:
+        return "other";
+    }
+}
+
+static double GetAgeMs(uint64_t ulTimeNs)
+{
+    return ulTimeNs ? (GetTimestampNs() - ulTimeNs) * 1e-6 : -1.0;
+}
+
+void CSampleTrackedDevice::DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize)
+{
+    CSampleDebugCommand command(pchRequest);
+    CSampleDebugResponse response(pchResponseBuffer, unResponseBufferSize);
+    if (unResponseBufferSize < 1) {
+        return;
+    }
+
+    if (!command.IsValid()) {
+        response.Error("too many words");
+    } else if (command.GetTokenCount() == 0 || command.IsToken(0, "help")) {
+        response.Append("help | get [name] | set <name> <value> | pose | state | trace [on|off|export [path]] | log [levels] | stats [reset] | frames | events [reset]");
+    } else if (command.IsToken(0, "get") && command.GetTokenCount() <= 2) {
+        for (uint32_t i = 0; i < SampleTuning_Count; i++) {
+            const SampleTuningInfo_t &info = GetSampleTuningInfo((ESampleTuning)i);
+            if (command.GetTokenCount() == 1 || command.IsToken(1, info.pchName)) {
+                response.Append("%s%s=%g", response.GetBuffer()[0] ? " " : "", info.pchName, GetSampleTuning((ESampleTuning)i));
+            }
+        }
+        if (!response.GetBuffer()[0]) {
+            response.Error("unknown parameter");
+        }
+    } else if (command.IsToken(0, "set") && command.GetTokenCount() == 3) {
+        ESampleTuning eTuning;
+        float flValue;
+        if (!FindSampleTuning(command.GetToken(1), command.GetTokenLength(1), &eTuning)) {
+            response.Error("unknown parameter");
+        } else if (!command.GetFloat(2, &flValue)) {
+            response.Error("not a number");
+        } else if (!SetSampleTuning(eTuning, flValue)) {
+            const SampleTuningInfo_t &info = GetSampleTuningInfo(eTuning);
+            response.Error("%s must be between %g and %g", info.pchName, info.flMin, info.flMax);
+        } else {
+            DRIVERLOG_INFO(DriverLogCategory_General, "driver_null: %s set to %g\n", GetSampleTuningInfo(eTuning).pchName, flValue);
+            response.Append("%s=%g", GetSampleTuningInfo(eTuning).pchName, GetSampleTuning(eTuning));
+        }
+    } else if (command.IsToken(0, "pose") && command.GetTokenCount() == 1) {
+        // evaluated now rather than the one the pose thread is working on
+        vr::DriverPose_t pose = GetPose();
+        response.Append("connected=%d valid=%d result=%d position=%.4f,%.4f,%.4f rotation=%.4f,%.4f,%.4f,%.4f time_offset=%g",
+            pose.deviceIsConnected ? 1 : 0, pose.poseIsValid ? 1 : 0, (int)pose.result,
+            pose.vecPosition[0], pose.vecPosition[1], pose.vecPosition[2],
+            pose.qRotation.w, pose.qRotation.x, pose.qRotation.y, pose.qRotation.z, pose.poseTimeOffset);
+    } else if (command.IsToken(0, "state") && command.GetTokenCount() == 1) {
+        uint64_t ulTransportPoseTimeNs;
+        {
+            std::lock_guard<std::mutex> lock(m_transportPoseMutex);
+            ulTransportPoseTimeNs = m_ulTransportPoseTimeNs;
+        }
+        response.Append("serial=%s class=%s object_id=%d added=%d connected=%d standby=%d keyboard=%d data_age_ms=%.1f transport_pose_age_ms=%.1f",
+            GetSerialNumber().c_str(), GetDeviceClassName(GetDeviceClass()), (int)GetObjectId(), m_bAddedToHost ? 1 : 0,
+            IsConnected() ? 1 : 0, IsInStandby() ? 1 : 0, IsKeyboardDriven() ? 1 : 0,
+            GetAgeMs(m_ulLastDataTimeNs.load(std::memory_order_relaxed)), GetAgeMs(ulTransportPoseTimeNs));
+    } else if (command.IsToken(0, "trace") && command.IsToken(1, "export") && command.GetTokenCount() <= 3) {
+        // the path can't contain spaces, send none to get the default
+        char rgchPath[512];
+        char rgchWritten[512];
+        snprintf(rgchPath, sizeof(rgchPath), "%.*s", command.GetTokenCount() == 3 ? (int)command.GetTokenLength(2) : 0, command.GetRest(2));
+        if (ExportSampleTraceChromeJson(rgchPath, rgchWritten, sizeof(rgchWritten))) {
+            response.Append("wrote %s", (const char *)rgchWritten);
+        } else {
+            response.Error("could not write %s", (const char *)rgchWritten);
+        }
+    } else if (command.IsToken(0, "trace") && command.GetTokenCount() <= 2) {
+        if (command.IsToken(1, "on")) {
+            char rgchDirectory[512];
+            GetSampleSettingString(k_pch_Sample_TraceDirectory_String, rgchDirectory, sizeof(rgchDirectory), "");
+            int32_t nTraceRecords = GetSampleSettingInt32(k_pch_Sample_TraceRecords_Int32, 65536);
+            StartSampleTrace(rgchDirectory, nTraceRecords > 0 ? (uint32_t)nTraceRecords : 0);
+        } else if (command.IsToken(1, "off")) {
+            StopSampleTrace();
+        } else if (command.GetTokenCount() == 2) {
+            response.Error("trace takes on or off");
+        }
+        if (command.GetTokenCount() == 1 || command.IsToken(1, "on") || command.IsToken(1, "off")) {
+            response.Append("trace=%s", IsSampleTraceEnabled() ? "on" : "off");
+        }
+    } else if (command.IsToken(0, "log")) {
+        if (command.GetTokenCount() > 1 && !SetDriverLogLevels(command.GetRest(1))) {
+            response.Error("bad log levels");
+        } else {
+            response.SetWritten(GetDriverLogLevels(pchResponseBuffer, unResponseBufferSize));
+        }
+    } else if (command.IsToken(0, "stats") && (command.GetTokenCount() == 1 || (command.GetTokenCount() == 2 && command.IsToken(1, "reset")))) {
+        // the answer of a reset is what was collected until then
+        response.SetWritten(FormatSampleLatencyStatsJson(pchResponseBuffer, unResponseBufferSize));
+        if (command.GetTokenCount() == 2) {
+            ResetSampleLatencyStats();
+        }
+    } else if (command.IsToken(0, "frames") && command.GetTokenCount() == 1) {
+        response.SetWritten(FormatSampleFrameMonitorJson(pchResponseBuffer, unResponseBufferSize));
+    } else if (command.IsToken(0, "events") && (command.GetTokenCount() == 1 || (command.GetTokenCount() == 2 && command.IsToken(1, "reset")))) {
+        CSampleEventDispatcher *pDispatcher = GetSampleEventDispatcher();
+        if (!pDispatcher) {
+            response.Error("no event dispatcher");
+        } else {
+            response.SetWritten(pDispatcher->FormatEventStatsJson(pchResponseBuffer, unResponseBufferSize));
+            if (command.GetTokenCount() == 2) {
+                pDispatcher->ResetEventStats();
+            }
+        }
+    } else {
+        response.Error("unknown request, try help");
+    }
+    response.Finish();
+}
+
+void CSampleTrackedDevice::OnPoseSubmitted()
+{
+    // the pose thread is the only writer
+    m_ulPosesSubmitted.store(m_ulPosesSubmitted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (m_pose.deviceIsConnected && m_ulPoseSampleTimeNs) {
+        RecordSampleLatency(SampleLatencyStage_SampleToSubmit, GetTimestampNs() - m_ulPoseSampleTimeNs);
+    }
+}
+
+bool CSampleTrackedDevice::IsConnected() const
+{
+    uint64_t ulLastData = m_ulLastDataTimeNs.load(std::memory_order_relaxed);
+    return ulLastData != 0 && GetTimestampNs() - ulLastData <= m_ulConnectionTimeoutNs;
+}
+
+void CSampleTrackedDevice::FillConnectionState(vr::DriverPose_t &pose) const
+{
+    if (IsConnected()) {
+        pose.poseIsValid = true;
+        pose.result = TrackingResult_Running_OK;
+        pose.deviceIsConnected = true;
+    } else {
+        pose.poseIsValid = false;
+        pose.result = TrackingResult_Running_OutOfRange;
+        pose.deviceIsConnected = false;
+    }
+    pose.poseTimeOffset = GetSampleTuning(SampleTuning_PoseTimeOffset);
+}
+
+bool CSampleTrackedDevice::GetTransportPose(vr::DriverPose_t &pose) const
+{
+    std::lock_guard<std::mutex> lock(m_transportPoseMutex);
+    if (m_ulTransportPoseTimeNs == 0 || GetTimestampNs() - m_ulTransportPoseTimeNs > m_ulConnectionTimeoutNs) {
+        return false;
+    }
+
+    pose.vecPosition[0] = m_rdTransportPosition[0];
+    pose.vecPosition[1] = m_rdTransportPosition[1];
+    pose.vecPosition[2] = m_rdTransportPosition[2];
+    pose.qRotation = m_qTransportRotation;
+    return true;
+}
+
+void CSampleTrackedDevice::UpdatePose()
+{
+    m_ulPoseSampleTimeNs = m_ulLastDataTimeNs.load(std::memory_order_relaxed);
+    uint64_t ulStartNs = GetTimestampNs();
+    if (!IsSampleTraceEnabled()) {
+        m_pose = GetPose();
+    } else {
+        uint64_t ulStart = GetSampleTraceTicks();
+        m_pose = GetPose();
+        SampleTracePoseStage_t stage = { m_unObjectId.load(std::memory_order_relaxed), SampleTracePoseStage_Evaluate, (uint32_t)(GetSampleTraceTicks() - ulStart) };
+        SampleTrace(stage);
+    }
+    RecordSampleLatency(SampleLatencyStage_PoseEvaluate, GetTimestampNs() - ulStartNs);
+}
+
+void CSampleTrackedDevice::SubmitPose()
+{
+    vr::TrackedDeviceIndex_t unObjectId = m_unObjectId.load(std::memory_order_acquire);
+    if (unObjectId == vr::k_unTrackedDeviceIndexInvalid) {
+        return;
+    }
+
+    // a disconnected pose is only worth sending once, after that SteamVR already knows
+    if (!m_pose.deviceIsConnected && !m_bReportedConnected) {
+        return;
+    }
+    if (m_bReportedConnected != m_pose.deviceIsConnected) {
+        DRIVERLOG_INFO(DriverLogCategory_Tracking, "driver_null: %s %s\n", GetSerialNumber().c_str(), m_pose.deviceIsConnected ? "connected" : "lost its transport");
+    }
+    m_bReportedConnected = m_pose.deviceIsConnected;
+
+    if (!IsSampleTraceEnabled()) {
+        vr::VRServerDriverHost()->TrackedDevicePoseUpdated(unObjectId, m_pose, sizeof(vr::DriverPose_t));
+        OnPoseSubmitted();
+        return;
+    }
+
+    SampleTracePoseSubmit_t submit;
+    submit.unDevice = unObjectId;
+    submit.unResult = (uint32_t)m_pose.result | (m_pose.poseIsValid ? 0x80000000u : 0);
+    submit.rflPosition[0] = (float)m_pose.vecPosition[0];
+    submit.rflPosition[1] = (float)m_pose.vecPosition[1];
+    submit.rflPosition[2] = (float)m_pose.vecPosition[2];
+    SampleTrace(submit);
+
+    uint64_t ulStart = GetSampleTraceTicks();
+    vr::VRServerDriverHost()->TrackedDevicePoseUpdated(unObjectId, m_pose, sizeof(vr::DriverPose_t));
+    OnPoseSubmitted();
+    SampleTracePoseStage_t stage = { unObjectId, SampleTracePoseStage_Submit, (uint32_t)(GetSampleTraceTicks() - ulStart) };
+    SampleTrace(stage);
+}
@@ -0,0 +1,106 @@
+#ifndef CSAMPLETRACKEDDEVICE_H
+#define CSAMPLETRACKEDDEVICE_H
+
+#include <openvr_driver.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+//-----------------------------------------------------------------------------
+// Purpose: Common base of every device owned by the device registry, so the
+// server driver can walk HMDs, controllers and trackers as one flat list.
+// It also tracks when the device's transport last delivered data: a device
+// is only added to SteamVR once data arrives and reports itself disconnected
+// after the configured silence timeout.
+//-----------------------------------------------------------------------------
+class CSampleTrackedDevice : public vr::ITrackedDeviceServerDriver
+{
+public:
+    CSampleTrackedDevice();
+
+    virtual ~CSampleTrackedDevice() {}
+
+    virtual vr::ETrackedDeviceClass GetDeviceClass() const = 0;
+
+    virtual const std::string &GetSerialNumber() const = 0;
+
+    /** input and other per frame work, called from RunFrame. Poses are done by the pose thread */
+    virtual void RunFrame() {}
+
+    virtual void ProcessEvent(const vr::VREvent_t &vrEvent) {}
+
+    /** debug request from a client, shared by every device class. "help" lists the commands: "get" and "set" the
+     * tuning parameters, "pose" and "state" of this device, "trace on|off|export [path]", "log [levels]",
+     * "stats [reset]" and "frames". Parsing allocates nothing and the response never exceeds unResponseBufferSize */
+    virtual void DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize);
+
+    /** event types ProcessEvent wants to see, the event dispatcher drops everything else */
+    virtual uint32_t GetEventSubscriptions(const uint32_t **ppunEventTypes) const { *ppunEventTypes = nullptr; return 0; }
+
+    vr::TrackedDeviceIndex_t GetObjectId() const { return m_unObjectId.load(std::memory_order_acquire); }
+
+    /** true if the keyboard emulation feeds this device */
+    virtual bool IsKeyboardDriven() const { return false; }
+
+    void SetConnectionTimeout(double flSeconds) { m_ulConnectionTimeoutNs = (uint64_t)(flSeconds * 1e9); }
+
+    /** called by a transport whenever it received anything for this device */
+    void OnTransportData();
+
+    /** called by a transport with a new absolute pose for this device */
+    void OnTransportPose(const double rdPosition[3], const vr::HmdQuaternion_t &qRotation);
+
+    bool HasReceivedData() const { return m_ulLastDataTimeNs.load(std::memory_order_relaxed) != 0; }
+
+    bool IsConnected() const;
+
+    bool IsAddedToHost() const { return m_bAddedToHost; }
+
+    void SetAddedToHost() { m_bAddedToHost = true; }
+
+    void SetStandby(bool bStandby) { m_bStandby.store(bStandby, std::memory_order_relaxed); }
+
+    bool IsInStandby() const { return m_bStandby.load(std::memory_order_relaxed); }
+
+    /** the server left standby, ITrackedDeviceServerDriver has no call for it so the registry makes this one */
+    virtual void LeaveStandby() { SetStandby(false); }
+
+    /** evaluates the pose of this tick, runs on any thread of the worker pool */
+    void UpdatePose();
+
+    /** hands the pose of this tick to SteamVR, pose thread only */
+    void SubmitPose();
+
+    /** poses handed to SteamVR since the device was created */
+    uint64_t GetPosesSubmitted() const { return m_ulPosesSubmitted.load(std::memory_order_relaxed); }
+
+protected:
+    /** sets deviceIsConnected, poseIsValid and result of a pose from the transport state, and the tuned poseTimeOffset */
+    void FillConnectionState(vr::DriverPose_t &pose) const;
+
+    /** copies the last transport pose into the pose, returns false if there is no recent one */
+    bool GetTransportPose(vr::DriverPose_t &pose) const;
+
+    // set by Activate on SteamVR's thread, read by the pose thread
+    std::atomic<vr::TrackedDeviceIndex_t> m_unObjectId;
+
+private:
+    void OnPoseSubmitted();
+
+    std::atomic<uint64_t> m_ulLastDataTimeNs;
+    std::atomic<bool> m_bStandby;
+    std::atomic<uint64_t> m_ulPosesSubmitted;
+    uint64_t m_ulConnectionTimeoutNs;
+    bool m_bAddedToHost;
+    bool m_bReportedConnected;
+    vr::DriverPose_t m_pose;
+    uint64_t m_ulPoseSampleTimeNs;   // transport data m_pose was evaluated from
+
+    mutable std::mutex m_transportPoseMutex;
+    uint64_t m_ulTransportPoseTimeNs;
+    double m_rdTransportPosition[3];
+    vr::HmdQuaternion_t m_qTransportRotation;
+};
+
+#endif // CSAMPLETRACKEDDEVICE_H
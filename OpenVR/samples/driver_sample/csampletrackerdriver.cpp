@@ -0,0 +1,78 @@
+#include "csampletrackerdriver.h"
+#include "basics.h"
+
+#include <stdio.h>
+
+using namespace vr;
+
+CSampleTrackerDriver::CSampleTrackerDriver()
+{
+    m_ulPropertyContainer = vr::k_ulInvalidPropertyContainer;
+    m_nTrackerIndex = 0;
+}
+
+CSampleTrackerDriver::~CSampleTrackerDriver()
+{
+}
+
+void CSampleTrackerDriver::SetTrackerIndex(int32_t nTrackerIndex)
+{
+    m_nTrackerIndex = nTrackerIndex;
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "TRK%dSerial", nTrackerIndex);
+    m_sSerialNumber = buf;
+}
+
+EVRInitError CSampleTrackerDriver::Activate(TrackedDeviceIndex_t unObjectId)
+{
+    m_unObjectId = unObjectId;
+    m_ulPropertyContainer = vr::VRProperties()->TrackedDeviceToPropertyContainer(m_unObjectId);
+
+    vr::VRProperties()->SetStringProperty(m_ulPropertyContainer, Prop_ModelNumber_String, "DIY Tracker");
+    vr::VRProperties()->SetStringProperty(m_ulPropertyContainer, Prop_RenderModelName_String, "{htc}vr_tracker_vive_1_0");
+    vr::VRProperties()->SetStringProperty(m_ulPropertyContainer, Prop_TrackingSystemName_String, "VR Tracker");
+    vr::VRProperties()->SetStringProperty(m_ulPropertyContainer, Prop_SerialNumber_String, m_sSerialNumber.c_str());
+    vr::VRProperties()->SetInt32Property(m_ulPropertyContainer, Prop_DeviceClass_Int32, TrackedDeviceClass_GenericTracker);
+
+    // body trackers never take part in left/right hand selection
+    vr::VRProperties()->SetInt32Property(m_ulPropertyContainer, Prop_ControllerRoleHint_Int32, TrackedControllerRole_OptOut);
+
+    return VRInitError_None;
+}
+
+void CSampleTrackerDriver::Deactivate()
+{
+    m_unObjectId = vr::k_unTrackedDeviceIndexInvalid;
+}
+
+void CSampleTrackerDriver::EnterStandby()
+{
+    // no more poses from this device until the server leaves standby
+    SetStandby(true);
+}
+
+void *CSampleTrackerDriver::GetComponent(const char *pchComponentNameAndVersion)
+{
+    // override this to add a component to a driver
+    return NULL;
+}
+
+void CSampleTrackerDriver::PowerOff()
+{
+}
+
+DriverPose_t CSampleTrackerDriver::GetPose()
+{
+    DriverPose_t pose = { 0 };
+    FillConnectionState(pose);
+
+    pose.qWorldFromDriverRotation = HmdQuaternion_Init(1, 0, 0, 0);
+    pose.qDriverFromHeadRotation = HmdQuaternion_Init(1, 0, 0, 0);
+    pose.qRotation = HmdQuaternion_Init(1, 0, 0, 0);
+
+    //Trackers only move through the transport
+    GetTransportPose(pose);
+
+    return pose;
+}
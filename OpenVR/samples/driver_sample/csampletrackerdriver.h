@@ -0,0 +1,42 @@
+#ifndef CSAMPLETRACKERDRIVER_H
+#define CSAMPLETRACKERDRIVER_H
+
+#include <openvr_driver.h>
+#include "csampletrackeddevice.h"
+
+//-----------------------------------------------------------------------------
+// Purpose: Generic (body) tracker without any input components
+//-----------------------------------------------------------------------------
+class CSampleTrackerDriver : public CSampleTrackedDevice
+{
+public:
+    CSampleTrackerDriver();
+
+    virtual ~CSampleTrackerDriver();
+
+    void SetTrackerIndex(int32_t nTrackerIndex);
+
+    virtual vr::EVRInitError Activate(vr::TrackedDeviceIndex_t unObjectId);
+
+    virtual void Deactivate();
+
+    virtual void EnterStandby();
+
+    void *GetComponent(const char *pchComponentNameAndVersion);
+
+    virtual void PowerOff();
+
+    virtual vr::DriverPose_t GetPose();
+
+    virtual vr::ETrackedDeviceClass GetDeviceClass() const { return vr::TrackedDeviceClass_GenericTracker; }
+
+    virtual const std::string &GetSerialNumber() const { return m_sSerialNumber; }
+
+private:
+    vr::PropertyContainerHandle_t m_ulPropertyContainer;
+
+    int32_t m_nTrackerIndex;
+    std::string m_sSerialNumber;
+};
+
+#endif // CSAMPLETRACKERDRIVER_H
@@ -0,0 +1,44 @@
+#include "csampletuning.h"
+
+#include <string.h>
+
+static const SampleTuningInfo_t k_rgTuningInfo[SampleTuning_Count] = {
+    { "poseRate", 90.0f, 1.0f, 2000.0f },
+    { "standbyPoseRate", 1.0f, 0.01f, 2000.0f },
+    { "poseTimeOffset", 0.0f, -1.0f, 1.0f },
+    { "hmdTurnStep", 0.01f, 0.0f, 1.0f },
+    { "hmdMoveStep", 0.01f, 0.0f, 1.0f },
+    { "controllerTurnStep", 0.1f, 0.0f, 1.0f },
+    { "controllerMoveStep", 0.01f, 0.0f, 1.0f },
+};
+
+std::atomic<float> g_rgflSampleTuning[SampleTuning_Count] = {
+    { 90.0f }, { 1.0f }, { 0.0f }, { 0.01f }, { 0.01f }, { 0.1f }, { 0.01f },
+};
+
+bool SetSampleTuning(ESampleTuning eTuning, float flValue)
+{
+    const SampleTuningInfo_t &info = k_rgTuningInfo[eTuning];
+    // written so NaN fails too
+    if (!(flValue >= info.flMin && flValue <= info.flMax)) {
+        return false;
+    }
+    g_rgflSampleTuning[eTuning].store(flValue, std::memory_order_relaxed);
+    return true;
+}
+
+const SampleTuningInfo_t &GetSampleTuningInfo(ESampleTuning eTuning)
+{
+    return k_rgTuningInfo[eTuning];
+}
+
+bool FindSampleTuning(const char *pchName, size_t cchName, ESampleTuning *peTuning)
+{
+    for (uint32_t i = 0; i < SampleTuning_Count; i++) {
+        if (strlen(k_rgTuningInfo[i].pchName) == cchName && !strncmp(k_rgTuningInfo[i].pchName, pchName, cchName)) {
+            *peTuning = (ESampleTuning)i;
+            return true;
+        }
+    }
+    return false;
+}
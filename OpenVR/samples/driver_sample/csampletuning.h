@@ -0,0 +1,45 @@
+#ifndef CSAMPLETUNING_H
+#define CSAMPLETUNING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// parameters that can be changed while the driver runs, see the "set" debug request
+enum ESampleTuning
+{
+    SampleTuning_PoseRate,              // pose thread ticks per second
+    SampleTuning_StandbyPoseRate,       // the same in standby
+    SampleTuning_PoseTimeOffset,        // DriverPose_t::poseTimeOffset of every pose, SteamVR predicts from it
+    SampleTuning_HmdTurnStep,           // keyboard emulation, radians and metres per pose tick
+    SampleTuning_HmdMoveStep,
+    SampleTuning_ControllerTurnStep,
+    SampleTuning_ControllerMoveStep,
+    SampleTuning_Count
+};
+
+struct SampleTuningInfo_t
+{
+    const char *pchName;
+    float flDefault;
+    float flMin;
+    float flMax;
+};
+
+extern std::atomic<float> g_rgflSampleTuning[SampleTuning_Count];
+
+/** one relaxed load, cheap enough for the pose thread */
+inline float GetSampleTuning(ESampleTuning eTuning)
+{
+    return g_rgflSampleTuning[eTuning].load(std::memory_order_relaxed);
+}
+
+/** returns false and changes nothing when the value is outside the range of the parameter */
+bool SetSampleTuning(ESampleTuning eTuning, float flValue);
+
+const SampleTuningInfo_t &GetSampleTuningInfo(ESampleTuning eTuning);
+
+/** looks a parameter up by the first cchName characters of pchName */
+bool FindSampleTuning(const char *pchName, size_t cchName, ESampleTuning *peTuning);
+
+#endif // CSAMPLETUNING_H
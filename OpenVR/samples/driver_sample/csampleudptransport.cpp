@@ -0,0 +1,247 @@
+#if defined(_WINDOWS)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define closesocket close
+#endif
+
+#include "csampleudptransport.h"
+#include "csampledeviceregistry.h"
+
+#include "basics.h"
+#include "csampleframemonitor.h"
+#include "csamplelatencystats.h"
+#include "csampletrace.h"
+#include "driverlog.h"
+
+#include <math.h>
+#include <string.h>
+
+using namespace vr;
+
+static const intptr_t k_hInvalidSocket = -1;
+
+bool DecodeSamplePosePacket(const uint8_t *pData, size_t cbData, SamplePosePacket_t *pPacket)
+{
+    if (cbData < sizeof(SamplePosePacket_t)) {
+        return false;
+    }
+    memcpy(pPacket, pData, sizeof(SamplePosePacket_t));
+    return pPacket->unMagic == k_unSamplePosePacketMagic;
+}
+
+size_t EncodeSamplePosePacket(const SamplePosePacket_t &packet, uint8_t *pData, size_t cbData)
+{
+    if (cbData < sizeof(SamplePosePacket_t)) {
+        return 0;
+    }
+    memcpy(pData, &packet, sizeof(SamplePosePacket_t));
+    return sizeof(SamplePosePacket_t);
+}
+
+static inline void IncrementCounter(std::atomic<uint64_t> &ulCounter, uint64_t ulAmount = 1)
+{
+    ulCounter.store(ulCounter.load(std::memory_order_relaxed) + ulAmount, std::memory_order_relaxed);
+}
+
+// senders may drift off unit length, false if the pose has a non-finite value or no usable rotation
+static bool NormalizePosePacket(SamplePosePacket_t *pPacket)
+{
+    for (int i = 0; i < 3; i++) {
+        if (!isfinite(pPacket->rfPosition[i])) {
+            return false;
+        }
+    }
+
+    double dNormSquared = 0.0;
+    for (int i = 0; i < 4; i++) {
+        if (!isfinite(pPacket->rfRotation[i])) {
+            return false;
+        }
+        dNormSquared += (double)pPacket->rfRotation[i] * pPacket->rfRotation[i];
+    }
+    if (dNormSquared < 1e-12) {
+        return false;
+    }
+
+    double dNorm = sqrt(dNormSquared);
+    for (int i = 0; i < 4; i++) {
+        pPacket->rfRotation[i] = (float)(pPacket->rfRotation[i] / dNorm);
+    }
+    return true;
+}
+
+CSampleUdpTransport::CSampleUdpTransport()
+    : m_bRunning(false), m_ulDatagrams(0), m_ulPackets(0), m_ulUnknownSlot(0), m_ulTrailingBytes(0), m_ulRejectedPoses(0), m_ulSequenceGaps(0), m_ulRestartFailures(0)
+{
+    m_pRegistry = nullptr;
+    m_usPort = 0;
+    m_hSocket = k_hInvalidSocket;
+    m_pThread = nullptr;
+}
+
+CSampleUdpTransport::~CSampleUdpTransport()
+{
+    Stop();
+}
+
+bool CSampleUdpTransport::Start(uint16_t usPort, CSampleDeviceRegistry *pRegistry)
+{
+    if (m_pThread) {
+        return false;
+    }
+
+#if defined(_WINDOWS)
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+#endif
+
+    // only listen on localhost, anything coming from the network goes through a bridge process
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(usPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    intptr_t hSocket = (intptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (hSocket == k_hInvalidSocket) {
+        return false;
+    }
+    if (bind(hSocket, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        closesocket(hSocket);
+        return false;
+    }
+
+    m_pRegistry = pRegistry;
+    m_usPort = usPort;
+    m_vecNextSequence.assign(pRegistry->GetDeviceCount(), 0);
+    m_hSocket = hSocket;
+    m_bRunning = true;
+    m_pThread = new std::thread(&CSampleUdpTransport::ThreadFunction, this);
+    return true;
+}
+
+void CSampleUdpTransport::Stop()
+{
+    m_bRunning = false;
+    if (m_pThread) {
+        m_pThread->join();
+        delete m_pThread;
+        m_pThread = nullptr;
+    }
+    if (m_hSocket != k_hInvalidSocket) {
+        closesocket(m_hSocket);
+        m_hSocket = k_hInvalidSocket;
+#if defined(_WINDOWS)
+        WSACleanup();
+#endif
+    }
+}
+
+void CSampleUdpTransport::SetStandby(bool bStandby)
+{
+    // never started, so there is nothing to close or reopen
+    if (m_usPort == 0) {
+        return;
+    }
+
+    // a port that can't be bound again leaves every device disconnected, the next LeaveStandby tries again
+    if (bStandby) {
+        Stop();
+    } else if (!m_pThread && !Start(m_usPort, m_pRegistry)) {
+        DRIVERLOG_ERROR(DriverLogCategory_Transport, "driver_null: unable to open transport port %d again after standby\n", (int)m_usPort);
+        IncrementCounter(m_ulRestartFailures);
+    }
+}
+
+void CSampleUdpTransport::GetCounters(SampleTransportCounters_t *pCounters) const
+{
+    pCounters->ulDatagrams = m_ulDatagrams.load(std::memory_order_relaxed);
+    pCounters->ulPackets = m_ulPackets.load(std::memory_order_relaxed);
+    pCounters->ulUnknownSlot = m_ulUnknownSlot.load(std::memory_order_relaxed);
+    pCounters->ulTrailingBytes = m_ulTrailingBytes.load(std::memory_order_relaxed);
+    pCounters->ulRejectedPoses = m_ulRejectedPoses.load(std::memory_order_relaxed);
+    pCounters->ulSequenceGaps = m_ulSequenceGaps.load(std::memory_order_relaxed);
+    pCounters->ulRestartFailures = m_ulRestartFailures.load(std::memory_order_relaxed);
+}
+
+void CSampleUdpTransport::ThreadFunction()
+{
+    uint8_t buf[1500];
+    SetSampleTraceThreadName("transport");
+
+    while (m_bRunning) {
+        // wake up regularly so Stop() never waits long for the thread
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(m_hSocket, &readSet);
+        timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = 100000;
+        if (select((int)m_hSocket + 1, &readSet, NULL, NULL, &timeout) <= 0) {
+            continue;
+        }
+
+        int cbReceived = (int)recvfrom(m_hSocket, (char *)buf, sizeof(buf), 0, NULL, NULL);
+        if (cbReceived > 0) {
+            uint64_t ulReceived = GetTimestampNs();
+            HandleDatagram(buf, (size_t)cbReceived);
+            RecordSampleLatency(SampleLatencyStage_TransportDecode, GetTimestampNs() - ulReceived);
+        }
+    }
+}
+
+void CSampleUdpTransport::HandleDatagram(const uint8_t *pData, size_t cbData)
+{
+    uint32_t cbDatagram = (uint32_t)cbData;
+    CSampleTraceScope scope(SampleTraceScope_TransportDatagram, cbDatagram);
+    CSampleActivityScope activity(SampleActivityThread_Transport, SampleTraceScope_TransportDatagram);
+    IncrementCounter(m_ulDatagrams);
+    SamplePosePacket_t packet;
+    while (DecodeSamplePosePacket(pData, cbData, &packet)) {
+        pData += sizeof(SamplePosePacket_t);
+        cbData -= sizeof(SamplePosePacket_t);
+        IncrementCounter(m_ulPackets);
+
+        SampleTraceTransportReceive_t receive = { packet.unDeviceSlot, packet.unSequence, packet.unFlags, cbDatagram };
+        SampleTrace(receive);
+
+        if (packet.unDeviceSlot >= m_pRegistry->GetDeviceCount()) {
+            DRIVERLOG_VERBOSE(DriverLogCategory_Transport, "driver_null: packet %u for device slot %u, only %u devices\n", packet.unSequence, packet.unDeviceSlot, m_pRegistry->GetDeviceCount());
+            IncrementCounter(m_ulUnknownSlot);
+            continue;
+        }
+
+        // a sender that restarts begins again at a lower sequence, that's not counted as a gap
+        uint32_t &unNextSequence = m_vecNextSequence[packet.unDeviceSlot];
+        if (unNextSequence != 0 && packet.unSequence > unNextSequence) {
+            IncrementCounter(m_ulSequenceGaps, packet.unSequence - unNextSequence);
+        }
+        unNextSequence = packet.unSequence + 1;
+        DRIVERLOG_DEBUG(DriverLogCategory_Transport, "driver_null: packet %u slot %u flags 0x%x\n", packet.unSequence, packet.unDeviceSlot, packet.unFlags);
+
+        CSampleTrackedDevice *pDevice = m_pRegistry->GetDevice(packet.unDeviceSlot);
+        if (packet.unFlags & k_unSamplePosePacketFlag_Heartbeat) {
+            pDevice->OnTransportData();
+        } else if (!NormalizePosePacket(&packet)) {
+            DRIVERLOG_VERBOSE(DriverLogCategory_Transport, "driver_null: rejecting pose packet %u for slot %u, non-finite value or zero rotation\n", packet.unSequence, packet.unDeviceSlot);
+            IncrementCounter(m_ulRejectedPoses);
+        } else {
+            double rdPosition[3] = { packet.rfPosition[0], packet.rfPosition[1], packet.rfPosition[2] };
+            pDevice->OnTransportPose(rdPosition, HmdQuaternion_Init(packet.rfRotation[0], packet.rfRotation[1], packet.rfRotation[2], packet.rfRotation[3]));
+        }
+    }
+    if (cbData > 0) {
+        DRIVERLOG_VERBOSE(DriverLogCategory_Transport, "driver_null: ignoring %u bytes of a %u byte datagram\n", (uint32_t)cbData, cbDatagram);
+        IncrementCounter(m_ulTrailingBytes);
+    }
+}
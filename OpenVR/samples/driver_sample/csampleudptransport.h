@@ -0,0 +1,94 @@
+#ifndef CSAMPLEUDPTRANSPORT_H
+#define CSAMPLEUDPTRANSPORT_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class CSampleDeviceRegistry;
+
+// Wire format of one pose sample. A datagram carries one or more of them back to
+// back, little endian, addressed by the device's slot in the registry (HMDs first,
+// then controllers, then trackers, all counted from 0).
+#pragma pack(push, 1)
+struct SamplePosePacket_t
+{
+    uint32_t unMagic;
+    uint16_t unDeviceSlot;
+    uint16_t unFlags;
+    uint32_t unSequence;
+    float rfPosition[3];
+    float rfRotation[4]; // w, x, y, z
+};
+#pragma pack(pop)
+
+static const uint32_t k_unSamplePosePacketMagic = 0x50594944; // "DIYP"
+
+// the packet only keeps the device alive and carries no pose
+static const uint16_t k_unSamplePosePacketFlag_Heartbeat = 0x0001;
+
+/** decodes the packet at pData, returns false if it is truncated or not one of ours */
+bool DecodeSamplePosePacket(const uint8_t *pData, size_t cbData, SamplePosePacket_t *pPacket);
+
+// what the transport received since the driver started, for the metrics
+struct SampleTransportCounters_t
+{
+    uint64_t ulDatagrams;
+    uint64_t ulPackets;            // decoded pose and heartbeat packets
+    uint64_t ulUnknownSlot;        // packets for a device slot that doesn't exist
+    uint64_t ulTrailingBytes;      // datagrams with bytes left that weren't a packet
+    uint64_t ulRejectedPoses;      // pose packets with a non-finite value or a zero rotation
+    uint64_t ulSequenceGaps;       // packets missing from a device's sequence numbers, lost or reordered on the way
+    uint64_t ulRestartFailures;    // times the port couldn't be opened again after standby
+};
+
+/** encodes a packet into pData, returns the number of bytes written or 0 if it doesn't fit */
+size_t EncodeSamplePosePacket(const SamplePosePacket_t &packet, uint8_t *pData, size_t cbData);
+
+//-----------------------------------------------------------------------------
+// Purpose: Receives pose packets on a localhost UDP port and hands them to the
+// devices of the registry. The first packet for a device is what gets it added
+// to SteamVR.
+//-----------------------------------------------------------------------------
+class CSampleUdpTransport
+{
+public:
+    CSampleUdpTransport();
+
+    ~CSampleUdpTransport();
+
+    bool Start(uint16_t usPort, CSampleDeviceRegistry *pRegistry);
+
+    void Stop();
+
+    /** closes the socket while SteamVR is in standby and opens it again afterwards */
+    void SetStandby(bool bStandby);
+
+    /** safe from any thread, each counter is read atomically */
+    void GetCounters(SampleTransportCounters_t *pCounters) const;
+
+private:
+    void ThreadFunction();
+
+    void HandleDatagram(const uint8_t *pData, size_t cbData);
+
+    CSampleDeviceRegistry *m_pRegistry;
+    uint16_t m_usPort;
+    intptr_t m_hSocket;
+    std::thread *m_pThread;
+    std::atomic<bool> m_bRunning;
+
+    // written by the transport thread only
+    std::atomic<uint64_t> m_ulDatagrams;
+    std::atomic<uint64_t> m_ulPackets;
+    std::atomic<uint64_t> m_ulUnknownSlot;
+    std::atomic<uint64_t> m_ulTrailingBytes;
+    std::atomic<uint64_t> m_ulRejectedPoses;
+    std::atomic<uint64_t> m_ulSequenceGaps;
+    std::atomic<uint64_t> m_ulRestartFailures;   // by SetStandby(), while the thread isn't running
+    std::vector<uint32_t> m_vecNextSequence;   // per device slot, 0 until the first packet
+};
+
+#endif // CSAMPLEUDPTRANSPORT_H
@@ -0,0 +1,160 @@
+#include "csamplevirtualdisplay.h"
+
+#include "basics.h"
+
+#include <string.h>
+
+using namespace vr;
+
+CSampleVirtualDisplay::CSampleVirtualDisplay()
+    : m_ulPresentVsync(0), m_ulPresentedFrames(0), m_ulTimedFrames(0), m_ulBusyNs(0), m_ulMissedVsyncs(0)
+{
+    m_pVsyncClock = nullptr;
+    m_pLensModel = nullptr;
+    m_pPoseSource = nullptr;
+    m_bReprojected = false;
+    m_ulReprojectNs = 0;
+    m_ulRemapNs = 0;
+}
+
+CSampleVirtualDisplay::~CSampleVirtualDisplay()
+{
+    Close();
+}
+
+bool CSampleVirtualDisplay::Open(const char *pchExportName, uint32_t unWidth, uint32_t unHeight, const CSampleVsyncClock *pVsyncClock, bool bPixels)
+{
+    if (!m_frameExport.Create(pchExportName, unWidth, unHeight, bPixels)) {
+        return false;
+    }
+
+    m_pVsyncClock = pVsyncClock;
+    m_ulPresentVsync = 0;
+    m_ulPresentedFrames = 0;
+    m_ulTimedFrames = 0;
+    m_ulBusyNs = 0;
+    m_ulMissedVsyncs = 0;
+    return true;
+}
+
+void CSampleVirtualDisplay::Close()
+{
+    m_remapPool.Stop();
+    m_frameExport.Close();
+}
+
+void CSampleVirtualDisplay::SetDistortion(const CSampleLensModel *pLensModel, uint32_t unThreads)
+{
+    m_pLensModel = pLensModel;
+    m_remapPool.Stop();
+    m_remapPool.Start(unThreads, -1);
+}
+
+void CSampleVirtualDisplay::SetReprojection(vr::ITrackedDeviceServerDriver *pPoseSource, const float rgflProjection[2][4])
+{
+    m_pPoseSource = pPoseSource;
+    m_remap.SetProjection(rgflProjection);
+}
+
+void CSampleVirtualDisplay::Present(const vr::PresentInfo_t *pPresentInfo, uint32_t unPresentInfoSize)
+{
+    if (!m_frameExport.IsOpen() || unPresentInfoSize < sizeof(vr::PresentInfo_t)) {
+        return;
+    }
+
+    // the backbuffer stays on the GPU, consumers that want pixels open the shared handle themselves
+    PublishFrame(pPresentInfo, false, 0);
+}
+
+void CSampleVirtualDisplay::PresentPixels(const vr::PresentInfo_t *pPresentInfo, const uint8_t *pRgba, uint32_t unStride, uint32_t unWidth, uint32_t unHeight,
+    const vr::HmdQuaternion_t *pRenderRotation)
+{
+    if (!m_frameExport.IsOpen() || !m_frameExport.HasPixels()) {
+        return;
+    }
+
+    uint8_t *pPixels = m_frameExport.GetWritePixels();
+    uint32_t unExportWidth = m_frameExport.GetWidth();
+    uint32_t unExportHeight = m_frameExport.GetHeight();
+    m_ulReprojectNs = 0;
+    m_ulRemapNs = 0;
+    if (m_pLensModel || m_pPoseSource) {
+        // the tables only depend on the sizes, the lens doesn't change while the display is up
+        if (!m_remap.Matches(unWidth, unHeight, unExportWidth, unExportHeight)) {
+            m_remap.Build(m_pLensModel ? *m_pLensModel : m_identityLens, unWidth, unHeight, unExportWidth, unExportHeight);
+            m_bReprojected = false;
+        }
+
+        // as late as possible, the rotation from the rendered head to the latest one goes into the nodes
+        uint64_t ulStart = GetTimestampNs();
+        if (m_pPoseSource && m_remap.CanReproject() && (pRenderRotation || m_bReprojected)) {
+            vr::HmdQuaternion_t qDelta = HmdQuaternion_Init(1, 0, 0, 0);
+            if (pRenderRotation) {
+                vr::HmdQuaternion_t qLatest = m_pPoseSource->GetPose().qRotation;
+                qDelta = HmdQuaternion_Multiply(HmdQuaternion_Conjugate(*pRenderRotation), qLatest);
+            }
+            m_remap.Reproject(qDelta, &m_remapPool);
+            m_bReprojected = pRenderRotation != nullptr;
+        }
+        uint64_t ulReprojected = GetTimestampNs();
+        m_remap.Remap(pRgba, unStride, pPixels, m_frameExport.GetStride(), &m_remapPool);
+        m_ulReprojectNs = ulReprojected - ulStart;
+        m_ulRemapNs = GetTimestampNs() - ulReprojected;
+    } else {
+        uint32_t unRowBytes = (unWidth < unExportWidth ? unWidth : unExportWidth) * 4;
+        uint32_t unRows = unHeight < unExportHeight ? unHeight : unExportHeight;
+        for (uint32_t y = 0; y < unRows; y++) {
+            memcpy(pPixels + (size_t)y * m_frameExport.GetStride(), pRgba + (size_t)y * unStride, unRowBytes);
+        }
+    }
+    PublishFrame(pPresentInfo, true, m_ulReprojectNs + m_ulRemapNs);
+}
+
+void CSampleVirtualDisplay::PublishFrame(const vr::PresentInfo_t *pPresentInfo, bool bPixelsValid, uint64_t ulWarpNs)
+{
+    uint64_t ulNow = GetTimestampNs();
+    SampleFrameInfo_t *pInfo = m_frameExport.GetWriteInfo();
+    pInfo->ulFrameId = pPresentInfo->nFrameId;
+    pInfo->ulSharedTexture = (uint64_t)pPresentInfo->backbufferTextureHandle;
+    pInfo->flVsyncTimeInSeconds = pPresentInfo->flVSyncTimeInSeconds;
+    pInfo->ulPresentNs = ulNow;
+    pInfo->unPixelsValid = bPixelsValid ? 1 : 0;
+    pInfo->unWarpMicroseconds = (uint32_t)(ulWarpNs / 1000);
+    m_frameExport.Publish();
+
+    // from the grid, the clock thread may not have ticked yet for a vsync that is already due
+    uint64_t ulVsync = m_pVsyncClock->GetVsyncCounterAt(ulNow);
+    uint64_t ulPreviousVsync = m_ulPresentVsync.load(std::memory_order_relaxed);
+    m_ulPresentVsync.store(ulVsync, std::memory_order_relaxed);
+
+    // WaitForPresent released this frame at the vsync after the previous Present, the rest is how long it took
+    if (m_ulPresentedFrames.fetch_add(1, std::memory_order_relaxed) > 0) {
+        uint64_t ulStartNs = m_pVsyncClock->GetVsyncTimeNs(ulPreviousVsync + 1);
+        m_ulBusyNs.fetch_add(ulNow > ulStartNs ? ulNow - ulStartNs : 0, std::memory_order_relaxed);
+        if (ulVsync > ulPreviousVsync + 1) {
+            m_ulMissedVsyncs.fetch_add(ulVsync - ulPreviousVsync - 1, std::memory_order_relaxed);
+        }
+        m_ulTimedFrames.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void CSampleVirtualDisplay::GetFrameTiming(SampleFrameTiming_t *pTiming) const
+{
+    pTiming->ulFrames = m_ulTimedFrames.load(std::memory_order_acquire);
+    pTiming->ulBusyNs = m_ulBusyNs.load(std::memory_order_relaxed);
+    pTiming->ulMissedVsyncs = m_ulMissedVsyncs.load(std::memory_order_relaxed);
+}
+
+void CSampleVirtualDisplay::WaitForPresent()
+{
+    // the presented frame starts scanning out at the first vsync after Present
+    m_pVsyncClock->WaitForVsync(m_ulPresentVsync.load(std::memory_order_relaxed) + 1);
+}
+
+bool CSampleVirtualDisplay::GetTimeSinceLastVsync(float *pfSecondsSinceLastVsync, uint64_t *pulFrameCounter)
+{
+    uint64_t ulNow = GetTimestampNs();
+    *pulFrameCounter = m_pVsyncClock->GetVsyncCounterAt(ulNow);
+    *pfSecondsSinceLastVsync = (float)((ulNow - m_pVsyncClock->GetVsyncTimeNs(*pulFrameCounter)) * 1e-9);
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef CSAMPLEVIRTUALDISPLAY_H
+#define CSAMPLEVIRTUALDISPLAY_H
+
+#include <openvr_driver.h>
+#include "csampledistortionremap.h"
+#include "csampleframeexport.h"
+#include "csamplelensmodel.h"
+#include "csamplevsyncclock.h"
+#include "csampleworkerpool.h"
+
+#include <atomic>
+#include <stdint.h>
+
+// running totals of the frames presented since Open(), for deltas between two reads
+struct SampleFrameTiming_t
+{
+    uint64_t ulFrames;          // presents that followed another one
+    uint64_t ulBusyNs;          // summed time from the vsync each frame could start at until its Present
+    uint64_t ulMissedVsyncs;    // vsyncs that went by without a new frame
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: IVRVirtualDisplay for HMDs whose panel belongs to another process
+// (a phone, a streaming client). Every Present() is published through a
+// CSampleFrameExport triple buffer with the frame id, vsync time and the
+// shared backbuffer handle. Vsync timing comes from the HMD's software vsync
+// clock. Frames that reach the driver as CPU pixels go through
+// PresentPixels() instead, pre-warped for the lens when SetDistortion() was
+// called, for clients that can't apply the distortion themselves. With
+// SetReprojection() those frames are also turned by the head rotation
+// between their render pose and the latest GetPose() of the HMD, late in
+// the same pass.
+//-----------------------------------------------------------------------------
+class CSampleVirtualDisplay : public vr::IVRVirtualDisplay
+{
+public:
+    CSampleVirtualDisplay();
+
+    virtual ~CSampleVirtualDisplay();
+
+    /** bPixels maps the pixel slots PresentPixels() fills, Present() alone only exports metadata */
+    bool Open(const char *pchExportName, uint32_t unWidth, uint32_t unHeight, const CSampleVsyncClock *pVsyncClock, bool bPixels);
+
+    void Close();
+
+    bool IsOpen() const { return m_frameExport.IsOpen(); }
+
+    /** warp frames from PresentPixels() through the lens on unThreads extra worker threads, the model must outlive the display. A null model only reprojects */
+    void SetDistortion(const CSampleLensModel *pLensModel, uint32_t unThreads);
+
+    /** reproject frames from PresentPixels() to the latest pose of pPoseSource, the projection is the HMD's GetProjectionRaw */
+    void SetReprojection(vr::ITrackedDeviceServerDriver *pPoseSource, const float rgflProjection[2][4]);
+
+    /**
+     * like Present(), with the side by side RGBA frame in pRgba, scaled to the export size by the remap or copied as is.
+     * pRenderRotation is the head rotation the frame was rendered for, null skips the reprojection.
+     */
+    void PresentPixels(const vr::PresentInfo_t *pPresentInfo, const uint8_t *pRgba, uint32_t unStride, uint32_t unWidth, uint32_t unHeight,
+        const vr::HmdQuaternion_t *pRenderRotation);
+
+    /** cost of the last PresentPixels() */
+    void GetWarpTimes(uint64_t *pulReprojectNs, uint64_t *pulRemapNs) const { *pulReprojectNs = m_ulReprojectNs; *pulRemapNs = m_ulRemapNs; }
+
+    virtual void Present(const vr::PresentInfo_t *pPresentInfo, uint32_t unPresentInfoSize);
+
+    virtual void WaitForPresent();
+
+    virtual bool GetTimeSinceLastVsync(float *pfSecondsSinceLastVsync, uint64_t *pulFrameCounter);
+
+    uint64_t GetPresentedFrames() const { return m_ulPresentedFrames.load(std::memory_order_relaxed); }
+
+    void GetFrameTiming(SampleFrameTiming_t *pTiming) const;
+
+private:
+    void PublishFrame(const vr::PresentInfo_t *pPresentInfo, bool bPixelsValid, uint64_t ulWarpNs);
+
+    CSampleFrameExport m_frameExport;
+    const CSampleVsyncClock *m_pVsyncClock;
+
+    const CSampleLensModel *m_pLensModel;
+    CSampleLensModel m_identityLens; // for reprojection without distortion
+    vr::ITrackedDeviceServerDriver *m_pPoseSource;
+    CSampleDistortionRemap m_remap;
+    CSampleWorkerPool m_remapPool;
+    bool m_bReprojected;
+    uint64_t m_ulReprojectNs;
+    uint64_t m_ulRemapNs;
+
+    std::atomic<uint64_t> m_ulPresentVsync;
+    std::atomic<uint64_t> m_ulPresentedFrames;
+    std::atomic<uint64_t> m_ulTimedFrames;
+    std::atomic<uint64_t> m_ulBusyNs;
+    std::atomic<uint64_t> m_ulMissedVsyncs;
+};
+
+#endif // CSAMPLEVIRTUALDISPLAY_H
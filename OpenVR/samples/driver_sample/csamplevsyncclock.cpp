@@ -0,0 +1,217 @@
+#include "csamplevsyncclock.h"
+
+#include "basics.h"
+#include "driverlog.h"
+
+#include <chrono>
+#include <stdio.h>
+
+#if !defined(_WINDOWS)
+#include <errno.h>
+#include <time.h>
+#endif
+
+static const uint64_t k_ulJitterReportIntervalNs = 10000000000ull;
+
+// GetTimestampNs() is steady_clock, which is CLOCK_MONOTONIC on Linux
+static void SleepUntilNs(uint64_t ulDeadlineNs)
+{
+#if !defined(_WINDOWS)
+    timespec deadline;
+    deadline.tv_sec = (time_t)(ulDeadlineNs / 1000000000ull);
+    deadline.tv_nsec = (long)(ulDeadlineNs % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+#else
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(ulDeadlineNs)));
+#endif
+}
+
+CSampleVsyncClock::CSampleVsyncClock()
+    : m_bRunning(false), m_unGridSequence(0), m_nOriginNs(0), m_ulFrameIntervalNs(1000000000ull / 60), m_ulCounter(0), m_ulJitterMaxNs(0)
+{
+    m_pThread = nullptr;
+    m_bNotifyHost = false;
+    m_bMeasureJitter = false;
+    ResetJitterHistogram();
+}
+
+CSampleVsyncClock::~CSampleVsyncClock()
+{
+    Stop();
+}
+
+void CSampleVsyncClock::Start(float flFrequency, bool bNotifyHost, bool bMeasureJitter)
+{
+    if (m_pThread) {
+        return;
+    }
+
+    m_ulFrameIntervalNs = (uint64_t)(1e9 / (flFrequency > 1.0f ? flFrequency : 60.0f));
+    m_nOriginNs = (int64_t)GetTimestampNs();
+    m_ulCounter = 0;
+    m_bNotifyHost = bNotifyHost;
+    m_bMeasureJitter = bMeasureJitter;
+    ResetJitterHistogram();
+
+    m_bRunning = true;
+    m_pThread = new std::thread(&CSampleVsyncClock::ThreadFunction, this);
+}
+
+void CSampleVsyncClock::Resume()
+{
+    if (m_pThread) {
+        return;
+    }
+
+    m_bRunning = true;
+    m_pThread = new std::thread(&CSampleVsyncClock::ThreadFunction, this);
+}
+
+void CSampleVsyncClock::Stop()
+{
+    m_bRunning = false;
+    if (m_pThread) {
+        m_pThread->join();
+        delete m_pThread;
+        m_pThread = nullptr;
+    }
+}
+
+void CSampleVsyncClock::SetFrequency(float flFrequency)
+{
+    uint64_t ulIntervalNs = (uint64_t)(1e9 / (flFrequency > 1.0f ? flFrequency : 60.0f));
+
+    // the vsync after the current one stays where it is, the new interval starts from there
+    uint64_t ulNext = GetVsyncCounterAt(GetTimestampNs()) + 1;
+    int64_t nNextNs = (int64_t)GetVsyncTimeNs(ulNext);
+
+    m_unGridSequence.fetch_add(1, std::memory_order_acq_rel);
+    m_nOriginNs.store(nNextNs - (int64_t)(ulNext * ulIntervalNs), std::memory_order_relaxed);
+    m_ulFrameIntervalNs.store(ulIntervalNs, std::memory_order_relaxed);
+    m_unGridSequence.fetch_add(1, std::memory_order_release);
+}
+
+void CSampleVsyncClock::LoadGrid(int64_t *pnOriginNs, uint64_t *pulIntervalNs) const
+{
+    uint32_t unSequence;
+    do {
+        unSequence = m_unGridSequence.load(std::memory_order_acquire);
+        *pnOriginNs = m_nOriginNs.load(std::memory_order_relaxed);
+        *pulIntervalNs = m_ulFrameIntervalNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((unSequence & 1) || unSequence != m_unGridSequence.load(std::memory_order_relaxed));
+}
+
+uint64_t CSampleVsyncClock::GetVsyncCounterAt(uint64_t ulNs) const
+{
+    int64_t nOriginNs;
+    uint64_t ulIntervalNs;
+    LoadGrid(&nOriginNs, &ulIntervalNs);
+    return (int64_t)ulNs > nOriginNs ? (uint64_t)((int64_t)ulNs - nOriginNs) / ulIntervalNs : 0;
+}
+
+uint64_t CSampleVsyncClock::GetVsyncTimeNs(uint64_t ulCounter) const
+{
+    int64_t nOriginNs;
+    uint64_t ulIntervalNs;
+    LoadGrid(&nOriginNs, &ulIntervalNs);
+    return (uint64_t)(nOriginNs + (int64_t)(ulCounter * ulIntervalNs));
+}
+
+uint64_t CSampleVsyncClock::GetVsyncCounter(uint64_t *pulVsyncNs) const
+{
+    uint64_t ulCounter = m_ulCounter.load(std::memory_order_acquire);
+    if (pulVsyncNs) {
+        *pulVsyncNs = GetVsyncTimeNs(ulCounter);
+    }
+    return ulCounter;
+}
+
+void CSampleVsyncClock::WaitForVsync(uint64_t ulCounter) const
+{
+    SleepUntilNs(GetVsyncTimeNs(ulCounter));
+}
+
+uint64_t CSampleVsyncClock::GetJitterHistogram(uint64_t rgulBuckets[k_unSampleVsyncJitterBuckets], uint64_t *pulMaxNs) const
+{
+    uint64_t ulTotal = 0;
+    for (uint32_t i = 0; i < k_unSampleVsyncJitterBuckets; i++) {
+        rgulBuckets[i] = m_rgulJitterBuckets[i].load(std::memory_order_relaxed);
+        ulTotal += rgulBuckets[i];
+    }
+    if (pulMaxNs) {
+        *pulMaxNs = m_ulJitterMaxNs.load(std::memory_order_relaxed);
+    }
+    return ulTotal;
+}
+
+void CSampleVsyncClock::ResetJitterHistogram()
+{
+    for (uint32_t i = 0; i < k_unSampleVsyncJitterBuckets; i++) {
+        m_rgulJitterBuckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_ulJitterMaxNs.store(0, std::memory_order_relaxed);
+}
+
+void CSampleVsyncClock::AddJitterSample(uint64_t ulLateNs)
+{
+    uint32_t unBucket = 0;
+    while (unBucket < k_unSampleVsyncJitterBuckets - 1 && ulLateNs >= k_rgunSampleVsyncJitterBucketUs[unBucket] * 1000ull) {
+        unBucket++;
+    }
+
+    // only this thread writes, readers just need untorn values
+    m_rgulJitterBuckets[unBucket].store(m_rgulJitterBuckets[unBucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (ulLateNs > m_ulJitterMaxNs.load(std::memory_order_relaxed)) {
+        m_ulJitterMaxNs.store(ulLateNs, std::memory_order_relaxed);
+    }
+}
+
+void CSampleVsyncClock::ThreadFunction()
+{
+    // 0 after Start(), after Resume() the catch up below jumps to the vsync that is due now
+    uint64_t ulCounter = m_ulCounter.load(std::memory_order_relaxed);
+    uint64_t ulNextReportNs = GetTimestampNs() + k_ulJitterReportIntervalNs;
+
+    while (m_bRunning) {
+        ulCounter++;
+        uint64_t ulDeadline = GetVsyncTimeNs(ulCounter);
+        SleepUntilNs(ulDeadline);
+        uint64_t ulNow = GetTimestampNs();
+
+        // after a long stall jump ahead instead of firing a burst of vsyncs to catch up
+        if (ulNow > ulDeadline + GetFrameIntervalNs()) {
+            ulCounter = GetVsyncCounterAt(ulNow);
+            ulDeadline = GetVsyncTimeNs(ulCounter);
+        }
+        m_ulCounter.store(ulCounter, std::memory_order_release);
+
+        if (m_bNotifyHost) {
+            // the offset is negative, the vsync lies in the past by the time we get here
+            vr::VRServerDriverHost()->VsyncEvent(-(double)(ulNow - ulDeadline) * 1e-9);
+        }
+
+        if (m_bMeasureJitter) {
+            AddJitterSample(ulNow - ulDeadline);
+            if (ulNow >= ulNextReportNs) {
+                ulNextReportNs = ulNow + k_ulJitterReportIntervalNs;
+
+                uint64_t rgulBuckets[k_unSampleVsyncJitterBuckets];
+                uint64_t ulMaxNs;
+                GetJitterHistogram(rgulBuckets, &ulMaxNs);
+                char buf[512];
+                int nLength = snprintf(buf, sizeof(buf), "driver_null: vsync lateness max %.1f us:", ulMaxNs * 1e-3);
+                for (uint32_t i = 0; i < k_unSampleVsyncJitterBuckets && nLength > 0 && nLength < (int)sizeof(buf); i++) {
+                    if (i < k_unSampleVsyncJitterBuckets - 1) {
+                        nLength += snprintf(buf + nLength, sizeof(buf) - nLength, " <%uus %llu", k_rgunSampleVsyncJitterBucketUs[i], (unsigned long long)rgulBuckets[i]);
+                    } else {
+                        nLength += snprintf(buf + nLength, sizeof(buf) - nLength, " more %llu", (unsigned long long)rgulBuckets[i]);
+                    }
+                }
+                DRIVERLOG_INFO(DriverLogCategory_Display, "%s\n", (const char *)buf);
+                ResetJitterHistogram();
+            }
+        }
+    }
+}
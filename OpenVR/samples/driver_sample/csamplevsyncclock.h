@@ -0,0 +1,86 @@
+#ifndef CSAMPLEVSYNCCLOCK_H
+#define CSAMPLEVSYNCCLOCK_H
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+
+static const uint32_t k_unSampleVsyncJitterBuckets = 12;
+
+// upper bounds of the jitter histogram buckets in microseconds, the last bucket takes the rest
+static const uint32_t k_rgunSampleVsyncJitterBucketUs[k_unSampleVsyncJitterBuckets - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000 };
+
+//-----------------------------------------------------------------------------
+// Purpose: Software vsync for displays the driver can't get vsync from. A
+// thread sleeps to absolute deadlines on a fixed grid at the display
+// frequency (clock_nanosleep with TIMER_ABSTIME where there is one, so the
+// error doesn't add up) and optionally tells the server with VsyncEvent.
+// Readers get the vsync counter from a single atomic or straight from the
+// grid, so they never wait for the thread. In jitter mode the thread
+// also counts how late it woke up per tick into a histogram.
+// SetFrequency() moves the clock onto a new grid that continues the
+// counter from the next vsync. Readers take the grid under a sequence
+// counter, so they retry instead of waiting when it changes under them.
+//-----------------------------------------------------------------------------
+class CSampleVsyncClock
+{
+public:
+    CSampleVsyncClock();
+
+    ~CSampleVsyncClock();
+
+    void Start(float flFrequency, bool bNotifyHost, bool bMeasureJitter);
+
+    void Stop();
+
+    /** restarts a stopped clock on the grid it had, so vsync counters handed out before stay valid */
+    void Resume();
+
+    bool IsRunning() const { return m_pThread != nullptr; }
+
+    /** switches a running clock to a new frequency from the next vsync on, the counter keeps counting */
+    void SetFrequency(float flFrequency);
+
+    uint64_t GetFrameIntervalNs() const { return m_ulFrameIntervalNs.load(std::memory_order_relaxed); }
+
+    /** vsyncs the thread has delivered since Start() and the time of the latest one, GetTimestampNs() based */
+    uint64_t GetVsyncCounter(uint64_t *pulVsyncNs) const;
+
+    /** latest vsync due at time ulNs on the grid, independent of when the thread gets to run */
+    uint64_t GetVsyncCounterAt(uint64_t ulNs) const;
+
+    /** time of vsync number ulCounter, also for vsyncs still to come */
+    uint64_t GetVsyncTimeNs(uint64_t ulCounter) const;
+
+    /** sleeps until vsync number ulCounter is due */
+    void WaitForVsync(uint64_t ulCounter) const;
+
+    /** copies the wakeup lateness histogram, returns the number of ticks in it */
+    uint64_t GetJitterHistogram(uint64_t rgulBuckets[k_unSampleVsyncJitterBuckets], uint64_t *pulMaxNs) const;
+
+    void ResetJitterHistogram();
+
+private:
+    void ThreadFunction();
+
+    void AddJitterSample(uint64_t ulLateNs);
+
+    /** vsync n is due at origin + n * interval, the origin can lie before the clock's epoch after a frequency change */
+    void LoadGrid(int64_t *pnOriginNs, uint64_t *pulIntervalNs) const;
+
+    std::thread *m_pThread;
+    std::atomic<bool> m_bRunning;
+    bool m_bNotifyHost;
+    bool m_bMeasureJitter;
+
+    // odd while SetFrequency() rewrites the grid
+    std::atomic<uint32_t> m_unGridSequence;
+    std::atomic<int64_t> m_nOriginNs;
+    std::atomic<uint64_t> m_ulFrameIntervalNs;
+    std::atomic<uint64_t> m_ulCounter;
+
+    std::atomic<uint64_t> m_rgulJitterBuckets[k_unSampleVsyncJitterBuckets];
+    std::atomic<uint64_t> m_ulJitterMaxNs;
+};
+
+#endif // CSAMPLEVSYNCCLOCK_H
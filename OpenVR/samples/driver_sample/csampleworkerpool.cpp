@@ -0,0 +1,166 @@
+#include "csampleworkerpool.h"
+
+#if defined(_WINDOWS)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static void PinThreadToCpu(std::thread *pThread, int32_t nCpu)
+{
+#if defined(_WINDOWS)
+    SetThreadAffinityMask(pThread->native_handle(), (DWORD_PTR)1 << nCpu);
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(nCpu, &cpuSet);
+    pthread_setaffinity_np(pThread->native_handle(), sizeof(cpuSet), &cpuSet);
+#endif
+}
+
+CSampleWorkerPool::CSampleWorkerPool()
+    : m_unChunksLeft(0), m_unBusyWorkers(0)
+{
+    m_unWorkerCount = 0;
+    for (uint32_t i = 0; i < k_unMaxWorkers; i++) {
+        m_rgpThreads[i] = nullptr;
+    }
+    m_ulGeneration = 0;
+    m_bStopping = false;
+    m_job.pfnChunk = nullptr;
+    m_job.pContext = nullptr;
+    m_job.unChunkCount = 0;
+    m_job.unParticipants = 1;
+}
+
+CSampleWorkerPool::~CSampleWorkerPool()
+{
+    Stop();
+}
+
+void CSampleWorkerPool::Start(uint32_t unWorkerCount, int32_t nFirstCpu)
+{
+    Stop();
+
+    if (unWorkerCount > k_unMaxWorkers) {
+        unWorkerCount = k_unMaxWorkers;
+    }
+
+    m_bStopping = false;
+    m_unWorkerCount = unWorkerCount;
+    for (uint32_t i = 0; i < m_unWorkerCount; i++) {
+        m_rgpThreads[i] = new std::thread(&CSampleWorkerPool::WorkerThreadFunction, this, i);
+        if (nFirstCpu >= 0) {
+            PinThreadToCpu(m_rgpThreads[i], nFirstCpu + (int32_t)i);
+        }
+    }
+}
+
+void CSampleWorkerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bStopping = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (uint32_t i = 0; i < m_unWorkerCount; i++) {
+        m_rgpThreads[i]->join();
+        delete m_rgpThreads[i];
+        m_rgpThreads[i] = nullptr;
+    }
+    m_unWorkerCount = 0;
+}
+
+void CSampleWorkerPool::ParallelFor(uint32_t unChunkCount, ChunkFunction_t pfnChunk, void *pContext)
+{
+    if (unChunkCount == 0) {
+        return;
+    }
+
+    // not worth waking anybody for a single chunk
+    if (m_unWorkerCount == 0 || unChunkCount == 1) {
+        for (uint32_t i = 0; i < unChunkCount; i++) {
+            pfnChunk(pContext, i);
+        }
+        return;
+    }
+
+    // hand every participant an even, contiguous share of the chunks
+    uint32_t unParticipants = m_unWorkerCount + 1;
+    if (unParticipants > unChunkCount) {
+        unParticipants = unChunkCount;
+    }
+    uint32_t unBegin = 0;
+    for (uint32_t i = 0; i < unParticipants; i++) {
+        uint32_t unEnd = (uint32_t)((uint64_t)unChunkCount * (i + 1) / unParticipants);
+        m_rgQueues[i].unNext.store(unBegin, std::memory_order_relaxed);
+        m_rgQueues[i].unEnd = unEnd;
+        unBegin = unEnd;
+    }
+
+    Job_t job;
+    job.pfnChunk = pfnChunk;
+    job.pContext = pContext;
+    job.unChunkCount = unChunkCount;
+    job.unParticipants = unParticipants;
+    m_unChunksLeft.store(unChunkCount, std::memory_order_relaxed);
+    m_unBusyWorkers.store(unParticipants - 1, std::memory_order_relaxed);
+
+    // the job is only ever read together with its generation, so a worker that wakes late can't mix two jobs
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = job;
+        m_ulGeneration++;
+    }
+    m_wakeCondition.notify_all();
+
+    // the caller is the last participant and helps out instead of just waiting
+    RunChunks(job, unParticipants - 1);
+
+    // workers may still be looking for something to steal, wait until they are out
+    while (m_unChunksLeft.load(std::memory_order_acquire) != 0 || m_unBusyWorkers.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+}
+
+void CSampleWorkerPool::RunChunks(const Job_t &job, uint32_t unParticipant)
+{
+    // own queue first, then go round the others stealing from the front of their queues
+    for (uint32_t i = 0; i < job.unParticipants; i++) {
+        ChunkQueue_t &queue = m_rgQueues[(unParticipant + i) % job.unParticipants];
+        for (;;) {
+            uint32_t unChunk = queue.unNext.fetch_add(1, std::memory_order_relaxed);
+            if (unChunk >= queue.unEnd) {
+                break;
+            }
+            job.pfnChunk(job.pContext, unChunk);
+            m_unChunksLeft.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+void CSampleWorkerPool::WorkerThreadFunction(uint32_t unWorker)
+{
+    uint64_t ulSeenGeneration = 0;
+
+    for (;;) {
+        Job_t job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCondition.wait(lock, [&] { return m_bStopping || m_ulGeneration != ulSeenGeneration; });
+            if (m_bStopping) {
+                return;
+            }
+            ulSeenGeneration = m_ulGeneration;
+            job = m_job;
+        }
+
+        // a job may need fewer participants than there are workers
+        if (unWorker + 1 < job.unParticipants) {
+            RunChunks(job, unWorker);
+            m_unBusyWorkers.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef CSAMPLEWORKERPOOL_H
+#define CSAMPLEWORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+
+//-----------------------------------------------------------------------------
+// Purpose: Small fixed pool of worker threads for the per-tick device update.
+// ParallelFor() splits the chunks evenly over the workers and the calling
+// thread; whoever runs out of its own chunks steals from the others. It
+// returns once every chunk has run.
+//-----------------------------------------------------------------------------
+class CSampleWorkerPool
+{
+public:
+    typedef void (*ChunkFunction_t)(void *pContext, uint32_t unChunk);
+
+    static const uint32_t k_unMaxWorkers = 15;
+
+    CSampleWorkerPool();
+
+    ~CSampleWorkerPool();
+
+    /** nFirstCpu >= 0 pins worker i to cpu nFirstCpu + i, the caller of ParallelFor is left alone */
+    void Start(uint32_t unWorkerCount, int32_t nFirstCpu);
+
+    void Stop();
+
+    uint32_t GetWorkerCount() const { return m_unWorkerCount; }
+
+    void ParallelFor(uint32_t unChunkCount, ChunkFunction_t pfnChunk, void *pContext);
+
+private:
+    // one per participant, on its own cache line so stealing doesn't bounce the owner's line
+    struct alignas(64) ChunkQueue_t
+    {
+        std::atomic<uint32_t> unNext;
+        uint32_t unEnd;
+    };
+
+    // what one ParallelFor() hands out, guarded by m_mutex together with m_ulGeneration
+    struct Job_t
+    {
+        ChunkFunction_t pfnChunk;
+        void *pContext;
+        uint32_t unChunkCount;
+        uint32_t unParticipants;
+    };
+
+    void WorkerThreadFunction(uint32_t unWorker);
+
+    void RunChunks(const Job_t &job, uint32_t unParticipant);
+
+    uint32_t m_unWorkerCount;
+    std::thread *m_rgpThreads[k_unMaxWorkers];
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    uint64_t m_ulGeneration;
+    bool m_bStopping;
+
+    Job_t m_job;
+    ChunkQueue_t m_rgQueues[k_unMaxWorkers + 1];
+    alignas(64) std::atomic<uint32_t> m_unChunksLeft;
+    std::atomic<uint32_t> m_unBusyWorkers;
+};
+
+#endif // CSAMPLEWORKERPOOL_H
@@ -1,61 +1,114 @@
 #include "cserverdriver_sample.h"
 
+#include "basics.h"
+#include "csampleframemonitor.h"
+#include "csamplelatencystats.h"
+#include "csampletrace.h"
+#include "driverlog.h"
+
 using namespace vr;
 
 EVRInitError CServerDriver_Sample::Init(vr::IVRDriverContext *pDriverContext)
 {
     VR_INIT_SERVER_DRIVER_CONTEXT(pDriverContext);
-    //InitDriverLog( vr::VRDriverLog() );
+    InitDriverLog(vr::VRDriverLog());
+
+    char rgchLogLevels[256];
+    GetSampleSettingString(k_pch_Sample_LogLevels_String, rgchLogLevels, sizeof(rgchLogLevels), "");
+    if (!SetDriverLogLevels(rgchLogLevels)) {
+        DRIVERLOG_WARNING(DriverLogCategory_General, "driver_null: ignoring invalid logLevels \"%s\"\n", (const char *)rgchLogLevels);
+    }
+
+    if (GetSampleSettingBool(k_pch_Sample_TraceEnabled_Bool, false)) {
+        char rgchDirectory[512];
+        GetSampleSettingString(k_pch_Sample_TraceDirectory_String, rgchDirectory, sizeof(rgchDirectory), "");
+        int32_t nTraceRecords = GetSampleSettingInt32(k_pch_Sample_TraceRecords_Int32, 65536);
+        StartSampleTrace(rgchDirectory, nTraceRecords > 0 ? (uint32_t)nTraceRecords : 0);
+    }
+
+    ResetSampleLatencyStats();
+    StartSampleFrameMonitor(GetSampleSettingFloat(k_pch_Sample_RunFrameStallMs_Float, 50.0f), GetSampleSettingFloat(k_pch_Sample_StallWarnInterval_Float, 10.0f));
 
-    m_pNullHmdLatest = new CSampleDeviceDriver();
-    vr::VRServerDriverHost()->TrackedDeviceAdded(m_pNullHmdLatest->GetSerialNumber().c_str(), vr::TrackedDeviceClass_HMD, m_pNullHmdLatest);
+    SetSampleEventDispatcher(&m_eventDispatcher);
 
-    m_pController = new CSampleControllerDriver();
-    m_pController->SetControllerIndex(1);
-    vr::VRServerDriverHost()->TrackedDeviceAdded(m_pController->GetSerialNumber().c_str(), vr::TrackedDeviceClass_Controller, m_pController);
+    // devices are only created here, RunFrame adds them to SteamVR once their transport delivers data
+    m_deviceRegistry.CreateDevicesFromSettings();
 
-    m_pController2 = new CSampleControllerDriver();
-    m_pController2->SetControllerIndex(2);
-    vr::VRServerDriverHost()->TrackedDeviceAdded(m_pController2->GetSerialNumber().c_str(), vr::TrackedDeviceClass_Controller, m_pController2);
+    int32_t nWorkerThreads = GetSampleSettingInt32(k_pch_Sample_WorkerThreads_Int32, 2);
+    m_workerPool.Start(nWorkerThreads > 0 ? (uint32_t)nWorkerThreads : 0, GetSampleSettingInt32(k_pch_Sample_WorkerFirstCpu_Int32, -1));
+    m_deviceRegistry.StartPoseThread(&m_workerPool, GetSampleSettingFloat(k_pch_Sample_PoseRate_Float, 90.0f));
+
+    int32_t nTransportPort = GetSampleSettingInt32(k_pch_Sample_TransportPort_Int32, 0);
+    if (nTransportPort > 0 && nTransportPort <= 0xFFFF) {
+        if (!m_udpTransport.Start((uint16_t)nTransportPort, &m_deviceRegistry)) {
+            DRIVERLOG_ERROR(DriverLogCategory_Transport, "driver_null: unable to open transport port %d\n", nTransportPort);
+        }
+    }
+
+    char rgchMetricsSocket[256];
+    GetSampleSettingString(k_pch_Sample_MetricsSocket_String, rgchMetricsSocket, sizeof(rgchMetricsSocket), "");
+    if (rgchMetricsSocket[0] && !m_metricsServer.Start(rgchMetricsSocket, &m_deviceRegistry, &m_udpTransport, &m_eventDispatcher)) {
+        DRIVERLOG_ERROR(DriverLogCategory_General, "driver_null: unable to serve metrics on %s\n", (const char *)rgchMetricsSocket);
+    }
 
     return VRInitError_None;
 }
 
 void CServerDriver_Sample::Cleanup()
 {
-    //CleanupDriverLog();
-    delete m_pNullHmdLatest;
-    m_pNullHmdLatest = NULL;
-    delete m_pController;
-    m_pController = NULL;
-    delete m_pController2;
-    m_pController2 = NULL;
+    m_metricsServer.Stop();
+    StopSampleFrameMonitor();
+    m_udpTransport.Stop();
+    m_deviceRegistry.StopPoseThread();
+    m_workerPool.Stop();
+    SetSampleEventDispatcher(nullptr);
+    m_eventDispatcher.Clear();
+    m_deviceRegistry.Clear();
+    StopSampleTrace();
+
+    // last, so whatever the threads above logged on their way out still gets written
+    CleanupDriverLog();
 }
 
 void CServerDriver_Sample::RunFrame()
 {
-    if (m_pNullHmdLatest) {
-        m_pNullHmdLatest->RunFrame();
-    }
-    if (m_pController) {
-        m_pController->RunFrame();
-    }
-    if (m_pController2) {
-        m_pController2->RunFrame();
-    }
-
-#if 0
-    vr::VREvent_t vrEvent;
-    while ( vr::VRServerDriverHost()->PollNextEvent( &vrEvent, sizeof( vrEvent ) ) )
+    // SteamVR calls this from a thread other drivers block too, so how regular it is isn't up to us. The monitor
+    // tells a stall in here from one outside
+    OnSampleRunFrameBegin();
     {
-        if ( m_pController )
-        {
-            m_pController->ProcessEvent(vrEvent);
-        }
-        if ( m_pController2)
-        {
-            m_pController2->ProcessEvent(vrEvent);
-        }
+        CSampleTraceScope scope(SampleTraceScope_RunFrame);
+        CSampleActivityScope activity(SampleActivityThread_Server, SampleTraceScope_RunFrame);
+
+        m_deviceRegistry.RunFrame();
+
+        // drain every pending event, each one only reaches the devices that asked for its type
+        m_eventDispatcher.SyncDevices(m_deviceRegistry);
+        CSampleTraceScope pumpScope(SampleTraceScope_EventPump);
+        CSampleActivityScope pumpActivity(SampleActivityThread_Server, SampleTraceScope_EventPump);
+        m_eventDispatcher.PumpEvents();
     }
-#endif
+    OnSampleRunFrameEnd();
+}
+
+bool CServerDriver_Sample::ShouldBlockStandbyMode()
+{
+    // nothing of ours needs SteamVR awake, standby is cheap for us
+    return false;
+}
+
+void CServerDriver_Sample::EnterStandby()
+{
+    // pose thread drops to a heartbeat, the transport closes its socket and the idle workers stay parked
+    m_deviceRegistry.SetStandby(true);
+    m_udpTransport.SetStandby(true);
+    SetSampleFrameMonitorStandby(true);
+    SetDriverLogStandby(true);
+}
+
+void CServerDriver_Sample::LeaveStandby()
+{
+    SetDriverLogStandby(false);
+    m_udpTransport.SetStandby(false);
+    m_deviceRegistry.SetStandby(false);
+    SetSampleFrameMonitorStandby(false);
 }
@@ -2,8 +2,11 @@
 #define CSERVERDRIVER_SAMPLE_H
 
 #include <openvr_driver.h>
-#include "csampledevicedriver.h"
-#include "csamplecontrollerdriver.h"
+#include "csampledeviceregistry.h"
+#include "csampleeventdispatcher.h"
+#include "csamplemetricsserver.h"
+#include "csampleudptransport.h"
+#include "csampleworkerpool.h"
 
 //-----------------------------------------------------------------------------
 // Purpose:
@@ -15,14 +18,16 @@ public:
     virtual void Cleanup();
     virtual const char *const *GetInterfaceVersions() { return vr::k_InterfaceVersions; }
     virtual void RunFrame();
-    virtual bool ShouldBlockStandbyMode()  { return false; }
-    virtual void EnterStandby()  {}
-    virtual void LeaveStandby()  {}
+    virtual bool ShouldBlockStandbyMode();
+    virtual void EnterStandby();
+    virtual void LeaveStandby();
 
 private:
-    CSampleDeviceDriver *m_pNullHmdLatest = nullptr;
-    CSampleControllerDriver *m_pController = nullptr;
-    CSampleControllerDriver *m_pController2 = nullptr;
+    CSampleDeviceRegistry m_deviceRegistry;
+    CSampleEventDispatcher m_eventDispatcher;
+    CSampleUdpTransport m_udpTransport;
+    CSampleWorkerPool m_workerPool;
+    CSampleMetricsServer m_metricsServer;
 };
 
 #endif // CSERVERDRIVER_SAMPLE_H
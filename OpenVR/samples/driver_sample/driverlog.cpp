@@ -2,57 +2,444 @@
 
 #include "driverlog.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <stdio.h>
-#include <stdarg.h>
+#include <string.h>
+#include <thread>
+
+// queued lines, a power of two. Each record holds the arguments and the copied strings of one line
+static const uint32_t k_unLogRecords = 1024;
+static const uint32_t k_unLogStringBytes = 384;
+
+// lines are collected into one IVRDriverLog::Log call up to this size
+static const uint32_t k_unLogBatchBytes = 8192;
+static const uint32_t k_unLogLineBytes = 1024;
+
+struct LogRecord_t
+{
+    // Vyukov's bounded queue: equals the enqueue position when free, position + 1 once filled
+    std::atomic<uint64_t> ulSequence;
+    const char *pchFormat;
+    uint32_t unArgs;
+    DriverLogArg_t rgArgs[k_unDriverLogMaxArgs];
+    char rgchStrings[k_unLogStringBytes];
+};
+
+static LogRecord_t s_rgRecords[k_unLogRecords];
+static std::atomic<uint64_t> s_ulEnqueuePos(0);
+static uint64_t s_ulDequeuePos = 0;
+static std::atomic<uint64_t> s_ulDequeued(0);   // s_ulDequeuePos published for GetDriverLogQueueDepth()
+static std::atomic<uint64_t> s_ulDropped(0);
+static std::atomic<bool> s_bLogging(false);
 
 static vr::IVRDriverLog *s_pLogFile = NULL;
+static std::thread *s_pLogThread = NULL;
+static std::atomic<bool> s_bLogThreadRunning(false);
 
-#if !defined(WIN32)
-#define vsnprintf_s vsnprintf
-#endif
+// the writer sleeps on the condition variable once the queue is empty, producers only take the mutex to wake it
+static std::mutex s_logMutex;
+static std::condition_variable s_logWake;
+static std::atomic<bool> s_bLogThreadWaiting(false);
+static std::atomic<bool> s_bLogStandby(false);
 
-bool InitDriverLog(vr::IVRDriverLog *pDriverLog)
+static void WakeLogThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_logMutex);
+    }
+    s_logWake.notify_one();
+}
+
+void DriverLogCapture(const char *pchFormat, const DriverLogArg_t *pArgs, uint32_t unArgs)
+{
+    if (!s_bLogging.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // claim a free record, a full queue drops the line instead of waiting for the writer
+    LogRecord_t *pRecord;
+    uint64_t ulPos = s_ulEnqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        pRecord = &s_rgRecords[ulPos & (k_unLogRecords - 1)];
+        int64_t nDiff = (int64_t)(pRecord->ulSequence.load(std::memory_order_acquire) - ulPos);
+        if (nDiff == 0) {
+            if (s_ulEnqueuePos.compare_exchange_weak(ulPos, ulPos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (nDiff < 0) {
+            s_ulDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            ulPos = s_ulEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // strings may live on the caller's stack, they are copied and cut off when the record runs out of room
+    pRecord->pchFormat = pchFormat;
+    pRecord->unArgs = unArgs < k_unDriverLogMaxArgs ? unArgs : k_unDriverLogMaxArgs;
+    uint32_t cbStrings = 0;
+    for (uint32_t i = 0; i < pRecord->unArgs; i++) {
+        pRecord->rgArgs[i] = pArgs[i];
+        if (pArgs[i].unType == DriverLogArg_String) {
+            const char *pchSource = pArgs[i].pchValue ? pArgs[i].pchValue : "(null)";
+            uint32_t cbLeft = k_unLogStringBytes - cbStrings;
+            uint32_t cbCopy = 0;
+            while (cbCopy + 1 < cbLeft && pchSource[cbCopy]) {
+                cbCopy++;
+            }
+            char *pchCopy = pRecord->rgchStrings + cbStrings;
+            if (cbLeft > 0) {
+                memcpy(pchCopy, pchSource, cbCopy);
+                pchCopy[cbCopy] = 0;
+                cbStrings += cbCopy + 1;
+            } else {
+                pchCopy = pRecord->rgchStrings + k_unLogStringBytes - 1;
+            }
+            pRecord->rgArgs[i].pchValue = pchCopy;
+        }
+    }
+
+    // seq_cst pairs with the writer announcing that it waits, so either it sees the record or we see it waiting.
+    // Only the first producer to find it waiting wakes it, the others don't touch the mutex
+    pRecord->ulSequence.store(ulPos + 1, std::memory_order_seq_cst);
+    if (s_bLogThreadWaiting.load(std::memory_order_seq_cst) && !s_bLogStandby.load(std::memory_order_relaxed)
+        && s_bLogThreadWaiting.exchange(false, std::memory_order_relaxed)) {
+        WakeLogThread();
+    }
+}
+
+std::atomic<uint32_t> g_rgunDriverLogLevel[DriverLogCategory_Count] = {
+    { DriverLogLevel_Info }, { DriverLogLevel_Info }, { DriverLogLevel_Info }, { DriverLogLevel_Info }, { DriverLogLevel_Info },
+};
+
+static const char *const k_rgpchLogCategoryNames[DriverLogCategory_Count] = { "general", "tracking", "transport", "input", "display" };
+static const char *const k_rgpchLogLevelNames[] = { "error", "warning", "info", "verbose", "debug" };
+static const uint32_t k_unLogLevels = sizeof(k_rgpchLogLevelNames) / sizeof(k_rgpchLogLevelNames[0]);
+
+static bool MatchName(const char *pchName, const char *pchBegin, const char *pchEnd)
+{
+    size_t cbName = strlen(pchName);
+    return (size_t)(pchEnd - pchBegin) == cbName && !strncmp(pchName, pchBegin, cbName);
+}
+
+// one "category=level" or "level" entry, unCategoryMask has a bit per category it applies to
+static bool ParseLogLevelEntry(const char *pchBegin, const char *pchEnd, uint32_t *punCategoryMask, uint32_t *punLevel)
+{
+    while (pchBegin < pchEnd && *pchBegin == ' ') {
+        pchBegin++;
+    }
+    while (pchEnd > pchBegin && pchEnd[-1] == ' ') {
+        pchEnd--;
+    }
+
+    const char *pchEquals = pchBegin;
+    while (pchEquals < pchEnd && *pchEquals != '=') {
+        pchEquals++;
+    }
+    const char *pchLevel = pchEquals < pchEnd ? pchEquals + 1 : pchBegin;
+    *punCategoryMask = (1u << DriverLogCategory_Count) - 1;
+    if (pchEquals < pchEnd && !MatchName("all", pchBegin, pchEquals)) {
+        *punCategoryMask = 0;
+        for (uint32_t i = 0; i < DriverLogCategory_Count; i++) {
+            if (MatchName(k_rgpchLogCategoryNames[i], pchBegin, pchEquals)) {
+                *punCategoryMask = 1u << i;
+            }
+        }
+        if (!*punCategoryMask) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < k_unLogLevels; i++) {
+        if (MatchName(k_rgpchLogLevelNames[i], pchLevel, pchEnd)) {
+            *punLevel = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SetDriverLogLevels(const char *pchLevels)
+{
+    uint32_t rgunLevels[DriverLogCategory_Count];
+    for (uint32_t i = 0; i < DriverLogCategory_Count; i++) {
+        rgunLevels[i] = g_rgunDriverLogLevel[i].load(std::memory_order_relaxed);
+    }
+
+    // entries apply left to right, so "all=warning,tracking=verbose" turns up just one category
+    const char *pch = pchLevels;
+    while (*pch) {
+        const char *pchEnd = pch;
+        while (*pchEnd && *pchEnd != ',') {
+            pchEnd++;
+        }
+        if (pchEnd > pch) {
+            uint32_t unCategoryMask;
+            uint32_t unLevel;
+            if (!ParseLogLevelEntry(pch, pchEnd, &unCategoryMask, &unLevel)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < DriverLogCategory_Count; i++) {
+                if (unCategoryMask & (1u << i)) {
+                    rgunLevels[i] = unLevel;
+                }
+            }
+        }
+        pch = *pchEnd ? pchEnd + 1 : pchEnd;
+    }
+
+    for (uint32_t i = 0; i < DriverLogCategory_Count; i++) {
+        g_rgunDriverLogLevel[i].store(rgunLevels[i], std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool GetDriverLogLevels(char *pchLevels, uint32_t unLevelsLen)
 {
-    if (s_pLogFile) {
+    if (unLevelsLen == 0) {
         return false;
     }
-    s_pLogFile = pDriverLog;
-    return s_pLogFile != NULL;
+    pchLevels[0] = 0;
+    uint32_t cbUsed = 0;
+    for (uint32_t i = 0; i < DriverLogCategory_Count; i++) {
+        uint32_t unLevel = g_rgunDriverLogLevel[i].load(std::memory_order_relaxed);
+        int nWritten = snprintf(pchLevels + cbUsed, unLevelsLen - cbUsed, "%s%s=%s", i ? "," : "", k_rgpchLogCategoryNames[i],
+            unLevel < k_unLogLevels ? k_rgpchLogLevelNames[unLevel] : "?");
+        if (nWritten < 0 || cbUsed + (uint32_t)nWritten >= unLevelsLen) {
+            pchLevels[0] = 0;
+            return false;
+        }
+        cbUsed += (uint32_t)nWritten;
+    }
+    return true;
 }
 
-void CleanupDriverLog()
+uint64_t GetDriverLogDropped()
 {
-    s_pLogFile = NULL;
+    return s_ulDropped.load(std::memory_order_relaxed);
 }
 
-static void DriverLogVarArgs(const char *pMsgFormat, va_list args)
+uint64_t GetDriverLogQueueDepth()
 {
-    char buf[1024];
-    vsnprintf_s(buf, sizeof(buf), pMsgFormat, args);
+    uint64_t ulDequeued = s_ulDequeued.load(std::memory_order_relaxed);
+    uint64_t ulEnqueued = s_ulEnqueuePos.load(std::memory_order_relaxed);
+    return ulEnqueued > ulDequeued ? ulEnqueued - ulDequeued : 0;
+}
 
-    if (s_pLogFile) {
-        s_pLogFile->Log(buf);
+// formats one conversion with the type that was captured, a mismatch prints a marker instead of reading garbage
+static int FormatArg(char *pchOut, size_t cbOut, const char *pchSpecStart, size_t cbSpec, char chConversion, const DriverLogArg_t &arg)
+{
+    // the length modifiers of the format are replaced by what the captured type needs
+    char rgchSpec[32];
+    size_t cbPrefix = 0;
+    for (size_t i = 0; i + 1 < cbSpec && cbPrefix + 4 < sizeof(rgchSpec); i++) {
+        char ch = pchSpecStart[i];
+        if (ch != 'h' && ch != 'l' && ch != 'L' && ch != 'z' && ch != 'j' && ch != 't' && ch != 'q' && ch != 'I') {
+            rgchSpec[cbPrefix++] = ch;
+        }
+    }
+
+    bool bIntConversion = strchr("diouxXc", chConversion) != NULL;
+    bool bFloatConversion = strchr("fFeEgGaA", chConversion) != NULL;
+    switch (arg.unType) {
+    case DriverLogArg_Int32:
+    case DriverLogArg_Uint32:
+        if (bIntConversion) {
+            rgchSpec[cbPrefix] = chConversion;
+            rgchSpec[cbPrefix + 1] = 0;
+            return snprintf(pchOut, cbOut, rgchSpec, (int)arg.nValue);
+        }
+        break;
+    case DriverLogArg_Int64:
+    case DriverLogArg_Uint64:
+        if (bIntConversion) {
+            rgchSpec[cbPrefix] = 'l';
+            rgchSpec[cbPrefix + 1] = 'l';
+            rgchSpec[cbPrefix + 2] = chConversion;
+            rgchSpec[cbPrefix + 3] = 0;
+            return snprintf(pchOut, cbOut, rgchSpec, (long long)arg.nValue);
+        }
+        break;
+    case DriverLogArg_Double:
+        if (bFloatConversion) {
+            rgchSpec[cbPrefix] = chConversion;
+            rgchSpec[cbPrefix + 1] = 0;
+            return snprintf(pchOut, cbOut, rgchSpec, arg.flValue);
+        }
+        break;
+    case DriverLogArg_Pointer:
+        if (chConversion == 'p') {
+            rgchSpec[cbPrefix] = 'p';
+            rgchSpec[cbPrefix + 1] = 0;
+            return snprintf(pchOut, cbOut, rgchSpec, arg.pValue);
+        }
+        break;
+    case DriverLogArg_String:
+        if (chConversion == 's') {
+            rgchSpec[cbPrefix] = 's';
+            rgchSpec[cbPrefix + 1] = 0;
+            return snprintf(pchOut, cbOut, rgchSpec, arg.pchValue);
+        }
+        break;
     }
+    return snprintf(pchOut, cbOut, "(bad %c)", chConversion);
+}
+
+static void FormatRecord(const LogRecord_t &record, char *pchLine, size_t cbLine)
+{
+    size_t cbUsed = 0;
+    uint32_t unArg = 0;
+    const char *pch = record.pchFormat;
+    while (*pch && cbUsed + 1 < cbLine) {
+        if (*pch != '%') {
+            pchLine[cbUsed++] = *pch++;
+            continue;
+        }
+        if (pch[1] == '%') {
+            pchLine[cbUsed++] = '%';
+            pch += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion, * widths aren't supported
+        const char *pchSpec = pch++;
+        while (*pch && strchr("-+ #0123456789.hlLzjtqI", *pch)) {
+            pch++;
+        }
+        if (!*pch) {
+            break;
+        }
+        char chConversion = *pch++;
+        int nWritten;
+        if (unArg < record.unArgs) {
+            nWritten = FormatArg(pchLine + cbUsed, cbLine - cbUsed, pchSpec, pch - pchSpec, chConversion, record.rgArgs[unArg++]);
+        } else {
+            nWritten = snprintf(pchLine + cbUsed, cbLine - cbUsed, "(missing %c)", chConversion);
+        }
+        if (nWritten > 0) {
+            cbUsed += (size_t)nWritten < cbLine - cbUsed ? (size_t)nWritten : cbLine - cbUsed - 1;
+        }
+    }
+    pchLine[cbUsed] = 0;
+}
+
+// formats everything queued so far, returns the number of lines written
+static uint32_t DrainRecords(char *pchBatch, char *pchLine)
+{
+    uint32_t unLines = 0;
+    size_t cbBatch = 0;
+    for (;;) {
+        LogRecord_t &record = s_rgRecords[s_ulDequeuePos & (k_unLogRecords - 1)];
+        if (record.ulSequence.load(std::memory_order_acquire) != s_ulDequeuePos + 1) {
+            break;
+        }
+        FormatRecord(record, pchLine, k_unLogLineBytes);
+        record.ulSequence.store(s_ulDequeuePos + k_unLogRecords, std::memory_order_release);
+        s_ulDequeuePos++;
+        unLines++;
+
+        size_t cbLine = strlen(pchLine);
+        if (cbBatch + cbLine + 1 > k_unLogBatchBytes && cbBatch > 0) {
+            s_pLogFile->Log(pchBatch);
+            cbBatch = 0;
+        }
+        memcpy(pchBatch + cbBatch, pchLine, cbLine + 1);
+        cbBatch += cbLine;
+    }
+    if (cbBatch > 0) {
+        s_pLogFile->Log(pchBatch);
+    }
+    s_ulDequeued.store(s_ulDequeuePos, std::memory_order_relaxed);
+    return unLines;
+}
+
+static bool HasQueuedRecord()
+{
+    return s_rgRecords[s_ulDequeuePos & (k_unLogRecords - 1)].ulSequence.load(std::memory_order_seq_cst) == s_ulDequeuePos + 1;
 }
 
-void DriverLog(const char *pMsgFormat, ...)
+static void LogThreadFunction()
 {
-    va_list args;
-    va_start(args, pMsgFormat);
+    static char s_rgchBatch[k_unLogBatchBytes + k_unLogLineBytes];
+    static char s_rgchLine[k_unLogLineBytes];
+    uint64_t ulReportedDropped = 0;
+
+    for (;;) {
+        bool bRunning = s_bLogThreadRunning.load(std::memory_order_acquire);
+        uint32_t unLines = DrainRecords(s_rgchBatch, s_rgchLine);
 
-    DriverLogVarArgs(pMsgFormat, args);
+        uint64_t ulDropped = GetDriverLogDropped();
+        if (ulDropped != ulReportedDropped) {
+            snprintf(s_rgchLine, sizeof(s_rgchLine), "driver_null: log queue full, dropped %llu lines\n", (unsigned long long)(ulDropped - ulReportedDropped));
+            s_pLogFile->Log(s_rgchLine);
+            ulReportedDropped = ulDropped;
+        }
 
-    va_end(args);
+        if (!bRunning) {
+            break;
+        }
+        if (unLines) {
+            continue;
+        }
+
+        // no timeout, the next line or CleanupDriverLog() wakes us, in standby only leaving it does
+        std::unique_lock<std::mutex> lock(s_logMutex);
+        s_bLogThreadWaiting.store(true, std::memory_order_seq_cst);
+        while (s_bLogThreadRunning.load(std::memory_order_acquire) && (s_bLogStandby.load(std::memory_order_relaxed) || !HasQueuedRecord())) {
+            s_logWake.wait(lock);
+        }
+        s_bLogThreadWaiting.store(false, std::memory_order_relaxed);
+    }
 }
 
-void DebugDriverLog(const char *pMsgFormat, ...)
+bool InitDriverLog(vr::IVRDriverLog *pDriverLog)
 {
-#ifdef _DEBUG
-    va_list args;
-    va_start(args, pMsgFormat);
+    if (s_pLogFile || !pDriverLog) {
+        return false;
+    }
+    s_pLogFile = pDriverLog;
 
-    DriverLogVarArgs(pMsgFormat, args);
+    for (uint32_t i = 0; i < k_unLogRecords; i++) {
+        s_rgRecords[i].ulSequence.store(i, std::memory_order_relaxed);
+    }
+    s_ulEnqueuePos.store(0, std::memory_order_relaxed);
+    s_ulDequeuePos = 0;
+    s_ulDequeued.store(0, std::memory_order_relaxed);
+    s_ulDropped.store(0, std::memory_order_relaxed);
+    s_bLogStandby.store(false, std::memory_order_relaxed);
 
-    va_end(args);
-#endif
+    s_bLogThreadRunning = true;
+    s_pLogThread = new std::thread(LogThreadFunction);
+    s_bLogging.store(true, std::memory_order_release);
+    return true;
+}
+
+void SetDriverLogStandby(bool bStandby)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_logMutex);
+        s_bLogStandby.store(bStandby, std::memory_order_relaxed);
+    }
+    if (!bStandby) {
+        s_logWake.notify_one();
+    }
+}
+
+void CleanupDriverLog()
+{
+    // lines logged after this point are dropped silently, the thread writes what got in before
+    s_bLogging.store(false, std::memory_order_relaxed);
+    if (s_pLogThread) {
+        {
+            std::lock_guard<std::mutex> lock(s_logMutex);
+            s_bLogThreadRunning = false;
+        }
+        s_logWake.notify_one();
+        s_pLogThread->join();
+        delete s_pLogThread;
+        s_pLogThread = NULL;
+    }
+    s_pLogFile = NULL;
 }
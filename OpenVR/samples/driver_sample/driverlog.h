@@ -5,17 +5,151 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
+#include <stdint.h>
 #include <openvr_driver.h>
 
-extern void DriverLog(const char *pchFormat, ...);
+// --------------------------------------------------------------------------
+// Purpose: One captured argument of a log call. Strings are copied into the
+// log record by DriverLogCapture, everything else is kept by value.
+// --------------------------------------------------------------------------
+enum EDriverLogArgType
+{
+    DriverLogArg_Int32,
+    DriverLogArg_Uint32,
+    DriverLogArg_Int64,
+    DriverLogArg_Uint64,
+    DriverLogArg_Double,
+    DriverLogArg_Pointer,
+    DriverLogArg_String,
+};
+
+struct DriverLogArg_t
+{
+    uint32_t unType;
+    union
+    {
+        int64_t nValue;
+        uint64_t ulValue;
+        double flValue;
+        const void *pValue;
+        const char *pchValue;
+    };
+};
+
+static const uint32_t k_unDriverLogMaxArgs = 8;
+
+inline DriverLogArg_t MakeDriverLogArg(int nValue) { DriverLogArg_t arg; arg.unType = DriverLogArg_Int32; arg.nValue = nValue; return arg; }
+inline DriverLogArg_t MakeDriverLogArg(unsigned int unValue) { DriverLogArg_t arg; arg.unType = DriverLogArg_Uint32; arg.ulValue = unValue; return arg; }
+inline DriverLogArg_t MakeDriverLogArg(long nValue) { DriverLogArg_t arg; arg.unType = sizeof(long) == 8 ? DriverLogArg_Int64 : DriverLogArg_Int32; arg.nValue = nValue; return arg; }
+inline DriverLogArg_t MakeDriverLogArg(unsigned long ulValue) { DriverLogArg_t arg; arg.unType = sizeof(long) == 8 ? DriverLogArg_Uint64 : DriverLogArg_Uint32; arg.ulValue = ulValue; return arg; }
+inline DriverLogArg_t MakeDriverLogArg(long long nValue) { DriverLogArg_t arg; arg.unType = DriverLogArg_Int64; arg.nValue = nValue; return arg; }
+inline DriverLogArg_t MakeDriverLogArg(unsigned long long ulValue) { DriverLogArg_t arg; arg.unType = DriverLogArg_Uint64; arg.ulValue = ulValue; return arg; }
+inline DriverLogArg_t MakeDriverLogArg(double flValue) { DriverLogArg_t arg; arg.unType = DriverLogArg_Double; arg.flValue = flValue; return arg; }
+inline DriverLogArg_t MakeDriverLogArg(const char *pchValue) { DriverLogArg_t arg; arg.unType = DriverLogArg_String; arg.pchValue = pchValue; return arg; }
+inline DriverLogArg_t MakeDriverLogArg(const void *pValue) { DriverLogArg_t arg; arg.unType = DriverLogArg_Pointer; arg.pValue = pValue; return arg; }
+
+/** queues a log line, never formats on the calling thread and only takes a lock to wake a sleeping writer */
+extern void DriverLogCapture(const char *pchFormat, const DriverLogArg_t *pArgs, uint32_t unArgs);
+
+/** log lines thrown away because the queue was full */
+extern uint64_t GetDriverLogDropped();
+
+/** log lines queued but not yet written, as of the last time the writer thread looked */
+extern uint64_t GetDriverLogQueueDepth();
+
+// --------------------------------------------------------------------------
+// Purpose: printf style logging that is safe from any thread, including the
+// pose thread. The call copies the format pointer (which must be a string
+// literal) and the arguments into a lock-free queue, a background thread
+// formats them and hands them to IVRDriverLog in batches.
+// --------------------------------------------------------------------------
+template <typename... Args>
+void DriverLog(const char *pchFormat, Args... args)
+{
+    static_assert(sizeof...(Args) <= k_unDriverLogMaxArgs, "too many arguments for DriverLog");
+    const DriverLogArg_t rgArgs[sizeof...(Args) + 1] = { MakeDriverLogArg(args)... };
+    DriverLogCapture(pchFormat, rgArgs, (uint32_t)sizeof...(Args));
+}
+
+// --------------------------------------------------------------------------
+// Purpose: Levels and categories of the DRIVERLOG_* macros. A line is written
+// if its level is compiled in (DRIVERLOG_MAX_LEVEL) and its category is set
+// to that level or a more verbose one at runtime (SetDriverLogLevels).
+// --------------------------------------------------------------------------
+enum EDriverLogLevel
+{
+    DriverLogLevel_Error = 0,
+    DriverLogLevel_Warning = 1,
+    DriverLogLevel_Info = 2,
+    DriverLogLevel_Verbose = 3,
+    DriverLogLevel_Debug = 4,
+};
+
+enum EDriverLogCategory
+{
+    DriverLogCategory_General,
+    DriverLogCategory_Tracking,   // pose thread, device connection state
+    DriverLogCategory_Transport,
+    DriverLogCategory_Input,
+    DriverLogCategory_Display,    // lenses, virtual display, vsync, frame export
+    DriverLogCategory_Count
+};
+
+// release builds keep verbose lines so a single category can be turned up in the field
+#ifndef DRIVERLOG_MAX_LEVEL
+#ifdef _DEBUG
+#define DRIVERLOG_MAX_LEVEL DriverLogLevel_Debug
+#else
+#define DRIVERLOG_MAX_LEVEL DriverLogLevel_Verbose
+#endif
+#endif
+
+extern std::atomic<uint32_t> g_rgunDriverLogLevel[DriverLogCategory_Count];
+
+inline bool IsDriverLogEnabled(EDriverLogCategory eCategory, EDriverLogLevel eLevel)
+{
+    return (uint32_t)eLevel <= g_rgunDriverLogLevel[eCategory].load(std::memory_order_relaxed);
+}
+
+// the arguments are not evaluated when the line is filtered out, and not compiled at all above DRIVERLOG_MAX_LEVEL
+#define DRIVERLOG_AT(eCategory, eLevel, ...) \
+    do { \
+        if ((eLevel) <= DRIVERLOG_MAX_LEVEL && IsDriverLogEnabled(eCategory, eLevel)) { \
+            DriverLog(__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define DRIVERLOG_ERROR(eCategory, ...) DRIVERLOG_AT(eCategory, DriverLogLevel_Error, __VA_ARGS__)
+#define DRIVERLOG_WARNING(eCategory, ...) DRIVERLOG_AT(eCategory, DriverLogLevel_Warning, __VA_ARGS__)
+#define DRIVERLOG_INFO(eCategory, ...) DRIVERLOG_AT(eCategory, DriverLogLevel_Info, __VA_ARGS__)
+#define DRIVERLOG_VERBOSE(eCategory, ...) DRIVERLOG_AT(eCategory, DriverLogLevel_Verbose, __VA_ARGS__)
+#define DRIVERLOG_DEBUG(eCategory, ...) DRIVERLOG_AT(eCategory, DriverLogLevel_Debug, __VA_ARGS__)
+
+/** applies a list like "tracking=verbose,transport=warning", "all" names every category and a bare level
+ * sets all of them. Nothing changes if any entry is invalid */
+extern bool SetDriverLogLevels(const char *pchLevels);
+
+/** the level of every category in the format SetDriverLogLevels takes, returns false if it didn't fit */
+extern bool GetDriverLogLevels(char *pchLevels, uint32_t unLevelsLen);
 
 // --------------------------------------------------------------------------
 // Purpose: Write to the log file only in debug builds
 // --------------------------------------------------------------------------
-extern void DebugDriverLog(const char *pchFormat, ...);
+template <typename... Args>
+void DebugDriverLog(const char *pchFormat, Args... args)
+{
+    DRIVERLOG_DEBUG(DriverLogCategory_General, pchFormat, args...);
+}
 
+/** starts the thread that formats and writes the queued lines */
 extern bool InitDriverLog(vr::IVRDriverLog *pDriverLog);
+
+/** parks the thread while SteamVR is in standby, lines logged meanwhile are written when it leaves */
+extern void SetDriverLogStandby(bool bStandby);
+
+/** writes what is still queued and stops the thread */
 extern void CleanupDriverLog();
 
 #endif // DRIVERLOG_H
@@ -0,0 +1,422 @@
+// Runs driver_sample under the mock host and fails if its pose, input or
+// RunFrame paths allocate once they are warmed up.
+//
+// usage: alloc_check [-s settings] [-w seconds] [-t seconds] [-r hz] [-v] [[section/]key=value ...]
+//
+// The driver is linked into this executable and built with
+// DRIVER_SAMPLE_ALLOC_CHECK, so every CSampleTraceScope marks the thread it
+// runs on. malloc and its siblings are replaced here; libstdc++'s operator new
+// allocates through them, so new is covered as well. After -w seconds (1) of
+// warm-up every allocation inside a scope is counted on the thread that made
+// it and its call stack is kept, for -t seconds (5) of RunFrame at -r Hz (90).
+// Settings and overrides work like mock_host's, -v keeps the driver's log.
+//
+// Exits with 0 when nothing was allocated, with 1 after printing each
+// offending call stack once with its count, and with 2 when the driver
+// couldn't be run. Allocations outside the scopes, those of the log thread or
+// of the host itself, are only reported as a total.
+
+#include "csamplemockhost.h"
+
+#include "basics.h"
+#include "csampletrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cxxabi.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <malloc.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+#if !defined(DRIVER_SAMPLE_ALLOC_CHECK)
+#error "alloc_check needs the driver built with DRIVER_SAMPLE_ALLOC_CHECK"
+#endif
+
+#if !defined(__GLIBC__)
+#error "alloc_check replaces malloc on top of glibc's"
+#endif
+
+extern "C" void *HmdDriverFactory(const char *pInterfaceName, int *pReturnCode);
+
+// glibc's own allocator under the names it exports for interposers
+extern "C" void *__libc_malloc(size_t cb);
+extern "C" void *__libc_calloc(size_t unCount, size_t cb);
+extern "C" void *__libc_realloc(void *p, size_t cb);
+extern "C" void __libc_free(void *p);
+extern "C" void *__libc_memalign(size_t cbAlignment, size_t cb);
+
+static const uint32_t k_unMaxThreads = 64;
+static const uint32_t k_unMaxStacks = 256;
+static const uint32_t k_unMaxFrames = 32;
+
+// the frames of RecordStack(), CountAllocation() and the replaced function
+static const int k_nSkipFrames = 3;
+
+// allocations of one thread in a scope, only that thread writes them
+struct AllocThread_t
+{
+    uint32_t unThreadId;
+    uint64_t rgulAllocations[SampleTraceScope_Count];
+    uint64_t ulBytes;
+};
+
+// one distinct call stack that allocated in a scope
+struct AllocStack_t
+{
+    uint64_t ulHash;
+    uint32_t unScope;
+    uint32_t unThreadId;
+    int nFrames;
+    void *rgpFrames[k_unMaxFrames];
+    uint64_t ulCount;
+    uint64_t ulBytes;
+};
+
+static std::atomic<bool> s_bArmed(false);
+static std::atomic<uint64_t> s_ulOutsideAllocations(0);
+
+static AllocThread_t s_rgThreads[k_unMaxThreads];
+static std::atomic<uint32_t> s_unThreads(0);
+static std::atomic<uint64_t> s_ulThreadsDropped(0);
+
+static std::mutex s_stackMutex;
+static AllocStack_t s_rgStacks[k_unMaxStacks];
+static uint32_t s_unStacks = 0;
+static uint64_t s_ulStacksDropped = 0;
+
+static thread_local AllocThread_t *t_pThread = nullptr;
+static thread_local bool t_bInHook = false;
+
+static uint32_t GetThreadId()
+{
+    return (uint32_t)syscall(SYS_gettid);
+}
+
+static __attribute__((noinline)) void RecordStack(uint32_t unScope, size_t cb)
+{
+    void *rgpFrames[k_unMaxFrames + k_nSkipFrames];
+    int nFrames = backtrace(rgpFrames, (int)(k_unMaxFrames + k_nSkipFrames)) - k_nSkipFrames;
+    if (nFrames < 0) {
+        nFrames = 0;
+    }
+
+    uint64_t ulHash = 14695981039346656037ull ^ unScope;
+    for (int i = 0; i < nFrames; i++) {
+        ulHash = (ulHash ^ (uint64_t)(uintptr_t)rgpFrames[i + k_nSkipFrames]) * 1099511628211ull;
+    }
+
+    std::lock_guard<std::mutex> lock(s_stackMutex);
+    for (uint32_t i = 0; i < s_unStacks; i++) {
+        if (s_rgStacks[i].ulHash == ulHash) {
+            s_rgStacks[i].ulCount++;
+            s_rgStacks[i].ulBytes += cb;
+            return;
+        }
+    }
+    if (s_unStacks == k_unMaxStacks) {
+        s_ulStacksDropped++;
+        return;
+    }
+
+    AllocStack_t &stack = s_rgStacks[s_unStacks++];
+    stack.ulHash = ulHash;
+    stack.unScope = unScope;
+    stack.unThreadId = t_pThread ? t_pThread->unThreadId : GetThreadId();
+    stack.nFrames = nFrames;
+    memcpy(stack.rgpFrames, rgpFrames + k_nSkipFrames, nFrames * sizeof(void *));
+    stack.ulCount = 1;
+    stack.ulBytes = cb;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Called by every replaced allocation function. Costs a flag check
+// until the warm-up is over; afterwards the allocations inside a scope are
+// counted and their stacks kept, without allocating anything itself. What
+// backtrace() allocates the first time is done before arming.
+//-----------------------------------------------------------------------------
+static __attribute__((noinline)) void CountAllocation(size_t cb)
+{
+    if (!s_bArmed.load(std::memory_order_relaxed) || t_bInHook) {
+        return;
+    }
+
+    uint32_t unScope = t_unSampleAllocCheckScope;
+    if (unScope == 0) {
+        s_ulOutsideAllocations.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    unScope--;
+
+    t_bInHook = true;
+    if (!t_pThread) {
+        uint32_t unSlot = s_unThreads.fetch_add(1, std::memory_order_relaxed);
+        if (unSlot < k_unMaxThreads) {
+            t_pThread = &s_rgThreads[unSlot];
+            t_pThread->unThreadId = GetThreadId();
+        } else {
+            s_ulThreadsDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (t_pThread) {
+        t_pThread->rgulAllocations[unScope]++;
+        t_pThread->ulBytes += cb;
+    }
+    RecordStack(unScope, cb);
+    t_bInHook = false;
+}
+
+extern "C" void *malloc(size_t cb) noexcept
+{
+    CountAllocation(cb);
+    return __libc_malloc(cb);
+}
+
+extern "C" void *calloc(size_t unCount, size_t cb) noexcept
+{
+    CountAllocation(unCount * cb);
+    return __libc_calloc(unCount, cb);
+}
+
+extern "C" void *realloc(void *p, size_t cb) noexcept
+{
+    CountAllocation(cb);
+    return __libc_realloc(p, cb);
+}
+
+extern "C" void free(void *p) noexcept
+{
+    __libc_free(p);
+}
+
+extern "C" void *memalign(size_t cbAlignment, size_t cb) noexcept
+{
+    CountAllocation(cb);
+    return __libc_memalign(cbAlignment, cb);
+}
+
+extern "C" void *aligned_alloc(size_t cbAlignment, size_t cb) noexcept
+{
+    CountAllocation(cb);
+    return __libc_memalign(cbAlignment, cb);
+}
+
+extern "C" int posix_memalign(void **pp, size_t cbAlignment, size_t cb) noexcept
+{
+    CountAllocation(cb);
+    void *p = __libc_memalign(cbAlignment, cb);
+    if (!p) {
+        return ENOMEM;
+    }
+    *pp = p;
+    return 0;
+}
+
+// the path of the driver a scope belongs to
+static const char *GetScopePath(uint32_t unScope)
+{
+    switch (unScope) {
+    case SampleTraceScope_RunFrame:
+    case SampleTraceScope_EventPump:
+        return "run_frame";
+    case SampleTraceScope_DeviceRunFrame:
+    case SampleTraceScope_TransportDatagram:
+        return "input";
+    default:
+        return "pose";
+    }
+}
+
+// one frame of backtrace_symbols() with the C++ name demangled where there is one
+static void PrintFrame(FILE *pFile, const char *pchSymbol)
+{
+    const char *pchOpen = strchr(pchSymbol, '(');
+    const char *pchEnd = pchOpen ? strpbrk(pchOpen, "+)") : nullptr;
+    if (pchOpen && pchEnd && pchEnd > pchOpen + 1) {
+        std::string sMangled(pchOpen + 1, pchEnd - pchOpen - 1);
+        int nStatus = 0;
+        char *pchDemangled = abi::__cxa_demangle(sMangled.c_str(), nullptr, nullptr, &nStatus);
+        const char *pchClose = strchr(pchEnd, ')');
+        if (nStatus == 0 && pchDemangled && pchClose) {
+            fprintf(pFile, "        %s%.*s%s\n", pchDemangled, (int)(pchClose - pchEnd), pchEnd, pchClose + 1);
+            free(pchDemangled);
+            return;
+        }
+        free(pchDemangled);
+    }
+    fprintf(pFile, "        %s\n", pchSymbol);
+}
+
+static uint64_t PrintReport(FILE *pFile)
+{
+    uint64_t rgulPerScope[SampleTraceScope_Count] = {};
+    uint32_t unThreads = std::min(s_unThreads.load(), k_unMaxThreads);
+    for (uint32_t i = 0; i < unThreads; i++) {
+        for (uint32_t unScope = 0; unScope < SampleTraceScope_Count; unScope++) {
+            rgulPerScope[unScope] += s_rgThreads[i].rgulAllocations[unScope];
+        }
+    }
+
+    uint64_t ulTotal = 0;
+    fprintf(pFile, "%-20s %-10s %12s\n", "scope", "path", "allocations");
+    for (uint32_t unScope = 0; unScope < SampleTraceScope_Count; unScope++) {
+        fprintf(pFile, "%-20s %-10s %12llu\n", GetSampleTraceScopeName(unScope), GetScopePath(unScope), (unsigned long long)rgulPerScope[unScope]);
+        ulTotal += rgulPerScope[unScope];
+    }
+    fprintf(pFile, "outside of the scopes: %llu allocations, not checked\n", (unsigned long long)s_ulOutsideAllocations.load());
+
+    if (ulTotal == 0) {
+        return 0;
+    }
+
+    fprintf(pFile, "\nper thread:\n");
+    for (uint32_t i = 0; i < unThreads; i++) {
+        uint64_t ulAllocations = 0;
+        for (uint32_t unScope = 0; unScope < SampleTraceScope_Count; unScope++) {
+            ulAllocations += s_rgThreads[i].rgulAllocations[unScope];
+        }
+        fprintf(pFile, "    thread %u: %llu allocations, %llu bytes\n", s_rgThreads[i].unThreadId, (unsigned long long)ulAllocations, (unsigned long long)s_rgThreads[i].ulBytes);
+    }
+    if (s_ulThreadsDropped.load() > 0) {
+        fprintf(pFile, "    %llu allocations of threads beyond the first %u aren't in the counts\n", (unsigned long long)s_ulThreadsDropped.load(), k_unMaxThreads);
+    }
+
+    std::sort(s_rgStacks, s_rgStacks + s_unStacks, [](const AllocStack_t &a, const AllocStack_t &b) { return a.ulCount > b.ulCount; });
+    fprintf(pFile, "\n%u call stacks allocated:\n", s_unStacks);
+    for (uint32_t i = 0; i < s_unStacks; i++) {
+        const AllocStack_t &stack = s_rgStacks[i];
+        fprintf(pFile, "\n    %llu allocations, %llu bytes in %s (%s) on thread %u\n", (unsigned long long)stack.ulCount,
+            (unsigned long long)stack.ulBytes, GetSampleTraceScopeName(stack.unScope), GetScopePath(stack.unScope), stack.unThreadId);
+        char **ppchSymbols = backtrace_symbols(stack.rgpFrames, stack.nFrames);
+        for (int nFrame = 0; nFrame < stack.nFrames; nFrame++) {
+            if (ppchSymbols) {
+                PrintFrame(pFile, ppchSymbols[nFrame]);
+            } else {
+                fprintf(pFile, "        %p\n", stack.rgpFrames[nFrame]);
+            }
+        }
+        free(ppchSymbols);
+    }
+    if (s_ulStacksDropped > 0) {
+        fprintf(pFile, "\n%llu allocations came from stacks beyond the first %u\n", (unsigned long long)s_ulStacksDropped, k_unMaxStacks);
+    }
+    return ulTotal;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr, "usage: alloc_check [-s settings] [-w seconds] [-t seconds] [-r hz] [-v] [[section/]key=value ...]\n");
+}
+
+static void RunFrames(CSampleMockHost &host, float flRate, float flSeconds)
+{
+    std::chrono::nanoseconds interval((int64_t)(1e9 / flRate));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point end = start + std::chrono::nanoseconds((int64_t)(flSeconds * 1e9));
+    std::chrono::steady_clock::time_point next = start;
+    while (next < end) {
+        host.RunFrame();
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string sSettingsPath(DRIVER_SAMPLE_SETTINGS_PATH);
+    float flWarmupSeconds = 1.0f;
+    float flSeconds = 5.0f;
+    float flRate = 90.0f;
+    bool bVerbose = false;
+
+    CSampleMockHost host;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sSettingsPath = argv[++i];
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            flWarmupSeconds = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            flSeconds = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            flRate = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            bVerbose = true;
+        } else if (strchr(argv[i], '=') && argv[i][0] != '-') {
+            continue;
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (flRate <= 0.0f || flSeconds <= 0.0f || flWarmupSeconds < 0.0f) {
+        PrintUsage();
+        return 2;
+    }
+
+    if (!host.LoadSettings(sSettingsPath.c_str())) {
+        fprintf(stderr, "alloc_check: no settings from %s, the driver uses its defaults\n", sSettingsPath.c_str());
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-r") == 0) {
+            i++;
+            continue;
+        }
+        const char *pchEquals = strchr(argv[i], '=');
+        if (!pchEquals || argv[i][0] == '-') {
+            continue;
+        }
+        std::string sKey(argv[i], pchEquals - argv[i]);
+        std::string sSection(k_pch_Sample_Section);
+        size_t unSlash = sKey.find('/');
+        if (unSlash != std::string::npos) {
+            sSection = sKey.substr(0, unSlash);
+            sKey = sKey.substr(unSlash + 1);
+        }
+        host.SetSetting(sSection.c_str(), sKey.c_str(), pchEquals + 1);
+    }
+
+    host.SetRecordCapacity((size_t)((flWarmupSeconds + flSeconds + 1.0f) * 1000.0f) * 64);
+    host.SetLogFile(bVerbose ? stderr : nullptr);
+
+    // the first backtrace() loads the unwinder, which allocates
+    void *pFrame = nullptr;
+    backtrace(&pFrame, 1);
+
+    if (!host.UseDriverFactory(HmdDriverFactory)) {
+        return 2;
+    }
+    vr::EVRInitError eError = host.Init();
+    if (eError != vr::VRInitError_None) {
+        fprintf(stderr, "alloc_check: Init failed with error %d\n", (int)eError);
+        return 2;
+    }
+
+    RunFrames(host, flRate, flWarmupSeconds);
+    uint64_t ulWarmupFrames = host.GetRunFrameCount();
+
+    s_bArmed.store(true);
+    RunFrames(host, flRate, flSeconds);
+    s_bArmed.store(false);
+
+    uint64_t ulFrames = host.GetRunFrameCount() - ulWarmupFrames;
+    host.Cleanup();
+
+    printf("alloc_check: %.1f s warm-up, %llu RunFrame calls checked over %.1f s\n\n", flWarmupSeconds, (unsigned long long)ulFrames, flSeconds);
+    uint64_t ulAllocations = PrintReport(stdout);
+    host.UnloadDriver();
+
+    if (ulAllocations > 0) {
+        printf("\nFAILED: %llu allocations on the pose, input and RunFrame paths\n", (unsigned long long)ulAllocations);
+        return 1;
+    }
+    printf("\nno allocations on the pose, input and RunFrame paths\n");
+    return 0;
+}
@@ -0,0 +1,957 @@
+#include "csamplemockhost.h"
+
+#include "basics.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WINDOWS)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+using namespace vr;
+
+static const DriverHandle_t k_ulMockDriverHandle = 1;
+
+static const char *const k_rgpchRecordNames[] = { "added", "pose", "boolean", "scalar", "skeleton", "vsync", "vendor_event" };
+
+//-----------------------------------------------------------------------------
+// .vrsettings parsing: an object of sections, each an object of scalar values.
+// Arrays and deeper objects are skipped, like vrserver ignores what the driver
+// can't read through IVRSettings anyway
+//-----------------------------------------------------------------------------
+static void SkipWhitespace(const char **ppch)
+{
+    while (**ppch == ' ' || **ppch == '\t' || **ppch == '\r' || **ppch == '\n') {
+        (*ppch)++;
+    }
+}
+
+static bool ParseJsonString(const char **ppch, std::string *psValue)
+{
+    const char *pch = *ppch;
+    if (*pch != '"') {
+        return false;
+    }
+    pch++;
+    psValue->clear();
+    while (*pch && *pch != '"') {
+        if (*pch == '\\') {
+            pch++;
+            switch (*pch) {
+            case 'n': psValue->push_back('\n'); break;
+            case 't': psValue->push_back('\t'); break;
+            case 'r': psValue->push_back('\r'); break;
+            case 'b': psValue->push_back('\b'); break;
+            case 'f': psValue->push_back('\f'); break;
+            case 'u':
+                // settings are ASCII, anything else becomes a placeholder
+                if (strlen(pch) < 5) {
+                    return false;
+                }
+                psValue->push_back('?');
+                pch += 4;
+                break;
+            case 0: return false;
+            default: psValue->push_back(*pch); break;
+            }
+            pch++;
+        } else {
+            psValue->push_back(*pch++);
+        }
+    }
+    if (*pch != '"') {
+        return false;
+    }
+    *ppch = pch + 1;
+    return true;
+}
+
+static bool SkipJsonValue(const char **ppch, uint32_t unDepth)
+{
+    SkipWhitespace(ppch);
+    std::string sIgnored;
+    char ch = **ppch;
+    if (ch == '"') {
+        return ParseJsonString(ppch, &sIgnored);
+    }
+    if (ch == '{' || ch == '[') {
+        if (unDepth > 32) {
+            return false;
+        }
+        char chClose = ch == '{' ? '}' : ']';
+        (*ppch)++;
+        SkipWhitespace(ppch);
+        if (**ppch == chClose) {
+            (*ppch)++;
+            return true;
+        }
+        for (;;) {
+            if (ch == '{') {
+                SkipWhitespace(ppch);
+                if (!ParseJsonString(ppch, &sIgnored)) {
+                    return false;
+                }
+                SkipWhitespace(ppch);
+                if (**ppch != ':') {
+                    return false;
+                }
+                (*ppch)++;
+            }
+            if (!SkipJsonValue(ppch, unDepth + 1)) {
+                return false;
+            }
+            SkipWhitespace(ppch);
+            if (**ppch == ',') {
+                (*ppch)++;
+                continue;
+            }
+            if (**ppch != chClose) {
+                return false;
+            }
+            (*ppch)++;
+            return true;
+        }
+    }
+    // literals and numbers
+    const char *pchStart = *ppch;
+    while (**ppch && strchr(",}] \t\r\n", **ppch) == nullptr) {
+        (*ppch)++;
+    }
+    return *ppch != pchStart;
+}
+
+CSampleMockHost::CSampleMockHost()
+    : m_hModule(nullptr), m_pProvider(nullptr), m_bInitialized(false), m_pLogFile(stderr), m_ulStartNs(0),
+      m_unRecordCapacity(0), m_ulDroppedRecords(0), m_ulRunFrames(0), m_ulRunFrameTotalNs(0), m_ulRunFrameMaxNs(0)
+{
+}
+
+CSampleMockHost::~CSampleMockHost()
+{
+    Cleanup();
+    UnloadDriver();
+}
+
+bool CSampleMockHost::LoadSettings(const char *pchPath)
+{
+    FILE *pFile = fopen(pchPath, "rb");
+    if (!pFile) {
+        return false;
+    }
+    std::string sText;
+    char rgchChunk[4096];
+    size_t cbRead;
+    while ((cbRead = fread(rgchChunk, 1, sizeof(rgchChunk), pFile)) > 0) {
+        sText.append(rgchChunk, cbRead);
+    }
+    fclose(pFile);
+
+    const char *pch = sText.c_str();
+    SkipWhitespace(&pch);
+    if (*pch++ != '{') {
+        return false;
+    }
+    SkipWhitespace(&pch);
+    if (*pch == '}') {
+        return true;
+    }
+
+    std::string sSection;
+    std::string sKey;
+    std::string sValue;
+    for (;;) {
+        SkipWhitespace(&pch);
+        if (!ParseJsonString(&pch, &sSection)) {
+            return false;
+        }
+        SkipWhitespace(&pch);
+        if (*pch++ != ':') {
+            return false;
+        }
+        SkipWhitespace(&pch);
+        if (*pch != '{') {
+            if (!SkipJsonValue(&pch, 0)) {
+                return false;
+            }
+        } else {
+            pch++;
+            SkipWhitespace(&pch);
+            while (*pch != '}') {
+                if (!ParseJsonString(&pch, &sKey)) {
+                    return false;
+                }
+                SkipWhitespace(&pch);
+                if (*pch++ != ':') {
+                    return false;
+                }
+                SkipWhitespace(&pch);
+                if (*pch == '"') {
+                    if (!ParseJsonString(&pch, &sValue)) {
+                        return false;
+                    }
+                    Setting_t setting = { SettingType_String, false, 0.0, sValue };
+                    StoreSetting(sSection.c_str(), sKey.c_str(), setting, nullptr);
+                } else {
+                    const char *pchValue = pch;
+                    if (!SkipJsonValue(&pch, 0)) {
+                        return false;
+                    }
+                    if (*pchValue != '{' && *pchValue != '[' && strncmp(pchValue, "null", 4) != 0) {
+                        SetSetting(sSection.c_str(), sKey.c_str(), std::string(pchValue, pch).c_str());
+                    }
+                }
+                SkipWhitespace(&pch);
+                if (*pch == ',') {
+                    pch++;
+                    SkipWhitespace(&pch);
+                } else if (*pch != '}') {
+                    return false;
+                }
+            }
+            pch++;
+        }
+        SkipWhitespace(&pch);
+        if (*pch == ',') {
+            pch++;
+            continue;
+        }
+        return *pch == '}';
+    }
+}
+
+void CSampleMockHost::SetSetting(const char *pchSection, const char *pchKey, const char *pchValue)
+{
+    Setting_t setting = { SettingType_String, false, 0.0, pchValue };
+    char *pchEnd = nullptr;
+    double dValue = strtod(pchValue, &pchEnd);
+    if (strcmp(pchValue, "true") == 0 || strcmp(pchValue, "false") == 0) {
+        setting.eType = SettingType_Bool;
+        setting.bValue = pchValue[0] == 't';
+    } else if (pchValue[0] && pchEnd && *pchEnd == 0) {
+        setting.eType = SettingType_Number;
+        setting.dValue = dValue;
+    }
+    StoreSetting(pchSection, pchKey, setting, nullptr);
+}
+
+void CSampleMockHost::SetRecordCapacity(size_t unRecords)
+{
+    std::lock_guard<std::mutex> lock(m_recordsMutex);
+    m_unRecordCapacity = unRecords;
+    m_vecRecords.reserve(unRecords);
+}
+
+bool CSampleMockHost::LoadDriver(const char *pchPath)
+{
+    UnloadDriver();
+
+#if defined(_WINDOWS)
+    HMODULE hModule = LoadLibraryA(pchPath);
+    if (!hModule) {
+        fprintf(stderr, "mock_host: unable to load %s (error %lu)\n", pchPath, GetLastError());
+        return false;
+    }
+    HmdDriverFactoryFn pFactory = (HmdDriverFactoryFn)GetProcAddress(hModule, "HmdDriverFactory");
+#else
+    void *hModule = dlopen(pchPath, RTLD_NOW | RTLD_LOCAL);
+    if (!hModule) {
+        fprintf(stderr, "mock_host: unable to load %s: %s\n", pchPath, dlerror());
+        return false;
+    }
+    HmdDriverFactoryFn pFactory = (HmdDriverFactoryFn)dlsym(hModule, "HmdDriverFactory");
+#endif
+    m_hModule = (void *)hModule;
+
+    if (!pFactory) {
+        fprintf(stderr, "mock_host: %s has no HmdDriverFactory\n", pchPath);
+        UnloadDriver();
+        return false;
+    }
+    if (!UseDriverFactory(pFactory)) {
+        UnloadDriver();
+        return false;
+    }
+    return true;
+}
+
+bool CSampleMockHost::UseDriverFactory(HmdDriverFactoryFn pFactory)
+{
+    if (m_pProvider) {
+        return false;
+    }
+
+    int nReturnCode = VRInitError_None;
+    m_pProvider = (IServerTrackedDeviceProvider *)pFactory(IServerTrackedDeviceProvider_Version, &nReturnCode);
+    if (!m_pProvider) {
+        fprintf(stderr, "mock_host: the driver doesn't provide %s (error %d)\n", IServerTrackedDeviceProvider_Version, nReturnCode);
+        return false;
+    }
+    return true;
+}
+
+EVRInitError CSampleMockHost::Init()
+{
+    if (!m_pProvider || m_bInitialized) {
+        return VRInitError_Init_NotInitialized;
+    }
+    m_ulStartNs = GetTimestampNs();
+    EVRInitError eError = m_pProvider->Init(this);
+    m_bInitialized = eError == VRInitError_None;
+    return eError;
+}
+
+void CSampleMockHost::RunFrame()
+{
+    if (!m_bInitialized) {
+        return;
+    }
+
+    uint64_t ulBeginNs = GetTimestampNs();
+    m_pProvider->RunFrame();
+    uint64_t ulDurationNs = GetTimestampNs() - ulBeginNs;
+    m_ulRunFrames++;
+    m_ulRunFrameTotalNs += ulDurationNs;
+    m_ulRunFrameMaxNs = std::max(m_ulRunFrameMaxNs, ulDurationNs);
+
+    for (uint32_t i = 0; i < (uint32_t)m_vecDevices.size(); i++) {
+        Device_t &device = m_vecDevices[i];
+        if (device.bActivated) {
+            continue;
+        }
+        EVRInitError eError = device.pDriver->Activate(i);
+        device.bActivated = true;
+        if (eError != VRInitError_None) {
+            fprintf(stderr, "mock_host: activating %s failed with error %d\n", device.sSerialNumber.c_str(), (int)eError);
+        }
+    }
+}
+
+void CSampleMockHost::Cleanup()
+{
+    if (!m_bInitialized) {
+        return;
+    }
+    for (Device_t &device : m_vecDevices) {
+        if (device.bActivated) {
+            device.pDriver->Deactivate();
+            device.bActivated = false;
+        }
+    }
+    m_pProvider->Cleanup();
+    m_bInitialized = false;
+}
+
+void CSampleMockHost::UnloadDriver()
+{
+    Cleanup();
+    m_pProvider = nullptr;
+    m_vecDevices.clear();
+    if (m_hModule) {
+#if defined(_WINDOWS)
+        FreeLibrary((HMODULE)m_hModule);
+#else
+        dlclose(m_hModule);
+#endif
+        m_hModule = nullptr;
+    }
+}
+
+void CSampleMockHost::WriteRecordsCsv(FILE *pFile) const
+{
+    fprintf(pFile, "time_s,type,device,serial,component,value,time_offset,result,valid,connected,x,y,z,qw,qx,qy,qz\n");
+    for (const SampleMockHostRecord_t &record : m_vecRecords) {
+        const char *pchSerial = record.unDevice < m_vecDevices.size() ? m_vecDevices[record.unDevice].sSerialNumber.c_str() : "";
+        const char *pchComponent = record.unComponent > 0 && record.unComponent <= m_vecComponents.size() ? m_vecComponents[record.unComponent - 1].sName.c_str() : "";
+        fprintf(pFile, "%.9f,%s,%d,%s,%s,%.9g,%.9g,", (record.ulTimeNs - m_ulStartNs) * 1e-9, k_rgpchRecordNames[record.eType],
+            record.unDevice == k_unTrackedDeviceIndexInvalid ? -1 : (int)record.unDevice, pchSerial, pchComponent, record.dValue, record.dTimeOffset);
+        if (record.eType == SampleMockHostRecord_Pose) {
+            fprintf(pFile, "%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", (int)record.eResult, record.bPoseIsValid ? 1 : 0, record.bDeviceIsConnected ? 1 : 0,
+                record.rdPosition[0], record.rdPosition[1], record.rdPosition[2], record.qRotation.w, record.qRotation.x, record.qRotation.y, record.qRotation.z);
+        } else {
+            fprintf(pFile, ",,,,,,,,,\n");
+        }
+    }
+}
+
+void CSampleMockHost::PrintSummary(FILE *pFile) const
+{
+    fprintf(pFile, "RunFrame: %llu calls, mean %.1f us, max %.1f us\n", (unsigned long long)m_ulRunFrames,
+        m_ulRunFrames ? m_ulRunFrameTotalNs * 1e-3 / m_ulRunFrames : 0.0, m_ulRunFrameMaxNs * 1e-3);
+
+    for (uint32_t i = 0; i < (uint32_t)m_vecDevices.size(); i++) {
+        uint64_t ulPoses = 0;
+        uint64_t ulInputs = 0;
+        uint64_t ulFirstNs = 0;
+        uint64_t ulLastNs = 0;
+        uint64_t ulMaxGapNs = 0;
+        for (const SampleMockHostRecord_t &record : m_vecRecords) {
+            if (record.unDevice != i) {
+                continue;
+            }
+            if (record.eType == SampleMockHostRecord_Pose) {
+                if (ulPoses++ == 0) {
+                    ulFirstNs = record.ulTimeNs;
+                } else {
+                    ulMaxGapNs = std::max(ulMaxGapNs, record.ulTimeNs - ulLastNs);
+                }
+                ulLastNs = record.ulTimeNs;
+            } else if (record.eType != SampleMockHostRecord_DeviceAdded) {
+                ulInputs++;
+            }
+        }
+        double dRate = ulPoses > 1 ? (ulPoses - 1) / ((ulLastNs - ulFirstNs) * 1e-9) : 0.0;
+        fprintf(pFile, "device %u %s (class %d): %llu poses, %.1f Hz, max gap %.1f ms, %llu input updates\n", i,
+            m_vecDevices[i].sSerialNumber.c_str(), (int)m_vecDevices[i].eClass, (unsigned long long)ulPoses, dRate, ulMaxGapNs * 1e-6,
+            (unsigned long long)ulInputs);
+    }
+
+    if (m_ulDroppedRecords) {
+        fprintf(pFile, "%llu records dropped, the buffer holds %llu\n", (unsigned long long)m_ulDroppedRecords, (unsigned long long)m_unRecordCapacity);
+    }
+}
+
+void CSampleMockHost::Record(const SampleMockHostRecord_t &record)
+{
+    std::lock_guard<std::mutex> lock(m_recordsMutex);
+    if (m_vecRecords.size() >= m_unRecordCapacity) {
+        m_ulDroppedRecords++;
+        return;
+    }
+    m_vecRecords.push_back(record);
+}
+
+//-----------------------------------------------------------------------------
+// IVRDriverContext
+//-----------------------------------------------------------------------------
+void *CSampleMockHost::GetGenericInterface(const char *pchInterfaceVersion, EVRInitError *peError)
+{
+    void *pInterface = nullptr;
+    if (strcmp(pchInterfaceVersion, IVRServerDriverHost_Version) == 0) {
+        pInterface = static_cast<IVRServerDriverHost *>(this);
+    } else if (strcmp(pchInterfaceVersion, IVRSettings_Version) == 0) {
+        pInterface = static_cast<IVRSettings *>(this);
+    } else if (strcmp(pchInterfaceVersion, IVRProperties_Version) == 0) {
+        pInterface = static_cast<IVRProperties *>(this);
+    } else if (strcmp(pchInterfaceVersion, IVRDriverInput_Version) == 0) {
+        pInterface = static_cast<IVRDriverInput *>(this);
+    } else if (strcmp(pchInterfaceVersion, IVRDriverLog_Version) == 0) {
+        pInterface = static_cast<IVRDriverLog *>(this);
+    } else if (strcmp(pchInterfaceVersion, IVRDriverManager_Version) == 0) {
+        pInterface = static_cast<IVRDriverManager *>(this);
+    } else if (strcmp(pchInterfaceVersion, IVRResources_Version) == 0) {
+        pInterface = static_cast<IVRResources *>(this);
+    }
+    if (peError) {
+        *peError = pInterface ? VRInitError_None : VRInitError_Init_InterfaceNotFound;
+    }
+    return pInterface;
+}
+
+DriverHandle_t CSampleMockHost::GetDriverHandle()
+{
+    return k_ulMockDriverHandle;
+}
+
+//-----------------------------------------------------------------------------
+// IVRServerDriverHost
+//-----------------------------------------------------------------------------
+bool CSampleMockHost::TrackedDeviceAdded(const char *pchDeviceSerialNumber, ETrackedDeviceClass eDeviceClass, ITrackedDeviceServerDriver *pDriver)
+{
+    if (!pDriver || m_vecDevices.size() >= k_unMaxTrackedDeviceCount) {
+        return false;
+    }
+    for (const Device_t &device : m_vecDevices) {
+        if (device.sSerialNumber == pchDeviceSerialNumber) {
+            return false;
+        }
+    }
+
+    Device_t device = { pchDeviceSerialNumber, eDeviceClass, pDriver, false };
+    m_vecDevices.push_back(device);
+
+    SampleMockHostRecord_t record = {};
+    record.ulTimeNs = GetTimestampNs();
+    record.eType = SampleMockHostRecord_DeviceAdded;
+    record.unDevice = (uint32_t)m_vecDevices.size() - 1;
+    record.dValue = eDeviceClass;
+    Record(record);
+    return true;
+}
+
+static HmdQuaternion_t MultiplyQuaternions(const HmdQuaternion_t &a, const HmdQuaternion_t &b)
+{
+    HmdQuaternion_t q;
+    q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+    q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+    q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+    q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+    return q;
+}
+
+static void RotateVector(const HmdQuaternion_t &q, const double rdIn[3], double rdOut[3])
+{
+    HmdQuaternion_t v = { 0.0, rdIn[0], rdIn[1], rdIn[2] };
+    HmdQuaternion_t qConjugate = { q.w, -q.x, -q.y, -q.z };
+    HmdQuaternion_t r = MultiplyQuaternions(MultiplyQuaternions(q, v), qConjugate);
+    rdOut[0] = r.x;
+    rdOut[1] = r.y;
+    rdOut[2] = r.z;
+}
+
+void CSampleMockHost::TrackedDevicePoseUpdated(uint32_t unWhichDevice, const DriverPose_t &newPose, uint32_t unPoseStructSize)
+{
+    SampleMockHostRecord_t record = {};
+    record.ulTimeNs = GetTimestampNs();
+    record.eType = SampleMockHostRecord_Pose;
+    record.unDevice = unWhichDevice;
+    record.dTimeOffset = newPose.poseTimeOffset;
+    record.eResult = newPose.result;
+    record.bPoseIsValid = newPose.poseIsValid;
+    record.bDeviceIsConnected = newPose.deviceIsConnected;
+
+    // the same chain vrserver applies: head offset, driver pose, then driver to world
+    double rdHead[3];
+    RotateVector(newPose.qRotation, newPose.vecDriverFromHeadTranslation, rdHead);
+    double rdDriver[3] = { newPose.vecPosition[0] + rdHead[0], newPose.vecPosition[1] + rdHead[1], newPose.vecPosition[2] + rdHead[2] };
+    RotateVector(newPose.qWorldFromDriverRotation, rdDriver, record.rdPosition);
+    for (int i = 0; i < 3; i++) {
+        record.rdPosition[i] += newPose.vecWorldFromDriverTranslation[i];
+    }
+    record.qRotation = MultiplyQuaternions(MultiplyQuaternions(newPose.qWorldFromDriverRotation, newPose.qRotation), newPose.qDriverFromHeadRotation);
+    Record(record);
+}
+
+void CSampleMockHost::VsyncEvent(double vsyncTimeOffsetSeconds)
+{
+    SampleMockHostRecord_t record = {};
+    record.ulTimeNs = GetTimestampNs();
+    record.eType = SampleMockHostRecord_Vsync;
+    record.unDevice = k_unTrackedDeviceIndexInvalid;
+    record.dTimeOffset = vsyncTimeOffsetSeconds;
+    Record(record);
+}
+
+void CSampleMockHost::VendorSpecificEvent(uint32_t unWhichDevice, EVREventType eventType, const VREvent_Data_t &eventData, double eventTimeOffset)
+{
+    SampleMockHostRecord_t record = {};
+    record.ulTimeNs = GetTimestampNs();
+    record.eType = SampleMockHostRecord_VendorEvent;
+    record.unDevice = unWhichDevice;
+    record.dValue = eventType;
+    record.dTimeOffset = eventTimeOffset;
+    Record(record);
+}
+
+bool CSampleMockHost::IsExiting()
+{
+    return false;
+}
+
+bool CSampleMockHost::PollNextEvent(VREvent_t *pEvent, uint32_t uncbVREvent)
+{
+    return false;
+}
+
+void CSampleMockHost::GetRawTrackedDevicePoses(float fPredictedSecondsFromNow, TrackedDevicePose_t *pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount)
+{
+    memset(pTrackedDevicePoseArray, 0, sizeof(TrackedDevicePose_t) * unTrackedDevicePoseArrayCount);
+}
+
+void CSampleMockHost::TrackedDeviceDisplayTransformUpdated(uint32_t unWhichDevice, HmdMatrix34_t eyeToHeadLeft, HmdMatrix34_t eyeToHeadRight)
+{
+}
+
+//-----------------------------------------------------------------------------
+// IVRSettings
+//-----------------------------------------------------------------------------
+const CSampleMockHost::Setting_t *CSampleMockHost::FindSetting(const char *pchSection, const char *pchSettingsKey, EVRSettingsError *peError) const
+{
+    const Setting_t *pSetting = nullptr;
+    auto iterSection = m_mapSettings.find(pchSection);
+    if (iterSection != m_mapSettings.end()) {
+        auto iterKey = iterSection->second.find(pchSettingsKey);
+        if (iterKey != iterSection->second.end()) {
+            pSetting = &iterKey->second;
+        }
+    }
+    if (peError) {
+        *peError = pSetting ? VRSettingsError_None : VRSettingsError_UnsetSettingHasNoDefault;
+    }
+    return pSetting;
+}
+
+void CSampleMockHost::StoreSetting(const char *pchSection, const char *pchSettingsKey, const Setting_t &setting, EVRSettingsError *peError)
+{
+    std::lock_guard<std::mutex> lock(m_settingsMutex);
+    m_mapSettings[pchSection][pchSettingsKey] = setting;
+    if (peError) {
+        *peError = VRSettingsError_None;
+    }
+}
+
+const char *CSampleMockHost::GetSettingsErrorNameFromEnum(EVRSettingsError eError)
+{
+    switch (eError) {
+    case VRSettingsError_None: return "VRSettingsError_None";
+    case VRSettingsError_IPCFailed: return "VRSettingsError_IPCFailed";
+    case VRSettingsError_WriteFailed: return "VRSettingsError_WriteFailed";
+    case VRSettingsError_ReadFailed: return "VRSettingsError_ReadFailed";
+    case VRSettingsError_JsonParseFailed: return "VRSettingsError_JsonParseFailed";
+    case VRSettingsError_UnsetSettingHasNoDefault: return "VRSettingsError_UnsetSettingHasNoDefault";
+    }
+    return "VRSettingsError_Unknown";
+}
+
+bool CSampleMockHost::Sync(bool bForce, EVRSettingsError *peError)
+{
+    if (peError) {
+        *peError = VRSettingsError_None;
+    }
+    return true;
+}
+
+void CSampleMockHost::SetBool(const char *pchSection, const char *pchSettingsKey, bool bValue, EVRSettingsError *peError)
+{
+    Setting_t setting = { SettingType_Bool, bValue, 0.0, std::string() };
+    StoreSetting(pchSection, pchSettingsKey, setting, peError);
+}
+
+void CSampleMockHost::SetInt32(const char *pchSection, const char *pchSettingsKey, int32_t nValue, EVRSettingsError *peError)
+{
+    Setting_t setting = { SettingType_Number, false, (double)nValue, std::string() };
+    StoreSetting(pchSection, pchSettingsKey, setting, peError);
+}
+
+void CSampleMockHost::SetFloat(const char *pchSection, const char *pchSettingsKey, float flValue, EVRSettingsError *peError)
+{
+    Setting_t setting = { SettingType_Number, false, (double)flValue, std::string() };
+    StoreSetting(pchSection, pchSettingsKey, setting, peError);
+}
+
+void CSampleMockHost::SetString(const char *pchSection, const char *pchSettingsKey, const char *pchValue, EVRSettingsError *peError)
+{
+    Setting_t setting = { SettingType_String, false, 0.0, pchValue };
+    StoreSetting(pchSection, pchSettingsKey, setting, peError);
+}
+
+// numbers and bools convert into each other like they do in vrserver, strings never do
+bool CSampleMockHost::GetBool(const char *pchSection, const char *pchSettingsKey, EVRSettingsError *peError)
+{
+    std::lock_guard<std::mutex> lock(m_settingsMutex);
+    const Setting_t *pSetting = FindSetting(pchSection, pchSettingsKey, peError);
+    if (!pSetting || pSetting->eType == SettingType_String) {
+        if (pSetting && peError) {
+            *peError = VRSettingsError_ReadFailed;
+        }
+        return false;
+    }
+    return pSetting->eType == SettingType_Bool ? pSetting->bValue : pSetting->dValue != 0.0;
+}
+
+int32_t CSampleMockHost::GetInt32(const char *pchSection, const char *pchSettingsKey, EVRSettingsError *peError)
+{
+    std::lock_guard<std::mutex> lock(m_settingsMutex);
+    const Setting_t *pSetting = FindSetting(pchSection, pchSettingsKey, peError);
+    if (!pSetting || pSetting->eType == SettingType_String) {
+        if (pSetting && peError) {
+            *peError = VRSettingsError_ReadFailed;
+        }
+        return 0;
+    }
+    return pSetting->eType == SettingType_Bool ? (pSetting->bValue ? 1 : 0) : (int32_t)pSetting->dValue;
+}
+
+float CSampleMockHost::GetFloat(const char *pchSection, const char *pchSettingsKey, EVRSettingsError *peError)
+{
+    std::lock_guard<std::mutex> lock(m_settingsMutex);
+    const Setting_t *pSetting = FindSetting(pchSection, pchSettingsKey, peError);
+    if (!pSetting || pSetting->eType == SettingType_String) {
+        if (pSetting && peError) {
+            *peError = VRSettingsError_ReadFailed;
+        }
+        return 0.0f;
+    }
+    return pSetting->eType == SettingType_Bool ? (pSetting->bValue ? 1.0f : 0.0f) : (float)pSetting->dValue;
+}
+
+void CSampleMockHost::GetString(const char *pchSection, const char *pchSettingsKey, char *pchValue, uint32_t unValueLen, EVRSettingsError *peError)
+{
+    std::lock_guard<std::mutex> lock(m_settingsMutex);
+    if (unValueLen > 0) {
+        pchValue[0] = 0;
+    }
+    const Setting_t *pSetting = FindSetting(pchSection, pchSettingsKey, peError);
+    if (!pSetting) {
+        return;
+    }
+    if (pSetting->eType != SettingType_String) {
+        if (peError) {
+            *peError = VRSettingsError_ReadFailed;
+        }
+        return;
+    }
+    if (unValueLen > 0) {
+        strncpy(pchValue, pSetting->sValue.c_str(), unValueLen - 1);
+        pchValue[unValueLen - 1] = 0;
+    }
+}
+
+void CSampleMockHost::RemoveSection(const char *pchSection, EVRSettingsError *peError)
+{
+    std::lock_guard<std::mutex> lock(m_settingsMutex);
+    m_mapSettings.erase(pchSection);
+    if (peError) {
+        *peError = VRSettingsError_None;
+    }
+}
+
+void CSampleMockHost::RemoveKeyInSection(const char *pchSection, const char *pchSettingsKey, EVRSettingsError *peError)
+{
+    std::lock_guard<std::mutex> lock(m_settingsMutex);
+    auto iterSection = m_mapSettings.find(pchSection);
+    if (iterSection != m_mapSettings.end()) {
+        iterSection->second.erase(pchSettingsKey);
+    }
+    if (peError) {
+        *peError = VRSettingsError_None;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// IVRProperties, container handles are the device index plus one
+//-----------------------------------------------------------------------------
+ETrackedPropertyError CSampleMockHost::ReadPropertyBatch(PropertyContainerHandle_t ulContainerHandle, PropertyRead_t *pBatch, uint32_t unBatchEntryCount)
+{
+    if (ulContainerHandle == k_ulInvalidPropertyContainer) {
+        return TrackedProp_InvalidDevice;
+    }
+    std::lock_guard<std::mutex> lock(m_propertiesMutex);
+    const std::map<ETrackedDeviceProperty, Property_t> &mapContainer = m_mapProperties[ulContainerHandle];
+    for (uint32_t i = 0; i < unBatchEntryCount; i++) {
+        PropertyRead_t &read = pBatch[i];
+        auto iter = mapContainer.find(read.prop);
+        if (iter == mapContainer.end()) {
+            read.eError = TrackedProp_UnknownProperty;
+            read.unRequiredBufferSize = 0;
+            continue;
+        }
+        const Property_t &property = iter->second;
+        read.unTag = property.unTag;
+        read.unRequiredBufferSize = (uint32_t)property.vecValue.size();
+        if (property.eError != TrackedProp_Success) {
+            read.eError = property.eError;
+        } else if (read.unBufferSize < property.vecValue.size()) {
+            read.eError = TrackedProp_BufferTooSmall;
+        } else {
+            if (!property.vecValue.empty()) {
+                memcpy(read.pvBuffer, property.vecValue.data(), property.vecValue.size());
+            }
+            read.eError = TrackedProp_Success;
+        }
+    }
+    return TrackedProp_Success;
+}
+
+ETrackedPropertyError CSampleMockHost::WritePropertyBatch(PropertyContainerHandle_t ulContainerHandle, PropertyWrite_t *pBatch, uint32_t unBatchEntryCount)
+{
+    if (ulContainerHandle == k_ulInvalidPropertyContainer) {
+        return TrackedProp_InvalidDevice;
+    }
+    std::lock_guard<std::mutex> lock(m_propertiesMutex);
+    std::map<ETrackedDeviceProperty, Property_t> &mapContainer = m_mapProperties[ulContainerHandle];
+    for (uint32_t i = 0; i < unBatchEntryCount; i++) {
+        PropertyWrite_t &write = pBatch[i];
+        switch (write.writeType) {
+        case PropertyWrite_Set: {
+            Property_t &property = mapContainer[write.prop];
+            property.unTag = write.unTag;
+            property.eError = TrackedProp_Success;
+            property.vecValue.assign((const char *)write.pvBuffer, (const char *)write.pvBuffer + write.unBufferSize);
+            break;
+        }
+        case PropertyWrite_Erase:
+            mapContainer.erase(write.prop);
+            break;
+        case PropertyWrite_SetError: {
+            Property_t &property = mapContainer[write.prop];
+            property.unTag = k_unInvalidPropertyTag;
+            property.eError = write.eSetError;
+            property.vecValue.clear();
+            break;
+        }
+        }
+        write.eError = TrackedProp_Success;
+    }
+    return TrackedProp_Success;
+}
+
+const char *CSampleMockHost::GetPropErrorNameFromEnum(ETrackedPropertyError error)
+{
+    switch (error) {
+    case TrackedProp_Success: return "TrackedProp_Success";
+    case TrackedProp_WrongDataType: return "TrackedProp_WrongDataType";
+    case TrackedProp_WrongDeviceClass: return "TrackedProp_WrongDeviceClass";
+    case TrackedProp_BufferTooSmall: return "TrackedProp_BufferTooSmall";
+    case TrackedProp_UnknownProperty: return "TrackedProp_UnknownProperty";
+    case TrackedProp_InvalidDevice: return "TrackedProp_InvalidDevice";
+    case TrackedProp_NotYetAvailable: return "TrackedProp_NotYetAvailable";
+    default: return "TrackedProp_Other";
+    }
+}
+
+PropertyContainerHandle_t CSampleMockHost::TrackedDeviceToPropertyContainer(TrackedDeviceIndex_t nDevice)
+{
+    return nDevice < k_unMaxTrackedDeviceCount ? (PropertyContainerHandle_t)nDevice + 1 : k_ulInvalidPropertyContainer;
+}
+
+//-----------------------------------------------------------------------------
+// IVRDriverInput, component handles are the component index plus one
+//-----------------------------------------------------------------------------
+EVRInputError CSampleMockHost::CreateComponent(PropertyContainerHandle_t ulContainer, const char *pchName, VRInputComponentHandle_t *pHandle)
+{
+    if (ulContainer == k_ulInvalidPropertyContainer || !pchName || !pHandle) {
+        return VRInputError_InvalidParam;
+    }
+    std::lock_guard<std::mutex> lock(m_componentsMutex);
+    Component_t component = { ulContainer, pchName };
+    m_vecComponents.push_back(component);
+    *pHandle = (VRInputComponentHandle_t)m_vecComponents.size();
+    return VRInputError_None;
+}
+
+bool CSampleMockHost::FindComponentDevice(VRInputComponentHandle_t ulComponent, uint32_t *punDevice)
+{
+    std::lock_guard<std::mutex> lock(m_componentsMutex);
+    if (ulComponent == k_ulInvalidInputComponentHandle || ulComponent > m_vecComponents.size()) {
+        return false;
+    }
+    *punDevice = (uint32_t)m_vecComponents[ulComponent - 1].ulContainer - 1;
+    return true;
+}
+
+EVRInputError CSampleMockHost::CreateBooleanComponent(PropertyContainerHandle_t ulContainer, const char *pchName, VRInputComponentHandle_t *pHandle)
+{
+    return CreateComponent(ulContainer, pchName, pHandle);
+}
+
+EVRInputError CSampleMockHost::UpdateBooleanComponent(VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset)
+{
+    uint32_t unDevice;
+    if (!FindComponentDevice(ulComponent, &unDevice)) {
+        return VRInputError_InvalidHandle;
+    }
+    SampleMockHostRecord_t record = {};
+    record.ulTimeNs = GetTimestampNs();
+    record.eType = SampleMockHostRecord_Boolean;
+    record.unDevice = unDevice;
+    record.unComponent = (uint32_t)ulComponent;
+    record.dValue = bNewValue ? 1.0 : 0.0;
+    record.dTimeOffset = fTimeOffset;
+    Record(record);
+    return VRInputError_None;
+}
+
+EVRInputError CSampleMockHost::CreateScalarComponent(PropertyContainerHandle_t ulContainer, const char *pchName, VRInputComponentHandle_t *pHandle, EVRScalarType eType, EVRScalarUnits eUnits)
+{
+    return CreateComponent(ulContainer, pchName, pHandle);
+}
+
+EVRInputError CSampleMockHost::UpdateScalarComponent(VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset)
+{
+    uint32_t unDevice;
+    if (!FindComponentDevice(ulComponent, &unDevice)) {
+        return VRInputError_InvalidHandle;
+    }
+    SampleMockHostRecord_t record = {};
+    record.ulTimeNs = GetTimestampNs();
+    record.eType = SampleMockHostRecord_Scalar;
+    record.unDevice = unDevice;
+    record.unComponent = (uint32_t)ulComponent;
+    record.dValue = fNewValue;
+    record.dTimeOffset = fTimeOffset;
+    Record(record);
+    return VRInputError_None;
+}
+
+EVRInputError CSampleMockHost::CreateHapticComponent(PropertyContainerHandle_t ulContainer, const char *pchName, VRInputComponentHandle_t *pHandle)
+{
+    return CreateComponent(ulContainer, pchName, pHandle);
+}
+
+EVRInputError CSampleMockHost::CreateSkeletonComponent(PropertyContainerHandle_t ulContainer, const char *pchName, const char *pchSkeletonPath, const char *pchBasePosePath,
+    const VRBoneTransform_t *pGripLimitTransforms, uint32_t unGripLimitTransformCount, VRInputComponentHandle_t *pHandle)
+{
+    return CreateComponent(ulContainer, pchName, pHandle);
+}
+
+EVRInputError CSampleMockHost::UpdateSkeletonComponent(VRInputComponentHandle_t ulComponent, EVRSkeletalMotionRange eMotionRange, const VRBoneTransform_t *pTransforms, uint32_t unTransformCount)
+{
+    uint32_t unDevice;
+    if (!FindComponentDevice(ulComponent, &unDevice)) {
+        return VRInputError_InvalidHandle;
+    }
+    SampleMockHostRecord_t record = {};
+    record.ulTimeNs = GetTimestampNs();
+    record.eType = SampleMockHostRecord_Skeleton;
+    record.unDevice = unDevice;
+    record.unComponent = (uint32_t)ulComponent;
+    record.dValue = eMotionRange;
+    Record(record);
+    return VRInputError_None;
+}
+
+//-----------------------------------------------------------------------------
+// IVRDriverLog
+//-----------------------------------------------------------------------------
+void CSampleMockHost::Log(const char *pchLogMessage)
+{
+    if (!m_pLogFile) {
+        return;
+    }
+    size_t cchMessage = strlen(pchLogMessage);
+    fprintf(m_pLogFile, "%10.6f %s%s", (GetTimestampNs() - m_ulStartNs) * 1e-9, pchLogMessage,
+        cchMessage && pchLogMessage[cchMessage - 1] == '\n' ? "" : "\n");
+}
+
+//-----------------------------------------------------------------------------
+// IVRDriverManager and IVRResources, the host only knows this one driver and
+// has no resources to share
+//-----------------------------------------------------------------------------
+uint32_t CSampleMockHost::GetDriverCount() const
+{
+    return 1;
+}
+
+uint32_t CSampleMockHost::GetDriverName(DriverId_t nDriver, char *pchValue, uint32_t unBufferSize)
+{
+    static const char k_rgchName[] = "sample";
+    if (nDriver != 0) {
+        return 0;
+    }
+    if (pchValue && unBufferSize >= sizeof(k_rgchName)) {
+        memcpy(pchValue, k_rgchName, sizeof(k_rgchName));
+    }
+    return sizeof(k_rgchName);
+}
+
+DriverHandle_t CSampleMockHost::GetDriverHandle(const char *pchDriverName)
+{
+    return strcmp(pchDriverName, "sample") == 0 ? k_ulMockDriverHandle : k_ulInvalidDriverHandle;
+}
+
+uint32_t CSampleMockHost::LoadSharedResource(const char *pchResourceName, char *pchBuffer, uint32_t unBufferLen)
+{
+    return 0;
+}
+
+uint32_t CSampleMockHost::GetResourceFullPath(const char *pchResourceName, const char *pchResourceTypeDirectory, char *pchPathBuffer, uint32_t unBufferLen)
+{
+    if (pchPathBuffer && unBufferLen > 0) {
+        pchPathBuffer[0] = 0;
+    }
+    return 0;
+}
@@ -0,0 +1,235 @@
+#ifndef CSAMPLEMOCKHOST_H
+#define CSAMPLEMOCKHOST_H
+
+#include <openvr_driver.h>
+
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+enum ESampleMockHostRecord
+{
+    SampleMockHostRecord_DeviceAdded,
+    SampleMockHostRecord_Pose,
+    SampleMockHostRecord_Boolean,
+    SampleMockHostRecord_Scalar,
+    SampleMockHostRecord_Skeleton,
+    SampleMockHostRecord_Vsync,
+    SampleMockHostRecord_VendorEvent,
+};
+
+typedef void *(*HmdDriverFactoryFn)(const char *pInterfaceName, int *pReturnCode);
+
+// one callback from the driver, time stamped when it arrived
+struct SampleMockHostRecord_t
+{
+    uint64_t ulTimeNs;
+    ESampleMockHostRecord eType;
+    uint32_t unDevice;             // device index, k_unTrackedDeviceIndexInvalid for vsync
+    uint32_t unComponent;          // input component index, 0 for everything else
+    double dValue;                 // input value, motion range, event type or vsync offset
+    double dTimeOffset;            // time offset the driver passed along
+    double rdPosition[3];          // pose only, in the world frame
+    vr::HmdQuaternion_t qRotation; // pose only, in the world frame
+    vr::ETrackingResult eResult;
+    bool bPoseIsValid;
+    bool bDeviceIsConnected;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Stand-in for vrserver, enough to load driver_sample outside of
+// SteamVR. It implements the driver context and every interface the server
+// driver asks for. Settings come from a .vrsettings file plus overrides,
+// properties and input components are kept in memory, and every pose, input
+// update and vsync the driver reports is recorded with a time stamp.
+//
+// Records go into a buffer reserved up front, so the pose thread never
+// allocates in here and a full buffer only counts what it dropped. Devices
+// are activated after RunFrame returns, like vrserver does, not from inside
+// TrackedDeviceAdded.
+//-----------------------------------------------------------------------------
+class CSampleMockHost : public vr::IVRDriverContext,
+                        public vr::IVRServerDriverHost,
+                        public vr::IVRSettings,
+                        public vr::IVRProperties,
+                        public vr::IVRDriverInput,
+                        public vr::IVRDriverLog,
+                        public vr::IVRDriverManager,
+                        public vr::IVRResources
+{
+public:
+    CSampleMockHost();
+    virtual ~CSampleMockHost();
+
+    /** adds every section of a .vrsettings file, returns false if it can't be read or parsed */
+    bool LoadSettings(const char *pchPath);
+
+    /** overrides one setting, the value is a bool, a number or else a string */
+    void SetSetting(const char *pchSection, const char *pchKey, const char *pchValue);
+
+    /** records beyond this are counted as dropped */
+    void SetRecordCapacity(size_t unRecords);
+
+    /** where the driver's log lines go, nullptr drops them */
+    void SetLogFile(FILE *pLogFile) { m_pLogFile = pLogFile; }
+
+    /** loads the module and asks its HmdDriverFactory for the server driver */
+    bool LoadDriver(const char *pchPath);
+
+    /** asks the factory of a driver linked into this executable for the server driver, instead of LoadDriver() */
+    bool UseDriverFactory(HmdDriverFactoryFn pFactory);
+
+    vr::EVRInitError Init();
+
+    /** calls the driver's RunFrame, then activates the devices it added */
+    void RunFrame();
+
+    void Cleanup();
+
+    void UnloadDriver();
+
+    /** calls of the driver's RunFrame so far and the longest one */
+    uint64_t GetRunFrameCount() const { return m_ulRunFrames; }
+    uint64_t GetRunFrameMaxNs() const { return m_ulRunFrameMaxNs; }
+
+    /** the records so far, only stable once the driver is cleaned up */
+    const std::vector<SampleMockHostRecord_t> &GetRecords() const { return m_vecRecords; }
+
+    uint64_t GetDroppedRecords() const { return m_ulDroppedRecords; }
+
+    /** writes the records as CSV, times relative to Init */
+    void WriteRecordsCsv(FILE *pFile) const;
+
+    /** pose rate and gaps per device, input update counts and RunFrame cost */
+    void PrintSummary(FILE *pFile) const;
+
+    // IVRDriverContext
+    void *GetGenericInterface(const char *pchInterfaceVersion, vr::EVRInitError *peError) override;
+    vr::DriverHandle_t GetDriverHandle() override;
+
+    // IVRServerDriverHost
+    bool TrackedDeviceAdded(const char *pchDeviceSerialNumber, vr::ETrackedDeviceClass eDeviceClass, vr::ITrackedDeviceServerDriver *pDriver) override;
+    void TrackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t &newPose, uint32_t unPoseStructSize) override;
+    void VsyncEvent(double vsyncTimeOffsetSeconds) override;
+    void VendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, const vr::VREvent_Data_t &eventData, double eventTimeOffset) override;
+    bool IsExiting() override;
+    bool PollNextEvent(vr::VREvent_t *pEvent, uint32_t uncbVREvent) override;
+    void GetRawTrackedDevicePoses(float fPredictedSecondsFromNow, vr::TrackedDevicePose_t *pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) override;
+    void TrackedDeviceDisplayTransformUpdated(uint32_t unWhichDevice, vr::HmdMatrix34_t eyeToHeadLeft, vr::HmdMatrix34_t eyeToHeadRight) override;
+
+    // IVRSettings
+    const char *GetSettingsErrorNameFromEnum(vr::EVRSettingsError eError) override;
+    bool Sync(bool bForce, vr::EVRSettingsError *peError) override;
+    void SetBool(const char *pchSection, const char *pchSettingsKey, bool bValue, vr::EVRSettingsError *peError) override;
+    void SetInt32(const char *pchSection, const char *pchSettingsKey, int32_t nValue, vr::EVRSettingsError *peError) override;
+    void SetFloat(const char *pchSection, const char *pchSettingsKey, float flValue, vr::EVRSettingsError *peError) override;
+    void SetString(const char *pchSection, const char *pchSettingsKey, const char *pchValue, vr::EVRSettingsError *peError) override;
+    bool GetBool(const char *pchSection, const char *pchSettingsKey, vr::EVRSettingsError *peError) override;
+    int32_t GetInt32(const char *pchSection, const char *pchSettingsKey, vr::EVRSettingsError *peError) override;
+    float GetFloat(const char *pchSection, const char *pchSettingsKey, vr::EVRSettingsError *peError) override;
+    void GetString(const char *pchSection, const char *pchSettingsKey, char *pchValue, uint32_t unValueLen, vr::EVRSettingsError *peError) override;
+    void RemoveSection(const char *pchSection, vr::EVRSettingsError *peError) override;
+    void RemoveKeyInSection(const char *pchSection, const char *pchSettingsKey, vr::EVRSettingsError *peError) override;
+
+    // IVRProperties
+    vr::ETrackedPropertyError ReadPropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyRead_t *pBatch, uint32_t unBatchEntryCount) override;
+    vr::ETrackedPropertyError WritePropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyWrite_t *pBatch, uint32_t unBatchEntryCount) override;
+    const char *GetPropErrorNameFromEnum(vr::ETrackedPropertyError error) override;
+    vr::PropertyContainerHandle_t TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) override;
+
+    // IVRDriverInput
+    vr::EVRInputError CreateBooleanComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle) override;
+    vr::EVRInputError UpdateBooleanComponent(vr::VRInputComponentHandle_t ulComponent, bool bNewValue, double fTimeOffset) override;
+    vr::EVRInputError CreateScalarComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle, vr::EVRScalarType eType, vr::EVRScalarUnits eUnits) override;
+    vr::EVRInputError UpdateScalarComponent(vr::VRInputComponentHandle_t ulComponent, float fNewValue, double fTimeOffset) override;
+    vr::EVRInputError CreateHapticComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle) override;
+    vr::EVRInputError CreateSkeletonComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, const char *pchSkeletonPath, const char *pchBasePosePath, const vr::VRBoneTransform_t *pGripLimitTransforms, uint32_t unGripLimitTransformCount, vr::VRInputComponentHandle_t *pHandle) override;
+    vr::EVRInputError UpdateSkeletonComponent(vr::VRInputComponentHandle_t ulComponent, vr::EVRSkeletalMotionRange eMotionRange, const vr::VRBoneTransform_t *pTransforms, uint32_t unTransformCount) override;
+
+    // IVRDriverLog
+    void Log(const char *pchLogMessage) override;
+
+    // IVRDriverManager
+    uint32_t GetDriverCount() const override;
+    uint32_t GetDriverName(vr::DriverId_t nDriver, char *pchValue, uint32_t unBufferSize) override;
+    vr::DriverHandle_t GetDriverHandle(const char *pchDriverName) override;
+
+    // IVRResources
+    uint32_t LoadSharedResource(const char *pchResourceName, char *pchBuffer, uint32_t unBufferLen) override;
+    uint32_t GetResourceFullPath(const char *pchResourceName, const char *pchResourceTypeDirectory, char *pchPathBuffer, uint32_t unBufferLen) override;
+
+private:
+    enum ESettingType
+    {
+        SettingType_Bool,
+        SettingType_Number,
+        SettingType_String,
+    };
+
+    struct Setting_t
+    {
+        ESettingType eType;
+        bool bValue;
+        double dValue;
+        std::string sValue;
+    };
+
+    struct Device_t
+    {
+        std::string sSerialNumber;
+        vr::ETrackedDeviceClass eClass;
+        vr::ITrackedDeviceServerDriver *pDriver;
+        bool bActivated;
+    };
+
+    struct Property_t
+    {
+        vr::PropertyTypeTag_t unTag;
+        vr::ETrackedPropertyError eError;
+        std::vector<char> vecValue;
+    };
+
+    struct Component_t
+    {
+        vr::PropertyContainerHandle_t ulContainer;
+        std::string sName;
+    };
+
+    const Setting_t *FindSetting(const char *pchSection, const char *pchSettingsKey, vr::EVRSettingsError *peError) const;
+    void StoreSetting(const char *pchSection, const char *pchSettingsKey, const Setting_t &setting, vr::EVRSettingsError *peError);
+    vr::EVRInputError CreateComponent(vr::PropertyContainerHandle_t ulContainer, const char *pchName, vr::VRInputComponentHandle_t *pHandle);
+    bool FindComponentDevice(vr::VRInputComponentHandle_t ulComponent, uint32_t *punDevice);
+    void Record(const SampleMockHostRecord_t &record);
+
+    void *m_hModule;
+    vr::IServerTrackedDeviceProvider *m_pProvider;
+    bool m_bInitialized;
+    FILE *m_pLogFile;
+    uint64_t m_ulStartNs;
+
+    mutable std::mutex m_settingsMutex;
+    std::map<std::string, std::map<std::string, Setting_t>> m_mapSettings;
+
+    std::mutex m_propertiesMutex;
+    std::map<vr::PropertyContainerHandle_t, std::map<vr::ETrackedDeviceProperty, Property_t>> m_mapProperties;
+
+    // written on the thread that calls RunFrame, the pose thread only passes indices in
+    std::vector<Device_t> m_vecDevices;
+
+    std::mutex m_componentsMutex;
+    std::vector<Component_t> m_vecComponents;
+
+    std::mutex m_recordsMutex;
+    std::vector<SampleMockHostRecord_t> m_vecRecords;
+    size_t m_unRecordCapacity;
+    uint64_t m_ulDroppedRecords;
+
+    uint64_t m_ulRunFrames;
+    uint64_t m_ulRunFrameTotalNs;
+    uint64_t m_ulRunFrameMaxNs;
+};
+
+#endif // CSAMPLEMOCKHOST_H
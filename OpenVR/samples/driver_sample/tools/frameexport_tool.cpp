@@ -0,0 +1,381 @@
+// Synthetic producer and consumer for the shared memory frame export.
+//
+// usage: frameexport_tool selftest [seconds] [width] [height]
+//        frameexport_tool produce <name> [rate] [width] [height] [seconds]
+//        frameexport_tool consume <name> [seconds]
+//        frameexport_tool adaptive [seconds] [full scale frame ms]
+//
+// The producer stamps every pixel of a frame with the low bits of its frame id,
+// so the consumer can tell a torn frame from a whole one. selftest runs both in
+// one process, then drives CSampleVirtualDisplay with fake presents to check the
+// vsync pacing of WaitForPresent, and last with CPU frames pre-warped through a
+// lens and reprojected to a spinning head to time the CPU warp. consume also works on the export of a running
+// driver (frameExportName, "openvr_diy_frames" by default), where frames carry
+// metadata only. adaptive presents frames whose cost grows with the square of
+// the render scale through the virtual display and lets CSampleAdaptiveRender
+// trade scale and frequency against the measured frame times, like the
+// driver does with adaptiveRender.
+
+#include "csampleadaptiverender.h"
+#include "csampleframeexport.h"
+#include "csamplelensmodel.h"
+#include "csamplevirtualdisplay.h"
+
+#include "basics.h"
+
+#include <math.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+struct ConsumerStats_t
+{
+    uint64_t ulFrames;
+    uint64_t ulSkipped;
+    uint64_t ulTorn;
+    uint64_t ulLatencyTotalNs;
+    uint64_t ulLatencyMaxNs;
+};
+
+// pose source for the reprojection that turns about the vertical axis at one radian per second
+class CSpinningHead : public vr::ITrackedDeviceServerDriver
+{
+public:
+    CSpinningHead() { m_ulStartNs = GetTimestampNs(); }
+
+    virtual vr::EVRInitError Activate(uint32_t unObjectId) { return vr::VRInitError_None; }
+    virtual void Deactivate() {}
+    virtual void EnterStandby() {}
+    virtual void *GetComponent(const char *pchComponentNameAndVersion) { return nullptr; }
+    virtual void DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize) {}
+
+    virtual vr::DriverPose_t GetPose()
+    {
+        vr::DriverPose_t pose = { 0 };
+        pose.qRotation = GetRotation(GetTimestampNs());
+        return pose;
+    }
+
+    vr::HmdQuaternion_t GetRotation(uint64_t ulNs) const
+    {
+        double flYaw = (ulNs - m_ulStartNs) * 1e-9;
+        return HmdQuaternion_Init(cos(flYaw * 0.5), 0, sin(flYaw * 0.5), 0);
+    }
+
+private:
+    uint64_t m_ulStartNs;
+};
+
+static void ProduceFrames(const char *pchName, uint32_t unWidth, uint32_t unHeight, float flRate, float flSeconds, std::atomic<bool> *pbReady)
+{
+    CSampleFrameExport frameExport;
+    if (!frameExport.Create(pchName, unWidth, unHeight, true)) {
+        fprintf(stderr, "cannot create %s\n", pchName);
+        exit(1);
+    }
+    if (pbReady) {
+        *pbReady = true;
+    }
+
+    uint64_t ulInterval = (uint64_t)(1e9 / flRate);
+    uint64_t ulStart = GetTimestampNs();
+    uint64_t ulFrames = (uint64_t)(flSeconds * flRate);
+    for (uint64_t ulFrame = 1; ulFrame <= ulFrames; ulFrame++) {
+        uint32_t unTag = (uint32_t)ulFrame * 0x9E3779B1u;
+        uint32_t *pPixels = (uint32_t *)frameExport.GetWritePixels();
+        for (uint32_t y = 0; y < unHeight; y++) {
+            uint32_t *pRow = (uint32_t *)((uint8_t *)pPixels + (size_t)y * frameExport.GetStride());
+            for (uint32_t x = 0; x < unWidth; x++) {
+                pRow[x] = unTag;
+            }
+        }
+
+        SampleFrameInfo_t *pInfo = frameExport.GetWriteInfo();
+        pInfo->ulFrameId = ulFrame;
+        pInfo->ulSharedTexture = 0;
+        pInfo->flVsyncTimeInSeconds = 0.0;
+        pInfo->ulPresentNs = GetTimestampNs();
+        pInfo->unPixelsValid = 1;
+        frameExport.Publish();
+
+        uint64_t ulNext = ulStart + ulFrame * ulInterval;
+        uint64_t ulNow = GetTimestampNs();
+        if (ulNext > ulNow) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(ulNext - ulNow));
+        }
+    }
+}
+
+static bool ConsumeFrames(const char *pchName, float flSeconds, bool bCheckTags, ConsumerStats_t *pStats)
+{
+    memset(pStats, 0, sizeof(*pStats));
+
+    CSampleFrameExport frameExport;
+    uint64_t ulEnd = GetTimestampNs() + (uint64_t)(flSeconds * 1e9);
+    while (!frameExport.Open(pchName)) {
+        if (GetTimestampNs() > ulEnd) {
+            fprintf(stderr, "cannot open %s\n", pchName);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    uint64_t ulLastFrameId = 0;
+    while (GetTimestampNs() < ulEnd) {
+        if (!frameExport.AcquireLatest()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+
+        const SampleFrameInfo_t *pInfo = frameExport.GetReadInfo();
+        uint64_t ulLatency = GetTimestampNs() - pInfo->ulPresentNs;
+        pStats->ulFrames++;
+        pStats->ulLatencyTotalNs += ulLatency;
+        if (ulLatency > pStats->ulLatencyMaxNs) {
+            pStats->ulLatencyMaxNs = ulLatency;
+        }
+        if (ulLastFrameId && pInfo->ulFrameId > ulLastFrameId + 1) {
+            pStats->ulSkipped += pInfo->ulFrameId - ulLastFrameId - 1;
+        }
+        ulLastFrameId = pInfo->ulFrameId;
+
+        // first, middle and last pixel must all carry the tag of this frame
+        if (bCheckTags && pInfo->unPixelsValid) {
+            uint32_t unTag = (uint32_t)pInfo->ulFrameId * 0x9E3779B1u;
+            const uint8_t *pPixels = frameExport.GetReadPixels();
+            size_t cbLastRow = (size_t)(frameExport.GetHeight() - 1) * frameExport.GetStride();
+            const uint32_t *pFirst = (const uint32_t *)pPixels;
+            const uint32_t *pMiddle = (const uint32_t *)(pPixels + cbLastRow / 2) + frameExport.GetWidth() / 2;
+            const uint32_t *pLast = (const uint32_t *)(pPixels + cbLastRow) + frameExport.GetWidth() - 1;
+            if (*pFirst != unTag || *pMiddle != unTag || *pLast != unTag) {
+                pStats->ulTorn++;
+            }
+        }
+    }
+    return true;
+}
+
+static void PrintStats(const char *pchLabel, const ConsumerStats_t &stats)
+{
+    printf("%s: %llu frames, %llu skipped, %llu torn, latency mean %.3f ms max %.3f ms\n", pchLabel,
+        (unsigned long long)stats.ulFrames, (unsigned long long)stats.ulSkipped, (unsigned long long)stats.ulTorn,
+        stats.ulFrames ? stats.ulLatencyTotalNs * 1e-6 / stats.ulFrames : 0.0, stats.ulLatencyMaxNs * 1e-6);
+}
+
+static int SelfTest(float flSeconds, uint32_t unWidth, uint32_t unHeight)
+{
+    const char *pchName = "frameexport_selftest";
+
+    // pixels through the triple buffer at 90 Hz
+    std::atomic<bool> bReady(false);
+    std::thread producer(ProduceFrames, pchName, unWidth, unHeight, 90.0f, flSeconds, &bReady);
+    while (!bReady) {
+        std::this_thread::yield();
+    }
+    ConsumerStats_t stats;
+    bool bConsumed = ConsumeFrames(pchName, flSeconds, true, &stats);
+    producer.join();
+    if (!bConsumed) {
+        return 1;
+    }
+    PrintStats("triple buffer", stats);
+
+    // presents through the virtual display, paced by WaitForPresent at 90 Hz
+    CSampleVsyncClock vsyncClock;
+    vsyncClock.Start(90.0f, false, false);
+    CSampleVirtualDisplay display;
+    if (!display.Open(pchName, 64, 64, &vsyncClock, false)) {
+        fprintf(stderr, "cannot open virtual display\n");
+        return 1;
+    }
+    std::atomic<bool> bPresenting(true);
+    std::thread presenter([&]() {
+        vr::PresentInfo_t info;
+        memset(&info, 0, sizeof(info));
+        while (bPresenting) {
+            info.nFrameId++;
+            display.Present(&info, sizeof(info));
+            display.WaitForPresent();
+        }
+    });
+    ConsumerStats_t displayStats;
+    ConsumeFrames(pchName, flSeconds, false, &displayStats);
+    bPresenting = false;
+    presenter.join();
+
+    float flSinceVsync;
+    uint64_t ulVsyncs;
+    display.GetTimeSinceLastVsync(&flSinceVsync, &ulVsyncs);
+    PrintStats("virtual display", displayStats);
+    printf("virtual display: %llu presents over %llu vsyncs, %.1f presents/s\n", (unsigned long long)display.GetPresentedFrames(),
+        (unsigned long long)ulVsyncs, display.GetPresentedFrames() / flSeconds);
+
+    display.Close();
+
+    // side by side CPU frames through the lens remap into the export, as fast as it goes
+    CSampleLensModel lensModel;
+    lensModel.SetModel(SampleLensModel_BrownConrady);
+    const float rgflRed[k_unSampleLensCoefficients] = { 0.20f, 0.22f, 0.0f, 0.0f, 0.0f };
+    const float rgflGreen[k_unSampleLensCoefficients] = { 0.22f, 0.24f, 0.0f, 0.0f, 0.0f };
+    const float rgflBlue[k_unSampleLensCoefficients] = { 0.24f, 0.26f, 0.0f, 0.0f, 0.0f };
+    lensModel.SetCoefficients(SampleLensChannel_Red, rgflRed);
+    lensModel.SetCoefficients(SampleLensChannel_Green, rgflGreen);
+    lensModel.SetCoefficients(SampleLensChannel_Blue, rgflBlue);
+    lensModel.SetAspect(0.5f * unWidth / unHeight);
+
+    if (!display.Open(pchName, unWidth, unHeight, &vsyncClock, true)) {
+        fprintf(stderr, "cannot open virtual display\n");
+        return 1;
+    }
+    uint32_t unThreads = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0;
+    display.SetDistortion(&lensModel, unThreads < CSampleWorkerPool::k_unMaxWorkers ? unThreads : CSampleWorkerPool::k_unMaxWorkers);
+    CSpinningHead head;
+    const float rgflProjection[2][4] = { { -1.2f, 1.0f, -1.1f, 1.1f }, { -1.0f, 1.2f, -1.1f, 1.1f } };
+    display.SetReprojection(&head, rgflProjection);
+    std::vector<uint8_t> vecRgba((size_t)unWidth * unHeight * 4);
+    for (size_t i = 0; i < vecRgba.size(); i++) {
+        vecRgba[i] = (uint8_t)(i * 7);
+    }
+
+    vr::PresentInfo_t info;
+    memset(&info, 0, sizeof(info));
+    uint64_t ulStart = GetTimestampNs();
+    uint64_t ulEnd = ulStart + (uint64_t)(flSeconds * 1e9);
+    uint64_t ulReprojectTotalNs = 0, ulRemapTotalNs = 0;
+    while (GetTimestampNs() < ulEnd) {
+        // as if rendered for the head of 20 ms ago
+        vr::HmdQuaternion_t qRender = head.GetRotation(GetTimestampNs() - 20000000);
+        info.nFrameId++;
+        display.PresentPixels(&info, vecRgba.data(), unWidth * 4, unWidth, unHeight, &qRender);
+
+        uint64_t ulReprojectNs, ulRemapNs;
+        display.GetWarpTimes(&ulReprojectNs, &ulRemapNs);
+        ulReprojectTotalNs += ulReprojectNs;
+        ulRemapTotalNs += ulRemapNs;
+    }
+    double flPresentMs = (GetTimestampNs() - ulStart) * 1e-6 / info.nFrameId;
+    printf("remapped pixels: %llu presents of %ux%u, %.2f ms each (reprojection %.2f ms, remap %.2f ms) with %u worker threads\n",
+        (unsigned long long)info.nFrameId, unWidth, unHeight, flPresentMs, ulReprojectTotalNs * 1e-6 / info.nFrameId,
+        ulRemapTotalNs * 1e-6 / info.nFrameId, unThreads);
+
+    return (stats.ulTorn == 0 && stats.ulFrames > 0 && displayStats.ulFrames > 0 && info.nFrameId > 0) ? 0 : 1;
+}
+
+static int AdaptiveTest(float flSeconds, float flFullScaleMs)
+{
+    CSampleVsyncClock vsyncClock;
+    vsyncClock.Start(90.0f, false, false);
+    CSampleVirtualDisplay display;
+    if (!display.Open("frameexport_adaptive", 64, 64, &vsyncClock, false)) {
+        fprintf(stderr, "cannot open virtual display\n");
+        return 1;
+    }
+
+    SampleAdaptiveRenderConfig_t config;
+    config.flMinScale = 0.5f;
+    config.flMaxScale = 1.0f;
+    config.flScaleStep = 0.1f;
+    config.flMinFrequency = 60.0f;
+    config.flMaxFrequency = 90.0f;
+    config.flFrequencyStep = 10.0f;
+    config.flTargetLoad = 0.85f;
+    config.flHysteresis = 0.1f;
+    config.flHoldSeconds = 1.0f;
+    CSampleAdaptiveRender adaptive;
+    adaptive.Configure(config);
+
+    // the app renders for the current scale, the work grows with the pixel count
+    std::atomic<float> flScale(1.0f);
+    std::atomic<bool> bPresenting(true);
+    std::thread presenter([&]() {
+        vr::PresentInfo_t info;
+        memset(&info, 0, sizeof(info));
+        while (bPresenting) {
+            float flCurrent = flScale;
+            uint64_t ulWorkNs = (uint64_t)(flFullScaleMs * 1e6f * flCurrent * flCurrent);
+            uint64_t ulDone = GetTimestampNs() + ulWorkNs;
+            while (GetTimestampNs() < ulDone) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            info.nFrameId++;
+            display.Present(&info, sizeof(info));
+            display.WaitForPresent();
+        }
+    });
+
+    uint32_t unChanges = 0;
+    float flFrequency = config.flMaxFrequency;
+    SampleFrameTiming_t last;
+    memset(&last, 0, sizeof(last));
+    uint64_t ulEnd = GetTimestampNs() + (uint64_t)(flSeconds * 1e9);
+    while (GetTimestampNs() < ulEnd) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(11));
+        SampleFrameTiming_t timing;
+        display.GetFrameTiming(&timing);
+        if (adaptive.AddFrames(GetTimestampNs(), timing.ulFrames - last.ulFrames, timing.ulBusyNs - last.ulBusyNs,
+                timing.ulMissedVsyncs - last.ulMissedVsyncs)) {
+            unChanges++;
+            flScale = adaptive.GetScale();
+            if (adaptive.GetFrequency() != flFrequency) {
+                flFrequency = adaptive.GetFrequency();
+                vsyncClock.SetFrequency(flFrequency);
+            }
+            printf("%s\n", adaptive.GetReason());
+        }
+        last = timing;
+    }
+    bPresenting = false;
+    presenter.join();
+    display.Close();
+
+    printf("settled at scale %.2f and %.1f Hz after %u changes, %llu frames presented\n", adaptive.GetScale(), adaptive.GetFrequency(),
+        unChanges, (unsigned long long)display.GetPresentedFrames());
+    return display.GetPresentedFrames() > 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *pchMode = argc > 1 ? argv[1] : "selftest";
+
+    if (!strcmp(pchMode, "selftest")) {
+        float flSeconds = argc > 2 ? (float)atof(argv[2]) : 2.0f;
+        uint32_t unWidth = argc > 3 ? (uint32_t)atoi(argv[3]) : 1600;
+        uint32_t unHeight = argc > 4 ? (uint32_t)atoi(argv[4]) : 800;
+        return SelfTest(flSeconds, unWidth, unHeight);
+    }
+
+    if (!strcmp(pchMode, "produce") && argc > 2) {
+        float flRate = argc > 3 ? (float)atof(argv[3]) : 90.0f;
+        uint32_t unWidth = argc > 4 ? (uint32_t)atoi(argv[4]) : 1600;
+        uint32_t unHeight = argc > 5 ? (uint32_t)atoi(argv[5]) : 800;
+        float flSeconds = argc > 6 ? (float)atof(argv[6]) : 10.0f;
+        ProduceFrames(argv[2], unWidth, unHeight, flRate, flSeconds, nullptr);
+        return 0;
+    }
+
+    if (!strcmp(pchMode, "consume") && argc > 2) {
+        ConsumerStats_t stats;
+        if (!ConsumeFrames(argv[2], argc > 3 ? (float)atof(argv[3]) : 10.0f, true, &stats)) {
+            return 1;
+        }
+        PrintStats(argv[2], stats);
+        return 0;
+    }
+
+    if (!strcmp(pchMode, "adaptive")) {
+        float flSeconds = argc > 2 ? (float)atof(argv[2]) : 10.0f;
+        float flFullScaleMs = argc > 3 ? (float)atof(argv[3]) : 16.0f;
+        return AdaptiveTest(flSeconds, flFullScaleMs);
+    }
+
+    fprintf(stderr, "usage: frameexport_tool selftest [seconds] [width] [height]\n"
+        "       frameexport_tool produce <name> [rate] [width] [height] [seconds]\n"
+        "       frameexport_tool consume <name> [seconds]\n"
+        "       frameexport_tool adaptive [seconds] [full scale frame ms]\n");
+    return 1;
+}
@@ -0,0 +1,144 @@
+// Loads driver_sample outside of SteamVR and runs it against a stand-in host.
+//
+// usage: mock_host <driver module> [-s settings] [-r hz] [-t seconds] [-o records.csv] [-q] [[section/]key=value ...]
+//
+// Settings come from the .vrsettings file given with -s, by default the one an
+// installed driver ships (resources/settings/default.vrsettings two levels up
+// from the module) or else the one in the source tree. key=value arguments override the driver's own section,
+// section/key=value any other. RunFrame is called at -r Hz (90) for -t seconds
+// (5). Every pose, input update and vsync the driver reports is written to -o
+// as CSV, and a summary of pose rates and RunFrame cost goes to stdout. -q
+// drops the driver's log, which otherwise goes to stderr.
+
+#include "csamplemockhost.h"
+
+#include "basics.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+static void PrintUsage()
+{
+    fprintf(stderr, "usage: mock_host <driver module> [-s settings] [-r hz] [-t seconds] [-o records.csv] [-q] [[section/]key=value ...]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    const char *pchDriverPath = argv[1];
+    std::string sSettingsPath;
+    float flRate = 90.0f;
+    float flSeconds = 5.0f;
+    const char *pchRecordsPath = nullptr;
+    bool bQuiet = false;
+
+    CSampleMockHost host;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sSettingsPath = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            flRate = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            flSeconds = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            pchRecordsPath = argv[++i];
+        } else if (strcmp(argv[i], "-q") == 0) {
+            bQuiet = true;
+        } else if (strchr(argv[i], '=') && argv[i][0] != '-') {
+            continue;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (flRate <= 0.0f || flSeconds < 0.0f) {
+        PrintUsage();
+        return 1;
+    }
+
+    bool bDefaultSettings = sSettingsPath.empty();
+    if (bDefaultSettings) {
+        std::string sDirectory(pchDriverPath);
+        size_t unSlash = sDirectory.find_last_of("/\\");
+        sDirectory = unSlash == std::string::npos ? std::string(".") : sDirectory.substr(0, unSlash);
+        sSettingsPath = sDirectory + "/../../resources/settings/default.vrsettings";
+    }
+    bool bLoaded = host.LoadSettings(sSettingsPath.c_str());
+#ifdef DRIVER_SAMPLE_SETTINGS_PATH
+    // a build tree has no resources folder, the source tree it was built from has the same file
+    if (!bLoaded && bDefaultSettings) {
+        sSettingsPath = DRIVER_SAMPLE_SETTINGS_PATH;
+        bLoaded = host.LoadSettings(sSettingsPath.c_str());
+    }
+#endif
+    if (!bLoaded) {
+        fprintf(stderr, "mock_host: no settings from %s, the driver uses its defaults\n", sSettingsPath.c_str());
+    }
+
+    // overrides go on top of the file, in the order given
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-o") == 0) {
+            i++;
+            continue;
+        }
+        const char *pchEquals = strchr(argv[i], '=');
+        if (!pchEquals || argv[i][0] == '-') {
+            continue;
+        }
+        std::string sKey(argv[i], pchEquals - argv[i]);
+        std::string sSection(k_pch_Sample_Section);
+        size_t unSlash = sKey.find('/');
+        if (unSlash != std::string::npos) {
+            sSection = sKey.substr(0, unSlash);
+            sKey = sKey.substr(unSlash + 1);
+        }
+        host.SetSetting(sSection.c_str(), sKey.c_str(), pchEquals + 1);
+    }
+
+    // room for a pose of every device at up to 1 kHz plus input, nothing is allocated while recording
+    host.SetRecordCapacity((size_t)((flSeconds + 1.0f) * 1000.0f) * 64);
+    host.SetLogFile(bQuiet ? nullptr : stderr);
+
+    if (!host.LoadDriver(pchDriverPath)) {
+        return 1;
+    }
+    vr::EVRInitError eError = host.Init();
+    if (eError != vr::VRInitError_None) {
+        fprintf(stderr, "mock_host: Init failed with error %d\n", (int)eError);
+        return 1;
+    }
+
+    std::chrono::nanoseconds interval((int64_t)(1e9 / flRate));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point end = start + std::chrono::nanoseconds((int64_t)(flSeconds * 1e9));
+    std::chrono::steady_clock::time_point next = start;
+    while (next < end) {
+        host.RunFrame();
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+
+    host.Cleanup();
+
+    if (pchRecordsPath) {
+        FILE *pFile = fopen(pchRecordsPath, "w");
+        if (!pFile) {
+            fprintf(stderr, "mock_host: unable to write %s\n", pchRecordsPath);
+        } else {
+            host.WriteRecordsCsv(pFile);
+            fclose(pFile);
+        }
+    }
+    host.PrintSummary(stdout);
+
+    host.UnloadDriver();
+    return 0;
+}
@@ -0,0 +1,275 @@
+// Tiled intra-frame encoder for the frames of the shared memory frame export.
+//
+// usage: stream_tool selftest [seconds] [width] [height] [threads] [tile]
+//        stream_tool stream <name> <file path|udp:port> [seconds] [threads] [tile]
+//
+// selftest publishes a moving synthetic scene at 90 Hz into its own export,
+// encodes every frame it gets and decodes every tenth one again to check the
+// tiles are lossless. stream encodes the CPU frames of another producer, like
+// frameexport_tool produce (a driver's export carries metadata only), and
+// writes the tiles to a file or to a UDP port on localhost. Both print the
+// encoded frame rate, the latency from publish until the sink had
+// the whole frame and the compression ratio once a second.
+
+#include "csampleframeexport.h"
+#include "csampletileencoder.h"
+#include "csampletilesink.h"
+
+#include "basics.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// decodes the tiles of the frames it is asked to and compares them with the source
+class CVerifyingSink : public ISampleTileSink
+{
+public:
+    CVerifyingSink() : m_pSource(nullptr), m_unStride(0), m_ulTilesChecked(0), m_ulTilesBad(0) {}
+
+    void SetSource(const uint8_t *pSource, uint32_t unStride) { m_pSource = pSource; m_unStride = unStride; }
+
+    virtual bool WriteTile(const SampleTileFragment_t &tile, const uint8_t *pData)
+    {
+        if (!m_pSource) {
+            return true;
+        }
+        m_vecDecoded.resize((size_t)tile.unWidth * tile.unHeight * 4);
+        bool bGood = tile.unMagic == k_unSampleTileMagic && tile.unFragmentBytes == tile.unTileBytes &&
+            DecodeSampleTileIntra(pData, tile.unFragmentBytes, m_vecDecoded.data(), tile.unWidth * 4, tile.unWidth, tile.unHeight);
+        for (uint32_t y = 0; bGood && y < tile.unHeight; y++) {
+            const uint8_t *pRow = m_pSource + (size_t)(tile.unY + y) * m_unStride + tile.unX * 4;
+            bGood = !memcmp(pRow, m_vecDecoded.data() + (size_t)y * tile.unWidth * 4, tile.unWidth * 4);
+        }
+        m_ulTilesChecked++;
+        if (!bGood) {
+            m_ulTilesBad++;
+        }
+        return true;
+    }
+
+    virtual void EndFrame() { m_pSource = nullptr; }
+
+    uint64_t GetTilesChecked() const { return m_ulTilesChecked; }
+
+    uint64_t GetTilesBad() const { return m_ulTilesBad; }
+
+private:
+    const uint8_t *m_pSource;
+    uint32_t m_unStride;
+    std::vector<uint8_t> m_vecDecoded;
+    uint64_t m_ulTilesChecked;
+    uint64_t m_ulTilesBad;
+};
+
+// flat areas, gradients and a few hard edges that move a little every frame
+static void ProduceFrames(const char *pchName, uint32_t unWidth, uint32_t unHeight, float flSeconds, std::atomic<bool> *pbReady)
+{
+    CSampleFrameExport frameExport;
+    if (!frameExport.Create(pchName, unWidth, unHeight, true)) {
+        fprintf(stderr, "cannot create %s\n", pchName);
+        exit(1);
+    }
+    *pbReady = true;
+
+    uint64_t ulInterval = (uint64_t)(1e9 / 90.0);
+    uint64_t ulStart = GetTimestampNs();
+    uint64_t ulFrames = (uint64_t)(flSeconds * 90.0f);
+    for (uint64_t ulFrame = 1; ulFrame <= ulFrames; ulFrame++) {
+        uint8_t *pPixels = frameExport.GetWritePixels();
+        uint32_t unShift = (uint32_t)ulFrame * 3;
+        for (uint32_t y = 0; y < unHeight; y++) {
+            uint8_t *p = pPixels + (size_t)y * frameExport.GetStride();
+            for (uint32_t x = 0; x < unWidth; x++, p += 4) {
+                uint32_t u = x + unShift;
+                bool bBar = ((u / 97) & 3) == 0;
+                p[0] = bBar ? 230 : (uint8_t)(u >> 2);
+                p[1] = bBar ? 40 : (uint8_t)(y >> 2);
+                p[2] = (uint8_t)(((u ^ y) >> 5) * 16);
+                p[3] = 255;
+            }
+        }
+
+        SampleFrameInfo_t *pInfo = frameExport.GetWriteInfo();
+        pInfo->ulFrameId = ulFrame;
+        pInfo->ulSharedTexture = 0;
+        pInfo->flVsyncTimeInSeconds = 0.0;
+        pInfo->ulPresentNs = GetTimestampNs();
+        pInfo->unPixelsValid = 1;
+        pInfo->unWarpMicroseconds = 0;
+        frameExport.Publish();
+
+        uint64_t ulNext = ulStart + ulFrame * ulInterval;
+        uint64_t ulNow = GetTimestampNs();
+        if (ulNext > ulNow) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(ulNext - ulNow));
+        }
+    }
+}
+
+static void PrintStats(const char *pchLabel, const SampleEncoderStats_t &stats, double flSeconds)
+{
+    double flFrames = stats.ulFrames ? (double)stats.ulFrames : 1.0;
+    printf("%s: %.1f fps, encode mean %.2f ms max %.2f ms, latency mean %.2f ms max %.2f ms, %.1f:1, %.1f MB/s out, %llu sink errors\n",
+        pchLabel, stats.ulFrames / flSeconds, stats.ulEncodeNsTotal * 1e-6 / flFrames, stats.ulEncodeNsMax * 1e-6,
+        stats.ulLatencyNsTotal * 1e-6 / flFrames, stats.ulLatencyNsMax * 1e-6,
+        stats.ulEncodedBytes ? (double)stats.ulRawBytes / stats.ulEncodedBytes : 0.0,
+        stats.ulEncodedBytes / flSeconds / (1024.0 * 1024.0), (unsigned long long)stats.ulSinkErrors);
+}
+
+static void AddStats(const SampleEncoderStats_t &stats, SampleEncoderStats_t *pTotal)
+{
+    pTotal->ulFrames += stats.ulFrames;
+    pTotal->ulRawBytes += stats.ulRawBytes;
+    pTotal->ulEncodedBytes += stats.ulEncodedBytes;
+    pTotal->ulEncodeNsTotal += stats.ulEncodeNsTotal;
+    pTotal->ulLatencyNsTotal += stats.ulLatencyNsTotal;
+    pTotal->ulSinkErrors += stats.ulSinkErrors;
+    if (stats.ulEncodeNsMax > pTotal->ulEncodeNsMax) {
+        pTotal->ulEncodeNsMax = stats.ulEncodeNsMax;
+    }
+    if (stats.ulLatencyNsMax > pTotal->ulLatencyNsMax) {
+        pTotal->ulLatencyNsMax = stats.ulLatencyNsMax;
+    }
+}
+
+// encodes the newest frame of the export whenever there is one, returns the totals over the whole run
+static bool StreamFrames(const char *pchName, float flSeconds, uint32_t unThreads, uint32_t unTileSize, ISampleTileSink *pSink,
+    CVerifyingSink *pVerify, SampleEncoderStats_t *pTotal)
+{
+    memset(pTotal, 0, sizeof(*pTotal));
+
+    CSampleFrameExport frameExport;
+    uint64_t ulEnd = GetTimestampNs() + (uint64_t)(flSeconds * 1e9);
+    while (!frameExport.Open(pchName)) {
+        if (GetTimestampNs() > ulEnd) {
+            fprintf(stderr, "cannot open %s\n", pchName);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    CSampleTileEncoder encoder;
+    encoder.Start(unThreads, unTileSize);
+
+    uint64_t ulReport = GetTimestampNs();
+    uint64_t ulMetadataOnly = 0;
+    while (GetTimestampNs() < ulEnd) {
+        if (!frameExport.AcquireLatest()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+
+        const SampleFrameInfo_t *pInfo = frameExport.GetReadInfo();
+        if (!pInfo->unPixelsValid) {
+            ulMetadataOnly++;
+        } else {
+            if (pVerify && pInfo->ulFrameId % 10 == 0) {
+                pVerify->SetSource(frameExport.GetReadPixels(), frameExport.GetStride());
+            }
+            encoder.EncodeFrame(pInfo->ulFrameId, pInfo->ulPresentNs, frameExport.GetReadPixels(), frameExport.GetStride(),
+                frameExport.GetWidth(), frameExport.GetHeight(), pSink);
+        }
+
+        uint64_t ulNow = GetTimestampNs();
+        if (ulNow - ulReport >= 1000000000ull) {
+            SampleEncoderStats_t stats;
+            encoder.GetStats(&stats);
+            PrintStats(pchName, stats, (ulNow - ulReport) * 1e-9);
+            if (ulMetadataOnly) {
+                printf("%s: %llu frames without pixels skipped\n", pchName, (unsigned long long)ulMetadataOnly);
+                ulMetadataOnly = 0;
+            }
+            AddStats(stats, pTotal);
+            encoder.ResetStats();
+            ulReport = ulNow;
+        }
+    }
+
+    SampleEncoderStats_t stats;
+    encoder.GetStats(&stats);
+    AddStats(stats, pTotal);
+    return true;
+}
+
+static uint32_t DefaultThreads()
+{
+    uint32_t unThreads = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0;
+    return unThreads < CSampleWorkerPool::k_unMaxWorkers ? unThreads : CSampleWorkerPool::k_unMaxWorkers;
+}
+
+static int SelfTest(float flSeconds, uint32_t unWidth, uint32_t unHeight, uint32_t unThreads, uint32_t unTileSize)
+{
+    const char *pchName = "stream_selftest";
+
+    std::atomic<bool> bReady(false);
+    std::thread producer(ProduceFrames, pchName, unWidth, unHeight, flSeconds, &bReady);
+    while (!bReady) {
+        std::this_thread::yield();
+    }
+    CVerifyingSink sink;
+    SampleEncoderStats_t total;
+    bool bStreamed = StreamFrames(pchName, flSeconds, unThreads, unTileSize, &sink, &sink, &total);
+    producer.join();
+    if (!bStreamed) {
+        return 1;
+    }
+
+    printf("%ux%u in %u pixel tiles with %u worker threads\n", unWidth, unHeight, unTileSize, unThreads);
+    PrintStats("total", total, flSeconds);
+    printf("verified %llu tiles, %llu differ from the source\n", (unsigned long long)sink.GetTilesChecked(),
+        (unsigned long long)sink.GetTilesBad());
+    return (total.ulFrames > 0 && sink.GetTilesChecked() > 0 && sink.GetTilesBad() == 0) ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *pchMode = argc > 1 ? argv[1] : "selftest";
+
+    if (!strcmp(pchMode, "selftest")) {
+        float flSeconds = argc > 2 ? (float)atof(argv[2]) : 3.0f;
+        uint32_t unWidth = argc > 3 ? (uint32_t)atoi(argv[3]) : 1600;
+        uint32_t unHeight = argc > 4 ? (uint32_t)atoi(argv[4]) : 800;
+        uint32_t unThreads = argc > 5 ? (uint32_t)atoi(argv[5]) : DefaultThreads();
+        uint32_t unTileSize = argc > 6 ? (uint32_t)atoi(argv[6]) : 128;
+        return SelfTest(flSeconds, unWidth, unHeight, unThreads, unTileSize);
+    }
+
+    if (!strcmp(pchMode, "stream") && argc > 3) {
+        float flSeconds = argc > 4 ? (float)atof(argv[4]) : 10.0f;
+        uint32_t unThreads = argc > 5 ? (uint32_t)atoi(argv[5]) : DefaultThreads();
+        uint32_t unTileSize = argc > 6 ? (uint32_t)atoi(argv[6]) : 128;
+
+        CSampleFileTileSink fileSink;
+        CSampleUdpTileSink udpSink;
+        ISampleTileSink *pSink;
+        if (!strncmp(argv[3], "udp:", 4)) {
+            if (!udpSink.Open((uint16_t)atoi(argv[3] + 4))) {
+                fprintf(stderr, "cannot open %s\n", argv[3]);
+                return 1;
+            }
+            pSink = &udpSink;
+        } else {
+            if (!fileSink.Open(argv[3])) {
+                fprintf(stderr, "cannot open %s\n", argv[3]);
+                return 1;
+            }
+            pSink = &fileSink;
+        }
+
+        SampleEncoderStats_t total;
+        if (!StreamFrames(argv[2], flSeconds, unThreads, unTileSize, pSink, nullptr, &total)) {
+            return 1;
+        }
+        PrintStats("total", total, flSeconds);
+        return 0;
+    }
+
+    fprintf(stderr, "usage: stream_tool selftest [seconds] [width] [height] [threads] [tile]\n"
+        "       stream_tool stream <name> <file path|udp:port> [seconds] [threads] [tile]\n");
+    return 1;
+}
@@ -0,0 +1,343 @@
+// Decoder for the binary trace rings the driver writes with traceEnabled.
+//
+// usage: trace_tool text <file>...
+//        trace_tool csv <event> <file>...
+//        trace_tool chrome <out.json> <file>...
+//        trace_tool selftest [threads] [records per thread] [ring records]
+//
+// text merges the records of all given ring files (one per traced thread) by
+// time and prints one line per record with the thread and the payload fields.
+// csv prints only one event, one column per field, for plotting. chrome
+// writes Chrome trace_event JSON for Perfetto or chrome://tracing. The files
+// can be read while the driver still writes them; a record that is being
+// overwritten at that moment may come out wrong. selftest writes from several
+// threads at full speed, reports the cost per record and decodes the rings
+// again to check nothing was lost or reordered.
+
+#include "csampletrace.h"
+
+#include "basics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TraceFile_t
+{
+    std::string sPath;
+    std::vector<uint8_t> vecData;
+    const SampleTraceFileHeader_t *pHeader;
+    const SampleTraceRecord_t *pRecords;
+};
+
+struct DecodedRecord_t
+{
+    uint64_t ulTimeNs;
+    uint32_t unFile;
+    const SampleTraceRecord_t *pRecord;
+};
+
+static bool LoadTraceFile(const char *pchPath, TraceFile_t &file)
+{
+    FILE *pFile = fopen(pchPath, "rb");
+    if (!pFile) {
+        fprintf(stderr, "cannot open %s\n", pchPath);
+        return false;
+    }
+    fseek(pFile, 0, SEEK_END);
+    long cbFile = ftell(pFile);
+    fseek(pFile, 0, SEEK_SET);
+    file.sPath = pchPath;
+    file.vecData.resize(cbFile > 0 ? (size_t)cbFile : 0);
+    size_t cbRead = file.vecData.empty() ? 0 : fread(file.vecData.data(), 1, file.vecData.size(), pFile);
+    fclose(pFile);
+
+    file.pHeader = (const SampleTraceFileHeader_t *)file.vecData.data();
+    if (cbRead < k_cbSampleTraceHeader || cbRead != file.vecData.size() || file.pHeader->unMagic != k_unSampleTraceMagic
+        || file.pHeader->unVersion != k_unSampleTraceVersion || file.pHeader->unRecordBytes != sizeof(SampleTraceRecord_t)
+        || k_cbSampleTraceHeader + (size_t)file.pHeader->unRecords * sizeof(SampleTraceRecord_t) > cbRead) {
+        fprintf(stderr, "%s is not a trace file of this version\n", pchPath);
+        return false;
+    }
+    file.pRecords = (const SampleTraceRecord_t *)(file.vecData.data() + k_cbSampleTraceHeader);
+    return true;
+}
+
+// the records still in the ring, oldest first
+static void CollectRecords(const TraceFile_t &file, uint32_t unFile, std::vector<DecodedRecord_t> &vecRecords)
+{
+    const SampleTraceFileHeader_t &header = *file.pHeader;
+    uint64_t ulWritten = header.ulWriteIndex.load(std::memory_order_acquire);
+    uint64_t ulFirst = ulWritten > header.unRecords ? ulWritten - header.unRecords : 0;
+    for (uint64_t i = ulFirst; i < ulWritten; i++) {
+        const SampleTraceRecord_t &record = file.pRecords[i & (header.unRecords - 1)];
+        if (!GetSampleTraceEventInfo(record.unEvent)) {
+            continue;
+        }
+        DecodedRecord_t decoded;
+        decoded.ulTimeNs = header.ulNsBase + (uint64_t)((double)(int64_t)(record.ulTicks - header.ulTickBase) * header.flNsPerTick);
+        decoded.unFile = unFile;
+        decoded.pRecord = &record;
+        vecRecords.push_back(decoded);
+    }
+}
+
+static bool LoadAndMerge(int argc, char **argv, std::vector<TraceFile_t> &vecFiles, std::vector<DecodedRecord_t> &vecRecords)
+{
+    vecFiles.resize(argc);
+    for (int i = 0; i < argc; i++) {
+        if (!LoadTraceFile(argv[i], vecFiles[i])) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < vecFiles.size(); i++) {
+        CollectRecords(vecFiles[i], i, vecRecords);
+    }
+    std::stable_sort(vecRecords.begin(), vecRecords.end(), [](const DecodedRecord_t &a, const DecodedRecord_t &b) { return a.ulTimeNs < b.ulTimeNs; });
+    return true;
+}
+
+static int FormatField(char *pchOut, size_t cbOut, const SampleTraceField_t &field, const SampleTraceRecord_t &record, double flNsPerTick)
+{
+    uint32_t rgunValue[2] = { 0, 0 };
+    float flValue;
+    memcpy(rgunValue, record.rgPayload + field.unOffset, field.unType == SampleTraceField_Ticks64 ? 8 : 4);
+    memcpy(&flValue, record.rgPayload + field.unOffset, sizeof(flValue));
+    uint32_t unValue = rgunValue[0];
+    switch (field.unType) {
+    case SampleTraceField_Float:
+        return snprintf(pchOut, cbOut, "%.4f", flValue);
+    case SampleTraceField_Ticks:
+        return snprintf(pchOut, cbOut, "%.0f", unValue * flNsPerTick);
+    case SampleTraceField_Ticks64:
+        return snprintf(pchOut, cbOut, "%.0f", (double)(((uint64_t)rgunValue[1] << 32) | unValue) * flNsPerTick);
+    case SampleTraceField_Scope:
+        return snprintf(pchOut, cbOut, "%s", GetSampleTraceScopeName(unValue) ? GetSampleTraceScopeName(unValue) : "unknown");
+    case SampleTraceField_Hex:
+        return snprintf(pchOut, cbOut, "0x%x", unValue);
+    default:
+        return snprintf(pchOut, cbOut, "%u", unValue);
+    }
+}
+
+static const char *GetThreadName(const TraceFile_t &file, char *pchBuffer, size_t cbBuffer)
+{
+    if (file.pHeader->rgchThreadName[0]) {
+        snprintf(pchBuffer, cbBuffer, "%.*s", (int)sizeof(file.pHeader->rgchThreadName), file.pHeader->rgchThreadName);
+    } else {
+        snprintf(pchBuffer, cbBuffer, "thread %u", file.pHeader->unThreadIndex);
+    }
+    return pchBuffer;
+}
+
+static int PrintText(int argc, char **argv)
+{
+    std::vector<TraceFile_t> vecFiles;
+    std::vector<DecodedRecord_t> vecRecords;
+    if (!LoadAndMerge(argc, argv, vecFiles, vecRecords)) {
+        return 1;
+    }
+
+    uint64_t ulStartNs = vecRecords.empty() ? 0 : vecRecords.front().ulTimeNs;
+    char rgchThread[48];
+    char rgchValue[64];
+    for (const DecodedRecord_t &decoded : vecRecords) {
+        const TraceFile_t &file = vecFiles[decoded.unFile];
+        const SampleTraceEventInfo_t *pInfo = GetSampleTraceEventInfo(decoded.pRecord->unEvent);
+        printf("%14.6f ms  %-10s %-18s", (decoded.ulTimeNs - ulStartNs) / 1e6, GetThreadName(file, rgchThread, sizeof(rgchThread)), pInfo->pchName);
+        for (uint32_t i = 0; i < pInfo->unFields; i++) {
+            FormatField(rgchValue, sizeof(rgchValue), pInfo->rgFields[i], *decoded.pRecord, file.pHeader->flNsPerTick);
+            printf(" %s=%s", pInfo->rgFields[i].pchName, rgchValue);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+static int PrintCsv(const char *pchEvent, int argc, char **argv)
+{
+    uint32_t unEvent = SampleTraceEvent_Count;
+    for (uint32_t i = 0; i < SampleTraceEvent_Count; i++) {
+        const SampleTraceEventInfo_t *pInfo = GetSampleTraceEventInfo(i);
+        if (pInfo && !strcmp(pInfo->pchName, pchEvent)) {
+            unEvent = i;
+        }
+    }
+    if (unEvent == SampleTraceEvent_Count) {
+        fprintf(stderr, "unknown event %s, one of:", pchEvent);
+        for (uint32_t i = 0; i < SampleTraceEvent_Count; i++) {
+            if (GetSampleTraceEventInfo(i)) {
+                fprintf(stderr, " %s", GetSampleTraceEventInfo(i)->pchName);
+            }
+        }
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    std::vector<TraceFile_t> vecFiles;
+    std::vector<DecodedRecord_t> vecRecords;
+    if (!LoadAndMerge(argc, argv, vecFiles, vecRecords)) {
+        return 1;
+    }
+
+    const SampleTraceEventInfo_t *pInfo = GetSampleTraceEventInfo(unEvent);
+    printf("time_ns,thread");
+    for (uint32_t i = 0; i < pInfo->unFields; i++) {
+        printf(",%s", pInfo->rgFields[i].pchName);
+    }
+    printf("\n");
+
+    char rgchThread[48];
+    char rgchValue[64];
+    for (const DecodedRecord_t &decoded : vecRecords) {
+        if (decoded.pRecord->unEvent != unEvent) {
+            continue;
+        }
+        const TraceFile_t &file = vecFiles[decoded.unFile];
+        printf("%llu,%s", (unsigned long long)decoded.ulTimeNs, GetThreadName(file, rgchThread, sizeof(rgchThread)));
+        for (uint32_t i = 0; i < pInfo->unFields; i++) {
+            FormatField(rgchValue, sizeof(rgchValue), pInfo->rgFields[i], *decoded.pRecord, file.pHeader->flNsPerTick);
+            printf(",%s", rgchValue);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+static int WriteChrome(const char *pchOut, int argc, char **argv)
+{
+    std::vector<TraceFile_t> vecFiles(argc);
+    std::vector<SampleTraceRingView_t> vecViews;
+    for (int i = 0; i < argc; i++) {
+        if (!LoadTraceFile(argv[i], vecFiles[i])) {
+            return 1;
+        }
+        const SampleTraceFileHeader_t *pHeader = vecFiles[i].pHeader;
+        uint64_t ulWritten = pHeader->ulWriteIndex.load(std::memory_order_acquire);
+        SampleTraceRingView_t view = { pHeader, vecFiles[i].pRecords, ulWritten > pHeader->unRecords ? ulWritten - pHeader->unRecords : 0, ulWritten };
+        vecViews.push_back(view);
+    }
+    if (!WriteSampleTraceChromeJson(pchOut, vecViews.data(), (uint32_t)vecViews.size())) {
+        fprintf(stderr, "cannot write %s\n", pchOut);
+        return 1;
+    }
+    return 0;
+}
+
+static void WriteRecords(uint32_t unThread, uint32_t unRecords, std::atomic<uint64_t> *pulElapsedNs)
+{
+    char rgchName[32];
+    snprintf(rgchName, sizeof(rgchName), "writer %u", unThread);
+    SetSampleTraceThreadName(rgchName);
+
+    // the first record maps the file, that is not what we want to time
+    SampleTraceTransportReceive_t receive = { unThread, 0, 0, sizeof(SampleTraceRecord_t) };
+    SampleTrace(receive);
+
+    uint64_t ulStart = GetTimestampNs();
+    for (uint32_t i = 1; i < unRecords; i++) {
+        receive.unSequence = i;
+        SampleTrace(receive);
+    }
+    pulElapsedNs->fetch_add(GetTimestampNs() - ulStart);
+}
+
+static int SelfTest(uint32_t unThreads, uint32_t unRecords, uint32_t unRingRecords)
+{
+    StartSampleTrace("", unRingRecords);
+
+    std::atomic<uint64_t> ulElapsedNs(0);
+    std::vector<std::thread *> vecThreads;
+    for (uint32_t i = 0; i < unThreads; i++) {
+        vecThreads.push_back(new std::thread(WriteRecords, i, unRecords, &ulElapsedNs));
+    }
+    for (std::thread *pThread : vecThreads) {
+        pThread->join();
+        delete pThread;
+    }
+    StopSampleTrace();
+
+    // the same loop with tracing off, which is what the hot paths pay normally
+    SampleTraceTransportReceive_t receive = { 0, 0, 0, 0 };
+    uint64_t ulStart = GetTimestampNs();
+    for (uint32_t i = 0; i < unRecords; i++) {
+        receive.unSequence = i;
+        SampleTrace(receive);
+    }
+    uint64_t ulDisabledNs = GetTimestampNs() - ulStart;
+
+    // the time stamp is most of a record, and costs a lot more under some hypervisors
+    ulStart = GetTimestampNs();
+    for (uint32_t i = 0; i < unRecords; i++) {
+        GetSampleTraceTicks();
+    }
+    uint64_t ulClockNs = GetTimestampNs() - ulStart;
+
+    // with more threads than cores the time of each thread includes the others
+    printf("%u threads, %u records each: %.1f ns per record (%.1f ns of it reading the clock), %.2f ns with tracing off\n", unThreads, unRecords,
+        (double)ulElapsedNs.load() / ((double)unThreads * (unRecords - 1)), (double)ulClockNs / unRecords, (double)ulDisabledNs / unRecords);
+
+    std::vector<std::string> vecPaths;
+    GetSampleTraceFiles(vecPaths);
+    bool bOk = vecPaths.size() == unThreads;
+    for (const std::string &sPath : vecPaths) {
+        TraceFile_t file;
+        if (!LoadTraceFile(sPath.c_str(), file)) {
+            bOk = false;
+            continue;
+        }
+        std::vector<DecodedRecord_t> vecRecords;
+        CollectRecords(file, 0, vecRecords);
+
+        // the ring keeps the newest records, in order and without gaps
+        uint32_t unExpected = unRecords < file.pHeader->unRecords ? unRecords : file.pHeader->unRecords;
+        bool bFileOk = vecRecords.size() == unExpected;
+        for (size_t i = 0; bFileOk && i < vecRecords.size(); i++) {
+            SampleTraceTransportReceive_t decoded;
+            memcpy(&decoded, vecRecords[i].pRecord->rgPayload, sizeof(decoded));
+            bFileOk = vecRecords[i].pRecord->unEvent == SampleTraceEvent_TransportReceive && decoded.unSequence == unRecords - unExpected + i
+                && (i == 0 || vecRecords[i].ulTimeNs >= vecRecords[i - 1].ulTimeNs);
+        }
+        char rgchThread[48];
+        printf("  %s: %zu records %s\n", GetThreadName(file, rgchThread, sizeof(rgchThread)), vecRecords.size(), bFileOk ? "ok" : "BAD");
+        bOk = bOk && bFileOk;
+        remove(sPath.c_str());
+    }
+    printf("%s\n", bOk ? "selftest passed" : "selftest FAILED");
+    return bOk ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *pchMode = argc > 1 ? argv[1] : "selftest";
+
+    if (!strcmp(pchMode, "selftest")) {
+        uint32_t unThreads = argc > 2 ? (uint32_t)atoi(argv[2]) : 4;
+        uint32_t unRecords = argc > 3 ? (uint32_t)atoi(argv[3]) : 1000000;
+        uint32_t unRingRecords = argc > 4 ? (uint32_t)atoi(argv[4]) : 65536;
+        return SelfTest(unThreads > 0 ? unThreads : 1, unRecords > 1 ? unRecords : 2, unRingRecords);
+    }
+
+    if (!strcmp(pchMode, "text") && argc > 2) {
+        return PrintText(argc - 2, argv + 2);
+    }
+
+    if (!strcmp(pchMode, "csv") && argc > 3) {
+        return PrintCsv(argv[2], argc - 3, argv + 3);
+    }
+
+    if (!strcmp(pchMode, "chrome") && argc > 3) {
+        return WriteChrome(argv[2], argc - 3, argv + 3);
+    }
+
+    fprintf(stderr, "usage: trace_tool text <file>...\n"
+                    "       trace_tool csv <event> <file>...\n"
+                    "       trace_tool chrome <out.json> <file>...\n"
+                    "       trace_tool selftest [threads] [records per thread] [ring records]\n");
+    return 1;
+}
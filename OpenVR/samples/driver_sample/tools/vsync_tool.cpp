@@ -0,0 +1,48 @@
+// Runs the software vsync clock on its own and prints how late its thread woke up.
+//
+// usage: vsync_tool [frequency] [seconds]
+//
+// The histogram is what vsyncJitterStats logs from inside the driver every ten
+// seconds. Run it on an idle and on a loaded machine to see how much headroom
+// the display frequency has.
+
+#include "csamplevsyncclock.h"
+
+#include "basics.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+int main(int argc, char **argv)
+{
+    float flFrequency = argc > 1 ? (float)atof(argv[1]) : 90.0f;
+    float flSeconds = argc > 2 ? (float)atof(argv[2]) : 5.0f;
+
+    CSampleVsyncClock vsyncClock;
+    vsyncClock.Start(flFrequency, false, true);
+    std::this_thread::sleep_for(std::chrono::milliseconds((int64_t)(flSeconds * 1000.0f)));
+
+    // the counter must have kept pace with wall time, or vsyncs were lost
+    uint64_t ulVsyncNs;
+    uint64_t ulCounter = vsyncClock.GetVsyncCounter(&ulVsyncNs);
+    vsyncClock.Stop();
+
+    uint64_t rgulBuckets[k_unSampleVsyncJitterBuckets];
+    uint64_t ulMaxNs;
+    uint64_t ulTicks = vsyncClock.GetJitterHistogram(rgulBuckets, &ulMaxNs);
+
+    printf("%.2f Hz for %.1f s: %llu vsyncs (%.1f expected), lateness max %.1f us\n", flFrequency, flSeconds,
+        (unsigned long long)ulCounter, flFrequency * flSeconds, ulMaxNs * 1e-3);
+    uint64_t ulCumulative = 0;
+    for (uint32_t i = 0; i < k_unSampleVsyncJitterBuckets; i++) {
+        ulCumulative += rgulBuckets[i];
+        if (i < k_unSampleVsyncJitterBuckets - 1) {
+            printf("  < %5u us %8llu  %6.2f%%\n", k_rgunSampleVsyncJitterBucketUs[i], (unsigned long long)rgulBuckets[i], ulTicks ? 100.0 * ulCumulative / ulTicks : 0.0);
+        } else {
+            printf("  more       %8llu  %6.2f%%\n", (unsigned long long)rgulBuckets[i], ulTicks ? 100.0 * ulCumulative / ulTicks : 0.0);
+        }
+    }
+    return 0;
+}